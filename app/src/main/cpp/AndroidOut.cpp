@@ -1,4 +1,25 @@
 #include "AndroidOut.h"
 
-AndroidOut androidOut("AO");
-std::ostream aout(&androidOut);
\ No newline at end of file
+void AndroidOut::write(const LogRecord &record) {
+    int priority = ANDROID_LOG_INFO;
+    switch (record.level) {
+        case LOG_LEVEL_VERBOSE:
+            priority = ANDROID_LOG_VERBOSE;
+            break;
+        case LOG_LEVEL_DEBUG:
+            priority = ANDROID_LOG_DEBUG;
+            break;
+        case LOG_LEVEL_INFO:
+            priority = ANDROID_LOG_INFO;
+            break;
+        case LOG_LEVEL_WARN:
+            priority = ANDROID_LOG_WARN;
+            break;
+        case LOG_LEVEL_ERROR:
+        case LOG_LEVEL_SILENT:
+            priority = ANDROID_LOG_ERROR;
+            break;
+    }
+    // Records are terminated by vsnprintf, so the text can go to logcat as is
+    __android_log_write(priority, logTag_, record.text);
+}
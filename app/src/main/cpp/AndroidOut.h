@@ -2,37 +2,28 @@
 #define ANDROIDGLINVESTIGATIONS_ANDROIDOUT_H
 
 #include <android/log.h>
-#include <sstream>
+#include "logger.h"
 
 /*!
- * Use this to log strings out to logcat. Note that you should use std::endl to commit the line
+ * Log sink that writes each record to logcat under one tag, at the priority matching its level.
+ * Install it with startLogging, then log with the LOG macros of logger.h:
  *
  * ex:
- *  aout << "Hello World" << std::endl;
+ *  startLogging(std::make_unique<AndroidOut>("AO"));
+ *  LOGI("Hello %s", "World");
  */
-extern std::ostream aout;
-
-/*!
- * Use this class to create an output stream that writes to logcat. By default, a global one is
- * defined as @a aout
- */
-class AndroidOut: public std::stringbuf {
+class AndroidOut: public LogSink {
 public:
     /*!
-     * Creates a new output stream for logcat
+     * Creates a new sink for logcat
      * @param kLogTag the log tag to output
      */
     inline AndroidOut(const char* kLogTag) : logTag_(kLogTag){}
 
-protected:
-    virtual int sync() override {
-        __android_log_print(ANDROID_LOG_DEBUG, logTag_, "%s", str().c_str());
-        str("");
-        return 0;
-    }
+    void write(const LogRecord &record) override;
 
 private:
     const char* logTag_;
 };
 
-#endif //ANDROIDGLINVESTIGATIONS_ANDROIDOUT_H
\ No newline at end of file
+#endif //ANDROIDGLINVESTIGATIONS_ANDROIDOUT_H
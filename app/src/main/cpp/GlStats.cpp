@@ -0,0 +1,3 @@
+#include "GlStats.h"
+
+GlStats glStats;
@@ -0,0 +1,30 @@
+#ifndef ANDROIDGLINVESTIGATIONS_GLSTATS_H
+#define ANDROIDGLINVESTIGATIONS_GLSTATS_H
+
+#include <cstdint>
+
+/*!
+ * Running totals of the GL work the renderer issues, so steady-state frames can be checked to
+ * upload (almost) nothing. Only touched from the render thread.
+ */
+struct GlStats {
+    //! GL entry points called through GL_COUNTED
+    uint64_t calls = 0;
+
+    //! draw calls, a subset of calls
+    uint64_t drawCalls = 0;
+
+    //! bytes handed to the driver for buffer and texture uploads
+    uint64_t bytesUploaded = 0;
+};
+
+/*!
+ * The render thread's counters. Take a copy at the start of a frame and subtract it at the end to
+ * get per-frame numbers.
+ */
+extern GlStats glStats;
+
+//! calls a GL function, counting it in glStats
+#define GL_COUNTED(call) (++glStats.calls, call)
+
+#endif //ANDROIDGLINVESTIGATIONS_GLSTATS_H
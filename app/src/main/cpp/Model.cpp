@@ -0,0 +1,185 @@
+#include "Model.h"
+
+#include <cstddef>
+#include <cstring>
+
+#include "GlStats.h"
+
+Model::Model(
+        const std::vector<Vertex> &vertices,
+        const std::vector<Index> &indices,
+        std::shared_ptr<TextureAsset> spTexture)
+        : vertexArray_(0),
+          vertexBuffer_(0),
+          indexBuffer_(0),
+          instanceBuffer_(0),
+          indexCount_(static_cast<GLsizei>(indices.size())),
+          instanceCount_(0),
+          instanceCapacity_(0),
+          hasInstances_(false),
+          spTexture_(std::move(spTexture)) {
+    GL_COUNTED(glGenVertexArrays(1, &vertexArray_));
+    GL_COUNTED(glBindVertexArray(vertexArray_));
+
+    // Upload the geometry once. It never changes for the lifetime of the model.
+    GL_COUNTED(glGenBuffers(1, &vertexBuffer_));
+    GL_COUNTED(glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer_));
+    GL_COUNTED(glBufferData(
+            GL_ARRAY_BUFFER,
+            vertices.size() * sizeof(Vertex),
+            vertices.data(),
+            GL_STATIC_DRAW));
+    glStats.bytesUploaded += vertices.size() * sizeof(Vertex);
+
+    // The element buffer binding is part of the vertex array state, so it stays bound to it
+    GL_COUNTED(glGenBuffers(1, &indexBuffer_));
+    GL_COUNTED(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer_));
+    GL_COUNTED(glBufferData(
+            GL_ELEMENT_ARRAY_BUFFER,
+            indices.size() * sizeof(Index),
+            indices.data(),
+            GL_STATIC_DRAW));
+    glStats.bytesUploaded += indices.size() * sizeof(Index);
+
+    // The position attribute is 3 floats, the uv attribute 2 floats right after it
+    GL_COUNTED(glVertexAttribPointer(
+            kPositionAttribute,
+            3,
+            GL_FLOAT,
+            GL_FALSE,
+            sizeof(Vertex),
+            (const void *) offsetof(Vertex, position)));
+    GL_COUNTED(glEnableVertexAttribArray(kPositionAttribute));
+    GL_COUNTED(glVertexAttribPointer(
+            kUVAttribute,
+            2,
+            GL_FLOAT,
+            GL_FALSE,
+            sizeof(Vertex),
+            (const void *) offsetof(Vertex, uv)));
+    GL_COUNTED(glEnableVertexAttribArray(kUVAttribute));
+
+    GL_COUNTED(glGenBuffers(1, &instanceBuffer_));
+
+    GL_COUNTED(glBindVertexArray(0));
+    GL_COUNTED(glBindBuffer(GL_ARRAY_BUFFER, 0));
+}
+
+Model::Model(Model &&other) noexcept
+        : vertexArray_(other.vertexArray_),
+          vertexBuffer_(other.vertexBuffer_),
+          indexBuffer_(other.indexBuffer_),
+          instanceBuffer_(other.instanceBuffer_),
+          indexCount_(other.indexCount_),
+          instanceCount_(other.instanceCount_),
+          instanceCapacity_(other.instanceCapacity_),
+          hasInstances_(other.hasInstances_),
+          spTexture_(std::move(other.spTexture_)) {
+    other.vertexArray_ = 0;
+    other.vertexBuffer_ = 0;
+    other.indexBuffer_ = 0;
+    other.instanceBuffer_ = 0;
+}
+
+Model &Model::operator=(Model &&other) noexcept {
+    if (this != &other) {
+        release();
+        vertexArray_ = other.vertexArray_;
+        vertexBuffer_ = other.vertexBuffer_;
+        indexBuffer_ = other.indexBuffer_;
+        instanceBuffer_ = other.instanceBuffer_;
+        indexCount_ = other.indexCount_;
+        instanceCount_ = other.instanceCount_;
+        instanceCapacity_ = other.instanceCapacity_;
+        hasInstances_ = other.hasInstances_;
+        spTexture_ = std::move(other.spTexture_);
+        other.vertexArray_ = 0;
+        other.vertexBuffer_ = 0;
+        other.indexBuffer_ = 0;
+        other.instanceBuffer_ = 0;
+    }
+    return *this;
+}
+
+Model::~Model() {
+    release();
+}
+
+void Model::updateInstances(
+        const std::vector<CellInstance> &instances,
+        const std::vector<InstanceRange> &dirtyRanges) {
+    GL_COUNTED(glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer_));
+
+    if (!hasInstances_) {
+        // Both instance attributes stay integers in memory and arrive in the shader as floats.
+        // They advance once per instance rather than once per vertex.
+        GL_COUNTED(glBindVertexArray(vertexArray_));
+        GL_COUNTED(glVertexAttribPointer(
+                kCellAttribute,
+                2,
+                GL_UNSIGNED_SHORT,
+                GL_FALSE,
+                sizeof(CellInstance),
+                (const void *) offsetof(CellInstance, x)));
+        GL_COUNTED(glVertexAttribDivisor(kCellAttribute, 1));
+        GL_COUNTED(glEnableVertexAttribArray(kCellAttribute));
+        GL_COUNTED(glVertexAttribPointer(
+                kTileAttribute,
+                1,
+                GL_UNSIGNED_BYTE,
+                GL_FALSE,
+                sizeof(CellInstance),
+                (const void *) offsetof(CellInstance, tile)));
+        GL_COUNTED(glVertexAttribDivisor(kTileAttribute, 1));
+        GL_COUNTED(glEnableVertexAttribArray(kTileAttribute));
+        GL_COUNTED(glBindVertexArray(0));
+        hasInstances_ = true;
+    }
+
+    size_t dirtyCount = 0;
+    for (const auto &range: dirtyRanges) {
+        dirtyCount += range.count;
+    }
+
+    if (instances.size() > instanceCapacity_ || dirtyCount * 2 >= instances.size()) {
+        // Re-specifying the whole store orphans the old one, so the driver can hand out fresh
+        // memory instead of waiting for frames still reading it.
+        GL_COUNTED(glBufferData(
+                GL_ARRAY_BUFFER,
+                instances.size() * sizeof(CellInstance),
+                instances.data(),
+                GL_DYNAMIC_DRAW));
+        glStats.bytesUploaded += instances.size() * sizeof(CellInstance);
+        instanceCapacity_ = instances.size();
+    } else {
+        for (const auto &range: dirtyRanges) {
+            GLsizeiptr offset = range.first * sizeof(CellInstance);
+            GLsizeiptr length = range.count * sizeof(CellInstance);
+            void *mapped = GL_COUNTED(glMapBufferRange(
+                    GL_ARRAY_BUFFER,
+                    offset,
+                    length,
+                    GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT));
+            if (mapped) {
+                memcpy(mapped, instances.data() + range.first, length);
+                GL_COUNTED(glUnmapBuffer(GL_ARRAY_BUFFER));
+                glStats.bytesUploaded += length;
+            }
+        }
+    }
+    instanceCount_ = static_cast<GLsizei>(instances.size());
+
+    GL_COUNTED(glBindBuffer(GL_ARRAY_BUFFER, 0));
+}
+
+void Model::release() {
+    if (vertexArray_) {
+        glDeleteVertexArrays(1, &vertexArray_);
+        vertexArray_ = 0;
+    }
+    GLuint buffers[] = {vertexBuffer_, indexBuffer_, instanceBuffer_};
+    glDeleteBuffers(3, buffers);
+    vertexBuffer_ = 0;
+    indexBuffer_ = 0;
+    instanceBuffer_ = 0;
+}
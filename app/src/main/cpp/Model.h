@@ -1,8 +1,11 @@
 #ifndef ANDROIDGLINVESTIGATIONS_MODEL_H
 #define ANDROIDGLINVESTIGATIONS_MODEL_H
 
+#include <GLES3/gl3.h>
+#include <memory>
 #include <vector>
 #include "TextureAsset.h"
+#include "board_instances.h"
 
 union Vector3 {
     struct {
@@ -31,26 +34,62 @@ struct Vertex {
 
 typedef uint16_t Index;
 
+/*!
+ * Fixed attribute locations shared by every Model and Shader. Shader binds its attribute names to
+ * these before linking, so a model's vertex array works with any shader.
+ */
+static constexpr GLuint kPositionAttribute = 0;
+static constexpr GLuint kUVAttribute = 1;
+static constexpr GLuint kCellAttribute = 2;
+static constexpr GLuint kTileAttribute = 3;
+
+/*!
+ * Geometry living in GPU buffers. The vertex and index buffers are uploaded once on construction
+ * and recorded with their attribute layout in a vertex array object, so drawing binds one object
+ * instead of re-specifying every attribute. A model may also carry a buffer of CellInstances that
+ * is updated in place, range by range.
+ *
+ * Models own GL objects: create and destroy them with the GL context current. They can be moved
+ * but not copied.
+ */
 class Model {
 public:
-    inline Model(
-            std::vector<Vertex> vertices,
-            std::vector<Index> indices,
-            std::shared_ptr<TextureAsset> spTexture)
-            : vertices_(std::move(vertices)),
-              indices_(std::move(indices)),
-              spTexture_(std::move(spTexture)) {}
-
-    inline const Vertex *getVertexData() const {
-        return vertices_.data();
+    Model(
+            const std::vector<Vertex> &vertices,
+            const std::vector<Index> &indices,
+            std::shared_ptr<TextureAsset> spTexture);
+
+    Model(Model &&other) noexcept;
+
+    Model &operator=(Model &&other) noexcept;
+
+    Model(const Model &) = delete;
+
+    Model &operator=(const Model &) = delete;
+
+    ~Model();
+
+    /*!
+     * Uploads the changed part of an instance array, growing the instance buffer when the array
+     * grows. Large updates orphan and refill the whole buffer; small ones map and write only the
+     * dirty ranges.
+     * @param instances the full instance array, the model draws instances.size() instances
+     * @param dirtyRanges the instances that changed since the last upload
+     */
+    void updateInstances(
+            const std::vector<CellInstance> &instances,
+            const std::vector<InstanceRange> &dirtyRanges);
+
+    inline GLuint getVertexArray() const {
+        return vertexArray_;
     }
 
-    inline const size_t getIndexCount() const {
-        return indices_.size();
+    inline GLsizei getIndexCount() const {
+        return indexCount_;
     }
 
-    inline const Index *getIndexData() const {
-        return indices_.data();
+    inline GLsizei getInstanceCount() const {
+        return instanceCount_;
     }
 
     inline const TextureAsset &getTexture() const {
@@ -58,9 +97,19 @@ public:
     }
 
 private:
-    std::vector<Vertex> vertices_;
-    std::vector<Index> indices_;
+    void release();
+
+    GLuint vertexArray_;
+    GLuint vertexBuffer_;
+    GLuint indexBuffer_;
+    GLuint instanceBuffer_;
+    GLsizei indexCount_;
+    GLsizei instanceCount_;
+    //! instances the instance buffer has storage for
+    size_t instanceCapacity_;
+    //! whether the instance attributes are enabled in the vertex array yet
+    bool hasInstances_;
     std::shared_ptr<TextureAsset> spTexture_;
 };
 
-#endif //ANDROIDGLINVESTIGATIONS_MODEL_H
\ No newline at end of file
+#endif //ANDROIDGLINVESTIGATIONS_MODEL_H
@@ -2,55 +2,115 @@
 
 #include <game-activity/native_app_glue/android_native_app_glue.h>
 #include <GLES3/gl3.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
 #include <memory>
 #include <vector>
 #include <android/imagedecoder.h>
+#include <jni.h>
 
-#include "AndroidOut.h"
+#include "logger.h"
+#include "GlStats.h"
 #include "Shader.h"
+#include "native-lib.h"
 #include "Utility.h"
 #include "TextureAsset.h"
+#include "glyph_atlas.h"
+#include "trace.h"
 
 //! executes glGetString and outputs the result to logcat
-#define PRINT_GL_STRING(s) {aout << #s": "<< glGetString(s) << std::endl;}
+#define PRINT_GL_STRING(s) LOGI(#s": %s", (const char *) glGetString(s))
 
 /*!
  * @brief if glGetString returns a space separated list of elements, prints each one on a new line
  *
- * This works by creating an istringstream of the input c-style string. Then that is used to create
- * a vector -- each element of the vector is a new element in the input string. Finally a foreach
- * loop consumes this and outputs it to logcat using @a aout
+ * Each element is copied out of the input c-style string and logged as its own debug line, so long
+ * lists are not cut to one log record.
  */
 #define PRINT_GL_STRING_AS_LIST(s) { \
-std::istringstream extensionStream((const char *) glGetString(s));\
-std::vector<std::string> extensionList(\
-        std::istream_iterator<std::string>{extensionStream},\
-        std::istream_iterator<std::string>());\
-aout << #s":\n";\
-for (auto& extension: extensionList) {\
-    aout << extension << "\n";\
+LOGD(#s":");\
+const char *element = (const char *) glGetString(s);\
+while (element != nullptr && *element != '\0') {\
+    size_t length = std::strcspn(element, " ");\
+    if (length > 0) {\
+        LOGD("%.*s", static_cast<int>(length), element);\
+    }\
+    element += length + std::strspn(element + length, " ");\
 }\
-aout << std::endl;\
 }
 
 //! Color for cornflower blue. Can be sent directly to glClearColor
 #define CORNFLOWER_BLUE 100 / 255.f, 149 / 255.f, 237 / 255.f, 1
 
-// Vertex shader, you'd typically load this from assets
+// Vertex shader, you'd typically load this from assets. Draws one unit quad per board cell, placed
+// by the instance cell position and textured with the instance tile of the atlas. The glyph layers
+// of the tile are looked up in tables baked with the glyph atlas, see GLYPH_UNIFORMS.
 static const char *vertex = R"vertex(#version 300 es
 in vec3 inPosition;
 in vec2 inUV;
+in vec2 inCell;
+in float inTile;
 
 out vec2 fragUV;
+out vec4 fragGlyphUV;
+flat out vec4 fragGlyphColour0;
+flat out vec4 fragGlyphColour1;
 
 uniform mat4 uProjection;
+uniform vec4 uGlyphOrigins[32];
+uniform vec4 uGlyphColours[32];
+
+const float kAtlasColumns = 4.0;
+const float kGlyphColumns = 4.0;
 
 void main() {
-    fragUV = inUV;
-    gl_Position = uProjection * vec4(inPosition, 1.0);
+    vec2 tile = vec2(mod(inTile, kAtlasColumns), floor(inTile / kAtlasColumns));
+    fragUV = (tile + inUV) / kAtlasColumns;
+    int layer = int(inTile) * 2;
+    fragGlyphUV = vec4(uGlyphOrigins[layer].xy, uGlyphOrigins[layer + 1].xy)
+            + inUV.xyxy / kGlyphColumns;
+    fragGlyphColour0 = uGlyphColours[layer];
+    fragGlyphColour1 = uGlyphColours[layer + 1];
+    gl_Position = uProjection * vec4(inCell + inPosition.xy, 0.0, 1.0);
 }
 )vertex";
 
+static_assert(GLYPH_TILES * GLYPH_LAYERS == 32 && GLYPH_LAYERS == 2 && GLYPH_COLUMNS == 4,
+              "the cell shaders hard code the glyph tables' layout");
+
+// Fragment shader for cells: the atlas background with up to two glyphs cut from their distance
+// fields on top. The edge is smoothed over about one screen pixel whatever the zoom, so glyphs stay
+// sharp when magnified and do not shimmer when small.
+static const char *cellFragment = R"fragment(#version 300 es
+precision mediump float;
+
+in vec2 fragUV;
+in vec4 fragGlyphUV;
+flat in vec4 fragGlyphColour0;
+flat in vec4 fragGlyphColour1;
+
+uniform sampler2D uTexture;
+uniform sampler2D uGlyphs;
+
+out vec4 outColor;
+
+float coverage(vec2 uv) {
+    float distance = texture(uGlyphs, uv).r;
+    float width = max(fwidth(distance), 1.0 / 255.0) * 0.5;
+    return smoothstep(0.5 - width, 0.5 + width, distance);
+}
+
+void main() {
+    vec4 colour = texture(uTexture, fragUV);
+    float cover0 = fragGlyphColour0.a * coverage(fragGlyphUV.xy);
+    float cover1 = fragGlyphColour1.a * coverage(fragGlyphUV.zw);
+    colour.rgb = mix(mix(colour.rgb, fragGlyphColour0.rgb, cover0), fragGlyphColour1.rgb, cover1);
+    outColor = colour;
+}
+)fragment";
+
 // Fragment shader, you'd typically load this from assets
 static const char *fragment = R"fragment(#version 300 es
 precision mediump float;
@@ -66,25 +126,81 @@ void main() {
 }
 )fragment";
 
+// Vertex shader for zoomed out boards, where each render tile is a single quad textured with one
+// texel per cell
+static const char *texelVertex = R"vertex(#version 300 es
+in vec3 inPosition;
+in vec2 inUV;
+
+out vec2 fragUV;
+
+uniform mat4 uProjection;
+
+void main() {
+    fragUV = inUV;
+    gl_Position = uProjection * vec4(inPosition, 1.0);
+}
+)vertex";
+
 /*!
- * Half the height of the projection matrix. This gives you a renderable area of height 4 ranging
- * from -2 to 2
+ * Pixel size of one atlas tile. Cells are rarely drawn larger than this on a phone.
  */
-static constexpr float kProjectionHalfHeight = 2.f;
+static constexpr int32_t kAtlasTileSize = 64;
 
 /*!
- * The near plane distance for the projection matrix. Since this is an orthographic projection
- * matrix, it's convenient to have negative values for sorting (and avoiding z-fighting at 0).
+ * Time a frame may spend uploading the cell atlas, and the rows uploaded between checks of it.
  */
-static constexpr float kProjectionNearPlane = -1.f;
+static constexpr int64_t kAtlasUploadNanos = 2'000'000;
+static constexpr int32_t kAtlasUploadRows = 32;
 
 /*!
- * The far plane distance for the projection matrix. Since this is an orthographic porjection
- * matrix, it's convenient to have the far plane equidistant from 0 as the near plane.
+ * @return the steady clock in nanoseconds, for the startup profile
  */
-static constexpr float kProjectionFarPlane = 1.f;
+static int64_t steadyNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/*!
+ * Frames averaged into each logged line of GL statistics, about ten seconds at 60 Hz.
+ */
+static constexpr int32_t kStatsWindowFrames = 600;
+
+//! measured inputs between input latency reports
+static constexpr uint64_t kLatencyReportSamples = 200;
+
+/*!
+ * Cells a frame applies from a reveal. A large opening spreads over frames as a wave from the cell
+ * tapped, about a second for a million cells at 60 Hz: no frame floods, patches or uploads more
+ * than this many cells.
+ */
+static constexpr int32_t kRevealCellsPerFrame = 16384;
+
+//! Set to 1 to log every EGL config considered and the full GL extension list at startup. Both
+//! take a noticeable share of startup and are only useful when bringing up a new device.
+#ifndef MINESWEEPER_GL_DIAGNOSTICS
+#define MINESWEEPER_GL_DIAGNOSTICS 0
+#endif
+
+//! Set to 1 to log every input event and gesture to logcat. Formatting and logging an event costs
+//! far more than recognizing it, so it is compiled out by default.
+#ifndef MINESWEEPER_LOG_INPUT
+#define MINESWEEPER_LOG_INPUT 0
+#endif
 
 Renderer::~Renderer() {
+    // games still being stored use statsStore_
+    {
+        std::unique_lock<std::mutex> lock(pendingGamesMutex_);
+        pendingGamesIdle_.wait(lock, [this]() { return pendingGames_ == 0; });
+    }
+    // GL objects have to go while the context is still current
+    tileModels_.clear();
+    texelTiles_.clear();
+    spAtlas_.reset();
+    spGlyphs_.reset();
+    shader_.reset();
+    texelShader_.reset();
     if (display_ != EGL_NO_DISPLAY) {
         eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
         if (context_ != EGL_NO_CONTEXT) {
@@ -101,53 +217,125 @@ Renderer::~Renderer() {
 }
 
 void Renderer::render() {
+    ScopedTrace trace(TraceOp::RENDER);
+
     // Check to see if the surface has changed size. This is _necessary_ to do every frame when
     // using immersive mode as you'll get no other notification that your renderable area has
     // changed.
     updateRenderArea();
 
-    // When the renderable area changes, the projection matrix has to also be updated. This is true
-    // even if you change from the sample orthographic projection matrix as your aspect ratio has
-    // likely changed.
-    if (shaderNeedsNewProjectionMatrix_) {
-        // a placeholder projection matrix allocated on the stack. Column-major memory layout
-        float projectionMatrix[16] = {0};
-
-        // build an orthographic projection matrix for 2d rendering
-        Utility::buildOrthographicMatrix(
-                projectionMatrix,
-                kProjectionHalfHeight,
-                float(width_) / height_,
-                kProjectionNearPlane,
-                kProjectionFarPlane);
-
-        // send the matrix to the shader
-        // Note: the shader must be active for this to work. Since we only have one shader for this
-        // demo, we can assume that it's active.
-        shader_->setProjectionMatrix(projectionMatrix);
-
-        // make sure the matrix isn't generated every frame
-        shaderNeedsNewProjectionMatrix_ = false;
-    }
+    GlStats frameStart = glStats;
+    int32_t latencyFrame = inputLatency_.beginFrame();
 
     // clear the color buffer
-    glClear(GL_COLOR_BUFFER_BIT);
-
-    // Render all the models. There's no depth testing in this sample so they're accepted in the
-    // order provided. But the sample EGL setup requests a 24 bit depth buffer so you could
-    // configure it at the end of initRenderer
-    if (!models_.empty()) {
-        for (const auto &model: models_) {
-            shader_->drawModel(model);
+    GL_COUNTED(glClear(GL_COLOR_BUFFER_BIT));
+
+    uploadAtlas();
+
+    {
+        std::lock_guard<std::mutex> lock(gameBoardMutex);
+        if (gameBoard) {
+            if (gameBoard->isRevealPending()) {
+                ScopedTrace revealTrace(TraceOp::REVEAL_CELL);
+                countTrace(
+                        TraceCounter::CELLS_REVEALED,
+                        gameBoard->advanceReveal(kRevealCellsPerFrame));
+            }
+            ScopedTrace drawTrace(TraceOp::DRAW_BOARD);
+            drawBoard(*gameBoard);
         }
+        hasDrawnBoard_ = gameBoard != nullptr;
+        isRevealPending_ = gameBoard && gameBoard->isRevealPending();
     }
 
+    // With presentation times the inputs drawn in this frame are measured to when it is on screen,
+    // otherwise to when the swap returns
+    EGLuint64KHR eglFrameId = 0;
+    bool isPresentQueried = latencyFrame >= 0 && getNextFrameId_
+                            && presentQueryCount_ < LATENCY_FRAMES_IN_FLIGHT
+                            && getNextFrameId_(display_, surface_, &eglFrameId);
+    inputLatency_.onSwapStarted(latencyFrame);
+
     // Present the rendered image. This is an implicit glFlush.
     auto swapResult = eglSwapBuffers(display_, surface_);
     assert(swapResult == EGL_TRUE);
+
+    inputLatency_.onSwapFinished(latencyFrame, isPresentQueried);
+    if (isPresentQueried) {
+        presentQueries_[presentQueryCount_++] = PresentQuery{latencyFrame, eglFrameId};
+    }
+    pollPresentTimes();
+    reportInputLatency();
+
+    if (!startupProfile_.isComplete()) {
+        reportStartup();
+    }
+
+    countTrace(TraceCounter::GL_DRAWS, glStats.drawCalls - frameStart.drawCalls);
+    logFrameStats(frameStart);
+}
+
+void Renderer::pollPresentTimes() {
+    static constexpr EGLint kPresentTime[] = {EGL_DISPLAY_PRESENT_TIME_ANDROID};
+    int32_t kept = 0;
+    for (int32_t i = 0; i < presentQueryCount_; i++) {
+        const PresentQuery &query = presentQueries_[i];
+        EGLnsecsANDROID presentNanos = EGL_TIMESTAMP_INVALID_ANDROID;
+        bool isAnswered = getFrameTimestamps_(display_, surface_, query.eglFrameId, 1,
+                                              kPresentTime, &presentNanos);
+        if (isAnswered && presentNanos == EGL_TIMESTAMP_PENDING_ANDROID) {
+            presentQueries_[kept++] = query;
+        } else if (isAnswered && presentNanos >= 0) {
+            inputLatency_.onPresented(query.latencyFrame, presentNanos);
+        } else {
+            inputLatency_.onPresentUnknown(query.latencyFrame);
+        }
+    }
+    presentQueryCount_ = kept;
+}
+
+void Renderer::reportInputLatency() {
+    if (inputLatency_.getSamples() < kLatencyReportSamples) {
+        return;
+    }
+    char line[LOG_TEXT_BYTES];
+    inputLatency_.format(line, sizeof(line));
+    LOGI("Input latency %s", line);
+    inputLatency_.clear();
+}
+
+void Renderer::reportStartup() {
+    int64_t now = steadyNanos();
+    startupProfile_.mark(StartupPhase::FIRST_SWAP, now);
+    if (!isAtlasUploaded_) {
+        return;
+    }
+    startupProfile_.mark(StartupPhase::FIRST_FULL_FRAME, now);
+
+    char line[LOG_TEXT_BYTES];
+    startupProfile_.format(line, sizeof(line));
+    LOGI("Startup %s", line);
+}
+
+void Renderer::logFrameStats(const GlStats &frameStart) {
+    statsWindow_.calls += glStats.calls - frameStart.calls;
+    statsWindow_.drawCalls += glStats.drawCalls - frameStart.drawCalls;
+    statsWindow_.bytesUploaded += glStats.bytesUploaded - frameStart.bytesUploaded;
+    statsWindowFrames_++;
+    if (statsWindowFrames_ < kStatsWindowFrames) {
+        return;
+    }
+    LOGD("GL per frame over %d frames: %g calls, %g draws, %g bytes uploaded",
+         int(statsWindowFrames_), double(statsWindow_.calls) / statsWindowFrames_,
+         double(statsWindow_.drawCalls) / statsWindowFrames_,
+         double(statsWindow_.bytesUploaded) / statsWindowFrames_);
+    statsWindow_ = GlStats();
+    statsWindowFrames_ = 0;
 }
 
 void Renderer::initRenderer() {
+    startupProfile_.begin(steadyNanos());
+
     // Choose your render attributes
     constexpr EGLint attribs[] = {
             EGL_RENDERABLE_TYPE, EGL_OPENGL_ES3_BIT,
@@ -184,15 +372,19 @@ void Renderer::initRenderer() {
                     && eglGetConfigAttrib(display, config, EGL_BLUE_SIZE, &blue)
                     && eglGetConfigAttrib(display, config, EGL_DEPTH_SIZE, &depth)) {
 
-                    aout << "Found config with " << red << ", " << green << ", " << blue << ", "
-                         << depth << std::endl;
+#if MINESWEEPER_GL_DIAGNOSTICS
+                    LOGD("Found config with %d, %d, %d, %d", red, green, blue, depth);
+#endif
                     return red == 8 && green == 8 && blue == 8 && depth == 24;
                 }
                 return false;
             });
 
-    aout << "Found " << numConfigs << " configs" << std::endl;
-    aout << "Chose " << config << std::endl;
+#if MINESWEEPER_GL_DIAGNOSTICS
+    LOGD("Found %d configs", numConfigs);
+    LOGD("Chose %p", config);
+#endif
+    startupProfile_.mark(StartupPhase::EGL_INIT, steadyNanos());
 
     // create the proper window surface
     EGLint format;
@@ -215,18 +407,68 @@ void Renderer::initRenderer() {
     width_ = -1;
     height_ = -1;
 
+    startupProfile_.mark(StartupPhase::CONTEXT, steadyNanos());
+
+    // Presentation times let input latency run to the moment a frame is on screen
+    const char *eglExtensions = eglQueryString(display, EGL_EXTENSIONS);
+    if (eglExtensions && std::strstr(eglExtensions, "EGL_ANDROID_get_frame_timestamps")
+        && eglSurfaceAttrib(display, surface, EGL_TIMESTAMPS_ANDROID, EGL_TRUE)) {
+        getNextFrameId_ = reinterpret_cast<PFNEGLGETNEXTFRAMEIDANDROIDPROC>(
+                eglGetProcAddress("eglGetNextFrameIdANDROID"));
+        getFrameTimestamps_ = reinterpret_cast<PFNEGLGETFRAMETIMESTAMPSANDROIDPROC>(
+                eglGetProcAddress("eglGetFrameTimestampsANDROID"));
+        if (!getNextFrameId_ || !getFrameTimestamps_) {
+            getNextFrameId_ = nullptr;
+            getFrameTimestamps_ = nullptr;
+        }
+    }
+
     PRINT_GL_STRING(GL_VENDOR);
     PRINT_GL_STRING(GL_RENDERER);
     PRINT_GL_STRING(GL_VERSION);
+#if MINESWEEPER_GL_DIAGNOSTICS
     PRINT_GL_STRING_AS_LIST(GL_EXTENSIONS);
-
-    shader_ = std::unique_ptr<Shader>(
-            Shader::loadShader(vertex, fragment, "inPosition", "inUV", "uProjection"));
+#endif
+
+    // Linked programs are cached per driver, so only the first start after an install or a driver
+    // update compiles them
+    std::string dataPath = app_->activity->internalDataPath;
+    shader_ = std::unique_ptr<Shader>(Shader::loadShader(
+            vertex,
+            cellFragment,
+            "inPosition",
+            "inUV",
+            "uProjection",
+            "inCell",
+            "inTile",
+            dataPath + "/program_cells.bin"));
     assert(shader_);
 
-    // Note: there's only one shader in this demo, so I'll activate it here. For a more complex game
-    // you'll want to track the active shader and activate/deactivate it as necessary
+    // uniforms are not part of the program binary, so they are set on every start
     shader_->activate();
+    shader_->setVector4Array(
+            "uGlyphOrigins",
+            GLYPH_UNIFORMS.origins.data(),
+            GLYPH_TILES * GLYPH_LAYERS);
+    shader_->setVector4Array(
+            "uGlyphColours",
+            GLYPH_UNIFORMS.colours.data(),
+            GLYPH_TILES * GLYPH_LAYERS);
+    shader_->setTextureUnit("uGlyphs", 1);
+
+    texelShader_ = std::unique_ptr<Shader>(Shader::loadShader(
+            texelVertex,
+            fragment,
+            "inPosition",
+            "inUV",
+            "uProjection",
+            "",
+            "",
+            dataPath + "/program_texels.bin"));
+    assert(texelShader_);
+
+    startupProfile_.isShaderCached = shader_->isFromCache() && texelShader_->isFromCache();
+    startupProfile_.mark(StartupPhase::SHADERS, steadyNanos());
 
     // setup any other gl related global states
     glClearColor(CORNFLOWER_BLUE);
@@ -235,7 +477,9 @@ void Renderer::initRenderer() {
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-    // get some demo models into memory
+    instanceBuilder_.setCellBudget(kRevealCellsPerFrame);
+
+    // tiles of the board are drawn from quad models sharing one atlas, created as they come on screen
     createModels();
 }
 
@@ -250,18 +494,89 @@ void Renderer::updateRenderArea() {
         width_ = width;
         height_ = height;
         glViewport(0, 0, width, height);
+        camera_.resize(width, height);
 
         // make sure that we lazily recreate the projection matrix before we render
         shaderNeedsNewProjectionMatrix_ = true;
     }
 }
 
-/**
- * @brief Create any demo models we want for this demo.
- */
 void Renderer::createModels() {
+    // the glyphs are compiled into the library as a distance field, so they cost one upload and no
+    // I/O. They stay bound to texture unit 1 for the cell shader; draws only rebind unit 0.
+    spGlyphs_ = TextureAsset::createFromChannel(
+            GLYPH_ATLAS_SIZE,
+            GLYPH_ATLAS_SIZE,
+            GLYPH_ATLAS.data());
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, spGlyphs_->getTextureID());
+    glActiveTexture(GL_TEXTURE0);
+
+    // the atlas of cell states is drawn rather than decoded, see buildAtlasImage. Drawing it on
+    // the workers or reading it back from the cache happens off this thread, which draws the first
+    // frames from texels meanwhile.
+    // finished games are appended to a log; its index keeps queries from ever reading the log
+    if (!statsStore_.open(std::string(app_->activity->internalDataPath) + "/stats")) {
+        LOGW("Game statistics are unavailable, finished games will not be recorded");
+    }
+
+    ALooper *looper = app_->looper;
+    atlasLoader_.start(
+            std::string(app_->activity->internalDataPath) + "/cell_atlas.bin",
+            kAtlasTileSize,
+            [looper]() { ALooper_wake(looper); });
+}
+
+void Renderer::uploadAtlas() {
+    if (isAtlasUploaded_ || !atlasLoader_.isReady()) {
+        return;
+    }
+    const AtlasImage &image = atlasLoader_.getImage();
+    if (!spAtlas_) {
+        int32_t side = image.getLevelSide(0);
+        spAtlas_ = TextureAsset::createStorage(side, side, int32_t(image.levels.size()));
+    }
+
+    // Every level is small, but a band at a time keeps a slow driver from stalling a frame on it
+    int64_t deadline = steadyNanos() + kAtlasUploadNanos;
+    while (atlasLevel_ < int32_t(image.levels.size())) {
+        int32_t side = image.getLevelSide(atlasLevel_);
+        int32_t rows = std::min(kAtlasUploadRows, side - atlasRow_);
+        spAtlas_->uploadRows(
+                atlasLevel_,
+                side,
+                atlasRow_,
+                rows,
+                image.levels[atlasLevel_].data() + size_t(atlasRow_) * side * 4);
+        atlasRow_ += rows;
+        if (atlasRow_ == side) {
+            atlasLevel_++;
+            atlasRow_ = 0;
+        }
+        if (steadyNanos() >= deadline) {
+            break;
+        }
+    }
+    if (atlasLevel_ < int32_t(image.levels.size())) {
+        return;
+    }
+
+    // the pixels stay with the loader, which may still be writing them to the cache
+    isAtlasUploaded_ = true;
+    startupProfile_.isAtlasCached = atlasLoader_.wasCached();
+    startupProfile_.mark(StartupPhase::ASSETS, steadyNanos());
+}
+
+Model Renderer::createQuad(
+        float left,
+        float top,
+        float right,
+        float bottom,
+        float uvRight,
+        float uvBottom,
+        std::shared_ptr<TextureAsset> spTexture) {
     /*
-     * This is a square:
+     * A quad with its top left corner at (left, top) in cell coordinates:
      * 0 --- 1
      * | \   |
      * |  \  |
@@ -269,110 +584,388 @@ void Renderer::createModels() {
      * 3 --- 2
      */
     std::vector<Vertex> vertices = {
-            Vertex(Vector3{1, 1, 0}, Vector2{0, 0}), // 0
-            Vertex(Vector3{-1, 1, 0}, Vector2{1, 0}), // 1
-            Vertex(Vector3{-1, -1, 0}, Vector2{1, 1}), // 2
-            Vertex(Vector3{1, -1, 0}, Vector2{0, 1}) // 3
+            Vertex(Vector3{left, top, 0}, Vector2{0, 0}), // 0
+            Vertex(Vector3{right, top, 0}, Vector2{uvRight, 0}), // 1
+            Vertex(Vector3{right, bottom, 0}, Vector2{uvRight, uvBottom}), // 2
+            Vertex(Vector3{left, bottom, 0}, Vector2{0, uvBottom}) // 3
     };
     std::vector<Index> indices = {
-            0, 1, 2, 0, 2, 3
+            0, 2, 1, 0, 3, 2
     };
+    return Model(vertices, indices, std::move(spTexture));
+}
 
-    // loads an image and assigns it to the square.
-    //
-    // Note: there is no texture management in this sample, so if you reuse an image be careful not
-    // to load it repeatedly. Since you get a shared_ptr you can safely reuse it in many models.
-    auto assetManager = app_->activity->assetManager;
-    auto spAndroidRobotTexture = TextureAsset::loadAsset(assetManager, "android_robot.png");
+void Renderer::updateViewProjection() {
+    if (!shaderNeedsNewProjectionMatrix_ && camera_.getRevision() == cameraRevision_) {
+        return;
+    }
+
+    // Culling inverts this matrix, so the tiles kept are exactly those it puts on screen
+    camera_.buildViewProjection(viewProjection_);
+    viewRect_ = viewRectFromMatrix(viewProjection_);
 
-    // Create a model and put it in the back of the render list.
-    models_.emplace_back(vertices, indices, spAndroidRobotTexture);
+    // the shaders must be active to take the matrix
+    texelShader_->activate();
+    texelShader_->setProjectionMatrix(viewProjection_);
+    shader_->activate();
+    shader_->setProjectionMatrix(viewProjection_);
+
+    cameraRevision_ = camera_.getRevision();
+    shaderNeedsNewProjectionMatrix_ = false;
 }
 
-void Renderer::handleInput() {
-    // handle all queued inputs
-    auto *inputBuffer = android_app_swap_input_buffers(app_);
-    if (!inputBuffer) {
-        // no inputs yet.
+void Renderer::drawBoard(GameBoard &board) {
+    // Only instances the board reported as changed are patched into the tiles
+    instanceBuilder_.update(board);
+
+    if (board.getWidth() != boardWidth_ || board.getHeight() != boardHeight_) {
+        boardWidth_ = board.getWidth();
+        boardHeight_ = board.getHeight();
+        camera_.reset(width_, height_, boardWidth_, boardHeight_);
+
+        // tile geometry depends on the board size, so every tile model is stale
+        size_t tileCount = instanceBuilder_.getTiles().size();
+        tileModels_.clear();
+        tileModels_.resize(tileCount);
+        texelTiles_.clear();
+        texelTiles_.resize(tileCount);
+    }
+
+    updateViewProjection();
+
+    // Only tiles overlapping the view are touched, so the cost of a frame follows what is on
+    // screen, not the board size. Changes to off screen tiles wait in the tile until it is seen.
+    TileSpan span = visibleTiles(
+            viewRect_,
+            instanceBuilder_.getTileColumns(),
+            instanceBuilder_.getTileRows());
+    // Until the atlas is on the GPU every zoom draws texels, which need no atlas
+    bool isZoomedOut = !isAtlasUploaded_ || camera_.getPixelsPerCell() < LOD_PIXELS_PER_CELL;
+    (isZoomedOut ? texelShader_ : shader_)->activate();
+    auto &tiles = instanceBuilder_.getTiles();
+    for (int32_t row = span.firstRow; row < span.endRow; row++) {
+        for (int32_t column = span.firstColumn; column < span.endColumn; column++) {
+            size_t index = static_cast<size_t>(row) * instanceBuilder_.getTileColumns() + column;
+            if (isZoomedOut) {
+                drawTileTexels(index, tiles[index]);
+            } else {
+                drawTileInstances(index, tiles[index]);
+            }
+        }
+    }
+}
+
+void Renderer::drawTileInstances(size_t index, RenderTile &tile) {
+    auto &upModel = tileModels_[index];
+    if (!upModel) {
+        upModel = std::make_unique<Model>(createQuad(0.f, 0.f, 1.f, 1.f, 1.f, 1.f, spAtlas_));
+    }
+    InstanceBuilder::collectDirtyRanges(tile, dirtyRanges_);
+    if (!dirtyRanges_.empty()) {
+        upModel->updateInstances(tile.instances, dirtyRanges_);
+    }
+    shader_->drawModelInstanced(*upModel);
+}
+
+void Renderer::drawTileTexels(size_t index, RenderTile &tile) {
+    TexelTile &texelTile = texelTiles_[index];
+    if (!texelTile.upModel) {
+        buildTileTexels(tile, texels_);
+        tile.isTexelsDirty = false;
+        texelTile.spTexels = TextureAsset::createFromPixels(
+                RENDER_TILE_CELLS,
+                RENDER_TILE_CELLS,
+                texels_);
+        texelTile.upModel = std::make_unique<Model>(createQuad(
+                float(tile.x),
+                float(tile.y),
+                float(tile.x + tile.width),
+                float(tile.y + tile.height),
+                float(tile.width) / RENDER_TILE_CELLS,
+                float(tile.height) / RENDER_TILE_CELLS,
+                texelTile.spTexels));
+    } else if (tile.isTexelsDirty) {
+        buildTileTexels(tile, texels_);
+        tile.isTexelsDirty = false;
+        texelTile.spTexels->updatePixels(RENDER_TILE_CELLS, RENDER_TILE_CELLS, texels_);
+    }
+    texelShader_->drawModel(*texelTile.upModel);
+}
+
+void Renderer::applyCellAction(float x, float y, CellAction action) {
+    std::lock_guard<std::mutex> lock(gameBoardMutex);
+    if (!gameBoard) {
         return;
     }
+    GameBoard &board = *gameBoard;
+    int32_t cellX;
+    int32_t cellY;
+    if (!camera_.cellAt(x, y, cellX, cellY)) {
+        return;
+    }
+    if (board.state == STEPPED_MINE || board.state == VICTORY) {
+        return;
+    }
+    const Cell &cell = board.getCell(cellX, cellY);
+    switch (action) {
+        case CellAction::FLAG:
+            if (board.state == ONGOING && !cell.isRevealed) {
+                {
+                    ScopedTrace trace(TraceOp::TOGGLE_FLAG);
+                    board.toggleFlag(cellX, cellY);
+                }
+                gameClicks_++;
+                updateGameStatus(board);
+            }
+            break;
 
-    // handle motion events (motionEventsCounts can be 0).
-    for (auto i = 0; i < inputBuffer->motionEventsCount; i++) {
-        auto &motionEvent = inputBuffer->motionEvents[i];
-        auto action = motionEvent.action;
-
-        // Find the pointer index, mask and bitshift to turn it into a readable value.
-        auto pointerIndex = (action & AMOTION_EVENT_ACTION_POINTER_INDEX_MASK)
-                >> AMOTION_EVENT_ACTION_POINTER_INDEX_SHIFT;
-        aout << "Pointer(s): ";
-
-        // get the x and y position of this event if it is not ACTION_MOVE.
-        auto &pointer = motionEvent.pointers[pointerIndex];
-        auto x = GameActivityPointerAxes_getX(&pointer);
-        auto y = GameActivityPointerAxes_getY(&pointer);
-
-        // determine the action type and process the event accordingly.
-        switch (action & AMOTION_EVENT_ACTION_MASK) {
-            case AMOTION_EVENT_ACTION_DOWN:
-            case AMOTION_EVENT_ACTION_POINTER_DOWN:
-                aout << "(" << pointer.id << ", " << x << ", " << y << ") "
-                     << "Pointer Down";
+        case CellAction::CHORD: {
+            if (board.state != ONGOING) {
                 break;
+            }
+            int32_t revealed;
+            {
+                ScopedTrace trace(TraceOp::CHORD_CELL);
+                revealed = board.beginChord(cellX, cellY);
+            }
+            gameClicks_++;
+            if (revealed > 0) {
+                countTrace(TraceCounter::CELLS_REVEALED, revealed);
+                updateGameStatus(board);
+            }
+            break;
+        }
 
-            case AMOTION_EVENT_ACTION_CANCEL:
-                // treat the CANCEL as an UP event: doing nothing in the app, except
-                // removing the pointer from the cache if pointers are locally saved.
-                // code pass through on purpose.
-            case AMOTION_EVENT_ACTION_UP:
-            case AMOTION_EVENT_ACTION_POINTER_UP:
-                aout << "(" << pointer.id << ", " << x << ", " << y << ") "
-                     << "Pointer Up";
+        case CellAction::REVEAL:
+            if (cell.isFlagged) {
                 break;
-
-            case AMOTION_EVENT_ACTION_MOVE:
-                // There is no pointer index for ACTION_MOVE, only a snapshot of
-                // all active pointers; app needs to cache previous active pointers
-                // to figure out which ones are actually moved.
-                for (auto index = 0; index < motionEvent.pointerCount; index++) {
-                    pointer = motionEvent.pointers[index];
-                    x = GameActivityPointerAxes_getX(&pointer);
-                    y = GameActivityPointerAxes_getY(&pointer);
-                    aout << "(" << pointer.id << ", " << x << ", " << y << ")";
-
-                    if (index != (motionEvent.pointerCount - 1)) aout << ",";
-                    aout << " ";
+            }
+            {
+                ScopedTrace trace(TraceOp::REVEAL_CELL);
+                // The first reveal clears its safe zone of the mines generated in the background,
+                // or places them now if they are not there yet
+                if (board.state == STARTED) {
+                    board.initializeBoard(cellX, cellY);
+                    gameStartNanos_ = steadyNanos();
+                    gameClicks_ = 0;
                 }
-                aout << "Pointer Move";
-                break;
-            default:
-                aout << "Unknown MotionEvent Action: " << action;
+                // Only the cell itself; the flood fill it starts runs over the next frames, and
+                // the status is final already since the fill uncovers no mines
+                countTrace(TraceCounter::CELLS_REVEALED, board.beginReveal(cellX, cellY));
+            }
+            gameClicks_++;
+            updateGameStatus(board);
+            break;
+    }
+    // moves on a finished board return early above, so each game is recorded once
+    if (board.state == STEPPED_MINE || board.state == VICTORY) {
+        showGameResult(board.state == VICTORY);
+        recordFinishedGame(board);
+    }
+}
+
+void Renderer::updateGameStatus(GameBoard &board) {
+    ScopedTrace trace(TraceOp::UPDATE_STATUS);
+    board.updateGameStatus();
+}
+
+void Renderer::recordFinishedGame(const GameBoard &board) {
+    GameRecord record{};
+    record.seed = board.getSeed();
+    record.finishedAtMillis = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    record.width = board.getWidth();
+    record.height = board.getHeight();
+    record.mineCount = board.getMineCount();
+    record.durationMillis = int32_t((steadyNanos() - gameStartNanos_) / 1000000);
+    record.clicks = gameClicks_;
+    record.outcome = board.state;
+    {
+        std::lock_guard<std::mutex> lock(pendingGamesMutex_);
+        pendingGames_++;
+    }
+    // the board is copied into the task here, while the lock is held; the analysis and the write
+    // are O(cells) and a system call, so they stay off the render thread
+    spawn(getEngineScheduler(), storeFinishedGame(board, record));
+}
+
+Task<void> Renderer::storeFinishedGame(GameBoard board, GameRecord record) {
+    BoardAnalyzer analyzer;
+    record.threeBV = analyzer.analyze(board).threeBV;
+    if (statsStore_.append(record)) {
+        DifficultyStats stats{};
+        statsStore_.getStats(record.width, record.height, record.mineCount, stats);
+        LOGI("Game %s in %d ms, 3BV %d in %d clicks; %dx%d/%d: best %d ms, %lld games, %.1f%% won",
+             record.outcome == VICTORY ? "won" : "lost", int(record.durationMillis),
+             int(record.threeBV), int(record.clicks), int(record.width), int(record.height),
+             int(record.mineCount), stats.bestCount > 0 ? int(stats.best[0].durationMillis) : -1,
+             (long long) stats.games, stats.getWinRate() * 100.0);
+    }
+    std::lock_guard<std::mutex> lock(pendingGamesMutex_);
+    pendingGames_--;
+    pendingGamesIdle_.notify_all();
+    co_return;
+}
+
+void Renderer::showGameResult(bool isWon) {
+    ScopedTrace trace(TraceOp::JNI_CALL);
+    countTrace(TraceCounter::JNI_CALLS);
+    JavaVM *vm = app_->activity->vm;
+    JNIEnv *env = nullptr;
+    if (vm->AttachCurrentThread(&env, nullptr) != JNI_OK) {
+        LOGW("Could not attach the render thread to show the game result");
+        return;
+    }
+    jobject activity = app_->activity->javaGameActivity;
+    jclass activityClass = env->GetObjectClass(activity);
+    jmethodID onGameFinished = env->GetMethodID(activityClass, "onGameFinished", "(Z)V");
+    if (onGameFinished != nullptr) {
+        env->CallVoidMethod(activity, onGameFinished, jboolean(isWon));
+    }
+    if (env->ExceptionCheck()) {
+        env->ExceptionClear();
+        LOGW("MainActivity.onGameFinished failed");
+    }
+    env->DeleteLocalRef(activityClass);
+    vm->DetachCurrentThread();
+}
+
+void Renderer::applyGesture(const Gesture &gesture) {
+    switch (gesture.kind) {
+        case GestureKind::TAP:
+            applyCellAction(gesture.x, gesture.y, CellAction::REVEAL);
+            break;
+
+        case GestureKind::LONG_PRESS:
+            applyCellAction(gesture.x, gesture.y, CellAction::FLAG);
+            break;
+
+        case GestureKind::DOUBLE_TAP:
+            applyCellAction(gesture.x, gesture.y, CellAction::CHORD);
+            break;
+
+        case GestureKind::PAN:
+            camera_.pan(gesture.dx, gesture.dy);
+            break;
+
+        case GestureKind::PINCH:
+            // pan first so the board point under the old midpoint lands under the new one, then
+            // zoom around it
+            camera_.pan(gesture.dx, gesture.dy);
+            camera_.zoomAt(gesture.x, gesture.y, gesture.scale);
+            break;
+    }
+}
+
+bool Renderer::toTouchEvent(const GameActivityMotionEvent &motionEvent, TouchEvent &outEvent) {
+    auto action = motionEvent.action & AMOTION_EVENT_ACTION_MASK;
+    switch (action) {
+        case AMOTION_EVENT_ACTION_DOWN:
+        case AMOTION_EVENT_ACTION_UP:
+        case AMOTION_EVENT_ACTION_MOVE:
+        case AMOTION_EVENT_ACTION_CANCEL:
+        case AMOTION_EVENT_ACTION_POINTER_DOWN:
+        case AMOTION_EVENT_ACTION_POINTER_UP:
+            // TouchAction uses the same values
+            outEvent.action = static_cast<TouchAction>(action);
+            break;
+        default:
+            // hover, scroll and the like are not gestures
+            return false;
+    }
+
+    outEvent.timeNanos = motionEvent.eventTime;
+    outEvent.actionIndex = (motionEvent.action & AMOTION_EVENT_ACTION_POINTER_INDEX_MASK)
+            >> AMOTION_EVENT_ACTION_POINTER_INDEX_SHIFT;
+    outEvent.pointerCount = std::min<int32_t>(motionEvent.pointerCount, TouchEvent::MAX_POINTERS);
+    if (outEvent.pointerCount <= 0 || outEvent.actionIndex >= outEvent.pointerCount) {
+        // a third or later finger coming or going, which no gesture uses
+        return false;
+    }
+    for (int32_t i = 0; i < outEvent.pointerCount; i++) {
+        auto &pointer = motionEvent.pointers[i];
+        outEvent.pointers[i] = TouchPointer{
+                pointer.id,
+                GameActivityPointerAxes_getX(&pointer),
+                GameActivityPointerAxes_getY(&pointer)};
+    }
+    return true;
+}
+
+bool Renderer::isAnimating() const {
+    return instanceBuilder_.hasPendingCells() || isRevealPending_
+           || (atlasLoader_.isReady() && !isAtlasUploaded_);
+}
+
+bool Renderer::hasBoardChanged() {
+    std::lock_guard<std::mutex> lock(gameBoardMutex);
+    if (!gameBoard) {
+        return hasDrawnBoard_;
+    }
+    // drawBoard starts recording changes, so a board that is not recording has never been drawn.
+    // A reveal still filling needs frames to advance it even when the last one changed nothing
+    return !gameBoard->isRecordingChanges() || gameBoard->hasPendingChanges()
+           || gameBoard->isRevealPending();
+}
+
+bool Renderer::handleInput() {
+    ScopedTrace trace(TraceOp::HANDLE_INPUT);
+
+    // handle all queued inputs
+    auto *inputBuffer = android_app_swap_input_buffers(app_);
+    if (!inputBuffer) {
+        // no inputs yet.
+        return false;
+    }
+    bool hadEvents = inputBuffer->motionEventsCount > 0 || inputBuffer->keyEventsCount > 0;
+    int64_t dequeueNanos = latencyClock_.nowNanos();
+
+    // handle motion events (motionEventsCounts can be 0). Each event goes through the gesture
+    // recognizer and any gesture it completes is applied to the board or camera straight away. Both
+    // live in fixed storage, so nothing here allocates.
+    for (auto i = 0; i < inputBuffer->motionEventsCount; i++) {
+        TouchEvent touchEvent;
+        if (!toTouchEvent(inputBuffer->motionEvents[i], touchEvent)) {
+            continue;
+        }
+        Gesture gesture;
+        bool isGesture = gestureRecognizer_.onEvent(touchEvent, gesture);
+#if MINESWEEPER_LOG_INPUT
+        char line[256];
+        formatTouchEvent(touchEvent, line, sizeof(line));
+        LOGD("Touch: %s%s%s", line, isGesture ? " -> " : "",
+             isGesture ? gestureName(gesture.kind) : "");
+#endif
+        if (isGesture) {
+            applyGesture(gesture);
+            // measured from the event that completed the gesture
+            inputLatency_.onInputApplied(touchEvent.timeNanos, dequeueNanos);
         }
-        aout << std::endl;
     }
     // clear the motion input count in this buffer for main thread to re-use.
     android_app_clear_motion_events(inputBuffer);
 
+#if MINESWEEPER_LOG_INPUT
     // handle input key events.
     for (auto i = 0; i < inputBuffer->keyEventsCount; i++) {
         auto &keyEvent = inputBuffer->keyEvents[i];
-        aout << "Key: " << keyEvent.keyCode <<" ";
         switch (keyEvent.action) {
             case AKEY_EVENT_ACTION_DOWN:
-                aout << "Key Down";
+                LOGD("Key: %d Key Down", keyEvent.keyCode);
                 break;
             case AKEY_EVENT_ACTION_UP:
-                aout << "Key Up";
+                LOGD("Key: %d Key Up", keyEvent.keyCode);
                 break;
             case AKEY_EVENT_ACTION_MULTIPLE:
                 // Deprecated since Android API level 29.
-                aout << "Multiple Key Actions";
+                LOGD("Key: %d Multiple Key Actions", keyEvent.keyCode);
                 break;
             default:
-                aout << "Unknown KeyEvent Action: " << keyEvent.action;
+                LOGD("Key: %d Unknown KeyEvent Action: %d", keyEvent.keyCode, keyEvent.action);
         }
-        aout << std::endl;
     }
+#endif
     // clear the key input count too.
     android_app_clear_key_events(inputBuffer);
+    return hadEvents;
 }
\ No newline at end of file
@@ -2,12 +2,28 @@
 #define ANDROIDGLINVESTIGATIONS_RENDERER_H
 
 #include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <array>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
 
+#include "GlStats.h"
+#include "atlas_cache.h"
 #include "Model.h"
 #include "Shader.h"
+#include "board_instances.h"
+#include "board_metrics.h"
+#include "board_view.h"
+#include "game_objects.h"
+#include "gesture_recognizer.h"
+#include "input_latency.h"
+#include "startup_profile.h"
+#include "stats_store.h"
+#include "task_scheduler.h"
 
 struct android_app;
+struct GameActivityMotionEvent;
 
 class Renderer {
 public:
@@ -21,7 +37,26 @@ public:
             context_(EGL_NO_CONTEXT),
             width_(0),
             height_(0),
-            shaderNeedsNewProjectionMatrix_(true) {
+            shaderNeedsNewProjectionMatrix_(true),
+            cameraRevision_(0),
+            viewProjection_{},
+            viewRect_{0.f, 0.f, 0.f, 0.f},
+            atlasLevel_(0),
+            atlasRow_(0),
+            isAtlasUploaded_(false),
+            boardWidth_(0),
+            boardHeight_(0),
+            hasDrawnBoard_(false),
+            isRevealPending_(false),
+            statsWindowFrames_(0),
+            inputLatency_(latencyClock_),
+            getNextFrameId_(nullptr),
+            getFrameTimestamps_(nullptr),
+            presentQueries_{},
+            presentQueryCount_(0),
+            gameStartNanos_(0),
+            gameClicks_(0),
+            pendingGames_(0) {
         initRenderer();
     }
 
@@ -31,11 +66,25 @@ public:
      * Handles input from the android_app.
      *
      * Note: this will clear the input queue
+     *
+     * @return true if there were any events, which may have changed what is on screen
+     */
+    bool handleInput();
+
+    /*!
+     * @return true if the shared game board was replaced, removed or changed since it was last
+     * drawn
+     */
+    bool hasBoardChanged();
+
+    /*!
+     * @return true if the last frame left part of a reveal to later frames, or the cell atlas is
+     * ready and still being uploaded
      */
-    void handleInput();
+    bool isAnimating() const;
 
     /*!
-     * Renders all the models in the renderer
+     * Renders the shared game board, if there is one
      */
     void render();
 
@@ -53,11 +102,139 @@ private:
     void updateRenderArea();
 
     /*!
-     * Creates the models for this sample. You'd likely load a scene configuration from a file or
-     * use some other setup logic in your full game.
+     * Uploads the baked glyph atlas and starts loading the cell atlas shared by every tile on a
+     * background thread, from the cache in app storage if an earlier start left one
      */
     void createModels();
 
+    /*!
+     * Once the atlas is loaded, uploads as many rows of it as fit in a frame's upload budget,
+     * creating the texture on the first call. Until the upload completes the board is drawn
+     * from texels only.
+     */
+    void uploadAtlas();
+
+    /*!
+     * Creates a quad model in cell coordinates, with UVs running from 0 to uvRight and uvBottom
+     */
+    static Model createQuad(
+            float left,
+            float top,
+            float right,
+            float bottom,
+            float uvRight,
+            float uvBottom,
+            std::shared_ptr<TextureAsset> spTexture);
+
+    /*!
+     * Rebuilds the view-projection matrix and the visible rectangle if the camera or surface changed
+     */
+    void updateViewProjection();
+
+    /*!
+     * Draws the render tiles in view, each cell with its atlas tile or, when zoomed far out, each
+     * tile as one quad of texels. Call with gameBoardMutex held.
+     */
+    void drawBoard(GameBoard &board);
+
+    /*!
+     * Uploads the tile's changed instances and draws them with one instanced draw call
+     */
+    void drawTileInstances(size_t index, RenderTile &tile);
+
+    /*!
+     * Refreshes the tile's texel texture if it is stale and draws it as a single quad
+     */
+    void drawTileTexels(size_t index, RenderTile &tile);
+
+    /*!
+     * Marks the first swap and, once the atlas is in, the first full frame, then logs the startup
+     * profile as one JSON line
+     */
+    void reportStartup();
+
+    /*!
+     * Adds this frame's GL work to the statistics window and logs the per-frame averages once the
+     * window is full
+     * @param frameStart a copy of glStats taken at the start of the frame
+     */
+    void logFrameStats(const GlStats &frameStart);
+
+    /*!
+     * What a gesture on a cell does
+     */
+    enum class CellAction {
+        REVEAL,
+        FLAG,
+        CHORD
+    };
+
+    /*!
+     * Reveals, flags or chords the cell under a surface position
+     * @param x the horizontal surface position in pixels
+     * @param y the vertical surface position in pixels
+     * @param action what to do to the cell
+     */
+    void applyCellAction(float x, float y, CellAction action);
+
+    /*!
+     * Updates the board's status after a move, timed as its own trace operation
+     * @param board the board the move was made on, with gameBoardMutex held
+     */
+    void updateGameStatus(GameBoard &board);
+
+    /*!
+     * Records a game that just ended. Only the record and a copy of the board are taken here; the
+     * 3BV analysis and the write to the statistics store run on an engine worker
+     * @param board the finished board, with gameBoardMutex held
+     */
+    void recordFinishedGame(const GameBoard &board);
+
+    /*!
+     * Completes a finished game's record with its 3BV, appends it to the statistics store and
+     * logs its difficulty's best time and win rate
+     * @param board a copy of the finished board
+     * @param record the record so far, all but the 3BV
+     */
+    Task<void> storeFinishedGame(GameBoard board, GameRecord record);
+
+    /*!
+     * Asks the activity to tell the player how the game ended. Attaches the render thread to the
+     * VM for the call only, since games end rarely
+     * @param isWon whether the game was won rather than lost
+     */
+    void showGameResult(bool isWon);
+
+    /*!
+     * Asks the driver when earlier frames reached the display and completes their inputs'
+     * latency
+     */
+    void pollPresentTimes();
+
+    /*!
+     * Logs the input latency percentiles once enough inputs were measured, then starts over
+     */
+    void reportInputLatency();
+
+    /*!
+     * Applies a recognized gesture to the board or the camera
+     */
+    void applyGesture(const Gesture &gesture);
+
+    /*!
+     * Copies the parts of a GameActivity motion event gestures use
+     * @return false if the event is not part of any gesture
+     */
+    static bool toTouchEvent(const GameActivityMotionEvent &motionEvent, TouchEvent &outEvent);
+
+    /*!
+     * A zoomed out tile: one quad textured with a texel per cell
+     */
+    struct TexelTile {
+        std::unique_ptr<Model> upModel;
+        std::shared_ptr<TextureAsset> spTexels;
+    };
+
     android_app *app_;
     EGLDisplay display_;
     EGLSurface surface_;
@@ -67,8 +244,70 @@ private:
 
     bool shaderNeedsNewProjectionMatrix_;
 
+    BoardCamera camera_;
+    uint64_t cameraRevision_;
+    float viewProjection_[16];
+    ViewRect viewRect_;
+
     std::unique_ptr<Shader> shader_;
-    std::vector<Model> models_;
+    std::unique_ptr<Shader> texelShader_;
+    std::shared_ptr<TextureAsset> spAtlas_;
+    std::shared_ptr<TextureAsset> spGlyphs_;
+
+    // the atlas arrives from atlasLoader_ and is uploaded level by level, a band of rows per frame
+    AtlasLoader atlasLoader_;
+    int32_t atlasLevel_;
+    int32_t atlasRow_;
+    bool isAtlasUploaded_;
+
+    InstanceBuilder instanceBuilder_;
+    int32_t boardWidth_;
+    int32_t boardHeight_;
+    bool hasDrawnBoard_;
+    // the board's flood fill outlived the last frame and continues on the next
+    bool isRevealPending_;
+
+    // per render tile, created the first time the tile is seen at that level of detail
+    std::vector<std::unique_ptr<Model>> tileModels_;
+    std::vector<TexelTile> texelTiles_;
+
+    // scratch reused every frame
+    std::vector<InstanceRange> dirtyRanges_;
+    std::vector<uint8_t> texels_;
+
+    GlStats statsWindow_;
+    int32_t statsWindowFrames_;
+
+    GestureRecognizer gestureRecognizer_;
+
+    StartupProfile startupProfile_;
+
+    // inputs tagged with their event time and followed to the frame that shows them
+    SteadyFrameClock latencyClock_;
+    InputLatencyTracker inputLatency_;
+
+    /*!
+     * A swapped frame whose presentation time the driver has yet to report
+     */
+    struct PresentQuery {
+        int32_t latencyFrame;
+        EGLuint64KHR eglFrameId;
+    };
+
+    // EGL_ANDROID_get_frame_timestamps, null when the driver does not have it
+    PFNEGLGETNEXTFRAMEIDANDROIDPROC getNextFrameId_;
+    PFNEGLGETFRAMETIMESTAMPSANDROIDPROC getFrameTimestamps_;
+    std::array<PresentQuery, LATENCY_FRAMES_IN_FLIGHT> presentQueries_;
+    int32_t presentQueryCount_;
+
+    // finished games, timed from the first reveal and counting every move the player made
+    StatsStore statsStore_;
+    int64_t gameStartNanos_;
+    int32_t gameClicks_;
+    // finished games still being stored on an engine worker, which the destructor waits for
+    std::mutex pendingGamesMutex_;
+    std::condition_variable pendingGamesIdle_;
+    int32_t pendingGames_;
 };
 
 #endif //ANDROIDGLINVESTIGATIONS_RENDERER_H
\ No newline at end of file
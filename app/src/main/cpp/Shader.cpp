@@ -1,26 +1,115 @@
 #include "Shader.h"
 
-#include "AndroidOut.h"
+#include "logger.h"
+#include "GlStats.h"
 #include "Model.h"
 #include "Utility.h"
+#include "program_cache.h"
+
+#include <cstring>
+
+/*!
+ * Logs a shader or program info log one line per record, as the driver's logs often run past what
+ * a single record holds
+ */
+static void logInfoLog(const char *heading, const char *log) {
+    LOGE("%s", heading);
+    while (*log != '\0') {
+        size_t length = std::strcspn(log, "\n");
+        LOGE("%.*s", static_cast<int>(length), log);
+        log += length + (log[length] == '\n' ? 1 : 0);
+    }
+}
 
 Shader *Shader::loadShader(
         const std::string &vertexSource,
         const std::string &fragmentSource,
         const std::string &positionAttributeName,
         const std::string &uvAttributeName,
-        const std::string &projectionMatrixUniformName) {
-    Shader *shader = nullptr;
+        const std::string &projectionMatrixUniformName,
+        const std::string &cellAttributeName,
+        const std::string &tileAttributeName,
+        const std::string &binaryCachePath) {
+    bool instanced = !cellAttributeName.empty() || !tileAttributeName.empty();
+
+    // The binary is only valid for the driver that produced it and for exactly these inputs
+    uint64_t cacheKey = 0;
+    GLuint program = 0;
+    bool fromCache = false;
+    if (!binaryCachePath.empty()) {
+        cacheKey = programCacheKey({
+                reinterpret_cast<const char *>(glGetString(GL_VENDOR)),
+                reinterpret_cast<const char *>(glGetString(GL_RENDERER)),
+                reinterpret_cast<const char *>(glGetString(GL_VERSION)),
+                vertexSource.c_str(),
+                fragmentSource.c_str(),
+                positionAttributeName.c_str(),
+                uvAttributeName.c_str(),
+                cellAttributeName.c_str(),
+                tileAttributeName.c_str()});
+        program = loadCachedProgram(binaryCachePath, cacheKey);
+        fromCache = program != 0;
+    }
+    if (!program) {
+        program = buildProgram(
+                vertexSource,
+                fragmentSource,
+                positionAttributeName,
+                uvAttributeName,
+                cellAttributeName,
+                tileAttributeName,
+                !binaryCachePath.empty());
+        if (!program) {
+            return nullptr;
+        }
+    }
+
+    // Look the attributes up again to make sure the shader really has them all
+    GLint positionAttribute = glGetAttribLocation(program, positionAttributeName.c_str());
+    GLint uvAttribute = glGetAttribLocation(program, uvAttributeName.c_str());
+    GLint projectionMatrixUniform = glGetUniformLocation(
+            program,
+            projectionMatrixUniformName.c_str());
+    GLint cellAttribute = -1;
+    GLint tileAttribute = -1;
+    if (instanced) {
+        cellAttribute = glGetAttribLocation(program, cellAttributeName.c_str());
+        tileAttribute = glGetAttribLocation(program, tileAttributeName.c_str());
+    }
+
+    // Only create a new shader if all the attributes are found.
+    if (positionAttribute != -1
+        && uvAttribute != -1
+        && projectionMatrixUniform != -1
+        && (!instanced || (cellAttribute != -1 && tileAttribute != -1))) {
 
+        // Only cache programs that passed the checks, so a bad binary is never kept around
+        if (!binaryCachePath.empty() && !fromCache) {
+            saveCachedProgram(program, binaryCachePath, cacheKey);
+        }
+        return new Shader(program, projectionMatrixUniform, instanced, fromCache);
+    }
+    glDeleteProgram(program);
+    return nullptr;
+}
+
+GLuint Shader::buildProgram(
+        const std::string &vertexSource,
+        const std::string &fragmentSource,
+        const std::string &positionAttributeName,
+        const std::string &uvAttributeName,
+        const std::string &cellAttributeName,
+        const std::string &tileAttributeName,
+        bool retrievable) {
     GLuint vertexShader = loadShader(GL_VERTEX_SHADER, vertexSource);
     if (!vertexShader) {
-        return nullptr;
+        return 0;
     }
 
     GLuint fragmentShader = loadShader(GL_FRAGMENT_SHADER, fragmentSource);
     if (!fragmentShader) {
         glDeleteShader(vertexShader);
-        return nullptr;
+        return 0;
     }
 
     GLuint program = glCreateProgram();
@@ -28,6 +117,20 @@ Shader *Shader::loadShader(
         glAttachShader(program, vertexShader);
         glAttachShader(program, fragmentShader);
 
+        // Pin the attributes to the locations every Model's vertex array uses. The bindings are
+        // part of the linked binary, so cached programs keep them.
+        glBindAttribLocation(program, kPositionAttribute, positionAttributeName.c_str());
+        glBindAttribLocation(program, kUVAttribute, uvAttributeName.c_str());
+        if (!cellAttributeName.empty() || !tileAttributeName.empty()) {
+            glBindAttribLocation(program, kCellAttribute, cellAttributeName.c_str());
+            glBindAttribLocation(program, kTileAttribute, tileAttributeName.c_str());
+        }
+
+        // Without the hint some drivers return no binary at all
+        if (retrievable) {
+            glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        }
+
         glLinkProgram(program);
         GLint linkStatus = GL_FALSE;
         glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
@@ -39,33 +142,12 @@ Shader *Shader::loadShader(
             if (logLength) {
                 GLchar *log = new GLchar[logLength];
                 glGetProgramInfoLog(program, logLength, nullptr, log);
-                aout << "Failed to link program with:\n" << log << std::endl;
+                logInfoLog("Failed to link program with:", log);
                 delete[] log;
             }
 
             glDeleteProgram(program);
-        } else {
-            // Get the attribute and uniform locations by name. You may also choose to hardcode
-            // indices with layout= in your shader, but it is not done in this sample
-            GLint positionAttribute = glGetAttribLocation(program, positionAttributeName.c_str());
-            GLint uvAttribute = glGetAttribLocation(program, uvAttributeName.c_str());
-            GLint projectionMatrixUniform = glGetUniformLocation(
-                    program,
-                    projectionMatrixUniformName.c_str());
-
-            // Only create a new shader if all the attributes are found.
-            if (positionAttribute != -1
-                && uvAttribute != -1
-                && projectionMatrixUniform != -1) {
-
-                shader = new Shader(
-                        program,
-                        positionAttribute,
-                        uvAttribute,
-                        projectionMatrixUniform);
-            } else {
-                glDeleteProgram(program);
-            }
+            program = 0;
         }
     }
 
@@ -73,7 +155,55 @@ Shader *Shader::loadShader(
     glDeleteShader(vertexShader);
     glDeleteShader(fragmentShader);
 
-    return shader;
+    return program;
+}
+
+GLuint Shader::loadCachedProgram(const std::string &binaryCachePath, uint64_t cacheKey) {
+    ProgramBinary binary;
+    if (!readProgramBinary(binaryCachePath, cacheKey, binary)) {
+        return 0;
+    }
+
+    GLuint program = glCreateProgram();
+    if (!program) {
+        return 0;
+    }
+    glProgramBinary(program, binary.format, binary.bytes.data(), GLsizei(binary.bytes.size()));
+
+    // A driver may refuse a binary it wrote itself, e.g. after an update that kept its version
+    // string. Clear the error it raises and compile from source instead.
+    GLint linkStatus = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
+    while (glGetError() != GL_NO_ERROR) {}
+    if (linkStatus != GL_TRUE) {
+        LOGW("Cached program %s rejected by the driver", binaryCachePath.c_str());
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+void Shader::saveCachedProgram(
+        GLuint program,
+        const std::string &binaryCachePath,
+        uint64_t cacheKey) {
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+    ProgramBinary binary;
+    binary.bytes.resize(size_t(length));
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &length, &format, binary.bytes.data());
+    if (length <= 0) {
+        return;
+    }
+    binary.bytes.resize(size_t(length));
+    binary.format = format;
+    if (!writeProgramBinary(binaryCachePath, cacheKey, binary)) {
+        LOGW("Could not write program cache %s", binaryCachePath.c_str());
+    }
 }
 
 GLuint Shader::loadShader(GLenum shaderType, const std::string &shaderSource) {
@@ -96,7 +226,7 @@ GLuint Shader::loadShader(GLenum shaderType, const std::string &shaderSource) {
             if (infoLength) {
                 auto *infoLog = new GLchar[infoLength];
                 glGetShaderInfoLog(shader, infoLength, nullptr, infoLog);
-                aout << "Failed to compile with:\n" << infoLog << std::endl;
+                logInfoLog("Failed to compile with:", infoLog);
                 delete[] infoLog;
             }
 
@@ -116,39 +246,42 @@ void Shader::deactivate() const {
 }
 
 void Shader::drawModel(const Model &model) const {
-    // The position attribute is 3 floats
-    glVertexAttribPointer(
-            position_, // attrib
-            3, // elements
-            GL_FLOAT, // of type float
-            GL_FALSE, // don't normalize
-            sizeof(Vertex), // stride is Vertex bytes
-            model.getVertexData() // pull from the start of the vertex data
-    );
-    glEnableVertexAttribArray(position_);
-
-    // The uv attribute is 2 floats
-    glVertexAttribPointer(
-            uv_, // attrib
-            2, // elements
-            GL_FLOAT, // of type float
-            GL_FALSE, // don't normalize
-            sizeof(Vertex), // stride is Vertex bytes
-            ((uint8_t *) model.getVertexData()) + sizeof(Vector3) // offset Vector3 from the start
-    );
-    glEnableVertexAttribArray(uv_);
+    // The vertex array holds every attribute and the index buffer, so one bind replaces
+    // re-specifying the geometry each draw
+    GL_COUNTED(glBindVertexArray(model.getVertexArray()));
 
     // Setup the texture
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, model.getTexture().getTextureID());
+    GL_COUNTED(glActiveTexture(GL_TEXTURE0));
+    GL_COUNTED(glBindTexture(GL_TEXTURE_2D, model.getTexture().getTextureID()));
 
-    // Draw as indexed triangles
-    glDrawElements(GL_TRIANGLES, model.getIndexCount(), GL_UNSIGNED_SHORT, model.getIndexData());
+    // Draw as indexed triangles from the bound index buffer
+    GL_COUNTED(glDrawElements(GL_TRIANGLES, model.getIndexCount(), GL_UNSIGNED_SHORT, nullptr));
+    glStats.drawCalls++;
+}
+
+void Shader::drawModelInstanced(const Model &model) const {
+    assert(instanced_);
+
+    GL_COUNTED(glBindVertexArray(model.getVertexArray()));
+    GL_COUNTED(glActiveTexture(GL_TEXTURE0));
+    GL_COUNTED(glBindTexture(GL_TEXTURE_2D, model.getTexture().getTextureID()));
+    GL_COUNTED(glDrawElementsInstanced(
+            GL_TRIANGLES,
+            model.getIndexCount(),
+            GL_UNSIGNED_SHORT,
+            nullptr,
+            model.getInstanceCount()));
+    glStats.drawCalls++;
+}
+
+void Shader::setVector4Array(const char *name, const float *values, GLsizei count) const {
+    GL_COUNTED(glUniform4fv(glGetUniformLocation(program_, name), count, values));
+}
 
-    glDisableVertexAttribArray(uv_);
-    glDisableVertexAttribArray(position_);
+void Shader::setTextureUnit(const char *name, GLint unit) const {
+    GL_COUNTED(glUniform1i(glGetUniformLocation(program_, name), unit));
 }
 
 void Shader::setProjectionMatrix(float *projectionMatrix) const {
-    glUniformMatrix4fv(projectionMatrix_, 1, false, projectionMatrix);
+    GL_COUNTED(glUniformMatrix4fv(projectionMatrix_, 1, false, projectionMatrix));
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #ifndef ANDROIDGLINVESTIGATIONS_SHADER_H
 #define ANDROIDGLINVESTIGATIONS_SHADER_H
 
+#include <cstdint>
 #include <string>
 #include <GLES3/gl3.h>
 
@@ -8,7 +9,8 @@ class Model;
 
 /*!
  * A class representing a simple shader program. It consists of vertex and fragment components. The
- * input attributes are a position (as a Vector3) and a uv (as a Vector2). It also takes a uniform
+ * input attributes are a position (as a Vector3) and a uv (as a Vector2), optionally followed by
+ * the per-instance attributes of a CellInstance, all at the fixed locations declared in Model.h. It also takes a uniform
  * to be used as the entire model/view/projection matrix. The shader expects a single texture for
  * fragment shading, and does no other lighting calculations (thus no uniforms for lights or normal
  * attributes).
@@ -25,6 +27,12 @@ public:
      * @param positionAttributeName The name of the position attribute in your vertex program
      * @param uvAttributeName The name of the uv coordinate attribute in your vertex program
      * @param projectionMatrixUniformName The name of your model/view/projection matrix uniform
+     * @param cellAttributeName The name of the per-instance cell position attribute, empty if the
+     * shader does not draw instances
+     * @param tileAttributeName The name of the per-instance atlas tile attribute, empty if the
+     * shader does not draw instances
+     * @param binaryCachePath Where to keep the linked program binary, empty to always compile.
+     * A binary cached there by the same driver for the same sources is loaded instead of compiling.
      * @return a valid Shader on success, otherwise null.
      */
     static Shader *loadShader(
@@ -32,7 +40,10 @@ public:
             const std::string &fragmentSource,
             const std::string &positionAttributeName,
             const std::string &uvAttributeName,
-            const std::string &projectionMatrixUniformName);
+            const std::string &projectionMatrixUniformName,
+            const std::string &cellAttributeName = "",
+            const std::string &tileAttributeName = "",
+            const std::string &binaryCachePath = "");
 
     inline ~Shader() {
         if (program_) {
@@ -41,6 +52,11 @@ public:
         }
     }
 
+    /*!
+     * @return true if the program was loaded from its binary cache rather than compiled
+     */
+    constexpr bool isFromCache() const { return fromCache_; }
+
     /*!
      * Prepares the shader for use, call this before executing any draw commands
      */
@@ -57,6 +73,28 @@ public:
      */
     void drawModel(const Model &model) const;
 
+    /*!
+     * Renders a model once per instance uploaded with Model::updateInstances, in a single draw
+     * call. The shader must have been loaded with instance attribute names.
+     * @param model the model to render, typically a unit quad
+     */
+    void drawModelInstanced(const Model &model) const;
+
+    /*!
+     * Sets a uniform array of vec4s. The shader must be active.
+     * @param name the name of the uniform array
+     * @param values four floats per element
+     * @param count the number of elements
+     */
+    void setVector4Array(const char *name, const float *values, GLsizei count) const;
+
+    /*!
+     * Points a sampler uniform at a texture unit. The shader must be active.
+     * @param name the name of the sampler uniform
+     * @param unit the texture unit, 0 for GL_TEXTURE0
+     */
+    void setTextureUnit(const char *name, GLint unit) const;
+
     /*!
      * Sets the model/view/projection matrix in the shader.
      * @param projectionMatrix sixteen floats, column major, defining an OpenGL projection matrix.
@@ -72,27 +110,55 @@ private:
      */
     static GLuint loadShader(GLenum shaderType, const std::string &shaderSource);
 
+    /*!
+     * Compiles and links a program from source, pinning the attributes to the fixed locations
+     * @return the linked program, or 0 in the case of an error
+     */
+    static GLuint buildProgram(
+            const std::string &vertexSource,
+            const std::string &fragmentSource,
+            const std::string &positionAttributeName,
+            const std::string &uvAttributeName,
+            const std::string &cellAttributeName,
+            const std::string &tileAttributeName,
+            bool retrievable);
+
+    /*!
+     * Creates a program from a binary in the cache
+     * @return the linked program, or 0 if there is no usable binary for cacheKey
+     */
+    static GLuint loadCachedProgram(const std::string &binaryCachePath, uint64_t cacheKey);
+
+    /*!
+     * Stores the binary of a linked program in the cache, ignoring failures since the cache is only
+     * an optimization
+     */
+    static void saveCachedProgram(
+            GLuint program,
+            const std::string &binaryCachePath,
+            uint64_t cacheKey);
+
     /*!
      * Constructs a new instance of a shader. Use @a loadShader
      * @param program the GL program id of the shader
-     * @param position the attribute location of the position
-     * @param uv the attribute location of the uv coordinates
      * @param projectionMatrix the uniform location of the projection matrix
+     * @param instanced whether the program reads the instance attributes
+     * @param fromCache whether the program was loaded from its binary cache
      */
     constexpr Shader(
             GLuint program,
-            GLint position,
-            GLint uv,
-            GLint projectionMatrix)
+            GLint projectionMatrix,
+            bool instanced,
+            bool fromCache)
             : program_(program),
-              position_(position),
-              uv_(uv),
-              projectionMatrix_(projectionMatrix) {}
+              projectionMatrix_(projectionMatrix),
+              instanced_(instanced),
+              fromCache_(fromCache) {}
 
     GLuint program_;
-    GLint position_;
-    GLint uv_;
     GLint projectionMatrix_;
+    bool instanced_;
+    bool fromCache_;
 };
 
 #endif //ANDROIDGLINVESTIGATIONS_SHADER_H
\ No newline at end of file
@@ -1,7 +1,8 @@
 #include <android/imagedecoder.h>
 #include "TextureAsset.h"
-#include "AndroidOut.h"
+#include "logger.h"
 #include "Utility.h"
+#include "GlStats.h"
 
 std::shared_ptr<TextureAsset>
 TextureAsset::loadAsset(AAssetManager *assetManager, const std::string &assetPath) {
@@ -10,11 +11,19 @@ TextureAsset::loadAsset(AAssetManager *assetManager, const std::string &assetPat
             assetManager,
             assetPath.c_str(),
             AASSET_MODE_BUFFER);
+    if (!pAndroidRobotPng) {
+        LOGE("Could not open asset %s", assetPath.c_str());
+        return nullptr;
+    }
 
     // Make a decoder to turn it into a texture
     AImageDecoder *pAndroidDecoder = nullptr;
     auto result = AImageDecoder_createFromAAsset(pAndroidRobotPng, &pAndroidDecoder);
-    assert(result == ANDROID_IMAGE_DECODER_SUCCESS);
+    if (result != ANDROID_IMAGE_DECODER_SUCCESS) {
+        LOGE("Could not decode asset %s", assetPath.c_str());
+        AAsset_close(pAndroidRobotPng);
+        return nullptr;
+    }
 
     // make sure we get 8 bits per channel out. RGBA order.
     AImageDecoder_setAndroidBitmapFormat(pAndroidDecoder, ANDROID_BITMAP_FORMAT_RGBA_8888);
@@ -35,7 +44,12 @@ TextureAsset::loadAsset(AAssetManager *assetManager, const std::string &assetPat
             upAndroidImageData->data(),
             stride,
             upAndroidImageData->size());
-    assert(decodeResult == ANDROID_IMAGE_DECODER_SUCCESS);
+    if (decodeResult != ANDROID_IMAGE_DECODER_SUCCESS) {
+        LOGE("Could not decode asset %s", assetPath.c_str());
+        AImageDecoder_delete(pAndroidDecoder);
+        AAsset_close(pAndroidRobotPng);
+        return nullptr;
+    }
 
     // Get an opengl texture
     GLuint textureId;
@@ -73,6 +87,123 @@ TextureAsset::loadAsset(AAssetManager *assetManager, const std::string &assetPat
     return std::shared_ptr<TextureAsset>(new TextureAsset(textureId));
 }
 
+std::shared_ptr<TextureAsset>
+TextureAsset::createFromPixels(int32_t width, int32_t height, const std::vector<uint8_t> &pixels) {
+    assert(pixels.size() >= static_cast<size_t>(width) * height * 4);
+
+    GLuint textureId;
+    glGenTextures(1, &textureId);
+    glBindTexture(GL_TEXTURE_2D, textureId);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    // Generated textures are atlases, mip levels would bleed neighbouring tiles into each other
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    glTexImage2D(
+            GL_TEXTURE_2D,
+            0,
+            GL_RGBA,
+            width,
+            height,
+            0,
+            GL_RGBA,
+            GL_UNSIGNED_BYTE,
+            pixels.data());
+
+    return std::shared_ptr<TextureAsset>(new TextureAsset(textureId));
+}
+
+std::shared_ptr<TextureAsset>
+TextureAsset::createFromChannel(int32_t width, int32_t height, const uint8_t *pixels) {
+    GLuint textureId;
+    glGenTextures(1, &textureId);
+    glBindTexture(GL_TEXTURE_2D, textureId);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    // Averaging a distance field still gives a distance field, so mips keep small glyphs smooth
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    // single channel rows need not be 4 byte aligned
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(
+            GL_TEXTURE_2D,
+            0,
+            GL_R8,
+            width,
+            height,
+            0,
+            GL_RED,
+            GL_UNSIGNED_BYTE,
+            pixels);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glGenerateMipmap(GL_TEXTURE_2D);
+
+    return std::shared_ptr<TextureAsset>(new TextureAsset(textureId));
+}
+
+std::shared_ptr<TextureAsset>
+TextureAsset::createStorage(int32_t width, int32_t height, int32_t levels) {
+    GLuint textureId;
+    glGenTextures(1, &textureId);
+    glBindTexture(GL_TEXTURE_2D, textureId);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    // The levels come from the caller, already filtered so they do not bleed across atlas tiles
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+
+    glTexStorage2D(GL_TEXTURE_2D, levels, GL_RGBA8, width, height);
+
+    return std::shared_ptr<TextureAsset>(new TextureAsset(textureId));
+}
+
+void TextureAsset::uploadRows(
+        int32_t level,
+        int32_t width,
+        int32_t firstRow,
+        int32_t rowCount,
+        const uint8_t *pixels) {
+    GL_COUNTED(glBindTexture(GL_TEXTURE_2D, textureID_));
+    GL_COUNTED(glTexSubImage2D(
+            GL_TEXTURE_2D,
+            level,
+            0,
+            firstRow,
+            width,
+            rowCount,
+            GL_RGBA,
+            GL_UNSIGNED_BYTE,
+            pixels));
+    glStats.bytesUploaded += static_cast<size_t>(width) * rowCount * 4;
+}
+
+void TextureAsset::updatePixels(int32_t width, int32_t height, const std::vector<uint8_t> &pixels) {
+    size_t size = static_cast<size_t>(width) * height * 4;
+    assert(pixels.size() >= size);
+
+    GL_COUNTED(glBindTexture(GL_TEXTURE_2D, textureID_));
+    GL_COUNTED(glTexSubImage2D(
+            GL_TEXTURE_2D,
+            0,
+            0,
+            0,
+            width,
+            height,
+            GL_RGBA,
+            GL_UNSIGNED_BYTE,
+            pixels.data()));
+    glStats.bytesUploaded += size;
+}
+
 TextureAsset::~TextureAsset() {
     // return texture resources
     glDeleteTextures(1, &textureID_);
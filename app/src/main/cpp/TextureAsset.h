@@ -13,13 +13,64 @@ public:
      * Loads a texture asset from the assets/ directory
      * @param assetManager Asset manager to use
      * @param assetPath The path to the asset
-     * @return a shared pointer to a texture asset, resources will be reclaimed when it's cleaned up
+     * @return a shared pointer to a texture asset, resources will be reclaimed when it's cleaned
+     * up, or nullptr if the asset could not be opened or decoded
      */
     static std::shared_ptr<TextureAsset>
     loadAsset(AAssetManager *assetManager, const std::string &assetPath);
 
+    /*!
+     * Creates a texture from pixels generated in code
+     * @param width The width of the image in pixels
+     * @param height The height of the image in pixels
+     * @param pixels Tightly packed RGBA8 rows, top row first
+     * @return a shared pointer to a texture asset, resources will be reclaimed when it's cleaned up
+     */
+    static std::shared_ptr<TextureAsset>
+    createFromPixels(int32_t width, int32_t height, const std::vector<uint8_t> &pixels);
+
+    /*!
+     * Creates a single channel texture, e.g. a distance field, with a full mip chain
+     * @param width The width of the image in pixels
+     * @param height The height of the image in pixels
+     * @param pixels Tightly packed R8 rows, top row first
+     * @return a shared pointer to a texture asset, resources will be reclaimed when it's cleaned up
+     */
+    static std::shared_ptr<TextureAsset>
+    createFromChannel(int32_t width, int32_t height, const uint8_t *pixels);
+
+    /*!
+     * Creates an immutable RGBA8 texture with storage for every mip level but no pixels yet, to be
+     * filled a few rows at a time with uploadRows
+     * @param width The width of level 0 in pixels
+     * @param height The height of level 0 in pixels
+     * @param levels The number of mip levels, each half the size of the one before
+     * @return a shared pointer to a texture asset, resources will be reclaimed when it's cleaned up
+     */
+    static std::shared_ptr<TextureAsset>
+    createStorage(int32_t width, int32_t height, int32_t levels);
+
     ~TextureAsset();
 
+    /*!
+     * Uploads a band of rows of one mip level of a texture made by createStorage
+     * @param level The mip level
+     * @param width The width of the level in pixels
+     * @param firstRow The first row of the band
+     * @param rowCount The number of rows in the band
+     * @param pixels Tightly packed RGBA8 rows of the band, top row first
+     */
+    void uploadRows(int32_t level, int32_t width, int32_t firstRow, int32_t rowCount,
+                    const uint8_t *pixels);
+
+    /*!
+     * Replaces the pixels of a texture made by createFromPixels, keeping its size
+     * @param width The width of the texture in pixels
+     * @param height The height of the texture in pixels
+     * @param pixels Tightly packed RGBA8 rows, top row first
+     */
+    void updatePixels(int32_t width, int32_t height, const std::vector<uint8_t> &pixels);
+
     /*!
      * @return the texture id for use with OpenGL
      */
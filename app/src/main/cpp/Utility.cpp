@@ -1,15 +1,15 @@
 #include "Utility.h"
-#include "AndroidOut.h"
+#include "logger.h"
 
 #include <GLES3/gl3.h>
 
-#define CHECK_ERROR(e) case e: aout << "GL Error: "#e << std::endl; break;
+#define CHECK_ERROR(e) case e: LOGE("GL Error: "#e); break;
 
 bool Utility::checkAndLogGlError(bool alwaysLog) {
     GLenum error = glGetError();
     if (error == GL_NO_ERROR) {
         if (alwaysLog) {
-            aout << "No GL error" << std::endl;
+            LOGI("No GL error");
         }
         return true;
     } else {
@@ -20,7 +20,7 @@ bool Utility::checkAndLogGlError(bool alwaysLog) {
             CHECK_ERROR(GL_INVALID_FRAMEBUFFER_OPERATION);
             CHECK_ERROR(GL_OUT_OF_MEMORY);
             default:
-                aout << "Unknown GL error: " << error << std::endl;
+                LOGE("Unknown GL error: %u", error);
         }
         return false;
     }
@@ -0,0 +1,178 @@
+#include "atlas_cache.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include "board_instances.h"
+
+namespace {
+
+const char MAGIC[4] = {'M', 'S', 'A', 'T'};
+
+struct CacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t tileSize;
+    uint32_t columns;
+    uint32_t levelCount;
+    uint32_t reserved;
+    uint64_t hash;
+};
+
+static_assert(sizeof(CacheHeader) == 32, "CacheHeader is written to disk as is");
+
+// FNV-1a over 8 byte words rather than bytes, so checking the cache costs far less than reading it.
+// Every level is a multiple of 8 bytes, 4 bytes per texel and at least 2 texels per row.
+uint64_t hashLevels(const std::vector<std::vector<uint8_t>> &levels) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (const auto &level: levels) {
+        for (size_t i = 0; i + 8 <= level.size(); i += 8) {
+            uint64_t word;
+            std::memcpy(&word, level.data() + i, sizeof(word));
+            hash = (hash ^ word) * 0x100000001b3ull;
+        }
+    }
+    return hash;
+}
+
+int32_t levelCountFor(int32_t tileSize) {
+    int32_t count = 1;
+    while ((tileSize >> (count - 1)) > 1) {
+        count += 1;
+    }
+    return count;
+}
+
+}
+
+int32_t AtlasImage::getLevelSide(int32_t level) const {
+    return (ATLAS_COLUMNS * tileSize) >> level;
+}
+
+AtlasImage buildAtlasImage(int32_t tileSize, int32_t threads) {
+    AtlasImage image;
+    image.tileSize = tileSize;
+    int32_t levelCount = levelCountFor(tileSize);
+    image.levels.reserve(levelCount);
+    image.levels.push_back(buildCellAtlas(tileSize, threads));
+    for (int32_t level = 1; level < levelCount; level++) {
+        // Tiles stay aligned to even texels down to the last level, so each 2x2 box lies inside
+        // one tile.
+        const std::vector<uint8_t> &source = image.levels.back();
+        int32_t sourceSide = image.getLevelSide(level - 1);
+        int32_t side = image.getLevelSide(level);
+        std::vector<uint8_t> pixels(static_cast<size_t>(side) * side * 4);
+        for (int32_t y = 0; y < side; y++) {
+            for (int32_t x = 0; x < side; x++) {
+                for (int32_t channel = 0; channel < 4; channel++) {
+                    auto at = [&](int32_t sx, int32_t sy) {
+                        return source[(static_cast<size_t>(sy) * sourceSide + sx) * 4 + channel];
+                    };
+                    int32_t sum = at(2 * x, 2 * y) + at(2 * x + 1, 2 * y) + at(2 * x, 2 * y + 1) +
+                                  at(2 * x + 1, 2 * y + 1);
+                    pixels[(static_cast<size_t>(y) * side + x) * 4 + channel] =
+                            static_cast<uint8_t>((sum + 2) / 4);
+                }
+            }
+        }
+        image.levels.push_back(std::move(pixels));
+    }
+    return image;
+}
+
+bool writeAtlasCache(const std::string &path, const AtlasImage &image) {
+    CacheHeader header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = ATLAS_VERSION;
+    header.tileSize = static_cast<uint32_t>(image.tileSize);
+    header.columns = ATLAS_COLUMNS;
+    header.levelCount = static_cast<uint32_t>(image.levels.size());
+    header.hash = hashLevels(image.levels);
+
+    std::string temporaryPath = path + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        for (const auto &level: image.levels) {
+            file.write(reinterpret_cast<const char *>(level.data()),
+                       static_cast<std::streamsize>(level.size()));
+        }
+        if (not file.flush()) {
+            std::remove(temporaryPath.c_str());
+            return false;
+        }
+    }
+    return std::rename(temporaryPath.c_str(), path.c_str()) == 0;
+}
+
+bool readAtlasCache(const std::string &path, int32_t tileSize, AtlasImage &outImage) {
+    std::ifstream file(path, std::ios::binary);
+    CacheHeader header{};
+    if (not file.read(reinterpret_cast<char *>(&header), sizeof(header))) {
+        return false;
+    }
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 or header.version != ATLAS_VERSION or
+        header.tileSize != static_cast<uint32_t>(tileSize) or header.columns != ATLAS_COLUMNS or
+        header.levelCount != static_cast<uint32_t>(levelCountFor(tileSize))) {
+        return false;
+    }
+    AtlasImage image;
+    image.tileSize = tileSize;
+    image.levels.resize(header.levelCount);
+    for (int32_t level = 0; level < static_cast<int32_t>(header.levelCount); level++) {
+        size_t side = image.getLevelSide(level);
+        image.levels[level].resize(side * side * 4);
+        if (not file.read(reinterpret_cast<char *>(image.levels[level].data()),
+                          static_cast<std::streamsize>(image.levels[level].size()))) {
+            return false;
+        }
+    }
+    if (hashLevels(image.levels) != header.hash) {
+        return false;
+    }
+    outImage = std::move(image);
+    return true;
+}
+
+AtlasLoader::~AtlasLoader() {
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+void AtlasLoader::start(std::string cachePath, int32_t tileSize, std::function<void()> onReady) {
+    thread = std::thread([this, cachePath = std::move(cachePath), tileSize,
+                                 onReady = std::move(onReady)]() {
+        auto start = std::chrono::steady_clock::now();
+        cached = not cachePath.empty() and readAtlasCache(cachePath, tileSize, image);
+        if (not cached) {
+            image = buildAtlasImage(tileSize, 0);
+        }
+        loadNanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count();
+        ready.store(true, std::memory_order_release);
+        if (onReady) {
+            onReady();
+        }
+        // The atlas is usable already; the cache is only for the next start.
+        if (not cached and not cachePath.empty()) {
+            writeAtlasCache(cachePath, image);
+        }
+    });
+}
+
+bool AtlasLoader::isReady() const {
+    return ready.load(std::memory_order_acquire);
+}
+
+const AtlasImage &AtlasLoader::getImage() const {
+    return image;
+}
+
+bool AtlasLoader::wasCached() const {
+    return cached;
+}
+
+int64_t AtlasLoader::getLoadNanos() const {
+    return loadNanos;
+}
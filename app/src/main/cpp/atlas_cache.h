@@ -0,0 +1,80 @@
+#ifndef MINESWEEPER_ATLAS_CACHE_H
+#define MINESWEEPER_ATLAS_CACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Bump whenever buildCellAtlas draws differently, so cached atlases from older builds are redrawn.
+constexpr uint32_t ATLAS_VERSION = 2;
+
+// The cell atlas with its full mip chain, ready for upload.
+struct AtlasImage {
+    int32_t tileSize = 0;
+    // RGBA8 levels, level 0 first. Level i is getLevelSide(i) pixels square.
+    std::vector<std::vector<uint8_t>> levels;
+
+    int32_t getLevelSide(int32_t level) const;
+};
+
+// Draws the atlas on up to threads workers and builds its mips down to one pixel per tile. Each
+// mip texel averages texels of one tile only, so zoomed out cells do not pick up their neighbours
+// in the atlas. tileSize must be a power of two.
+AtlasImage buildAtlasImage(int32_t tileSize, int32_t threads);
+
+/*
+ * Cache file, little endian:
+ *
+ *   "MSAT", u32 ATLAS_VERSION, u32 tileSize, u32 columns, u32 levelCount, u32 0, u64 FNV-1a hash
+ *   of the level bytes taken 8 at a time, then every level's pixels in order
+ *
+ * A file with another version, tile size or hash is ignored and redrawn.
+ */
+
+// Writes to a temporary file next to path and renames it over path, so a crash never leaves a torn
+// cache behind. Returns false if the file could not be written.
+bool writeAtlasCache(const std::string &path, const AtlasImage &image);
+
+// Returns false if path holds no valid atlas of tileSize for this ATLAS_VERSION.
+bool readAtlasCache(const std::string &path, int32_t tileSize, AtlasImage &outImage);
+
+// Produces the atlas on a background thread: from the cache when it is valid, otherwise drawn with
+// buildAtlasImage and written back to the cache for the next start.
+class AtlasLoader {
+public:
+    AtlasLoader() = default;
+
+    AtlasLoader(const AtlasLoader &) = delete;
+
+    AtlasLoader &operator=(const AtlasLoader &) = delete;
+
+    // Waits for the background thread.
+    ~AtlasLoader();
+
+    // onReady runs on the background thread once the atlas is ready, e.g. to wake the render loop.
+    // An empty cachePath skips the cache.
+    void start(std::string cachePath, int32_t tileSize, std::function<void()> onReady);
+
+    bool isReady() const;
+
+    // Only valid once isReady() is true. The background thread may still be reading it to write
+    // the cache, so it must not be changed.
+    const AtlasImage &getImage() const;
+
+    bool wasCached() const;
+
+    // Time the background thread took, cache read or draw included.
+    int64_t getLoadNanos() const;
+
+private:
+    std::thread thread;
+    std::atomic<bool> ready{false};
+    AtlasImage image;
+    bool cached = false;
+    int64_t loadNanos = 0;
+};
+
+#endif //MINESWEEPER_ATLAS_CACHE_H
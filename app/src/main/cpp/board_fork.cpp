@@ -0,0 +1,258 @@
+#include "board_fork.h"
+#include "zobrist.h"
+
+namespace {
+
+const std::pair<int32_t, int32_t> DELTA[8] = {{0,  1},
+                                              {0,  -1},
+                                              {1,  0},
+                                              {-1, 0},
+                                              {-1, -1},
+                                              {-1, 1},
+                                              {1,  -1},
+                                              {1,  1}};
+
+bool isCovered(const Cell &cell) {
+    return cell.isMine and (cell.isRevealed or cell.isFlagged);
+}
+
+// Owner tags handed out so far. 0 is never handed out: it marks a fork that owns no tile.
+std::atomic<uint64_t> lastOwner{0};
+
+uint64_t nextOwner() {
+    return lastOwner.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+}
+
+BoardFork::BoardFork(const GameBoard &board) : owner(nextOwner()) {
+    width = board.getWidth();
+    height = board.getHeight();
+    tilesPerRow = (width + TILE_SIZE - 1) >> TILE_SHIFT;
+    int32_t tileRows = (height + TILE_SIZE - 1) >> TILE_SHIFT;
+    state = board.state;
+    visibleHash = board.getVisibleHash();
+    tiles.resize(static_cast<size_t>(tilesPerRow) * tileRows);
+    for (auto &tile: tiles) {
+        tile = std::make_shared<Tile>();
+        tile->owner = owner.load(std::memory_order_relaxed);
+    }
+    for (int32_t y = 0; y < height; y++) {
+        for (int32_t x = 0; x < width; x++) {
+            const Cell &cell = board.getCell(x, y);
+            mutableCell(x, y) = cell;
+            if (cell.isMine) {
+                mineCount += 1;
+            }
+            if (isCovered(cell)) {
+                coveredMines += 1;
+            }
+        }
+    }
+    copiedTiles = 0;
+}
+
+BoardFork::BoardFork(const BoardFork &other) : owner(0) {
+    copyFrom(other);
+}
+
+BoardFork::BoardFork(BoardFork &&other) noexcept
+        : width(other.width), height(other.height), tilesPerRow(other.tilesPerRow),
+          mineCount(other.mineCount), coveredMines(other.coveredMines),
+          copiedTiles(other.copiedTiles), visibleHash(other.visibleHash), state(other.state),
+          owner(other.owner.load(std::memory_order_relaxed)), tiles(std::move(other.tiles)) {
+    other.owner.store(0, std::memory_order_relaxed);
+}
+
+BoardFork &BoardFork::operator=(const BoardFork &other) {
+    if (this != &other) {
+        owner.store(0, std::memory_order_relaxed);
+        copyFrom(other);
+    }
+    return *this;
+}
+
+BoardFork &BoardFork::operator=(BoardFork &&other) noexcept {
+    if (this != &other) {
+        width = other.width;
+        height = other.height;
+        tilesPerRow = other.tilesPerRow;
+        mineCount = other.mineCount;
+        coveredMines = other.coveredMines;
+        copiedTiles = other.copiedTiles;
+        visibleHash = other.visibleHash;
+        state = other.state;
+        owner.store(other.owner.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        tiles = std::move(other.tiles);
+        other.owner.store(0, std::memory_order_relaxed);
+    }
+    return *this;
+}
+
+void BoardFork::copyFrom(const BoardFork &other) {
+    // From here on other copies the tiles it created before writing to them, like this fork does.
+    // Only the first fork stores, so forking a shared root from many threads leaves its cache line
+    // alone.
+    if (other.owner.load(std::memory_order_relaxed) != 0) {
+        other.owner.store(0, std::memory_order_relaxed);
+    }
+    width = other.width;
+    height = other.height;
+    tilesPerRow = other.tilesPerRow;
+    mineCount = other.mineCount;
+    coveredMines = other.coveredMines;
+    copiedTiles = 0;
+    visibleHash = other.visibleHash;
+    state = other.state;
+    tiles = other.tiles;
+}
+
+BoardFork BoardFork::fork() const {
+    return *this;
+}
+
+const Cell &BoardFork::getCell(int32_t x, int32_t y) const {
+    const Tile &tile = *tiles[(y >> TILE_SHIFT) * tilesPerRow + (x >> TILE_SHIFT)];
+    return tile.cells[(y & (TILE_SIZE - 1)) * TILE_SIZE + (x & (TILE_SIZE - 1))];
+}
+
+Cell &BoardFork::mutableCell(int32_t x, int32_t y) {
+    std::shared_ptr<Tile> &tile = tiles[(y >> TILE_SHIFT) * tilesPerRow + (x >> TILE_SHIFT)];
+    uint64_t tag = owner.load(std::memory_order_relaxed);
+    if (tile->owner != tag) {
+        // A fork takes a tag with its first copy, so forks that are only read cost no tag
+        if (tag == 0) {
+            tag = nextOwner();
+            owner.store(tag, std::memory_order_relaxed);
+        }
+        tile = std::make_shared<Tile>(*tile);
+        tile->owner = tag;
+        copiedTiles += 1;
+    }
+    return tile->cells[(y & (TILE_SIZE - 1)) * TILE_SIZE + (x & (TILE_SIZE - 1))];
+}
+
+template<class Change>
+void BoardFork::updateCell(int32_t x, int32_t y, Change change) {
+    Cell &cell = mutableCell(x, y);
+    bool wasCovered = isCovered(cell);
+    int32_t index = y * width + x;
+    visibleHash ^= zobristKey(index, visibleCode(cell));
+    change(cell);
+    visibleHash ^= zobristKey(index, visibleCode(cell));
+    coveredMines += static_cast<int32_t>(isCovered(cell)) - static_cast<int32_t>(wasCovered);
+    if (state == ONGOING and coveredMines == mineCount) {
+        state = VICTORY;
+    }
+}
+
+int32_t BoardFork::revealCell(int32_t x, int32_t y) {
+    return reveal(x, y, nullptr);
+}
+
+int32_t BoardFork::revealCell(int32_t x, int32_t y, std::vector<int32_t> &outUncovered) {
+    return reveal(x, y, &outUncovered);
+}
+
+int32_t BoardFork::reveal(int32_t x, int32_t y, std::vector<int32_t> *outUncovered) {
+    // Shared by every fork on this thread, so speculative reveals do not allocate once warm.
+    static thread_local std::vector<std::pair<int32_t, int32_t>> stack;
+
+    if (getCell(x, y).isMine) {
+        state = STEPPED_MINE;
+    }
+    int32_t revealed = getCell(x, y).isRevealed ? 0 : 1;
+    if (revealed > 0 and outUncovered != nullptr) {
+        outUncovered->push_back(y * width + x);
+    }
+    updateCell(x, y, [](Cell &cell) { cell.isRevealed = true; });
+    if (getCell(x, y).adjacentMines > 0) {
+        return revealed;
+    }
+    stack.clear();
+    stack.emplace_back(x, y);
+    while (not stack.empty()) {
+        const auto [currentX, currentY] = stack.back();
+        stack.pop_back();
+        for (int32_t i = 0; i < 4; i++) {
+            int32_t nextX = currentX + DELTA[i].first;
+            int32_t nextY = currentY + DELTA[i].second;
+            if (not isInBounds(nextX, nextY)) {
+                continue;
+            }
+            const Cell &next = getCell(nextX, nextY);
+            if (next.isRevealed or next.isFlagged or next.isMine) {
+                continue;
+            }
+            updateCell(nextX, nextY, [](Cell &cell) { cell.isRevealed = true; });
+            revealed += 1;
+            if (outUncovered != nullptr) {
+                outUncovered->push_back(nextY * width + nextX);
+            }
+            if (getCell(nextX, nextY).adjacentMines > 0) {
+                continue;
+            }
+            stack.emplace_back(nextX, nextY);
+        }
+    }
+    return revealed;
+}
+
+void BoardFork::setFlag(int32_t x, int32_t y, bool isFlagged) {
+    if (getCell(x, y).isFlagged == isFlagged) {
+        return;
+    }
+    updateCell(x, y, [isFlagged](Cell &cell) { cell.isFlagged = isFlagged; });
+}
+
+void BoardFork::setMine(int32_t x, int32_t y, bool isMine) {
+    if (getCell(x, y).isMine == isMine) {
+        return;
+    }
+    int32_t change = isMine ? 1 : -1;
+    mineCount += change;
+    int32_t adjacentMines = 0;
+    for (const auto &[dx, dy]: DELTA) {
+        if (not isInBounds(x + dx, y + dy)) {
+            continue;
+        }
+        if (getCell(x + dx, y + dy).isMine) {
+            adjacentMines += 1;
+        } else {
+            updateCell(x + dx, y + dy, [change](Cell &cell) { cell.adjacentMines += change; });
+        }
+    }
+    // Mines carry no count, matching GameBoard::calculateAdjacentMines.
+    updateCell(x, y, [isMine, adjacentMines](Cell &cell) {
+        cell.isMine = isMine;
+        cell.adjacentMines = isMine ? 0 : adjacentMines;
+    });
+}
+
+GameStatus BoardFork::getState() const {
+    return state;
+}
+
+int32_t BoardFork::getWidth() const {
+    return width;
+}
+
+int32_t BoardFork::getHeight() const {
+    return height;
+}
+
+int32_t BoardFork::getMineCount() const {
+    return mineCount;
+}
+
+uint64_t BoardFork::getVisibleHash() const {
+    return visibleHash;
+}
+
+int32_t BoardFork::getCopiedTiles() const {
+    return copiedTiles;
+}
+
+bool BoardFork::isInBounds(int32_t x, int32_t y) const {
+    return 0 <= x and x < width and 0 <= y and y < height;
+}
@@ -0,0 +1,105 @@
+#ifndef MINESWEEPER_BOARD_FORK_H
+#define MINESWEEPER_BOARD_FORK_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "game_objects.h"
+
+// A board for speculative play. Cells live in square tiles that forks share with their parent until
+// one of them writes to a tile, which then gets its own copy. Forking copies one pointer per tile and
+// discarding a fork just drops those references, so solvers can try thousands of "what if I reveal
+// this" or "what if this is a mine" branches per move.
+//
+// Every tile records the fork that created it, and a fork writes in place only to tiles it created
+// and has not shared since: forking retires the owner tag of the parent as well, so both sides copy
+// a tile before their first write to it. Tiles are never written once another fork can see them,
+// so forks sharing tiles may be read and written from different threads, and one fork may be forked
+// from several threads at once. A single BoardFork is otherwise not thread-safe; in particular it
+// must not be written while it is being forked.
+class BoardFork {
+public:
+    static constexpr int32_t TILE_SHIFT = 3;
+    static constexpr int32_t TILE_SIZE = 1 << TILE_SHIFT;
+
+    // Snapshots a board, mines included. The snapshot shares nothing with the GameBoard.
+    explicit BoardFork(const GameBoard &board);
+
+    // Same as other.fork().
+    BoardFork(const BoardFork &other);
+
+    BoardFork(BoardFork &&other) noexcept;
+
+    BoardFork &operator=(const BoardFork &other);
+
+    BoardFork &operator=(BoardFork &&other) noexcept;
+
+    BoardFork fork() const;
+
+    const Cell &getCell(int32_t x, int32_t y) const;
+
+    // Same reveal rule as GameBoard::revealCell. Returns the number of cells uncovered.
+    int32_t revealCell(int32_t x, int32_t y);
+
+    // As above, and appends the row-major index of every cell it uncovers to outUncovered.
+    int32_t revealCell(int32_t x, int32_t y, std::vector<int32_t> &outUncovered);
+
+    void setFlag(int32_t x, int32_t y, bool isFlagged);
+
+    // Adds or removes a mine and patches the counts of its neighbours.
+    void setMine(int32_t x, int32_t y, bool isMine);
+
+    GameStatus getState() const;
+
+    int32_t getWidth() const;
+
+    int32_t getHeight() const;
+
+    int32_t getMineCount() const;
+
+    // Same visible-state hash as GameBoard::getVisibleHash, kept up to date by every change.
+    uint64_t getVisibleHash() const;
+
+    // Tiles this fork has written to since it was forked, i.e. the memory it does not share.
+    int32_t getCopiedTiles() const;
+
+private:
+    struct Tile {
+        std::array<Cell, TILE_SIZE * TILE_SIZE> cells;
+        // Tag of the fork that created the tile; set before the tile is shared, then never changed.
+        uint64_t owner = 0;
+    };
+
+    // Copies everything but the owner tags: both sides start owning no tile.
+    void copyFrom(const BoardFork &other);
+
+    Cell &mutableCell(int32_t x, int32_t y);
+
+    // Both revealCell overloads; outUncovered may be null.
+    int32_t reveal(int32_t x, int32_t y, std::vector<int32_t> *outUncovered);
+
+    bool isInBounds(int32_t x, int32_t y) const;
+
+    // Applies a change to one cell while keeping the victory bookkeeping and hash in sync.
+    template<class Change>
+    void updateCell(int32_t x, int32_t y, Change change);
+
+    int32_t width = 0;
+    int32_t height = 0;
+    int32_t tilesPerRow = 0;
+    int32_t mineCount = 0;
+    // Mines that are flagged or revealed; the board is won once this reaches mineCount.
+    int32_t coveredMines = 0;
+    int32_t copiedTiles = 0;
+    uint64_t visibleHash = 0;
+    GameStatus state = STARTED;
+    // Tiles whose owner matches are this fork's alone; 0 until the fork copies its first tile, and
+    // again once it is forked. Atomic only so concurrent forks may retire it; the fork's own thread
+    // is the only one that reads it.
+    mutable std::atomic<uint64_t> owner;
+    std::vector<std::shared_ptr<Tile>> tiles;
+};
+
+#endif //MINESWEEPER_BOARD_FORK_H
@@ -0,0 +1,288 @@
+#include "board_instances.h"
+#include <algorithm>
+#include "worker_pool.h"
+
+namespace {
+
+// What each atlas tile looks like from afar, when a cell is a single texel. Numbers are tinted by
+// their digit colour so dense areas stay readable.
+const uint8_t TEXEL_COLOURS[ATLAS_COLUMNS * ATLAS_COLUMNS][3] = {{192, 192, 192},
+                                                                 {160, 160, 224},
+                                                                 {160, 200, 160},
+                                                                 {224, 160, 160},
+                                                                 {150, 150, 190},
+                                                                 {190, 150, 150},
+                                                                 {150, 190, 190},
+                                                                 {140, 140, 140},
+                                                                 {170, 170, 170},
+                                                                 {110, 110, 110},
+                                                                 {230, 60,  40},
+                                                                 {20,  20,  20},
+                                                                 {255, 0,   0},
+                                                                 {200, 0,   120},
+                                                                 {0,   0,   0},
+                                                                 {0,   0,   0}};
+
+class AtlasCanvas {
+public:
+    AtlasCanvas(int32_t tileSize, std::vector<uint8_t> &pixels) : tileSize(tileSize),
+                                                                  pixels(pixels) {}
+
+    void selectTile(int32_t tile) {
+        this->originX = tile % ATLAS_COLUMNS * tileSize;
+        this->originY = tile / ATLAS_COLUMNS * tileSize;
+    }
+
+    // Fills the rectangle [x0, x1) x [y0, y1) of the current tile, in tile pixels.
+    void fill(int32_t x0, int32_t y0, int32_t x1, int32_t y1, uint8_t r, uint8_t g, uint8_t b) {
+        for (int32_t y = std::max(y0, 0); y < std::min(y1, tileSize); y++) {
+            for (int32_t x = std::max(x0, 0); x < std::min(x1, tileSize); x++) {
+                plot(x, y, r, g, b);
+            }
+        }
+    }
+
+    void plot(int32_t x, int32_t y, uint8_t r, uint8_t g, uint8_t b) {
+        size_t stride = static_cast<size_t>(ATLAS_COLUMNS) * tileSize;
+        uint8_t *pixel = &pixels[((originY + y) * stride + originX + x) * 4];
+        pixel[0] = r;
+        pixel[1] = g;
+        pixel[2] = b;
+        pixel[3] = 255;
+    }
+
+    void revealedBackground(uint8_t r, uint8_t g, uint8_t b) {
+        fill(0, 0, tileSize, tileSize, 128, 128, 128);
+        fill(1, 1, tileSize, tileSize, r, g, b);
+    }
+
+    void hiddenBackground() {
+        int32_t bevel = std::max(1, tileSize / 10);
+        fill(0, 0, tileSize, tileSize, 255, 255, 255);
+        fill(bevel, bevel, tileSize, tileSize, 128, 128, 128);
+        fill(bevel, bevel, tileSize - bevel, tileSize - bevel, 192, 192, 192);
+    }
+
+private:
+    int32_t tileSize;
+    int32_t originX = 0;
+    int32_t originY = 0;
+    std::vector<uint8_t> &pixels;
+};
+
+// Only backgrounds: numbers, flags and mines are glyphs the cell shader draws on top, see
+// glyph_atlas.h.
+void drawAtlasTile(AtlasCanvas &canvas, int32_t tile) {
+    canvas.selectTile(tile);
+    switch (tile) {
+        case TILE_HIDDEN:
+        case TILE_FLAG:
+            canvas.hiddenBackground();
+            break;
+        case TILE_EXPLODED:
+            canvas.revealedBackground(255, 0, 0);
+            break;
+        default:
+            canvas.revealedBackground(192, 192, 192);
+            break;
+    }
+}
+
+}
+
+uint8_t cellTile(const Cell &cell, GameStatus state) {
+    bool isOver = state == STEPPED_MINE or state == VICTORY;
+    if (cell.isRevealed) {
+        if (cell.isMine) {
+            return TILE_EXPLODED;
+        }
+        return static_cast<uint8_t>(cell.adjacentMines);
+    }
+    if (cell.isFlagged) {
+        return isOver and not cell.isMine ? TILE_WRONG_FLAG : TILE_FLAG;
+    }
+    if (isOver and cell.isMine) {
+        return state == VICTORY ? TILE_FLAG : TILE_MINE;
+    }
+    return TILE_HIDDEN;
+}
+
+bool InstanceBuilder::update(GameBoard &board) {
+    bool isIncremental = &board == source and board.isRecordingChanges() and
+                         board.getWidth() == width and board.getHeight() == height and
+                         board.state == state;
+    if (not board.drainChanges(changed)) {
+        isIncremental = false;
+    }
+    if (not isIncremental) {
+        board.setRecordChanges(true);
+        rebuild(board);
+        pending.clear();
+        pendingHead = 0;
+        isPending.assign(static_cast<size_t>(width) * height, 0);
+        // changed trades places with the board's change set, so both get room for every cell
+        pending.reserve(static_cast<size_t>(width) * height);
+        changed.reserve(static_cast<size_t>(width) * height);
+        return true;
+    }
+
+    // New changes queue behind the ones still waiting, keeping the board's breadth-first order.
+    // Mid-wave, e.g. while flags are toggled during a large opening, the entries already applied
+    // make way when the queue would outgrow its room, and a cell still waiting is not queued
+    // again, so the queue never holds more than every cell once.
+    if (pendingHead == pending.size()) {
+        pending.clear();
+        pendingHead = 0;
+    } else if (pending.size() + changed.size() > pending.capacity()) {
+        pending.erase(pending.begin(), pending.begin() + static_cast<ptrdiff_t>(pendingHead));
+        pendingHead = 0;
+    }
+    for (int32_t index: changed) {
+        if (not isPending[index]) {
+            isPending[index] = 1;
+            pending.push_back(index);
+        }
+    }
+    if (pendingHead == pending.size()) {
+        return false;
+    }
+    size_t end = pending.size();
+    if (cellBudget > 0 and end - pendingHead > static_cast<size_t>(cellBudget)) {
+        end = pendingHead + cellBudget;
+    }
+
+    for (; pendingHead < end; pendingHead++) {
+        int32_t index = pending[pendingHead];
+        isPending[index] = 0;
+        int32_t x = index % width;
+        int32_t y = index / width;
+        RenderTile &tile = tiles[(y >> RENDER_TILE_SHIFT) * tileColumns + (x >> RENDER_TILE_SHIFT)];
+        auto local = static_cast<uint32_t>((y - tile.y) * tile.width + (x - tile.x));
+        tile.instances[local].tile = cellTile(board.getCell(x, y), state);
+        tile.isTexelsDirty = true;
+        if (tile.isFullyDirty) {
+            continue;
+        }
+        // A tile changed over and over while off screen is simply uploaded whole.
+        if (tile.changed.size() >= tile.instances.size()) {
+            tile.changed.clear();
+            tile.isFullyDirty = true;
+        } else {
+            tile.changed.push_back(local);
+        }
+    }
+    return true;
+}
+
+void InstanceBuilder::setCellBudget(int32_t cellsPerUpdate) {
+    cellBudget = cellsPerUpdate;
+}
+
+bool InstanceBuilder::hasPendingCells() const {
+    return pendingHead < pending.size();
+}
+
+int32_t InstanceBuilder::getTileColumns() const {
+    return tileColumns;
+}
+
+int32_t InstanceBuilder::getTileRows() const {
+    return tileRows;
+}
+
+std::vector<RenderTile> &InstanceBuilder::getTiles() {
+    return tiles;
+}
+
+const std::vector<RenderTile> &InstanceBuilder::getTiles() const {
+    return tiles;
+}
+
+void InstanceBuilder::collectDirtyRanges(RenderTile &tile, std::vector<InstanceRange> &outRanges) {
+    outRanges.clear();
+    // Ranges closer than RANGE_MERGE_GAP merge, which bounds how many a tile can have
+    outRanges.reserve(RENDER_TILE_CELLS * RENDER_TILE_CELLS / (RANGE_MERGE_GAP + 1) + 1);
+    if (tile.isFullyDirty) {
+        outRanges.push_back(InstanceRange{0, static_cast<uint32_t>(tile.instances.size())});
+        tile.isFullyDirty = false;
+        tile.changed.clear();
+        return;
+    }
+    std::sort(tile.changed.begin(), tile.changed.end());
+    for (uint32_t position: tile.changed) {
+        if (not outRanges.empty()) {
+            InstanceRange &last = outRanges.back();
+            if (position < last.first + last.count + RANGE_MERGE_GAP) {
+                last.count = std::max(last.count, position + 1 - last.first);
+                continue;
+            }
+        }
+        outRanges.push_back(InstanceRange{position, 1});
+    }
+    tile.changed.clear();
+}
+
+void InstanceBuilder::rebuild(const GameBoard &board) {
+    source = &board;
+    width = board.getWidth();
+    height = board.getHeight();
+    state = board.state;
+    tileColumns = (width + RENDER_TILE_CELLS - 1) >> RENDER_TILE_SHIFT;
+    tileRows = (height + RENDER_TILE_CELLS - 1) >> RENDER_TILE_SHIFT;
+
+    tiles.resize(static_cast<size_t>(tileColumns) * tileRows);
+    for (int32_t row = 0; row < tileRows; row++) {
+        for (int32_t column = 0; column < tileColumns; column++) {
+            RenderTile &tile = tiles[row * tileColumns + column];
+            tile.x = column << RENDER_TILE_SHIFT;
+            tile.y = row << RENDER_TILE_SHIFT;
+            tile.width = std::min(RENDER_TILE_CELLS, width - tile.x);
+            tile.height = std::min(RENDER_TILE_CELLS, height - tile.y);
+            tile.instances.resize(static_cast<size_t>(tile.width) * tile.height);
+            tile.changed.clear();
+            // The tile turns fully dirty instead of listing more changes than it has cells
+            tile.changed.reserve(tile.instances.size());
+            tile.isFullyDirty = true;
+            tile.isTexelsDirty = true;
+            CellInstance *instance = tile.instances.data();
+            for (int32_t y = tile.y; y < tile.y + tile.height; y++) {
+                for (int32_t x = tile.x; x < tile.x + tile.width; x++) {
+                    instance->x = static_cast<uint16_t>(x);
+                    instance->y = static_cast<uint16_t>(y);
+                    instance->tile = cellTile(board.getCell(x, y), state);
+                    instance += 1;
+                }
+            }
+        }
+    }
+}
+
+void buildTileTexels(const RenderTile &tile, std::vector<uint8_t> &outTexels) {
+    outTexels.assign(static_cast<size_t>(RENDER_TILE_CELLS) * RENDER_TILE_CELLS * 4, 0);
+    for (int32_t y = 0; y < tile.height; y++) {
+        for (int32_t x = 0; x < tile.width; x++) {
+            const uint8_t *colour = TEXEL_COLOURS[tile.instances[y * tile.width + x].tile];
+            uint8_t *texel = &outTexels[(static_cast<size_t>(y) * RENDER_TILE_CELLS + x) * 4];
+            texel[0] = colour[0];
+            texel[1] = colour[1];
+            texel[2] = colour[2];
+            texel[3] = 255;
+        }
+    }
+}
+
+std::vector<uint8_t> buildCellAtlas(int32_t tileSize, int32_t threads) {
+    size_t side = static_cast<size_t>(ATLAS_COLUMNS) * tileSize;
+    std::vector<uint8_t> pixels(side * side * 4, 0);
+    // Tiles cover disjoint pixels, so workers can draw them side by side.
+    ChunkCounter counter(TILE_WRONG_FLAG + 1, 1);
+    runWorkers(resolveThreadCount(threads), [&](int32_t) {
+        AtlasCanvas canvas(tileSize, pixels);
+        int64_t first;
+        int64_t last;
+        while (counter.claim(first, last)) {
+            drawAtlasTile(canvas, static_cast<int32_t>(first));
+        }
+    });
+    return pixels;
+}
@@ -0,0 +1,126 @@
+#ifndef MINESWEEPER_BOARD_INSTANCES_H
+#define MINESWEEPER_BOARD_INSTANCES_H
+
+#include <cstdint>
+#include <vector>
+#include "game_objects.h"
+
+// Tiles of the cell atlas. Tiles 0-8 are revealed cells showing that many adjacent mines.
+enum CellTile {
+    TILE_HIDDEN = 9,
+    TILE_FLAG = 10,
+    TILE_MINE = 11,
+    TILE_EXPLODED = 12,
+    TILE_WRONG_FLAG = 13
+};
+
+// The atlas is a square grid of ATLAS_COLUMNS x ATLAS_COLUMNS tiles, tile i at column i % columns
+// of row i / columns.
+constexpr int32_t ATLAS_COLUMNS = 4;
+
+// Per-instance data of the board draw: the cell position and which atlas tile covers it.
+struct CellInstance {
+    uint16_t x;
+    uint16_t y;
+    uint8_t tile;
+    uint8_t padding[3];
+};
+
+static_assert(sizeof(CellInstance) == 8, "CellInstance is uploaded to GL as is");
+
+// A run of instances [first, first + count) that changed and needs uploading.
+struct InstanceRange {
+    uint32_t first;
+    uint32_t count;
+};
+
+// What a player sees for a cell. Once the game is over every mine is shown, the one stepped on
+// and wrongly placed flags marked.
+uint8_t cellTile(const Cell &cell, GameStatus state);
+
+// Render tiles are squares of RENDER_TILE_CELLS x RENDER_TILE_CELLS cells; tiles on the right and
+// bottom edges may be smaller.
+constexpr int32_t RENDER_TILE_SHIFT = 6;
+constexpr int32_t RENDER_TILE_CELLS = 1 << RENDER_TILE_SHIFT;
+
+// The instances of one render tile, row-major within the tile, with what changed since the
+// renderer last uploaded them. Both kinds of change accumulate until collected, so a tile that is
+// off screen for a while uploads once when it comes back.
+struct RenderTile {
+    int32_t x;
+    int32_t y;
+    int32_t width;
+    int32_t height;
+    std::vector<CellInstance> instances;
+    // Local indices of instances changed since collectDirtyRanges.
+    std::vector<uint32_t> changed;
+    bool isFullyDirty;
+    // Whether the tile's low-detail texels are stale.
+    bool isTexelsDirty;
+};
+
+// Builds the instances the renderer draws the board from, split into render tiles. The first update
+// builds everything and turns on the board's change set; after that only cells in the change set
+// are patched, so a static board costs nothing per frame and a move costs in proportion to the
+// cells it changed, whatever the board size. Ending the game changes how every mine is shown and
+// rebuilds everything again.
+class InstanceBuilder {
+public:
+    // Changed runs closer than this many instances are merged into one range, trading a few
+    // redundant bytes for fewer uploads.
+    static constexpr uint32_t RANGE_MERGE_GAP = 32;
+
+    // Returns true if any tile changed since the last call.
+    bool update(GameBoard &board);
+
+    // Caps the changed cells one update applies, 0 for no cap. Cells beyond it wait for later
+    // updates in the order the board changed them, so a large reveal spreads over frames as a
+    // wavefront instead of landing in one long frame.
+    void setCellBudget(int32_t cellsPerUpdate);
+
+    // Whether changed cells are still waiting for an update.
+    bool hasPendingCells() const;
+
+    int32_t getTileColumns() const;
+
+    int32_t getTileRows() const;
+
+    // Tiles row by row; tile (column, row) is at row * getTileColumns() + column.
+    std::vector<RenderTile> &getTiles();
+
+    const std::vector<RenderTile> &getTiles() const;
+
+    // Moves the tile's accumulated instance changes into outRanges as sorted, disjoint ranges of
+    // local indices. Leaves outRanges empty if nothing changed.
+    static void collectDirtyRanges(RenderTile &tile, std::vector<InstanceRange> &outRanges);
+
+private:
+    void rebuild(const GameBoard &board);
+
+    std::vector<RenderTile> tiles;
+    std::vector<int32_t> changed;
+    // Changed cells not applied yet, consumed from pendingHead. A cell waits at most once, marked
+    // in isPending by row-major index, so the queue never needs more room than the board has cells.
+    std::vector<int32_t> pending;
+    size_t pendingHead = 0;
+    std::vector<uint8_t> isPending;
+    int32_t cellBudget = 0;
+    const GameBoard *source = nullptr;
+    int32_t width = -1;
+    int32_t height = -1;
+    int32_t tileColumns = 0;
+    int32_t tileRows = 0;
+    GameStatus state = ERROR;
+};
+
+// Fills outTexels with one RGBA8 texel per cell of the tile, RENDER_TILE_CELLS texels square, for
+// drawing the tile when cells are too small to show their atlas tiles.
+void buildTileTexels(const RenderTile &tile, std::vector<uint8_t> &outTexels);
+
+// RGBA8 pixels of the cell atlas, ATLAS_COLUMNS * tileSize pixels square, drawn procedurally so
+// the board needs no image assets. It holds only the cell backgrounds; the glyphs drawn over them
+// come from GLYPH_ATLAS. Tiles are drawn on up to threads workers, 0 meaning one per
+// hardware thread.
+std::vector<uint8_t> buildCellAtlas(int32_t tileSize, int32_t threads = 1);
+
+#endif //MINESWEEPER_BOARD_INSTANCES_H
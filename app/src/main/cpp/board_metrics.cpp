@@ -0,0 +1,211 @@
+#include "board_metrics.h"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include "seeding.h"
+#include "worker_pool.h"
+
+namespace {
+
+constexpr int64_t BOARDS_PER_CLAIM = 256;
+
+bool isZero(const Cell &cell) {
+    return not cell.isMine and cell.adjacentMines == 0;
+}
+
+}
+
+BoardMetrics BoardAnalyzer::analyze(const GameBoard &board) {
+    width = board.getWidth();
+    int32_t height = board.getHeight();
+    parent.resize(static_cast<size_t>(width) * height);
+    size.resize(parent.size());
+
+    BoardMetrics metrics{0, 0, 0, 0};
+    for (int32_t y = 0; y < height; y++) {
+        for (int32_t x = 0; x < width; x++) {
+            int32_t index = y * width + x;
+            const Cell &cell = board.getCell(x, y);
+            parent[index] = -1;
+            if (cell.isMine) {
+                continue;
+            }
+            if (cell.adjacentMines == 0) {
+                parent[index] = index;
+                size[index] = 1;
+                metrics.openings += 1;
+                if (x > 0 and parent[index - 1] >= 0) {
+                    unite(index - 1, index);
+                    metrics.openings -= 1;
+                }
+                if (y > 0 and parent[index - width] >= 0 and
+                    find(index - width) != find(index)) {
+                    unite(index - width, index);
+                    metrics.openings -= 1;
+                }
+                continue;
+            }
+            bool uncovered = (x > 0 and isZero(board.getCell(x - 1, y))) or
+                             (x + 1 < width and isZero(board.getCell(x + 1, y))) or
+                             (y > 0 and isZero(board.getCell(x, y - 1))) or
+                             (y + 1 < height and isZero(board.getCell(x, y + 1)));
+            if (not uncovered) {
+                metrics.isolatedNumbers += 1;
+            }
+        }
+    }
+
+    for (int32_t index = 0; index < static_cast<int32_t>(parent.size()); index++) {
+        if (parent[index] == index) {
+            metrics.largestOpening = std::max(metrics.largestOpening, size[index]);
+        }
+    }
+    metrics.threeBV = metrics.openings + metrics.isolatedNumbers;
+    return metrics;
+}
+
+int32_t BoardAnalyzer::openingLabel(int32_t x, int32_t y) {
+    int32_t index = y * width + x;
+    return parent[index] < 0 ? -1 : find(index);
+}
+
+int32_t BoardAnalyzer::find(int32_t index) {
+    while (parent[index] != index) {
+        parent[index] = parent[parent[index]];
+        index = parent[index];
+    }
+    return index;
+}
+
+void BoardAnalyzer::unite(int32_t a, int32_t b) {
+    a = find(a);
+    b = find(b);
+    if (a == b) {
+        return;
+    }
+    if (size[a] < size[b]) {
+        std::swap(a, b);
+    }
+    parent[b] = a;
+    size[a] += size[b];
+}
+
+int32_t MetricsBatchResult::threeBVPercentile(double quantile) const {
+    auto rank = static_cast<int64_t>(quantile * static_cast<double>(std::max<int64_t>(boards - 1, 0)));
+    int64_t seen = 0;
+    for (int32_t value = 0; value < static_cast<int32_t>(threeBVCounts.size()); value++) {
+        seen += threeBVCounts[value];
+        if (seen > rank) {
+            return value;
+        }
+    }
+    return 0;
+}
+
+MetricsBatchResult runMetricsBatch(const MetricsBatchConfig &config) {
+    const Difficulty &difficulty = config.difficulty;
+    int32_t firstClickX = config.firstClickX < 0 ? difficulty.width / 2 : config.firstClickX;
+    int32_t firstClickY = config.firstClickY < 0 ? difficulty.height / 2 : config.firstClickY;
+    // A board can never need more reveals than it has cells.
+    size_t histogramSize = static_cast<size_t>(difficulty.width) * difficulty.height + 1;
+
+    struct Match {
+        int64_t index;
+        uint64_t seed;
+    };
+    struct WorkerResult {
+        MetricsBatchResult result;
+        std::vector<Match> matches;
+    };
+
+    int32_t threadCount = resolveThreadCount(config.threads);
+    ChunkCounter counter(config.boards, BOARDS_PER_CLAIM);
+    std::vector<WorkerResult> workers(threadCount);
+
+    auto start = std::chrono::steady_clock::now();
+    runWorkers(threadCount, [&](int32_t index) {
+        WorkerResult &worker = workers[index];
+        worker.result.threeBVCounts.assign(histogramSize, 0);
+        GameBoard board(difficulty.width, difficulty.height, difficulty.mineCount, 0,
+                        config.safeZone);
+        BoardAnalyzer analyzer;
+        int64_t first;
+        int64_t last;
+        while (counter.claim(first, last)) {
+            for (int64_t boardIndex = first; boardIndex < last; boardIndex++) {
+                uint64_t seed = deriveSeed(config.masterSeed, boardIndex);
+                board.reset(seed);
+                board.initializeBoard(firstClickX, firstClickY);
+                BoardMetrics metrics = analyzer.analyze(board);
+
+                MetricsBatchResult &result = worker.result;
+                result.boards += 1;
+                result.openingsTotal += metrics.openings;
+                result.isolatedNumbersTotal += metrics.isolatedNumbers;
+                result.threeBVCounts[metrics.threeBV] += 1;
+                if (config.minThreeBV <= metrics.threeBV and metrics.threeBV <= config.maxThreeBV) {
+                    result.matches += 1;
+                    // Every worker keeps its own first maxMatches, which is enough for the merged
+                    // first maxMatches in board order.
+                    if (static_cast<int64_t>(worker.matches.size()) < config.maxMatches) {
+                        worker.matches.push_back(Match{boardIndex, seed});
+                    }
+                }
+            }
+        }
+    });
+
+    MetricsBatchResult total;
+    total.threeBVCounts.assign(histogramSize, 0);
+    std::vector<Match> matches;
+    for (const auto &worker: workers) {
+        total.boards += worker.result.boards;
+        total.matches += worker.result.matches;
+        total.openingsTotal += worker.result.openingsTotal;
+        total.isolatedNumbersTotal += worker.result.isolatedNumbersTotal;
+        for (size_t value = 0; value < histogramSize; value++) {
+            total.threeBVCounts[value] += worker.result.threeBVCounts[value];
+        }
+        matches.insert(matches.end(), worker.matches.begin(), worker.matches.end());
+    }
+    std::sort(matches.begin(), matches.end(), [](const Match &a, const Match &b) {
+        return a.index < b.index;
+    });
+    for (const Match &match: matches) {
+        if (static_cast<int64_t>(total.matchingSeeds.size()) == config.maxMatches) {
+            break;
+        }
+        total.matchingSeeds.push_back(match.seed);
+    }
+    total.wallNanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+    return total;
+}
+
+void writeMetricsReport(std::ostream &out, const MetricsBatchConfig &config,
+                        const MetricsBatchResult &result) {
+    double boards = static_cast<double>(std::max<int64_t>(result.boards, 1));
+    double seconds = static_cast<double>(std::max<uint64_t>(result.wallNanos, 1)) / 1e9;
+    double threeBVTotal = 0.0;
+    for (size_t value = 0; value < result.threeBVCounts.size(); value++) {
+        threeBVTotal += static_cast<double>(value) * static_cast<double>(result.threeBVCounts[value]);
+    }
+
+    out << std::fixed << std::setprecision(2);
+    out << "difficulty: " << config.difficulty.name << " (" << config.difficulty.width << "x"
+        << config.difficulty.height << ", " << config.difficulty.mineCount << " mines)\n";
+    out << "safe zone: " << safeZoneName(config.safeZone) << "\n";
+    out << "master seed: " << config.masterSeed << "\n";
+    out << "boards: " << result.boards << " (" << result.boards / seconds << " boards/s)\n";
+    out << "3BV: mean " << threeBVTotal / boards << ", p10 " << result.threeBVPercentile(0.1)
+        << ", p50 " << result.threeBVPercentile(0.5) << ", p90 "
+        << result.threeBVPercentile(0.9) << ", min " << result.threeBVPercentile(0.0)
+        << ", max " << result.threeBVPercentile(1.0) << "\n";
+    out << "openings: mean " << result.openingsTotal / boards << "\n";
+    out << "isolated numbers: mean " << result.isolatedNumbersTotal / boards << "\n";
+    out << "in 3BV range [" << config.minThreeBV << ", " << config.maxThreeBV << "]: "
+        << result.matches << "\n";
+    for (uint64_t seed: result.matchingSeeds) {
+        out << "seed " << seed << "\n";
+    }
+}
@@ -0,0 +1,84 @@
+#ifndef MINESWEEPER_BOARD_METRICS_H
+#define MINESWEEPER_BOARD_METRICS_H
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+#include "difficulty.h"
+#include "game_objects.h"
+
+// Difficulty metrics of a generated board, under the engine's own reveal rule: revealCell floods
+// through orthogonally connected zero cells and uncovers the numbers orthogonally next to them.
+struct BoardMetrics {
+    // Minimum number of reveals needed to clear the board: one per opening plus one per isolated
+    // number.
+    int32_t threeBV;
+    // Connected regions of zero cells, each cleared by a single reveal.
+    int32_t openings;
+    // Numbered cells that no opening uncovers and so need their own reveal.
+    int32_t isolatedNumbers;
+    // Zero cells in the biggest opening.
+    int32_t largestOpening;
+};
+
+// Labels openings with a union-find over one raster scan of the board. The label and size arrays are
+// kept between calls, so an analyzer allocates only when it sees a bigger board than before.
+class BoardAnalyzer {
+public:
+    // The board must have had its mines placed by initializeBoard.
+    BoardMetrics analyze(const GameBoard &board);
+
+    // Opening label of a cell from the last analyze call, or -1 for numbers and mines. Cells of the
+    // same opening share a label.
+    int32_t openingLabel(int32_t x, int32_t y);
+
+private:
+    int32_t find(int32_t index);
+
+    void unite(int32_t a, int32_t b);
+
+    int32_t width = 0;
+    std::vector<int32_t> parent;
+    std::vector<int32_t> size;
+};
+
+struct MetricsBatchConfig {
+    Difficulty difficulty = DIFFICULTIES[0];
+    SafeZone safeZone = SAFE_CELL;
+    // First click every board is generated around; negative means the board centre.
+    int32_t firstClickX = -1;
+    int32_t firstClickY = -1;
+    int64_t boards = 100000;
+    uint64_t masterSeed = 1;
+    // 0 uses every hardware thread.
+    int32_t threads = 0;
+    // Boards whose 3BV falls in [minThreeBV, maxThreeBV] are reported by seed.
+    int32_t minThreeBV = 0;
+    int32_t maxThreeBV = INT32_MAX;
+    // Upper bound on the seeds kept, so filtering millions of boards stays within memory.
+    int64_t maxMatches = 1000;
+};
+
+struct MetricsBatchResult {
+    int64_t boards = 0;
+    int64_t matches = 0;
+    int64_t openingsTotal = 0;
+    int64_t isolatedNumbersTotal = 0;
+    // threeBVCounts[v] is the number of boards with a 3BV of v.
+    std::vector<int64_t> threeBVCounts;
+    // Seeds of the first maxMatches matching boards, in board index order.
+    std::vector<uint64_t> matchingSeeds;
+    uint64_t wallNanos = 0;
+
+    // Smallest 3BV at or above the given quantile of all boards. quantile is in [0, 1].
+    int32_t threeBVPercentile(double quantile) const;
+};
+
+// Generates config.boards seeded boards across worker threads and analyzes each one. Board i always
+// uses deriveSeed(config.masterSeed, i), so results do not depend on the thread count.
+MetricsBatchResult runMetricsBatch(const MetricsBatchConfig &config);
+
+void writeMetricsReport(std::ostream &out, const MetricsBatchConfig &config,
+                        const MetricsBatchResult &result);
+
+#endif //MINESWEEPER_BOARD_METRICS_H
@@ -0,0 +1,129 @@
+#include "board_view.h"
+#include <algorithm>
+#include <cmath>
+#include "board_instances.h"
+
+void multiplyMatrices(const float *a, const float *b, float *outMatrix) {
+    for (int32_t column = 0; column < 4; column++) {
+        for (int32_t row = 0; row < 4; row++) {
+            float sum = 0.f;
+            for (int32_t k = 0; k < 4; k++) {
+                sum += a[k * 4 + row] * b[column * 4 + k];
+            }
+            outMatrix[column * 4 + row] = sum;
+        }
+    }
+}
+
+ViewRect viewRectFromMatrix(const float *viewProjection) {
+    // clip x = m[0] * x + m[12] and clip y = m[5] * y + m[13]; solve both for clip -1 and 1.
+    float x0 = (-1.f - viewProjection[12]) / viewProjection[0];
+    float x1 = (1.f - viewProjection[12]) / viewProjection[0];
+    float y0 = (-1.f - viewProjection[13]) / viewProjection[5];
+    float y1 = (1.f - viewProjection[13]) / viewProjection[5];
+    return ViewRect{std::min(x0, x1), std::min(y0, y1), std::max(x0, x1), std::max(y0, y1)};
+}
+
+TileSpan visibleTiles(const ViewRect &rect, int32_t tileColumns, int32_t tileRows) {
+    auto tileOf = [](float cell, int32_t limit) {
+        float tile = std::floor(cell / static_cast<float>(RENDER_TILE_CELLS));
+        return static_cast<int32_t>(std::min(std::max(tile, 0.f), static_cast<float>(limit)));
+    };
+    TileSpan span{};
+    span.firstColumn = tileOf(rect.left, tileColumns);
+    span.firstRow = tileOf(rect.top, tileRows);
+    // A tile is visible if any part of it is, so the far edges round outwards.
+    span.endColumn = std::min(tileOf(rect.right, tileColumns) + 1, tileColumns);
+    span.endRow = std::min(tileOf(rect.bottom, tileRows) + 1, tileRows);
+    if (rect.right < 0.f or rect.bottom < 0.f) {
+        span.endColumn = 0;
+        span.endRow = 0;
+    }
+    return span;
+}
+
+void BoardCamera::reset(int32_t surfaceWidth, int32_t surfaceHeight, int32_t boardWidth,
+                        int32_t boardHeight) {
+    this->boardWidth = boardWidth;
+    this->boardHeight = boardHeight;
+    this->centreX = boardWidth * 0.5f;
+    this->centreY = boardHeight * 0.5f;
+    this->pixelsPerCell = 0.f;
+    resize(surfaceWidth, surfaceHeight);
+}
+
+void BoardCamera::resize(int32_t surfaceWidth, int32_t surfaceHeight) {
+    this->surfaceWidth = std::max(surfaceWidth, 1);
+    this->surfaceHeight = std::max(surfaceHeight, 1);
+    this->minPixelsPerCell = std::min(static_cast<float>(this->surfaceWidth) / boardWidth,
+                                      static_cast<float>(this->surfaceHeight) / boardHeight);
+    clamp();
+}
+
+void BoardCamera::pan(float dxPixels, float dyPixels) {
+    centreX -= dxPixels / pixelsPerCell;
+    centreY -= dyPixels / pixelsPerCell;
+    clamp();
+}
+
+void BoardCamera::zoomAt(float focusX, float focusY, float factor) {
+    float offsetX = focusX - surfaceWidth * 0.5f;
+    float offsetY = focusY - surfaceHeight * 0.5f;
+    float focusCellX = centreX + offsetX / pixelsPerCell;
+    float focusCellY = centreY + offsetY / pixelsPerCell;
+    pixelsPerCell = std::min(std::max(pixelsPerCell * factor, minPixelsPerCell),
+                             MAX_PIXELS_PER_CELL);
+    centreX = focusCellX - offsetX / pixelsPerCell;
+    centreY = focusCellY - offsetY / pixelsPerCell;
+    clamp();
+}
+
+bool BoardCamera::cellAt(float pixelX, float pixelY, int32_t &outX, int32_t &outY) const {
+    float x = std::floor(centreX + (pixelX - surfaceWidth * 0.5f) / pixelsPerCell);
+    float y = std::floor(centreY + (pixelY - surfaceHeight * 0.5f) / pixelsPerCell);
+    if (x < 0.f or y < 0.f or x >= static_cast<float>(boardWidth) or
+        y >= static_cast<float>(boardHeight)) {
+        return false;
+    }
+    outX = static_cast<int32_t>(x);
+    outY = static_cast<int32_t>(y);
+    return true;
+}
+
+void BoardCamera::buildView(float *outMatrix) const {
+    std::fill(outMatrix, outMatrix + 16, 0.f);
+    outMatrix[0] = pixelsPerCell;
+    outMatrix[5] = -pixelsPerCell;
+    outMatrix[10] = 1.f;
+    outMatrix[12] = -centreX * pixelsPerCell;
+    outMatrix[13] = centreY * pixelsPerCell;
+    outMatrix[15] = 1.f;
+}
+
+void BoardCamera::buildViewProjection(float *outMatrix) const {
+    // Utility::buildOrthographicMatrix for half the surface height and planes at -1 and 1, which
+    // is not built off device.
+    float projection[16] = {};
+    projection[0] = 2.f / static_cast<float>(surfaceWidth);
+    projection[5] = 2.f / static_cast<float>(surfaceHeight);
+    projection[10] = -1.f;
+    projection[15] = 1.f;
+    float view[16];
+    buildView(view);
+    multiplyMatrices(projection, view, outMatrix);
+}
+
+float BoardCamera::getPixelsPerCell() const {
+    return pixelsPerCell;
+}
+
+uint64_t BoardCamera::getRevision() const {
+    return revision;
+}
+
+void BoardCamera::clamp() {
+    pixelsPerCell = std::min(std::max(pixelsPerCell, minPixelsPerCell), MAX_PIXELS_PER_CELL);
+    centreX = std::min(std::max(centreX, 0.f), static_cast<float>(boardWidth));
+    centreY = std::min(std::max(centreY, 0.f), static_cast<float>(boardHeight));
+    revision += 1;
+}
@@ -0,0 +1,93 @@
+#ifndef MINESWEEPER_BOARD_VIEW_H
+#define MINESWEEPER_BOARD_VIEW_H
+
+#include <cstdint>
+
+// Cells are drawn with their atlas tiles down to this many pixels per cell, and below it as single
+// texels of each render tile's low-detail texture.
+constexpr float LOD_PIXELS_PER_CELL = 4.f;
+constexpr float MAX_PIXELS_PER_CELL = 256.f;
+
+// An axis-aligned area of the board in cell coordinates, x right and y down.
+struct ViewRect {
+    float left;
+    float top;
+    float right;
+    float bottom;
+};
+
+// Render tiles [firstColumn, endColumn) x [firstRow, endRow).
+struct TileSpan {
+    int32_t firstColumn;
+    int32_t firstRow;
+    int32_t endColumn;
+    int32_t endRow;
+
+    bool isEmpty() const {
+        return firstColumn >= endColumn or firstRow >= endRow;
+    }
+
+    int32_t getTileCount() const {
+        return isEmpty() ? 0 : (endColumn - firstColumn) * (endRow - firstRow);
+    }
+};
+
+// Column-major 4x4 product a * b.
+void multiplyMatrices(const float *a, const float *b, float *outMatrix);
+
+// The area of the board a view-projection matrix puts inside the clip square. The matrix must map
+// cells to clip space without rotation, as BoardCamera::buildViewProjection does, so the frustum
+// test is the inverse of exactly the matrix the renderer draws with.
+ViewRect viewRectFromMatrix(const float *viewProjection);
+
+// Render tiles of RENDER_TILE_CELLS cells overlapping rect. Work is proportional to the visible
+// tiles, not the board.
+TileSpan visibleTiles(const ViewRect &rect, int32_t tileColumns, int32_t tileRows);
+
+// Zoom and pan state of the board on a surface. Zoom is kept between showing the whole board and
+// MAX_PIXELS_PER_CELL, and the view centre stays on the board.
+class BoardCamera {
+public:
+    // Fits the whole board on the surface, centred.
+    void reset(int32_t surfaceWidth, int32_t surfaceHeight, int32_t boardWidth, int32_t boardHeight);
+
+    // Keeps the centre and zoom for a new surface size, clamped to the new limits.
+    void resize(int32_t surfaceWidth, int32_t surfaceHeight);
+
+    // Moves the board with a finger that travelled (dx, dy) pixels.
+    void pan(float dxPixels, float dyPixels);
+
+    // Scales the zoom by factor, keeping the board point under (focusX, focusY) in place.
+    void zoomAt(float focusX, float focusY, float factor);
+
+    // Maps a surface pixel to the cell under it. Returns false outside the board.
+    bool cellAt(float pixelX, float pixelY, int32_t &outX, int32_t &outY) const;
+
+    // Column-major matrix taking cell coordinates to pixels with the origin at the surface centre
+    // and y up, what an orthographic projection of the surface expects.
+    void buildView(float *outMatrix) const;
+
+    // The view followed by an orthographic projection of the surface, mapping cells straight to
+    // clip space. Drawing and culling both use this matrix.
+    void buildViewProjection(float *outMatrix) const;
+
+    float getPixelsPerCell() const;
+
+    // Increases whenever the view changes, so callers can tell when to rebuild matrices.
+    uint64_t getRevision() const;
+
+private:
+    void clamp();
+
+    int32_t surfaceWidth = 1;
+    int32_t surfaceHeight = 1;
+    int32_t boardWidth = 1;
+    int32_t boardHeight = 1;
+    float centreX = 0.f;
+    float centreY = 0.f;
+    float pixelsPerCell = 1.f;
+    float minPixelsPerCell = 1.f;
+    uint64_t revision = 0;
+};
+
+#endif //MINESWEEPER_BOARD_VIEW_H
@@ -0,0 +1,58 @@
+#ifndef MINESWEEPER_BOUNDED_QUEUE_H
+#define MINESWEEPER_BOUNDED_QUEUE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+
+// Blocking FIFO with a fixed capacity, used to hand work between pipeline stages. A full queue
+// stalls its producer, which is what keeps a pipeline's memory bounded.
+template<class T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : capacity(capacity) {}
+
+    // Blocks while the queue is full. Returns false, dropping the item, once the queue is closed.
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this] { return closed or items.size() < capacity; });
+        if (closed) {
+            return false;
+        }
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+        return true;
+    }
+
+    // Blocks while the queue is empty. Returns false once the queue is closed and drained.
+    bool pop(T &outItem) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this] { return closed or not items.empty(); });
+        if (items.empty()) {
+            return false;
+        }
+        outItem = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    // Wakes every waiter. Items already queued can still be popped.
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        notFull.notify_all();
+        notEmpty.notify_all();
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable notFull;
+    std::condition_variable notEmpty;
+    std::deque<T> items;
+    size_t capacity;
+    bool closed = false;
+};
+
+#endif //MINESWEEPER_BOUNDED_QUEUE_H
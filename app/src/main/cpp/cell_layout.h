@@ -0,0 +1,102 @@
+#ifndef MINESWEEPER_CELL_LAYOUT_H
+#define MINESWEEPER_CELL_LAYOUT_H
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+// Layout policies map a cell's (x, y) to its slot in a board's flat cell storage. A layout is built
+// from the board's size, reports how many slots the storage needs (padding included, padding slots
+// stay default cells) and computes indices without branching. Boards take one as a template
+// argument, so the mapping inlines into every loop that walks the cells.
+
+// Rows one after another: horizontal neighbours share a cache line, vertical ones are a row apart.
+class RowMajorLayout {
+public:
+    RowMajorLayout(int32_t width, int32_t height) : width(width), height(height) {}
+
+    size_t getCapacity() const {
+        return static_cast<size_t>(width) * height;
+    }
+
+    size_t index(int32_t x, int32_t y) const {
+        return static_cast<size_t>(y) * width + x;
+    }
+
+private:
+    int32_t width;
+    int32_t height;
+};
+
+// Square tiles of 2^SHIFT cells a side, each stored row-major, the tiles themselves in row-major
+// order. A 3x3 neighbourhood stays within one tile unless it sits on the tile's edge.
+template<int32_t SHIFT>
+class TiledLayout {
+public:
+    static constexpr int32_t TILE_SIZE = 1 << SHIFT;
+
+    TiledLayout(int32_t width, int32_t height)
+            : tileColumns((width + TILE_SIZE - 1) >> SHIFT),
+              tileRows((height + TILE_SIZE - 1) >> SHIFT) {}
+
+    size_t getCapacity() const {
+        return static_cast<size_t>(tileColumns) * tileRows << (2 * SHIFT);
+    }
+
+    size_t index(int32_t x, int32_t y) const {
+        auto tile = static_cast<size_t>(y >> SHIFT) * tileColumns + (x >> SHIFT);
+        return tile << (2 * SHIFT) | static_cast<size_t>(y & (TILE_SIZE - 1)) << SHIFT |
+               static_cast<size_t>(x & (TILE_SIZE - 1));
+    }
+
+private:
+    int32_t tileColumns;
+    int32_t tileRows;
+};
+
+// Z-order: the bits of x and y interleaved, so every aligned power-of-two square is contiguous at
+// every scale. Only the low bits both coordinates have are interleaved; the longer side's extra
+// bits go on top, so a non-square board pads each side to a power of two rather than the square
+// of the longer one.
+class MortonLayout {
+public:
+    MortonLayout(int32_t width, int32_t height)
+            : widthBits(bitsFor(width)), heightBits(bitsFor(height)),
+              sharedBits(widthBits < heightBits ? widthBits : heightBits),
+              sharedMask((1u << sharedBits) - 1) {}
+
+    size_t getCapacity() const {
+        return static_cast<size_t>(1) << (widthBits + heightBits);
+    }
+
+    size_t index(int32_t x, int32_t y) const {
+        auto ux = static_cast<uint32_t>(x);
+        auto uy = static_cast<uint32_t>(y);
+        // Only the longer side has bits above sharedBits, so or-ing the two picks them out
+        size_t high = (ux >> sharedBits) | (uy >> sharedBits);
+        return high << (2 * sharedBits) | spread(ux & sharedMask) | spread(uy & sharedMask) << 1;
+    }
+
+private:
+    static int32_t bitsFor(int32_t size) {
+        return size <= 1 ? 0 : std::bit_width(static_cast<uint32_t>(size - 1));
+    }
+
+    // Moves bit i of value to bit 2i.
+    static size_t spread(uint32_t value) {
+        uint64_t bits = value;
+        bits = (bits | bits << 16) & 0x0000ffff0000ffffULL;
+        bits = (bits | bits << 8) & 0x00ff00ff00ff00ffULL;
+        bits = (bits | bits << 4) & 0x0f0f0f0f0f0f0f0fULL;
+        bits = (bits | bits << 2) & 0x3333333333333333ULL;
+        bits = (bits | bits << 1) & 0x5555555555555555ULL;
+        return static_cast<size_t>(bits);
+    }
+
+    int32_t widthBits;
+    int32_t heightBits;
+    int32_t sharedBits;
+    uint32_t sharedMask;
+};
+
+#endif //MINESWEEPER_CELL_LAYOUT_H
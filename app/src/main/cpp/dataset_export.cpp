@@ -0,0 +1,550 @@
+#include "dataset_export.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "bounded_queue.h"
+#include "seeding.h"
+#include "self_play.h"
+#include "worker_pool.h"
+
+namespace {
+
+constexpr uint32_t FORMAT_VERSION = 1;
+constexpr uint8_t MINE_BIT = 0x80;
+constexpr size_t NEIGHBOURHOOD_BYTES = 5;
+
+struct RawChunk {
+    int32_t games = 0;
+    std::vector<uint64_t> seeds;
+    std::vector<uint8_t> outcomes;
+    // One byte per cell of every game: MINE_BIT for mines, the adjacent count in the low bits.
+    std::vector<uint8_t> cells;
+    std::vector<uint32_t> moveOffsets;
+    std::vector<TracedMove> moves;
+};
+
+struct EncodedChunk {
+    std::vector<uint8_t> bytes;
+    int64_t games = 0;
+    int64_t moves = 0;
+};
+
+using RawQueue = BoundedQueue<std::unique_ptr<RawChunk>>;
+using EncodedQueue = BoundedQueue<std::unique_ptr<EncodedChunk>>;
+
+template<class T>
+void append(std::vector<uint8_t> &out, T value) {
+    size_t offset = out.size();
+    out.resize(offset + sizeof(T));
+    std::memcpy(out.data() + offset, &value, sizeof(T));
+}
+
+void appendMagic(std::vector<uint8_t> &out, const char *magic) {
+    uint32_t value;
+    std::memcpy(&value, magic, sizeof(value));
+    append<uint32_t>(out, value);
+}
+
+// Writes a column header and returns where its zero-filled body of the given length starts.
+size_t beginColumn(std::vector<uint8_t> &out, DatasetColumn column, size_t length) {
+    append<uint32_t>(out, column);
+    append<uint32_t>(out, 0);
+    append<uint64_t>(out, length);
+    size_t offset = out.size();
+    out.resize(offset + length, 0);
+    return offset;
+}
+
+template<class T>
+void appendArrayColumn(std::vector<uint8_t> &out, DatasetColumn column, const std::vector<T> &values) {
+    size_t offset = beginColumn(out, column, values.size() * sizeof(T));
+    if (not values.empty()) {
+        std::memcpy(out.data() + offset, values.data(), values.size() * sizeof(T));
+    }
+}
+
+// Bounds-checked little-endian reads over a byte range.
+struct ByteReader {
+    const uint8_t *position;
+    const uint8_t *end;
+
+    template<class T>
+    bool read(T &outValue) {
+        if (static_cast<size_t>(end - position) < sizeof(T)) {
+            return false;
+        }
+        std::memcpy(&outValue, position, sizeof(T));
+        position += sizeof(T);
+        return true;
+    }
+
+    bool readMagic(const char *magic) {
+        uint32_t value;
+        return read(value) and std::memcmp(&value, magic, sizeof(value)) == 0;
+    }
+
+    // Takes the next length bytes as a column body.
+    bool skip(size_t length, const uint8_t *&outBody) {
+        if (static_cast<size_t>(end - position) < length) {
+            return false;
+        }
+        outBody = position;
+        position += length;
+        return true;
+    }
+};
+
+void generateChunk(const ExportConfig &config, int64_t firstGame, int64_t lastGame, GameBoard &board,
+                   Strategy &strategy, BoardAnalyzer &analyzer, std::vector<TracedMove> &trace,
+                   RawChunk &chunk) {
+    size_t cellCount = static_cast<size_t>(board.getWidth()) * board.getHeight();
+    chunk.games = static_cast<int32_t>(lastGame - firstGame);
+    chunk.seeds.clear();
+    chunk.outcomes.clear();
+    chunk.cells.resize(cellCount * chunk.games);
+    chunk.moveOffsets.assign(1, 0);
+    chunk.moves.clear();
+
+    SelfPlayReport report;
+    uint8_t *cells = chunk.cells.data();
+    for (int64_t game = firstGame; game < lastGame; game++) {
+        uint64_t seed = deriveSeed(config.masterSeed, game);
+        GameStatus outcome = playGame(board, strategy, seed, analyzer, report, &trace);
+        chunk.seeds.push_back(seed);
+        chunk.outcomes.push_back(static_cast<uint8_t>(outcome));
+        for (int32_t y = 0; y < board.getHeight(); y++) {
+            for (int32_t x = 0; x < board.getWidth(); x++) {
+                const Cell &cell = board.getCell(x, y);
+                *cells++ = cell.isMine ? MINE_BIT : static_cast<uint8_t>(cell.adjacentMines);
+            }
+        }
+        chunk.moves.insert(chunk.moves.end(), trace.begin(), trace.end());
+        chunk.moveOffsets.push_back(static_cast<uint32_t>(chunk.moves.size()));
+    }
+}
+
+void encodeChunk(const RawChunk &raw, int32_t width, int32_t height, EncodedChunk &encoded) {
+    size_t cellCount = static_cast<size_t>(width) * height;
+    size_t games = static_cast<size_t>(raw.games);
+    size_t moves = raw.moves.size();
+    std::vector<uint8_t> &out = encoded.bytes;
+    out.clear();
+    encoded.games = raw.games;
+    encoded.moves = static_cast<int64_t>(moves);
+
+    appendMagic(out, "MSCK");
+    append<uint32_t>(out, static_cast<uint32_t>(games));
+    append<uint32_t>(out, static_cast<uint32_t>(moves));
+    append<uint32_t>(out, 9);
+
+    appendArrayColumn(out, COLUMN_SEEDS, raw.seeds);
+    appendArrayColumn(out, COLUMN_OUTCOMES, raw.outcomes);
+
+    size_t planeBytes = (cellCount + 7) / 8;
+    size_t offset = beginColumn(out, COLUMN_MINE_PLANE, planeBytes * games);
+    for (size_t game = 0; game < games; game++) {
+        const uint8_t *cells = raw.cells.data() + game * cellCount;
+        uint8_t *plane = out.data() + offset + game * planeBytes;
+        for (size_t i = 0; i < cellCount; i++) {
+            if (cells[i] & MINE_BIT) {
+                plane[i / 8] |= static_cast<uint8_t>(1u << (i % 8));
+            }
+        }
+    }
+
+    size_t countBytes = (cellCount + 1) / 2;
+    offset = beginColumn(out, COLUMN_COUNT_PLANE, countBytes * games);
+    for (size_t game = 0; game < games; game++) {
+        const uint8_t *cells = raw.cells.data() + game * cellCount;
+        uint8_t *plane = out.data() + offset + game * countBytes;
+        for (size_t i = 0; i < cellCount; i++) {
+            auto count = static_cast<uint8_t>(cells[i] & 0x0f);
+            plane[i / 2] |= static_cast<uint8_t>(count << (4 * (i % 2)));
+        }
+    }
+
+    appendArrayColumn(out, COLUMN_MOVE_OFFSETS, raw.moveOffsets);
+
+    offset = beginColumn(out, COLUMN_MOVE_CELLS, moves * sizeof(uint32_t));
+    for (size_t i = 0; i < moves; i++) {
+        auto cell = static_cast<uint32_t>(raw.moves[i].y * width + raw.moves[i].x);
+        std::memcpy(out.data() + offset + i * sizeof(uint32_t), &cell, sizeof(uint32_t));
+    }
+
+    offset = beginColumn(out, COLUMN_MOVE_ACTIONS, moves);
+    for (size_t i = 0; i < moves; i++) {
+        out[offset + i] = raw.moves[i].flag ? 1 : 0;
+    }
+
+    offset = beginColumn(out, COLUMN_MOVE_UNCOVERED, moves * sizeof(uint32_t));
+    for (size_t i = 0; i < moves; i++) {
+        auto uncovered = static_cast<uint32_t>(raw.moves[i].uncovered);
+        std::memcpy(out.data() + offset + i * sizeof(uint32_t), &uncovered, sizeof(uint32_t));
+    }
+
+    offset = beginColumn(out, COLUMN_MOVE_NEIGHBOURHOODS, moves * NEIGHBOURHOOD_BYTES);
+    for (size_t i = 0; i < moves; i++) {
+        uint64_t neighbourhood = raw.moves[i].neighbourhood;
+        std::memcpy(out.data() + offset + i * NEIGHBOURHOOD_BYTES, &neighbourhood,
+                    NEIGHBOURHOOD_BYTES);
+    }
+}
+
+}
+
+bool exportDataset(const ExportConfig &config, ExportSummary &outSummary) {
+    std::ofstream file(config.path, std::ios::binary | std::ios::trunc);
+    if (not file) {
+        return false;
+    }
+
+    const Difficulty &difficulty = config.difficulty;
+    int64_t gamesPerChunk = std::max(config.gamesPerChunk, 1);
+    int64_t chunkCount = (config.games + gamesPerChunk - 1) / gamesPerChunk;
+    int32_t generatorCount = resolveThreadCount(config.generatorThreads);
+    size_t depth = static_cast<size_t>(std::max(config.queueDepth, 1));
+
+    // Every stage hands buffers back through a free queue, so the number of chunks alive at once is
+    // fixed up front and buffers are reused instead of reallocated.
+    std::vector<std::unique_ptr<RawQueue>> freeRaw;
+    std::vector<std::unique_ptr<RawQueue>> readyRaw;
+    for (int32_t i = 0; i < generatorCount; i++) {
+        freeRaw.push_back(std::make_unique<RawQueue>(depth));
+        readyRaw.push_back(std::make_unique<RawQueue>(depth));
+        for (size_t j = 0; j < depth; j++) {
+            freeRaw[i]->push(std::make_unique<RawChunk>());
+        }
+    }
+    EncodedQueue freeEncoded(depth);
+    EncodedQueue readyEncoded(depth);
+    for (size_t j = 0; j < depth; j++) {
+        freeEncoded.push(std::make_unique<EncodedChunk>());
+    }
+    auto closeAll = [&]() {
+        for (int32_t i = 0; i < generatorCount; i++) {
+            freeRaw[i]->close();
+            readyRaw[i]->close();
+        }
+        freeEncoded.close();
+        readyEncoded.close();
+    };
+
+    auto start = std::chrono::steady_clock::now();
+
+    // Generator i owns chunks i, i + generatorCount, ... so the encoder can take them back in order
+    // by visiting the generators round-robin.
+    std::vector<std::thread> generators;
+    for (int32_t i = 0; i < generatorCount; i++) {
+        generators.emplace_back([&, i]() {
+            GameBoard board(difficulty.width, difficulty.height, difficulty.mineCount, 0,
+                            config.safeZone);
+            auto strategy = makeStrategy(config.strategy);
+            BoardAnalyzer analyzer;
+            std::vector<TracedMove> trace;
+            for (int64_t chunkIndex = i; chunkIndex < chunkCount; chunkIndex += generatorCount) {
+                std::unique_ptr<RawChunk> chunk;
+                if (not freeRaw[i]->pop(chunk)) {
+                    return;
+                }
+                int64_t firstGame = chunkIndex * gamesPerChunk;
+                int64_t lastGame = std::min(firstGame + gamesPerChunk, config.games);
+                generateChunk(config, firstGame, lastGame, board, *strategy, analyzer, trace, *chunk);
+                if (not readyRaw[i]->push(std::move(chunk))) {
+                    return;
+                }
+            }
+        });
+    }
+
+    std::thread encoder([&]() {
+        for (int64_t chunkIndex = 0; chunkIndex < chunkCount; chunkIndex++) {
+            RawQueue &ready = *readyRaw[chunkIndex % generatorCount];
+            RawQueue &free = *freeRaw[chunkIndex % generatorCount];
+            std::unique_ptr<RawChunk> raw;
+            std::unique_ptr<EncodedChunk> encoded;
+            if (not ready.pop(raw) or not freeEncoded.pop(encoded)) {
+                return;
+            }
+            encodeChunk(*raw, difficulty.width, difficulty.height, *encoded);
+            if (not free.push(std::move(raw)) or not readyEncoded.push(std::move(encoded))) {
+                return;
+            }
+        }
+    });
+
+    std::vector<uint8_t> header;
+    appendMagic(header, "MSDS");
+    append<uint32_t>(header, FORMAT_VERSION);
+    append<uint32_t>(header, static_cast<uint32_t>(difficulty.width));
+    append<uint32_t>(header, static_cast<uint32_t>(difficulty.height));
+    append<uint32_t>(header, static_cast<uint32_t>(difficulty.mineCount));
+    append<uint32_t>(header, static_cast<uint32_t>(config.safeZone));
+    append<uint32_t>(header, static_cast<uint32_t>(config.strategy));
+    append<uint32_t>(header, static_cast<uint32_t>(gamesPerChunk));
+    append<uint64_t>(header, config.masterSeed);
+    file.write(reinterpret_cast<const char *>(header.data()), header.size());
+
+    ExportSummary summary;
+    uint64_t position = header.size();
+    std::vector<uint64_t> chunkOffsets;
+    chunkOffsets.reserve(chunkCount);
+    bool ok = file.good();
+    for (int64_t chunkIndex = 0; ok and chunkIndex < chunkCount; chunkIndex++) {
+        std::unique_ptr<EncodedChunk> encoded;
+        if (not readyEncoded.pop(encoded)) {
+            ok = false;
+            break;
+        }
+        chunkOffsets.push_back(position);
+        file.write(reinterpret_cast<const char *>(encoded->bytes.data()), encoded->bytes.size());
+        position += encoded->bytes.size();
+        summary.games += encoded->games;
+        summary.moves += encoded->moves;
+        summary.chunks += 1;
+        ok = file.good() and freeEncoded.push(std::move(encoded));
+    }
+    if (not ok) {
+        closeAll();
+    }
+    encoder.join();
+    for (auto &generator: generators) {
+        generator.join();
+    }
+    if (not ok) {
+        return false;
+    }
+
+    std::vector<uint8_t> footer;
+    appendMagic(footer, "MSIX");
+    append<uint64_t>(footer, static_cast<uint64_t>(chunkOffsets.size()));
+    for (uint64_t offset: chunkOffsets) {
+        append<uint64_t>(footer, offset);
+    }
+    append<uint64_t>(footer, static_cast<uint64_t>(summary.games));
+    append<uint64_t>(footer, static_cast<uint64_t>(summary.moves));
+    append<uint64_t>(footer, position);
+    appendMagic(footer, "MSDE");
+    file.write(reinterpret_cast<const char *>(footer.data()), footer.size());
+    file.flush();
+    if (not file.good()) {
+        return false;
+    }
+
+    summary.bytes = position + footer.size();
+    summary.wallNanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+    outSummary = summary;
+    return true;
+}
+
+bool DatasetReader::open(const std::string &path) {
+    file = std::ifstream(path, std::ios::binary);
+    info = DatasetInfo();
+    const size_t headerBytes = 4 + 7 * sizeof(uint32_t) + sizeof(uint64_t);
+    // The footer ends in u64 games, u64 moves, u64 footer offset and "MSDE"
+    const size_t tailBytes = 3 * sizeof(uint64_t) + 4;
+    file.seekg(0, std::ios::end);
+    auto fileBytes = static_cast<uint64_t>(file.tellg());
+    if (not file or fileBytes < headerBytes + tailBytes) {
+        return false;
+    }
+
+    bytes.resize(headerBytes);
+    file.seekg(0);
+    file.read(reinterpret_cast<char *>(bytes.data()), static_cast<std::streamsize>(headerBytes));
+    ByteReader header{bytes.data(), bytes.data() + bytes.size()};
+    uint32_t version = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t mineCount = 0;
+    uint32_t safeZone = 0;
+    uint32_t strategy = 0;
+    uint32_t gamesPerChunk = 0;
+    if (not file or not header.readMagic("MSDS") or not header.read(version) or
+        version != FORMAT_VERSION or not header.read(width) or not header.read(height) or
+        not header.read(mineCount) or not header.read(safeZone) or not header.read(strategy) or
+        not header.read(gamesPerChunk) or not header.read(info.masterSeed)) {
+        return false;
+    }
+    info.width = static_cast<int32_t>(width);
+    info.height = static_cast<int32_t>(height);
+    info.mineCount = static_cast<int32_t>(mineCount);
+    info.safeZone = static_cast<SafeZone>(safeZone);
+    info.strategy = static_cast<StrategyKind>(strategy);
+    info.gamesPerChunk = static_cast<int32_t>(gamesPerChunk);
+
+    bytes.resize(tailBytes);
+    file.seekg(static_cast<std::streamoff>(fileBytes - tailBytes));
+    file.read(reinterpret_cast<char *>(bytes.data()), static_cast<std::streamsize>(tailBytes));
+    ByteReader tail{bytes.data(), bytes.data() + bytes.size()};
+    uint64_t games = 0;
+    uint64_t moves = 0;
+    if (not file or not tail.read(games) or not tail.read(moves) or
+        not tail.read(info.footerOffset) or not tail.readMagic("MSDE") or
+        info.footerOffset < headerBytes or info.footerOffset > fileBytes - tailBytes) {
+        return false;
+    }
+    info.games = static_cast<int64_t>(games);
+    info.moves = static_cast<int64_t>(moves);
+
+    bytes.resize(fileBytes - tailBytes - info.footerOffset);
+    file.seekg(static_cast<std::streamoff>(info.footerOffset));
+    file.read(reinterpret_cast<char *>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    ByteReader footer{bytes.data(), bytes.data() + bytes.size()};
+    uint64_t chunkCount = 0;
+    if (not file or not footer.readMagic("MSIX") or not footer.read(chunkCount) or
+        bytes.size() != 12 + chunkCount * sizeof(uint64_t)) {
+        return false;
+    }
+    info.chunkOffsets.resize(chunkCount);
+    // Chunks follow each other from the end of the header to the footer
+    uint64_t previous = headerBytes;
+    for (uint64_t &offset: info.chunkOffsets) {
+        footer.read(offset);
+        if (offset < previous or offset > info.footerOffset) {
+            return false;
+        }
+        previous = offset;
+    }
+    return chunkCount == 0 or info.chunkOffsets.front() == headerBytes;
+}
+
+const DatasetInfo &DatasetReader::getInfo() const {
+    return info;
+}
+
+bool DatasetReader::readChunk(int64_t index, DatasetChunk &outChunk) {
+    if (index < 0 or index >= static_cast<int64_t>(info.chunkOffsets.size())) {
+        return false;
+    }
+    uint64_t begin = info.chunkOffsets[index];
+    uint64_t end = index + 1 < static_cast<int64_t>(info.chunkOffsets.size())
+                   ? info.chunkOffsets[index + 1] : info.footerOffset;
+    bytes.resize(end - begin);
+    file.seekg(static_cast<std::streamoff>(begin));
+    file.read(reinterpret_cast<char *>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    ByteReader chunk{bytes.data(), bytes.data() + bytes.size()};
+    uint32_t games = 0;
+    uint32_t moves = 0;
+    uint32_t columnCount = 0;
+    if (not file or not chunk.readMagic("MSCK") or not chunk.read(games) or
+        not chunk.read(moves) or not chunk.read(columnCount)) {
+        return false;
+    }
+
+    size_t cellCount = static_cast<size_t>(info.width) * info.height;
+    size_t planeBytes = (cellCount + 7) / 8;
+    size_t countBytes = (cellCount + 1) / 2;
+    // Every column has one length its chunk's counts allow
+    auto expectedLength = [&](uint32_t column) -> size_t {
+        switch (column) {
+            case COLUMN_SEEDS:
+                return games * sizeof(uint64_t);
+            case COLUMN_OUTCOMES:
+                return games;
+            case COLUMN_MINE_PLANE:
+                return games * planeBytes;
+            case COLUMN_COUNT_PLANE:
+                return games * countBytes;
+            case COLUMN_MOVE_OFFSETS:
+                return (games + 1) * sizeof(uint32_t);
+            case COLUMN_MOVE_CELLS:
+            case COLUMN_MOVE_UNCOVERED:
+                return moves * sizeof(uint32_t);
+            case COLUMN_MOVE_ACTIONS:
+                return moves;
+            case COLUMN_MOVE_NEIGHBOURHOODS:
+                return moves * NEIGHBOURHOOD_BYTES;
+            default:
+                return SIZE_MAX;
+        }
+    };
+
+    outChunk.seeds.assign(games, 0);
+    outChunk.outcomes.assign(games, ERROR);
+    outChunk.mines.assign(games * cellCount, 0);
+    outChunk.counts.assign(games * cellCount, 0);
+    outChunk.moveOffsets.assign(games + 1, 0);
+    outChunk.moves.assign(moves, TracedMove{});
+    uint32_t seen = 0;
+    for (uint32_t i = 0; i < columnCount; i++) {
+        uint32_t column = 0;
+        uint32_t reserved = 0;
+        uint64_t length = 0;
+        const uint8_t *body = nullptr;
+        if (not chunk.read(column) or not chunk.read(reserved) or not chunk.read(length) or
+            length != expectedLength(column) or not chunk.skip(length, body)) {
+            return false;
+        }
+        seen |= 1u << column;
+        switch (column) {
+            case COLUMN_SEEDS:
+                std::memcpy(outChunk.seeds.data(), body, length);
+                break;
+            case COLUMN_OUTCOMES:
+                for (uint32_t game = 0; game < games; game++) {
+                    outChunk.outcomes[game] = static_cast<GameStatus>(body[game]);
+                }
+                break;
+            case COLUMN_MINE_PLANE:
+                for (size_t game = 0; game < games; game++) {
+                    const uint8_t *plane = body + game * planeBytes;
+                    uint8_t *mines = outChunk.mines.data() + game * cellCount;
+                    for (size_t cell = 0; cell < cellCount; cell++) {
+                        mines[cell] = (plane[cell / 8] >> (cell % 8)) & 1;
+                    }
+                }
+                break;
+            case COLUMN_COUNT_PLANE:
+                for (size_t game = 0; game < games; game++) {
+                    const uint8_t *plane = body + game * countBytes;
+                    uint8_t *counts = outChunk.counts.data() + game * cellCount;
+                    for (size_t cell = 0; cell < cellCount; cell++) {
+                        counts[cell] = (plane[cell / 2] >> (4 * (cell % 2))) & 0x0f;
+                    }
+                }
+                break;
+            case COLUMN_MOVE_OFFSETS:
+                std::memcpy(outChunk.moveOffsets.data(), body, length);
+                break;
+            case COLUMN_MOVE_CELLS:
+                for (uint32_t move = 0; move < moves; move++) {
+                    uint32_t cell;
+                    std::memcpy(&cell, body + move * sizeof(uint32_t), sizeof(uint32_t));
+                    outChunk.moves[move].x = static_cast<int32_t>(cell % info.width);
+                    outChunk.moves[move].y = static_cast<int32_t>(cell / info.width);
+                }
+                break;
+            case COLUMN_MOVE_ACTIONS:
+                for (uint32_t move = 0; move < moves; move++) {
+                    outChunk.moves[move].flag = body[move] != 0;
+                }
+                break;
+            case COLUMN_MOVE_UNCOVERED:
+                for (uint32_t move = 0; move < moves; move++) {
+                    uint32_t uncovered;
+                    std::memcpy(&uncovered, body + move * sizeof(uint32_t), sizeof(uint32_t));
+                    outChunk.moves[move].uncovered = static_cast<int32_t>(uncovered);
+                }
+                break;
+            case COLUMN_MOVE_NEIGHBOURHOODS:
+                for (uint32_t move = 0; move < moves; move++) {
+                    uint64_t neighbourhood = 0;
+                    std::memcpy(&neighbourhood, body + move * NEIGHBOURHOOD_BYTES,
+                                NEIGHBOURHOOD_BYTES);
+                    outChunk.moves[move].neighbourhood = neighbourhood;
+                }
+                break;
+        }
+    }
+    // Every column present and the move offsets in order and within the moves
+    if (seen != 0x3feu or outChunk.moveOffsets.front() != 0 or
+        outChunk.moveOffsets.back() != moves) {
+        return false;
+    }
+    return std::is_sorted(outChunk.moveOffsets.begin(), outChunk.moveOffsets.end());
+}
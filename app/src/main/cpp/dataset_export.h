@@ -0,0 +1,128 @@
+#ifndef MINESWEEPER_DATASET_EXPORT_H
+#define MINESWEEPER_DATASET_EXPORT_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "difficulty.h"
+#include "game_objects.h"
+#include "self_play.h"
+#include "solver.h"
+
+/*
+ * Streaming export of self-played games for model training.
+ *
+ * All integers are little endian. A file is a header, a sequence of chunks and a footer:
+ *
+ *   header  "MSDS", u32 version, u32 width, u32 height, u32 mineCount, u32 safeZone,
+ *           u32 strategy, u32 gamesPerChunk, u64 masterSeed
+ *   chunk   "MSCK", u32 games, u32 moves, u32 columnCount, then per column
+ *           u32 column id, u32 reserved (0), u64 byte length, the column bytes
+ *   footer  "MSIX", u64 chunkCount, u64 chunk offsets[chunkCount], u64 games, u64 moves,
+ *           u64 footer offset, "MSDE"
+ *
+ * Games inside a chunk are in seed order and cells are numbered row-major (y * width + x). The
+ * columns of a chunk with n games and m moves are:
+ *
+ *   SEEDS                u64[n], board seed of each game
+ *   OUTCOMES             u8[n], final GameStatus
+ *   MINE_PLANE           n bit-planes of ceil(cells / 8) bytes, cell i is bit i % 8 of byte i / 8
+ *   COUNT_PLANE          n planes of ceil(cells / 2) bytes, adjacent mine counts as 4-bit values,
+ *                        even cells in the low nibble
+ *   MOVE_OFFSETS         u32[n + 1], moves of game g are [offsets[g], offsets[g + 1])
+ *   MOVE_CELLS           u32[m], cell index of each move
+ *   MOVE_ACTIONS         u8[m], 0 reveal, 1 flag
+ *   MOVE_UNCOVERED       u32[m], cells uncovered by each move
+ *   MOVE_NEIGHBOURHOODS  5 bytes per move, the 36-bit visibleNeighbourhood before the move
+ */
+
+enum DatasetColumn {
+    COLUMN_SEEDS = 1,
+    COLUMN_OUTCOMES = 2,
+    COLUMN_MINE_PLANE = 3,
+    COLUMN_COUNT_PLANE = 4,
+    COLUMN_MOVE_OFFSETS = 5,
+    COLUMN_MOVE_CELLS = 6,
+    COLUMN_MOVE_ACTIONS = 7,
+    COLUMN_MOVE_UNCOVERED = 8,
+    COLUMN_MOVE_NEIGHBOURHOODS = 9
+};
+
+struct ExportConfig {
+    Difficulty difficulty = DIFFICULTIES[0];
+    StrategyKind strategy = StrategyKind::PROBABILITY;
+    SafeZone safeZone = SAFE_CELL;
+    int64_t games = 100000;
+    uint64_t masterSeed = 1;
+    int32_t gamesPerChunk = 4096;
+    // 0 uses every hardware thread for generation.
+    int32_t generatorThreads = 0;
+    // Chunks each generator may have finished ahead of the encoder. Together with gamesPerChunk
+    // this bounds the memory of the whole export.
+    int32_t queueDepth = 2;
+    std::string path;
+};
+
+struct ExportSummary {
+    int64_t games = 0;
+    int64_t moves = 0;
+    int64_t chunks = 0;
+    uint64_t bytes = 0;
+    uint64_t wallNanos = 0;
+};
+
+// Generates, encodes and writes config.games games as a pipeline: generator threads self-play
+// whole chunks, one encoder thread packs them into columns and the calling thread writes them out.
+// Game i always uses deriveSeed(config.masterSeed, i) and chunks are written in order, so the file
+// depends only on the config. Returns false if the file could not be written.
+bool exportDataset(const ExportConfig &config, ExportSummary &outSummary);
+
+// A dataset file's header and footer.
+struct DatasetInfo {
+    int32_t width = 0;
+    int32_t height = 0;
+    int32_t mineCount = 0;
+    SafeZone safeZone = SAFE_CELL;
+    StrategyKind strategy = StrategyKind::PROBABILITY;
+    int32_t gamesPerChunk = 0;
+    uint64_t masterSeed = 0;
+    int64_t games = 0;
+    int64_t moves = 0;
+    std::vector<uint64_t> chunkOffsets;
+    uint64_t footerOffset = 0;
+};
+
+// One chunk decoded back into plain values.
+struct DatasetChunk {
+    std::vector<uint64_t> seeds;
+    std::vector<GameStatus> outcomes;
+    // One byte per cell of every game, game after game: 1 for a mine, else 0.
+    std::vector<uint8_t> mines;
+    // Adjacent mine counts, laid out like mines.
+    std::vector<uint8_t> counts;
+    std::vector<uint32_t> moveOffsets;
+    // Moves of every game; x and y come from the cell index.
+    std::vector<TracedMove> moves;
+};
+
+// Reads files written by exportDataset one chunk at a time, so reading needs no more memory than
+// one chunk whatever the file's size.
+class DatasetReader {
+public:
+    // Reads the header and footer. Returns false if path holds no dataset of this version.
+    bool open(const std::string &path);
+
+    const DatasetInfo &getInfo() const;
+
+    // Decodes chunk index into outChunk. Returns false if the chunk is damaged or its columns do
+    // not match its game and move counts.
+    bool readChunk(int64_t index, DatasetChunk &outChunk);
+
+private:
+    std::ifstream file;
+    DatasetInfo info;
+    std::vector<uint8_t> bytes;
+};
+
+#endif //MINESWEEPER_DATASET_EXPORT_H
@@ -0,0 +1,32 @@
+#include "difficulty.h"
+#include <cstring>
+
+const Difficulty DIFFICULTIES[3] = {{"beginner",     9,  9,  10},
+                                    {"intermediate", 16, 16, 40},
+                                    {"expert",       30, 16, 99}};
+
+bool parseDifficulty(const char *name, Difficulty &outDifficulty) {
+    for (const Difficulty &difficulty: DIFFICULTIES) {
+        if (std::strcmp(name, difficulty.name) == 0) {
+            outDifficulty = difficulty;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *safeZoneName(SafeZone safeZone) {
+    return safeZone == SAFE_AREA ? "area" : "cell";
+}
+
+bool parseSafeZone(const char *name, SafeZone &outSafeZone) {
+    if (std::strcmp(name, "cell") == 0) {
+        outSafeZone = SAFE_CELL;
+        return true;
+    }
+    if (std::strcmp(name, "area") == 0) {
+        outSafeZone = SAFE_AREA;
+        return true;
+    }
+    return false;
+}
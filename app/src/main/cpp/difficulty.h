@@ -0,0 +1,22 @@
+#ifndef MINESWEEPER_DIFFICULTY_H
+#define MINESWEEPER_DIFFICULTY_H
+
+#include <cstdint>
+#include "game_objects.h"
+
+struct Difficulty {
+    const char *name;
+    int32_t width;
+    int32_t height;
+    int32_t mineCount;
+};
+
+extern const Difficulty DIFFICULTIES[3];
+
+bool parseDifficulty(const char *name, Difficulty &outDifficulty);
+
+const char *safeZoneName(SafeZone safeZone);
+
+bool parseSafeZone(const char *name, SafeZone &outSafeZone);
+
+#endif //MINESWEEPER_DIFFICULTY_H
@@ -0,0 +1,73 @@
+#include "frame_scheduler.h"
+#include <chrono>
+
+int64_t SteadyFrameClock::nowNanos() const {
+    // CLOCK_MONOTONIC on Android, the clock vsync timestamps use.
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int64_t ManualFrameClock::nowNanos() const {
+    return now;
+}
+
+void ManualFrameClock::advance(int64_t nanos) {
+    now += nanos;
+}
+
+FrameScheduler::FrameScheduler(const FrameClock &clock) : clock(clock) {}
+
+void FrameScheduler::invalidate(uint32_t reasons) {
+    pendingReasons |= reasons;
+}
+
+void FrameScheduler::animateUntil(int64_t untilNanos) {
+    if (untilNanos > animationEndNanos) {
+        animationEndNanos = untilNanos;
+    }
+}
+
+void FrameScheduler::setActive(bool active) {
+    this->active = active;
+}
+
+bool FrameScheduler::isActive() const {
+    return active;
+}
+
+bool FrameScheduler::isAnimating() const {
+    return clock.nowNanos() < animationEndNanos;
+}
+
+bool FrameScheduler::wantsVsync() const {
+    return active and not vsyncPosted and (pendingReasons != 0 or isAnimating());
+}
+
+void FrameScheduler::onVsyncPosted() {
+    vsyncPosted = true;
+}
+
+bool FrameScheduler::onVsync(int64_t frameTimeNanos) {
+    vsyncPosted = false;
+    stats.vsyncs += 1;
+    uint32_t reasons = pendingReasons;
+    if (frameTimeNanos < animationEndNanos) {
+        reasons |= FRAME_ANIMATION;
+    }
+    if (not active or reasons == 0) {
+        stats.idleVsyncs += 1;
+        return false;
+    }
+    pendingReasons = 0;
+    drawnReasons = reasons;
+    stats.frames += 1;
+    return true;
+}
+
+uint32_t FrameScheduler::getDrawnReasons() const {
+    return drawnReasons;
+}
+
+const FrameSchedulerStats &FrameScheduler::getStats() const {
+    return stats;
+}
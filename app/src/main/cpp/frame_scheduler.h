@@ -0,0 +1,100 @@
+#ifndef MINESWEEPER_FRAME_SCHEDULER_H
+#define MINESWEEPER_FRAME_SCHEDULER_H
+
+#include <cstdint>
+
+// Where the scheduler reads the time, on the same monotonic base as display vsync timestamps.
+class FrameClock {
+public:
+    virtual ~FrameClock() = default;
+
+    virtual int64_t nowNanos() const = 0;
+};
+
+class SteadyFrameClock : public FrameClock {
+public:
+    int64_t nowNanos() const override;
+};
+
+// A clock that only moves when told to, for driving the scheduler off device.
+class ManualFrameClock : public FrameClock {
+public:
+    int64_t nowNanos() const override;
+
+    void advance(int64_t nanos);
+
+private:
+    int64_t now = 0;
+};
+
+// Why a frame was asked for, as bits so several reasons can be pending at once.
+enum FrameReason : uint32_t {
+    FRAME_INPUT = 1 << 0,
+    FRAME_BOARD = 1 << 1,
+    FRAME_SURFACE = 1 << 2,
+    FRAME_ANIMATION = 1 << 3
+};
+
+struct FrameSchedulerStats {
+    // Vsync callbacks asked for and delivered.
+    int64_t vsyncs = 0;
+    // Frames drawn, at most one per vsync.
+    int64_t frames = 0;
+    // Vsyncs that arrived with nothing left to draw, e.g. after a pause.
+    int64_t idleVsyncs = 0;
+};
+
+// Decides when the render loop draws. Nothing is drawn unless something invalidated the frame or
+// an animation is running, and then at most once per display vsync, so a static board costs no
+// frames at all and the loop can block on its event queue until the next input or board change.
+//
+// The platform side is expected to:
+// - block on its event queue until woken, since every piece of work arrives as an event (input, a
+//   wake from another thread, or the vsync callback itself),
+// - ask the display for one vsync callback whenever wantsVsync() is true and call onVsyncPosted(),
+// - call onVsync() from that callback and draw if it returns true.
+//
+// Not thread-safe; everything runs on the render thread.
+class FrameScheduler {
+public:
+    explicit FrameScheduler(const FrameClock &clock);
+
+    // Something visible changed, draw it on the next vsync.
+    void invalidate(uint32_t reasons);
+
+    // Keeps drawing every vsync until the clock reaches untilNanos.
+    void animateUntil(int64_t untilNanos);
+
+    // An inactive scheduler (no window, or the app paused) never asks for vsync. Pending
+    // invalidations are kept and drawn once it becomes active again.
+    void setActive(bool active);
+
+    bool isActive() const;
+
+    bool isAnimating() const;
+
+    // True if a vsync callback is needed and none is outstanding.
+    bool wantsVsync() const;
+
+    void onVsyncPosted();
+
+    // Called from the vsync callback with the time the frame will be shown for. Returns true if a
+    // frame should be drawn now, and clears the reasons it is drawn for.
+    bool onVsync(int64_t frameTimeNanos);
+
+    // Reasons the frame was last drawn for, valid after onVsync returned true.
+    uint32_t getDrawnReasons() const;
+
+    const FrameSchedulerStats &getStats() const;
+
+private:
+    const FrameClock &clock;
+    uint32_t pendingReasons = 0;
+    uint32_t drawnReasons = 0;
+    int64_t animationEndNanos = 0;
+    bool active = false;
+    bool vsyncPosted = false;
+    FrameSchedulerStats stats;
+};
+
+#endif //MINESWEEPER_FRAME_SCHEDULER_H
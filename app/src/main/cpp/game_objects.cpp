@@ -2,145 +2,408 @@
 #include "game_objects.h"
 #include <random>
 #include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <numeric>
+#include "seeding.h"
+#include "zobrist.h"
 
-GameBoard::GameBoard(int32_t width, int32_t height, int32_t mineCount) {
+template<class Layout>
+BasicGameBoard<Layout>::BasicGameBoard(int32_t width, int32_t height, int32_t mineCount)
+        : BasicGameBoard(width, height, mineCount, std::random_device{}()) {}
+
+template<class Layout>
+BasicGameBoard<Layout>::BasicGameBoard(int32_t width, int32_t height, int32_t mineCount,
+                                       uint64_t seed, SafeZone safeZone) : layout(width, height) {
     this->width = width;
     this->height = height;
     this->mineCount = mineCount;
-    this->board.resize(height, std::vector<Cell>(width));
+    this->seed = seed;
+    this->safeZone = safeZone;
+    this->visibleHash = 0;
+    this->recordChanges = false;
+    this->changesComplete = true;
+    this->revealHead = 0;
+    this->minesPlaced = false;
+    this->cells.resize(layout.getCapacity());
+    // A reveal queues each cell at most once, so play never grows the queue
+    this->revealQueue.reserve(static_cast<size_t>(width) * height);
+    this->state = STARTED;
+}
+
+template<class Layout>
+void BasicGameBoard<Layout>::reset(uint64_t seed) {
+    this->seed = seed;
+    std::fill(cells.begin(), cells.end(), Cell{});
+    this->visibleHash = 0;
+    this->changes.clear();
+    this->changesComplete = false;
+    this->revealQueue.clear();
+    this->revealHead = 0;
+    this->minesPlaced = false;
     this->state = STARTED;
 }
 
-void GameBoard::initializeBoard(int32_t firstClickX, int32_t firstClickY) {
-    placeMines(firstClickX, firstClickY);
+template<class Layout>
+void BasicGameBoard<Layout>::generateMines() {
+    if (minesPlaced) {
+        return;
+    }
+    int32_t cellCount = width * height;
+    int32_t mines = std::min(mineCount, cellCount);
+    cellOrder.resize(cellCount);
+    std::iota(cellOrder.begin(), cellOrder.end(), 0);
+    // A Fisher-Yates shuffle stopped after the mines: each prefix is a uniform sample
+    std::mt19937_64 g(seed);
+    for (int32_t i = 0; i < mines; i++) {
+        std::uniform_int_distribution<int32_t> pick(i, cellCount - 1);
+        std::swap(cellOrder[i], cellOrder[pick(g)]);
+        cellAt(cellOrder[i] % width, cellOrder[i] / width).isMine = true;
+    }
     calculateAdjacentMines();
+    this->minesPlaced = true;
+}
+
+template<class Layout>
+bool BasicGameBoard<Layout>::adoptMines(BasicGameBoard &generated) {
+    if (minesPlaced or not generated.minesPlaced or generated.width != width or
+        generated.height != height or generated.mineCount != mineCount) {
+        return false;
+    }
+    // No cell can be revealed or flagged before the mines are placed, so the whole grid can go
+    cells.swap(generated.cells);
+    cellOrder.swap(generated.cellOrder);
+    this->minesPlaced = true;
+    generated.minesPlaced = false;
+    return true;
+}
+
+template<class Layout>
+bool BasicGameBoard<Layout>::hasMines() const {
+    return this->minesPlaced;
+}
+
+template<class Layout>
+void BasicGameBoard<Layout>::initializeBoard(int32_t firstClickX, int32_t firstClickY) {
+    generateMines();
+    relocateMines(firstClickX, firstClickY);
     this->state = ONGOING;
 }
 
-void GameBoard::revealCell(int32_t x, int32_t y) {
-    if (board[y][x].isMine) {
+template<class Layout>
+int32_t BasicGameBoard<Layout>::revealCell(int32_t x, int32_t y) {
+    int32_t revealed = beginReveal(x, y);
+    return revealed + advanceReveal(INT32_MAX);
+}
+
+template<class Layout>
+int32_t BasicGameBoard<Layout>::beginReveal(int32_t x, int32_t y) {
+    if (cellAt(x, y).isMine) {
         this->state = STEPPED_MINE;
     }
-    board[y][x].isRevealed = true;
-    if (board[y][x].adjacentMines > 0){
-        return;
+    int32_t revealed = cellAt(x, y).isRevealed ? 0 : 1;
+    visibleHash ^= cellKey(x, y);
+    cellAt(x, y).isRevealed = true;
+    visibleHash ^= cellKey(x, y);
+    noteChange(x, y);
+    if (not isRevealPending()) {
+        revealQueue.clear();
+        revealHead = 0;
+    } else if (revealed == 0) {
+        // Already uncovered mid-wave, so the wave has queued it or will reach its neighbours. Not
+        // queueing it again keeps every cell to one entry and the queue within its reservation.
+        return 0;
+    }
+    // A pending wave is joined rather than dropped, and the two fill on together
+    if (cellAt(x, y).adjacentMines == 0) {
+        revealQueue.emplace_back(x, y);
     }
-    std::vector<std::pair<int32_t, int32_t>> stack;
-    stack.emplace_back(x, y);
-    const std::vector<std::pair<int32_t, int32_t>> DELTA2 = {{0,  1},
-                                                             {0,  -1},
-                                                             {1,  0},
-                                                             {-1, 0}};
+    return revealed;
+}
 
-    while (not stack.empty()) {
-        const auto [currentX, currentY] = stack.back();
-        stack.pop_back();
+template<class Layout>
+int32_t BasicGameBoard<Layout>::advanceReveal(int32_t budget) {
+    const std::pair<int32_t, int32_t> DELTA2[4] = {{0,  1},
+                                                   {0,  -1},
+                                                   {1,  0},
+                                                   {-1, 0}};
+
+    // Cells are revealed breadth first, so the change set lists them in rings around the first one.
+    int32_t revealed = 0;
+    while (revealHead < revealQueue.size() and revealed < budget) {
+        const auto [currentX, currentY] = revealQueue[revealHead];
+        revealHead += 1;
         for (const auto [dx, dy]: DELTA2) {
             int32_t nextX = currentX + dx;
             int32_t nextY = currentY + dy;
             if (not isInBounds(nextX, nextY)) {
                 continue;
             }
-            if (board[nextY][nextX].isRevealed) {
+            if (cellAt(nextX, nextY).isRevealed) {
                 continue;
             }
-            if (board[nextY][nextX].isFlagged) {
+            if (cellAt(nextX, nextY).isFlagged) {
                 continue;
             }
-            if (board[nextY][nextX].isMine) {
+            if (cellAt(nextX, nextY).isMine) {
                 continue;
             }
-            board[nextY][nextX].isRevealed = true;
-            if (board[nextY][nextX].adjacentMines > 0) {
+            cellAt(nextX, nextY).isRevealed = true;
+            visibleHash ^= cellKey(nextX, nextY);
+            noteChange(nextX, nextY);
+            revealed += 1;
+            if (cellAt(nextX, nextY).adjacentMines > 0) {
                 continue;
             }
-            stack.emplace_back(nextX, nextY);
+            revealQueue.emplace_back(nextX, nextY);
         }
     }
+    return revealed;
 }
 
-void GameBoard::toggleFlag(int32_t x, int32_t y) {
-    board[y][x].isFlagged = not board[y][x].isFlagged;
+template<class Layout>
+bool BasicGameBoard<Layout>::isRevealPending() const {
+    return revealHead < revealQueue.size();
 }
 
-void GameBoard::updateGameStatus() {
+template<class Layout>
+int32_t BasicGameBoard<Layout>::chordCell(int32_t x, int32_t y) {
+    int32_t revealed = beginChord(x, y);
+    return revealed + advanceReveal(INT32_MAX);
+}
+
+template<class Layout>
+int32_t BasicGameBoard<Layout>::beginChord(int32_t x, int32_t y) {
+    const Cell &cell = cellAt(x, y);
+    if (not cell.isRevealed or cell.adjacentMines == 0) {
+        return 0;
+    }
+    int32_t flags = 0;
+    for (int32_t dy = -1; dy <= 1; dy++) {
+        for (int32_t dx = -1; dx <= 1; dx++) {
+            if (isInBounds(x + dx, y + dy) and cellAt(x + dx, y + dy).isFlagged) {
+                flags += 1;
+            }
+        }
+    }
+    if (flags != cell.adjacentMines) {
+        return 0;
+    }
+    int32_t revealed = 0;
+    for (int32_t dy = -1; dy <= 1; dy++) {
+        for (int32_t dx = -1; dx <= 1; dx++) {
+            if (not isInBounds(x + dx, y + dy)) {
+                continue;
+            }
+            const Cell &next = cellAt(x + dx, y + dy);
+            if (next.isRevealed or next.isFlagged) {
+                continue;
+            }
+            revealed += beginReveal(x + dx, y + dy);
+        }
+    }
+    return revealed;
+}
+
+template<class Layout>
+void BasicGameBoard<Layout>::toggleFlag(int32_t x, int32_t y) {
+    visibleHash ^= cellKey(x, y);
+    cellAt(x, y).isFlagged = not cellAt(x, y).isFlagged;
+    visibleHash ^= cellKey(x, y);
+    noteChange(x, y);
+}
+
+template<class Layout>
+void BasicGameBoard<Layout>::updateGameStatus() {
     if (state == STEPPED_MINE or state == VICTORY) {
         return;
     }
-    for (const auto &row: board) {
-        for (const auto &cell: row) {
-            if (cell.isMine and not (cell.isRevealed or cell.isFlagged)) {
-                return;
-            }
+    // Padding slots are default cells, so walking the storage in order sees every mine once
+    for (const auto &cell: cells) {
+        if (cell.isMine and not (cell.isRevealed or cell.isFlagged)) {
+            return;
         }
     }
     state = VICTORY;
 }
 
-const Cell &GameBoard::getCell(int32_t x, int32_t y) const {
-    return this->board[y][x];
+template<class Layout>
+const Cell &BasicGameBoard<Layout>::getCell(int32_t x, int32_t y) const {
+    return cellAt(x, y);
 }
 
-int GameBoard::getWidth() const {
+template<class Layout>
+int BasicGameBoard<Layout>::getWidth() const {
     return this->width;
 }
 
-int GameBoard::getHeight() const {
+template<class Layout>
+int BasicGameBoard<Layout>::getHeight() const {
     return this->height;
 }
 
-void GameBoard::placeMines(int32_t firstClickX, int32_t firstClickY) {
-    std::vector<std::pair<int32_t, int32_t>> positions;
-    for (int32_t y = 0; y < height; y++) {
-        for (int32_t x = 0; x < width; x++) {
-            if (x == firstClickX and y == firstClickY) {
+template<class Layout>
+int32_t BasicGameBoard<Layout>::getMineCount() const {
+    return this->mineCount;
+}
+
+template<class Layout>
+uint64_t BasicGameBoard<Layout>::getSeed() const {
+    return this->seed;
+}
+
+template<class Layout>
+uint64_t BasicGameBoard<Layout>::getVisibleHash() const {
+    return this->visibleHash;
+}
+
+template<class Layout>
+void BasicGameBoard<Layout>::setRecordChanges(bool enabled) {
+    this->recordChanges = enabled;
+    if (not enabled) {
+        this->changes.clear();
+    } else {
+        this->changes.reserve(static_cast<size_t>(width) * height);
+    }
+}
+
+template<class Layout>
+bool BasicGameBoard<Layout>::isRecordingChanges() const {
+    return this->recordChanges;
+}
+
+template<class Layout>
+bool BasicGameBoard<Layout>::drainChanges(std::vector<int32_t> &outChanges) {
+    outChanges.clear();
+    outChanges.swap(this->changes);
+    // The vector handed back in turn gets room for every cell changing once, so recording a move
+    // never allocates
+    if (this->recordChanges) {
+        this->changes.reserve(static_cast<size_t>(width) * height);
+    }
+    bool complete = this->changesComplete;
+    this->changesComplete = true;
+    return complete;
+}
+
+template<class Layout>
+bool BasicGameBoard<Layout>::hasPendingChanges() const {
+    return not this->changes.empty() or not this->changesComplete;
+}
+
+template<class Layout>
+void BasicGameBoard<Layout>::relocateMines(int32_t firstClickX, int32_t firstClickY) {
+    int32_t cellCount = width * height;
+    int32_t mines = std::min(mineCount, cellCount);
+    // A 3x3 safe zone can leave too few free cells on dense boards; fall back to only the
+    // clicked cell in that case.
+    SafeZone zone = safeZone;
+    if (zone == SAFE_AREA) {
+        int32_t zoneWidth =
+                std::min(firstClickX + 1, width - 1) - std::max(firstClickX - 1, 0) + 1;
+        int32_t zoneHeight =
+                std::min(firstClickY + 1, height - 1) - std::max(firstClickY - 1, 0) + 1;
+        if (cellCount - zoneWidth * zoneHeight < mines) {
+            zone = SAFE_CELL;
+        }
+    }
+    // Replacements are drawn without repeats from cellOrder[mines, freeEnd). Every mine was
+    // placed uniformly, so moving those in the zone to uniform free cells outside it leaves a
+    // uniform sample of the cells outside the zone.
+    int32_t freeEnd = cellCount;
+    uint64_t draws = 0;
+    for (int32_t y = firstClickY - 1; y <= firstClickY + 1; y++) {
+        for (int32_t x = firstClickX - 1; x <= firstClickX + 1; x++) {
+            if (not isInBounds(x, y) or not cellAt(x, y).isMine or
+                not isInSafeZone(zone, x, y, firstClickX, firstClickY)) {
                 continue;
             }
-            if (board[y][x].isMine) {
-                continue;
+            while (freeEnd > mines) {
+                uint64_t random = deriveSeed(seed, draws++) >> 32;
+                auto pick = mines + static_cast<int32_t>(
+                        random * static_cast<uint64_t>(freeEnd - mines) >> 32);
+                int32_t cell = cellOrder[pick];
+                std::swap(cellOrder[pick], cellOrder[freeEnd - 1]);
+                freeEnd -= 1;
+                if (isInSafeZone(zone, cell % width, cell / width, firstClickX, firstClickY)) {
+                    continue;
+                }
+                moveMine(x, y, cell % width, cell / width);
+                break;
             }
-            positions.emplace_back(x, y);
         }
     }
-    std::random_device rd;
-    std::mt19937 g(rd());
-    std::shuffle(positions.begin(), positions.end(), g);
-    for (int32_t i = 0; i < mineCount; i++) {
-        int32_t x = positions[i].first;
-        int32_t y = positions[i].second;
-        board[y][x].isMine = true;
-    }
 }
 
-void GameBoard::calculateAdjacentMines() {
-    const std::vector<std::pair<int32_t, int32_t>> DELTA = {{0,  1},
-                                                            {0,  -1},
-                                                            {1,  0},
-                                                            {-1, 0},
-                                                            {-1, -1},
-                                                            {-1, 1},
-                                                            {1,  -1},
-                                                            {1,  1}};
+template<class Layout>
+void BasicGameBoard<Layout>::moveMine(int32_t fromX, int32_t fromY, int32_t toX, int32_t toY) {
+    cellAt(fromX, fromY).isMine = false;
+    cellAt(toX, toY).isMine = true;
+    // Mines carry no count
+    cellAt(toX, toY).adjacentMines = 0;
+    for (int32_t dy = -1; dy <= 1; dy++) {
+        for (int32_t dx = -1; dx <= 1; dx++) {
+            if (isInBounds(fromX + dx, fromY + dy) and not cellAt(fromX + dx, fromY + dy).isMine) {
+                cellAt(fromX + dx, fromY + dy).adjacentMines -= 1;
+            }
+            if (isInBounds(toX + dx, toY + dy) and not cellAt(toX + dx, toY + dy).isMine) {
+                cellAt(toX + dx, toY + dy).adjacentMines += 1;
+            }
+        }
+    }
+    // The vacated cell was a mine without a count, so the loop above left it wrong
+    cellAt(fromX, fromY).adjacentMines = countAdjacentMines(fromX, fromY);
+}
 
+template<class Layout>
+void BasicGameBoard<Layout>::calculateAdjacentMines() {
     for (int32_t y = 0; y < height; y++) {
         for (int32_t x = 0; x < width; x++) {
-            if (board[y][x].isMine) {
-                continue;
-            }
+            cellAt(x, y).adjacentMines = cellAt(x, y).isMine ? 0 : countAdjacentMines(x, y);
+        }
+    }
+}
 
-            int32_t count = 0;
-            for (const auto &delta: DELTA) {
-                int32_t nx = x + delta.first;
-                int32_t ny = y + delta.second;
-                if (isInBounds(nx, ny) and board[ny][nx].isMine) {
-                    count += 1;
-                }
+template<class Layout>
+int32_t BasicGameBoard<Layout>::countAdjacentMines(int32_t x, int32_t y) const {
+    int32_t count = 0;
+    for (int32_t dy = -1; dy <= 1; dy++) {
+        for (int32_t dx = -1; dx <= 1; dx++) {
+            if ((dx != 0 or dy != 0) and isInBounds(x + dx, y + dy) and
+                cellAt(x + dx, y + dy).isMine) {
+                count += 1;
             }
-            board[y][x].adjacentMines = count;
         }
     }
+    return count;
 }
 
-bool GameBoard::isInBounds(int32_t x, int32_t y) const {
+template<class Layout>
+bool BasicGameBoard<Layout>::isInBounds(int32_t x, int32_t y) const {
     return 0 <= x and x < this->width and 0 <= y and y < this->height;
-}
\ No newline at end of file
+}
+
+template<class Layout>
+uint64_t BasicGameBoard<Layout>::cellKey(int32_t x, int32_t y) const {
+    return zobristKey(y * width + x, visibleCode(cellAt(x, y)));
+}
+
+template<class Layout>
+void BasicGameBoard<Layout>::noteChange(int32_t x, int32_t y) {
+    if (recordChanges) {
+        changes.push_back(y * width + x);
+    }
+}
+
+template<class Layout>
+bool BasicGameBoard<Layout>::isInSafeZone(SafeZone zone, int32_t x, int32_t y, int32_t firstClickX,
+                             int32_t firstClickY) {
+    if (zone == SAFE_AREA) {
+        return std::abs(x - firstClickX) <= 1 and std::abs(y - firstClickY) <= 1;
+    }
+    return x == firstClickX and y == firstClickY;
+}
+
+template class BasicGameBoard<RowMajorLayout>;
+template class BasicGameBoard<TiledLayout<3>>;
+template class BasicGameBoard<MortonLayout>;
@@ -6,7 +6,10 @@
 #define MINESWEEPER_GAME_OBJECTS_H
 
 #include <vector>
+#include <cstddef>
 #include <cstdint>
+#include <utility>
+#include "cell_layout.h"
 
 struct Cell {
     bool isMine;
@@ -15,6 +18,11 @@ struct Cell {
     int32_t adjacentMines;
 };
 
+enum SafeZone {
+    SAFE_CELL = 0,
+    SAFE_AREA = 1
+};
+
 enum GameStatus {
     ERROR = -1,
     STARTED = 0,
@@ -23,13 +31,59 @@ enum GameStatus {
     VICTORY = 3
 };
 
-class GameBoard {
+// Cells are stored flat in the order Layout gives them (see cell_layout.h); rules, coordinates and
+// the row-major indices in the change set are the same for every layout. Instantiated for
+// RowMajorLayout, TiledLayout<3> and MortonLayout; the engine plays on GameBoard below.
+template<class Layout>
+class BasicGameBoard {
 public:
-    GameBoard(int32_t width, int32_t height, int32_t mineCount);
+    BasicGameBoard(int32_t width, int32_t height, int32_t mineCount);
+
+    BasicGameBoard(int32_t width, int32_t height, int32_t mineCount, uint64_t seed,
+              SafeZone safeZone = SAFE_CELL);
+
+    void reset(uint64_t seed);
+
+    // Places the mines uniformly over the whole board and counts their neighbours, ahead of the
+    // first click. Does nothing if the mines are already placed. Costs O(width * height), so the
+    // app runs it in the background as soon as a board is created.
+    void generateMines();
+
+    // Takes the mines from generated, a board of the same size, mine count and seed that
+    // generateMines ran on, in O(1). Returns false and leaves both boards alone if this board
+    // already has its mines. generated is left without mines.
+    bool adoptMines(BasicGameBoard &generated);
+
+    bool hasMines() const;
 
+    // Starts the game at the first click. Mines are generated first if they are not yet, then any
+    // in the safe zone around the click move to free cells outside it, chosen uniformly, and only
+    // the counts around the moved mines are patched. With mines already generated this takes
+    // constant time whatever the board size, and the layout is as uniform as a fresh placement
+    // that avoided the safe zone.
     void initializeBoard(int32_t firstClickX, int32_t firstClickY);
 
-    void revealCell(int32_t x, int32_t y);
+    // Returns the number of cells the reveal uncovered.
+    int32_t revealCell(int32_t x, int32_t y);
+
+    // revealCell split into steps: beginReveal uncovers the cell itself and advanceReveal continues
+    // the flood fill by at most budget more cells. Each returns the number of cells it uncovered.
+    // The fill only uncovers safe cells, so the status updateGameStatus finds right after
+    // beginReveal is final; isRevealPending() tells whether cells are still to be uncovered.
+    // Starting another reveal mid-wave joins the pending one, and advanceReveal continues both.
+    int32_t beginReveal(int32_t x, int32_t y);
+
+    int32_t advanceReveal(int32_t budget);
+
+    bool isRevealPending() const;
+
+    // Reveals the hidden, unflagged neighbours of a revealed number once as many of its
+    // neighbours are flagged as it shows. Returns the number of cells uncovered.
+    int32_t chordCell(int32_t x, int32_t y);
+
+    // chordCell split like revealCell: uncovers the neighbours themselves and leaves the flood
+    // fills they start to advanceReveal.
+    int32_t beginChord(int32_t x, int32_t y);
 
     void toggleFlag(int32_t x, int32_t y);
 
@@ -41,20 +95,89 @@ public:
 
     int32_t getHeight() const;
 
+    int32_t getMineCount() const;
+
+    uint64_t getSeed() const;
+
+    // Zobrist hash of what a player can see: revealed cells and flags. Updated incrementally by
+    // revealCell and toggleFlag. It identifies whole positions (spectator streams, checks that two
+    // boards agree). The solver's verdict cache does not use it: it keys each frontier component
+    // on that component's cells and remaining mine counts, so a verdict is reused wherever the
+    // same component shows up, which a whole-board key would only allow for identical boards.
+    uint64_t getVisibleHash() const;
+
+    // While enabled, every cell whose visible state changes is appended to a change set as its
+    // row-major index. Off by default so simulations pay nothing for it.
+    void setRecordChanges(bool enabled);
+
+    bool isRecordingChanges() const;
+
+    // Swaps the change set recorded since the last drain into outChanges, which is cleared first.
+    // Swapping keeps both vectors' capacity, and the board tops its new one up to a change of every
+    // cell, so a steady drain does not allocate. Returns false if
+    // the board was reset since the last drain, in which case the change set is incomplete.
+    bool drainChanges(std::vector<int32_t> &outChanges);
+
+    // Whether anything was recorded, or the board reset, since the last drain.
+    bool hasPendingChanges() const;
+
     GameStatus state;
 
 private:
-    void placeMines(int32_t firstClickX, int32_t firstClickY);
+    void relocateMines(int32_t firstClickX, int32_t firstClickY);
+
+    void moveMine(int32_t fromX, int32_t fromY, int32_t toX, int32_t toY);
 
     void calculateAdjacentMines();
 
+    int32_t countAdjacentMines(int32_t x, int32_t y) const;
+
     bool isInBounds(int32_t x, int32_t y) const;
 
+    uint64_t cellKey(int32_t x, int32_t y) const;
+
+    void noteChange(int32_t x, int32_t y);
+
+    Cell &cellAt(int32_t x, int32_t y) {
+        return cells[layout.index(x, y)];
+    }
+
+    const Cell &cellAt(int32_t x, int32_t y) const {
+        return cells[layout.index(x, y)];
+    }
+
+    static bool isInSafeZone(SafeZone zone, int32_t x, int32_t y, int32_t firstClickX,
+                             int32_t firstClickY);
+
     int32_t width;
     int32_t height;
     int32_t mineCount;
+    uint64_t seed;
+    SafeZone safeZone;
+    uint64_t visibleHash;
+    bool recordChanges;
+    bool changesComplete;
+    std::vector<int32_t> changes;
+    // Breadth-first frontier of the reveal in progress, consumed from revealHead. Reserved for
+    // every cell up front, so a reveal never allocates.
+    std::vector<std::pair<int32_t, int32_t>> revealQueue;
+    size_t revealHead;
     std::vector<std::pair<int32_t, int32_t>> mines;
-    std::vector<std::vector<Cell>> board;
+    bool minesPlaced;
+    // Row-major cell indices, the mines first: generateMines leaves the mines in
+    // [0, mineCount) and the free cells after them, where the first click draws replacements.
+    std::vector<int32_t> cellOrder;
+    Layout layout;
+    std::vector<Cell> cells;
 };
 
+// Layout of the boards the app and the simulations play on, chosen by `layouts` in the simulator.
+// Row-major generates and reads fastest at every size and reveals fastest up to about 1024x1024.
+// Past that, 8x8 tiles reveal faster (about 15% at 4096x4096) and can win overall on some
+// machines, but boards that large belong in MappedBoard, which is tiled already, so the heap board
+// keeps the layout that is best at the sizes it is played at.
+using DefaultCellLayout = RowMajorLayout;
+
+using GameBoard = BasicGameBoard<DefaultCellLayout>;
+
 #endif //MINESWEEPER_GAME_OBJECTS_H
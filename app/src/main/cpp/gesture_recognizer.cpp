@@ -0,0 +1,266 @@
+#include "gesture_recognizer.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+const char *const ACTION_NAMES[] = {"down", "up", "move", "cancel", nullptr, "pointer_down",
+                                    "pointer_up"};
+
+bool isWithin(float x0, float y0, float x1, float y1, float distance) {
+    return std::abs(x1 - x0) <= distance and std::abs(y1 - y0) <= distance;
+}
+
+}
+
+GestureRecognizer::GestureRecognizer(const GestureConfig &config) : config(config) {}
+
+bool GestureRecognizer::onEvent(const TouchEvent &event, Gesture &outGesture) {
+    if (event.pointerCount <= 0) {
+        return false;
+    }
+    outGesture = Gesture{GestureKind::TAP, event.timeNanos, 0.f, 0.f, 0.f, 0.f, 1.f};
+    switch (event.action) {
+        case TouchAction::DOWN:
+            state = State::PRESSED;
+            trackedIds[0] = event.pointers[0].id;
+            trackedIds[1] = -1;
+            downNanos = event.timeNanos;
+            downX = event.pointers[0].x;
+            downY = event.pointers[0].y;
+            return false;
+
+        case TouchAction::POINTER_DOWN:
+            if (state == State::IDLE or state == State::FINISHING or trackedIds[1] >= 0) {
+                return false;
+            }
+            trackedIds[1] = event.pointers[event.actionIndex].id;
+            state = State::PINCHING;
+            anchor(event);
+            return false;
+
+        case TouchAction::POINTER_UP: {
+            if (state != State::PINCHING) {
+                return false;
+            }
+            int32_t liftedId = event.pointers[event.actionIndex].id;
+            if (liftedId != trackedIds[0] and liftedId != trackedIds[1]) {
+                return false;
+            }
+            // The pinch is over, but the finger left down must not turn into a tap or a pan that
+            // jumps the board.
+            state = State::FINISHING;
+            return false;
+        }
+
+        case TouchAction::MOVE:
+            return onMove(event, outGesture);
+
+        case TouchAction::UP:
+            return onRelease(event, outGesture);
+
+        case TouchAction::CANCEL:
+            reset();
+            return false;
+    }
+    return false;
+}
+
+void GestureRecognizer::reset() {
+    state = State::IDLE;
+    trackedIds[0] = -1;
+    trackedIds[1] = -1;
+    hasLastTap = false;
+}
+
+int32_t GestureRecognizer::findPointer(const TouchEvent &event, int32_t id) {
+    for (int32_t i = 0; i < event.pointerCount and i < TouchEvent::MAX_POINTERS; i++) {
+        if (event.pointers[i].id == id) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool GestureRecognizer::anchor(const TouchEvent &event) {
+    int32_t first = findPointer(event, trackedIds[0]);
+    if (first < 0) {
+        return false;
+    }
+    anchorX = event.pointers[first].x;
+    anchorY = event.pointers[first].y;
+    anchorSpan = 0.f;
+    if (trackedIds[1] < 0) {
+        return true;
+    }
+    int32_t second = findPointer(event, trackedIds[1]);
+    if (second < 0) {
+        return false;
+    }
+    float otherX = event.pointers[second].x;
+    float otherY = event.pointers[second].y;
+    anchorSpan = std::hypot(otherX - anchorX, otherY - anchorY);
+    anchorX = (anchorX + otherX) * 0.5f;
+    anchorY = (anchorY + otherY) * 0.5f;
+    return true;
+}
+
+bool GestureRecognizer::onMove(const TouchEvent &event, Gesture &outGesture) {
+    if (state == State::PRESSED) {
+        int32_t index = findPointer(event, trackedIds[0]);
+        if (index < 0 or isWithin(downX, downY, event.pointers[index].x, event.pointers[index].y,
+                                  config.touchSlopPixels)) {
+            return false;
+        }
+        // Pan from where the finger went down, so the board stays under it.
+        state = State::PANNING;
+        anchorX = downX;
+        anchorY = downY;
+        anchorSpan = 0.f;
+    }
+    if (state != State::PANNING and state != State::PINCHING) {
+        return false;
+    }
+    float lastX = anchorX;
+    float lastY = anchorY;
+    float lastSpan = anchorSpan;
+    if (not anchor(event)) {
+        return false;
+    }
+    outGesture.x = anchorX;
+    outGesture.y = anchorY;
+    outGesture.dx = anchorX - lastX;
+    outGesture.dy = anchorY - lastY;
+    if (state == State::PINCHING) {
+        outGesture.kind = GestureKind::PINCH;
+        outGesture.scale = lastSpan > 0.f and anchorSpan > 0.f ? anchorSpan / lastSpan : 1.f;
+    } else {
+        outGesture.kind = GestureKind::PAN;
+    }
+    return true;
+}
+
+bool GestureRecognizer::onRelease(const TouchEvent &event, Gesture &outGesture) {
+    bool wasPressed = state == State::PRESSED;
+    state = State::IDLE;
+    trackedIds[0] = -1;
+    trackedIds[1] = -1;
+    if (not wasPressed) {
+        hasLastTap = false;
+        return false;
+    }
+    outGesture.x = downX;
+    outGesture.y = downY;
+    if (event.timeNanos - downNanos >= config.longPressNanos) {
+        outGesture.kind = GestureKind::LONG_PRESS;
+        hasLastTap = false;
+        return true;
+    }
+    if (hasLastTap and downNanos - lastTapNanos <= config.doubleTapNanos and
+        isWithin(lastTapX, lastTapY, downX, downY, config.doubleTapSlopPixels)) {
+        // chord on the cell of the first tap, which the second one may have drifted from
+        outGesture.kind = GestureKind::DOUBLE_TAP;
+        outGesture.x = lastTapX;
+        outGesture.y = lastTapY;
+        hasLastTap = false;
+        return true;
+    }
+    outGesture.kind = GestureKind::TAP;
+    hasLastTap = true;
+    lastTapNanos = event.timeNanos;
+    lastTapX = downX;
+    lastTapY = downY;
+    return true;
+}
+
+int32_t formatTouchEvent(const TouchEvent &event, char *buffer, size_t size) {
+    int32_t count = event.pointerCount < TouchEvent::MAX_POINTERS ? event.pointerCount
+                                                                  : TouchEvent::MAX_POINTERS;
+    int32_t length = std::snprintf(buffer, size, "%lld %s %d %d",
+                                   static_cast<long long>(event.timeNanos),
+                                   ACTION_NAMES[static_cast<int32_t>(event.action)],
+                                   event.actionIndex, count);
+    for (int32_t i = 0; i < count and length >= 0; i++) {
+        size_t used = static_cast<size_t>(length) < size ? length : size;
+        int32_t written = std::snprintf(buffer + used, size - used, " %d %.2f %.2f",
+                                        event.pointers[i].id, event.pointers[i].x,
+                                        event.pointers[i].y);
+        length = written < 0 ? written : length + written;
+    }
+    return length;
+}
+
+bool parseTouchEvent(const char *line, TouchEvent &outEvent) {
+    char *end = nullptr;
+    outEvent.timeNanos = std::strtoll(line, &end, 10);
+    if (end == line) {
+        return false;
+    }
+    const char *cursor = end;
+    while (*cursor == ' ') {
+        cursor += 1;
+    }
+    size_t nameLength = std::strcspn(cursor, " ");
+    bool isKnown = false;
+    for (int32_t action = 0; action < 7; action++) {
+        const char *name = ACTION_NAMES[action];
+        if (name != nullptr and std::strlen(name) == nameLength and
+            std::strncmp(name, cursor, nameLength) == 0) {
+            outEvent.action = static_cast<TouchAction>(action);
+            isKnown = true;
+        }
+    }
+    if (not isKnown) {
+        return false;
+    }
+    cursor += nameLength;
+    outEvent.actionIndex = static_cast<int32_t>(std::strtol(cursor, &end, 10));
+    if (end == cursor) {
+        return false;
+    }
+    cursor = end;
+    outEvent.pointerCount = static_cast<int32_t>(std::strtol(cursor, &end, 10));
+    if (end == cursor or outEvent.pointerCount <= 0 or
+        outEvent.pointerCount > TouchEvent::MAX_POINTERS or
+        outEvent.actionIndex < 0 or outEvent.actionIndex >= outEvent.pointerCount) {
+        return false;
+    }
+    cursor = end;
+    for (int32_t i = 0; i < outEvent.pointerCount; i++) {
+        TouchPointer &pointer = outEvent.pointers[i];
+        pointer.id = static_cast<int32_t>(std::strtol(cursor, &end, 10));
+        if (end == cursor) {
+            return false;
+        }
+        cursor = end;
+        pointer.x = std::strtof(cursor, &end);
+        if (end == cursor) {
+            return false;
+        }
+        cursor = end;
+        pointer.y = std::strtof(cursor, &end);
+        if (end == cursor) {
+            return false;
+        }
+        cursor = end;
+    }
+    return true;
+}
+
+const char *gestureName(GestureKind kind) {
+    switch (kind) {
+        case GestureKind::TAP:
+            return "tap";
+        case GestureKind::LONG_PRESS:
+            return "long_press";
+        case GestureKind::DOUBLE_TAP:
+            return "double_tap";
+        case GestureKind::PAN:
+            return "pan";
+        case GestureKind::PINCH:
+            return "pinch";
+    }
+    return "unknown";
+}
@@ -0,0 +1,129 @@
+#ifndef MINESWEEPER_GESTURE_RECOGNIZER_H
+#define MINESWEEPER_GESTURE_RECOGNIZER_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Touch input decoupled from GameActivity, so recognition can be replayed from traces off device.
+enum class TouchAction {
+    DOWN = 0,
+    UP = 1,
+    MOVE = 2,
+    CANCEL = 3,
+    POINTER_DOWN = 5,
+    POINTER_UP = 6
+};
+
+struct TouchPointer {
+    int32_t id;
+    float x;
+    float y;
+};
+
+// One motion event. Only the first MAX_POINTERS pointers are kept; gestures use at most two.
+struct TouchEvent {
+    static constexpr int32_t MAX_POINTERS = 4;
+
+    int64_t timeNanos;
+    TouchAction action;
+    // The pointer that went down or up, for POINTER_DOWN and POINTER_UP.
+    int32_t actionIndex;
+    int32_t pointerCount;
+    TouchPointer pointers[MAX_POINTERS];
+};
+
+enum class GestureKind {
+    // A short press and release without moving: reveal.
+    TAP,
+    // A press held for at least longPressNanos: flag.
+    LONG_PRESS,
+    // A second tap soon after and close to the first: chord. Replaces that second TAP.
+    DOUBLE_TAP,
+    // One pointer moved by (dx, dy) pixels.
+    PAN,
+    // Two pointers: their midpoint (x, y) moved by (dx, dy) and their distance scaled by scale.
+    PINCH
+};
+
+struct Gesture {
+    GestureKind kind;
+    int64_t timeNanos;
+    float x;
+    float y;
+    float dx;
+    float dy;
+    float scale;
+};
+
+struct GestureConfig {
+    // How far a pointer may drift before a press stops being a tap and starts panning.
+    float touchSlopPixels = 24.f;
+    int64_t longPressNanos = 400'000'000;
+    // The longest gap from one tap's release to the next press that still chords.
+    int64_t doubleTapNanos = 300'000'000;
+    float doubleTapSlopPixels = 48.f;
+};
+
+// Turns a stream of TouchEvents into gestures. Every event produces at most one gesture, and the
+// recognizer keeps all of its state in fixed fields, so recognition never allocates.
+class GestureRecognizer {
+public:
+    explicit GestureRecognizer(const GestureConfig &config = GestureConfig());
+
+    // Returns true and fills outGesture if the event completed or continued a gesture.
+    bool onEvent(const TouchEvent &event, Gesture &outGesture);
+
+    // Forgets any gesture in progress, e.g. when the window loses focus.
+    void reset();
+
+private:
+    enum class State {
+        IDLE,
+        // One pointer down that may still be a tap.
+        PRESSED,
+        PANNING,
+        PINCHING,
+        // A pinch ended with a pointer still down; nothing more until all are up.
+        FINISHING
+    };
+
+    // Index in event of the pointer with id, or -1.
+    static int32_t findPointer(const TouchEvent &event, int32_t id);
+
+    // Takes anchors from the tracked pointers of event. Returns false if any of them is missing.
+    bool anchor(const TouchEvent &event);
+
+    bool onMove(const TouchEvent &event, Gesture &outGesture);
+
+    bool onRelease(const TouchEvent &event, Gesture &outGesture);
+
+    GestureConfig config;
+    State state = State::IDLE;
+    int32_t trackedIds[2] = {-1, -1};
+    int64_t downNanos = 0;
+    float downX = 0.f;
+    float downY = 0.f;
+    // Where the last PAN or PINCH left the midpoint and pointer distance.
+    float anchorX = 0.f;
+    float anchorY = 0.f;
+    float anchorSpan = 0.f;
+    // The last tap that could become the first half of a double tap.
+    bool hasLastTap = false;
+    int64_t lastTapNanos = 0;
+    float lastTapX = 0.f;
+    float lastTapY = 0.f;
+};
+
+// Recorded traces are text, one event per line:
+//   <timeNanos> <action> <actionIndex> <pointerCount> then <id> <x> <y> per pointer
+// with action one of down, up, move, cancel, pointer_down and pointer_up.
+
+// Writes event as one line without the newline. Returns the length written, like snprintf.
+int32_t formatTouchEvent(const TouchEvent &event, char *buffer, size_t size);
+
+// Parses a line written by formatTouchEvent. Returns false if it is malformed.
+bool parseTouchEvent(const char *line, TouchEvent &outEvent);
+
+const char *gestureName(GestureKind kind);
+
+#endif //MINESWEEPER_GESTURE_RECOGNIZER_H
@@ -0,0 +1,205 @@
+#include "glyph_atlas.h"
+#include <utility>
+
+namespace {
+
+// Glyphs are unions of a few shapes in glyph units, x to the right and y down.
+enum class ShapeKind {
+    // The segment from a to b, widened by radius.
+    CAPSULE,
+    // The disc around a of radius.
+    DISC,
+    // The triangle a, b, c.
+    TRIANGLE
+};
+
+struct Shape {
+    ShapeKind kind;
+    float ax;
+    float ay;
+    float bx;
+    float by;
+    float cx;
+    float cy;
+    float radius;
+};
+
+constexpr int32_t MAX_SHAPES = 5;
+
+struct GlyphShapes {
+    int32_t count;
+    Shape shapes[MAX_SHAPES];
+};
+
+constexpr Shape stroke(float ax, float ay, float bx, float by, float radius) {
+    return Shape{ShapeKind::CAPSULE, ax, ay, bx, by, 0.f, 0.f, radius};
+}
+
+constexpr Shape disc(float x, float y, float radius) {
+    return Shape{ShapeKind::DISC, x, y, 0.f, 0.f, 0.f, 0.f, radius};
+}
+
+constexpr Shape triangle(float ax, float ay, float bx, float by, float cx, float cy) {
+    return Shape{ShapeKind::TRIANGLE, ax, ay, bx, by, cx, cy, 0.f};
+}
+
+// Digits are drawn on a seven segment frame with rounded joints, bold like the classic game.
+constexpr float L = 0.32f;
+constexpr float R = 0.68f;
+constexpr float T = 0.2f;
+constexpr float M = 0.5f;
+constexpr float B = 0.8f;
+constexpr float W = 0.075f;
+
+// Every shape keeps at least GLYPH_SPREAD texels clear of its slot's edge, so glyphs never reach
+// into their neighbours, in the atlas or in its mip levels.
+constexpr GlyphShapes GLYPH_SHAPES[GLYPH_COUNT] = {
+        {3, {stroke(0.38f, 0.3f, 0.52f, T, W), stroke(0.52f, T, 0.52f, B, W),
+             stroke(0.36f, B, 0.68f, B, W)}},
+        {5, {stroke(L, T, R, T, W), stroke(R, T, R, M, W), stroke(R, M, L, M, W),
+             stroke(L, M, L, B, W), stroke(L, B, R, B, W)}},
+        {4, {stroke(L, T, R, T, W), stroke(R, T, R, B, W), stroke(0.4f, M, R, M, W),
+             stroke(L, B, R, B, W)}},
+        {3, {stroke(L, T, L, M, W), stroke(L, M, R, M, W), stroke(0.62f, T, 0.62f, B, W)}},
+        {5, {stroke(R, T, L, T, W), stroke(L, T, L, M, W), stroke(L, M, R, M, W),
+             stroke(R, M, R, B, W), stroke(R, B, L, B, W)}},
+        {5, {stroke(R, T, L, T, W), stroke(L, T, L, B, W), stroke(L, B, R, B, W),
+             stroke(R, B, R, M, W), stroke(R, M, L, M, W)}},
+        {2, {stroke(L, T, R, T, W), stroke(R, T, 0.44f, B, W)}},
+        {5, {stroke(L, T, R, T, W), stroke(L, T, L, B, W), stroke(R, T, R, B, W),
+             stroke(L, M, R, M, W), stroke(L, B, R, B, W)}},
+        // GLYPH_MINE: a ball with four spikes through it
+        {5, {disc(0.5f, 0.5f, 0.22f), stroke(0.5f, 0.2f, 0.5f, 0.8f, 0.035f),
+             stroke(0.2f, 0.5f, 0.8f, 0.5f, 0.035f), stroke(0.3f, 0.3f, 0.7f, 0.7f, 0.03f),
+             stroke(0.7f, 0.3f, 0.3f, 0.7f, 0.03f)}},
+        // GLYPH_SHINE
+        {1, {disc(0.43f, 0.43f, 0.055f)}},
+        // GLYPH_POLE: the pole and its base
+        {2, {stroke(0.54f, 0.22f, 0.54f, 0.72f, 0.03f),
+             stroke(0.3f, 0.76f, 0.74f, 0.76f, 0.04f)}},
+        // GLYPH_PENNANT
+        {1, {triangle(0.56f, 0.2f, 0.56f, 0.52f, 0.24f, 0.36f)}},
+        // GLYPH_CROSS
+        {2, {stroke(0.22f, 0.22f, 0.78f, 0.78f, 0.05f),
+             stroke(0.78f, 0.22f, 0.22f, 0.78f, 0.05f)}}};
+
+// std::sqrt is not constexpr before C++26. Newton's method from above converges monotonically, so
+// it stops as soon as an iteration no longer shrinks the estimate.
+constexpr float constexprSqrt(float value) {
+    if (value <= 0.f) {
+        return 0.f;
+    }
+    double estimate = value > 1.f ? value : 1.0;
+    for (int32_t i = 0; i < 64; i++) {
+        double next = 0.5 * (estimate + value / estimate);
+        if (next >= estimate) {
+            break;
+        }
+        estimate = next;
+    }
+    return static_cast<float>(estimate);
+}
+
+constexpr float squaredSegmentDistance(
+        float px, float py, float ax, float ay, float bx, float by) {
+    float abx = bx - ax;
+    float aby = by - ay;
+    float apx = px - ax;
+    float apy = py - ay;
+    float length = abx * abx + aby * aby;
+    float t = length > 0.f ? (apx * abx + apy * aby) / length : 0.f;
+    t = t < 0.f ? 0.f : (t > 1.f ? 1.f : t);
+    float dx = apx - t * abx;
+    float dy = apy - t * aby;
+    return dx * dx + dy * dy;
+}
+
+constexpr float cross(float ax, float ay, float bx, float by, float px, float py) {
+    return (bx - ax) * (py - ay) - (by - ay) * (px - ax);
+}
+
+constexpr float shapeDistance(const Shape &shape, float x, float y) {
+    switch (shape.kind) {
+        case ShapeKind::CAPSULE:
+            return constexprSqrt(squaredSegmentDistance(x, y, shape.ax, shape.ay, shape.bx,
+                                                        shape.by)) - shape.radius;
+        case ShapeKind::DISC:
+            return constexprSqrt((x - shape.ax) * (x - shape.ax) +
+                                 (y - shape.ay) * (y - shape.ay)) - shape.radius;
+        case ShapeKind::TRIANGLE: {
+            float edge = squaredSegmentDistance(x, y, shape.ax, shape.ay, shape.bx, shape.by);
+            float next = squaredSegmentDistance(x, y, shape.bx, shape.by, shape.cx, shape.cy);
+            edge = next < edge ? next : edge;
+            next = squaredSegmentDistance(x, y, shape.cx, shape.cy, shape.ax, shape.ay);
+            edge = next < edge ? next : edge;
+            float ab = cross(shape.ax, shape.ay, shape.bx, shape.by, x, y);
+            float bc = cross(shape.bx, shape.by, shape.cx, shape.cy, x, y);
+            float ca = cross(shape.cx, shape.cy, shape.ax, shape.ay, x, y);
+            bool isInside = (ab >= 0.f and bc >= 0.f and ca >= 0.f) or
+                            (ab <= 0.f and bc <= 0.f and ca <= 0.f);
+            float distance = constexprSqrt(edge);
+            return isInside ? -distance : distance;
+        }
+    }
+    return 1.f;
+}
+
+constexpr float distanceTo(int32_t glyph, float x, float y) {
+    const GlyphShapes &glyphShapes = GLYPH_SHAPES[glyph];
+    float distance = 1.f;
+    for (int32_t i = 0; i < glyphShapes.count; i++) {
+        float shape = shapeDistance(glyphShapes.shapes[i], x, y);
+        distance = shape < distance ? shape : distance;
+    }
+    return distance;
+}
+
+using GlyphField = std::array<uint8_t, GLYPH_SIZE * GLYPH_SIZE>;
+
+constexpr GlyphField bakeGlyph(int32_t glyph) {
+    GlyphField field{};
+    for (int32_t y = 0; y < GLYPH_SIZE; y++) {
+        for (int32_t x = 0; x < GLYPH_SIZE; x++) {
+            float distance = distanceTo(glyph, (x + 0.5f) / GLYPH_SIZE, (y + 0.5f) / GLYPH_SIZE);
+            float value = 128.f - distance * GLYPH_SIZE / GLYPH_SPREAD * 127.f;
+            value = value < 0.f ? 0.f : (value > 255.f ? 255.f : value);
+            field[y * GLYPH_SIZE + x] = static_cast<uint8_t>(value + 0.5f);
+        }
+    }
+    return field;
+}
+
+// One constant per glyph keeps each compile-time evaluation well inside compilers' step limits.
+template<int32_t Index>
+constexpr GlyphField BAKED_GLYPH = bakeGlyph(Index);
+
+template<int32_t... Indices>
+constexpr std::array<uint8_t, GLYPH_ATLAS_SIZE * GLYPH_ATLAS_SIZE>
+packGlyphs(std::integer_sequence<int32_t, Indices...>) {
+    const GlyphField *fields[] = {&BAKED_GLYPH<Indices>...};
+    std::array<uint8_t, GLYPH_ATLAS_SIZE * GLYPH_ATLAS_SIZE> atlas{};
+    for (int32_t glyph = 0; glyph < GLYPH_COUNT; glyph++) {
+        int32_t left = glyph % GLYPH_COLUMNS * GLYPH_SIZE;
+        int32_t top = glyph / GLYPH_COLUMNS * GLYPH_SIZE;
+        for (int32_t y = 0; y < GLYPH_SIZE; y++) {
+            for (int32_t x = 0; x < GLYPH_SIZE; x++) {
+                atlas[(top + y) * GLYPH_ATLAS_SIZE + left + x] =
+                        (*fields[glyph])[y * GLYPH_SIZE + x];
+            }
+        }
+    }
+    return atlas;
+}
+
+}
+
+constexpr std::array<uint8_t, GLYPH_ATLAS_SIZE * GLYPH_ATLAS_SIZE> GLYPH_ATLAS =
+        packGlyphs(std::make_integer_sequence<int32_t, GLYPH_COUNT>());
+
+// The slots no glyph uses must read as outside everywhere, like the margins of the glyphs.
+static_assert(GLYPH_ATLAS[GLYPH_ATLAS_SIZE * GLYPH_ATLAS_SIZE - 1] == 0, "unused slots are empty");
+static_assert(GLYPH_ATLAS[0] == 0, "glyphs keep clear of their slot's corner");
+
+float glyphDistance(int32_t glyph, float x, float y) {
+    return distanceTo(glyph, x, y);
+}
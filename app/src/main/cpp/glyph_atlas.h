@@ -0,0 +1,103 @@
+#ifndef MINESWEEPER_GLYPH_ATLAS_H
+#define MINESWEEPER_GLYPH_ATLAS_H
+
+#include <array>
+#include <cstdint>
+#include "board_instances.h"
+
+// Shapes drawn over the cell backgrounds of the atlas. Glyphs are stored as signed distance fields,
+// so the cell shader can cut their edges sharply at any zoom instead of magnifying texels.
+enum Glyph : int8_t {
+    GLYPH_NONE = -1,
+    // GLYPH_DIGIT_1 + n - 1 shows the number n.
+    GLYPH_DIGIT_1 = 0,
+    GLYPH_MINE = 8,
+    GLYPH_SHINE = 9,
+    GLYPH_POLE = 10,
+    GLYPH_PENNANT = 11,
+    GLYPH_CROSS = 12,
+    GLYPH_COUNT = 13
+};
+
+// The glyph atlas is a single channel square of GLYPH_COLUMNS x GLYPH_COLUMNS glyphs, each
+// GLYPH_SIZE texels square. A texel holds 128 on the glyph's edge, more inside and less outside,
+// changing by 127 every GLYPH_SPREAD texels and clamped beyond that.
+constexpr int32_t GLYPH_SIZE = 32;
+constexpr int32_t GLYPH_COLUMNS = 4;
+constexpr int32_t GLYPH_ATLAS_SIZE = GLYPH_SIZE * GLYPH_COLUMNS;
+constexpr float GLYPH_SPREAD = 4.f;
+
+static_assert(GLYPH_COUNT <= GLYPH_COLUMNS * GLYPH_COLUMNS, "every glyph needs a slot");
+
+// Baked while compiling glyph_atlas.cpp, so the library carries the atlas and startup neither
+// draws nor reads it.
+extern const std::array<uint8_t, GLYPH_ATLAS_SIZE * GLYPH_ATLAS_SIZE> GLYPH_ATLAS;
+
+// Signed distance from (x, y) to the edge of glyph, both in glyph units where the glyph's slot
+// spans [0, 1), negative inside. GLYPH_ATLAS holds this function sampled at texel centres.
+float glyphDistance(int32_t glyph, float x, float y);
+
+// One glyph drawn in one colour.
+struct GlyphLayer {
+    int8_t glyph;
+    uint8_t red;
+    uint8_t green;
+    uint8_t blue;
+};
+
+// The layers of each atlas tile, drawn in order over its background.
+constexpr int32_t GLYPH_LAYERS = 2;
+constexpr int32_t GLYPH_TILES = ATLAS_COLUMNS * ATLAS_COLUMNS;
+constexpr GlyphLayer TILE_GLYPHS[GLYPH_TILES][GLYPH_LAYERS] = {
+        {{GLYPH_NONE, 0, 0, 0}, {GLYPH_NONE, 0, 0, 0}},
+        {{GLYPH_DIGIT_1 + 0, 0, 0, 255}, {GLYPH_NONE, 0, 0, 0}},
+        {{GLYPH_DIGIT_1 + 1, 0, 128, 0}, {GLYPH_NONE, 0, 0, 0}},
+        {{GLYPH_DIGIT_1 + 2, 255, 0, 0}, {GLYPH_NONE, 0, 0, 0}},
+        {{GLYPH_DIGIT_1 + 3, 0, 0, 128}, {GLYPH_NONE, 0, 0, 0}},
+        {{GLYPH_DIGIT_1 + 4, 128, 0, 0}, {GLYPH_NONE, 0, 0, 0}},
+        {{GLYPH_DIGIT_1 + 5, 0, 128, 128}, {GLYPH_NONE, 0, 0, 0}},
+        {{GLYPH_DIGIT_1 + 6, 0, 0, 0}, {GLYPH_NONE, 0, 0, 0}},
+        {{GLYPH_DIGIT_1 + 7, 128, 128, 128}, {GLYPH_NONE, 0, 0, 0}},
+        // TILE_HIDDEN
+        {{GLYPH_NONE, 0, 0, 0}, {GLYPH_NONE, 0, 0, 0}},
+        // TILE_FLAG
+        {{GLYPH_POLE, 0, 0, 0}, {GLYPH_PENNANT, 255, 0, 0}},
+        // TILE_MINE and TILE_EXPLODED, which differ only in background
+        {{GLYPH_MINE, 0, 0, 0}, {GLYPH_SHINE, 255, 255, 255}},
+        {{GLYPH_MINE, 0, 0, 0}, {GLYPH_SHINE, 255, 255, 255}},
+        // TILE_WRONG_FLAG
+        {{GLYPH_MINE, 0, 0, 0}, {GLYPH_CROSS, 255, 0, 0}},
+        {{GLYPH_NONE, 0, 0, 0}, {GLYPH_NONE, 0, 0, 0}},
+        {{GLYPH_NONE, 0, 0, 0}, {GLYPH_NONE, 0, 0, 0}}};
+
+// TILE_GLYPHS flattened into the vec4 uniform arrays of the cell shader, layer l of tile t at
+// t * GLYPH_LAYERS + l: origins hold the glyph's top left corner in atlas UVs, colours its RGBA
+// with alpha 0 for an empty layer.
+struct GlyphUniforms {
+    std::array<float, GLYPH_TILES * GLYPH_LAYERS * 4> origins;
+    std::array<float, GLYPH_TILES * GLYPH_LAYERS * 4> colours;
+};
+
+constexpr GlyphUniforms makeGlyphUniforms() {
+    GlyphUniforms uniforms{};
+    for (int32_t tile = 0; tile < GLYPH_TILES; tile++) {
+        for (int32_t layer = 0; layer < GLYPH_LAYERS; layer++) {
+            const GlyphLayer &glyphLayer = TILE_GLYPHS[tile][layer];
+            size_t index = static_cast<size_t>(tile * GLYPH_LAYERS + layer) * 4;
+            if (glyphLayer.glyph == GLYPH_NONE) {
+                continue;
+            }
+            uniforms.origins[index] = float(glyphLayer.glyph % GLYPH_COLUMNS) / GLYPH_COLUMNS;
+            uniforms.origins[index + 1] = float(glyphLayer.glyph / GLYPH_COLUMNS) / GLYPH_COLUMNS;
+            uniforms.colours[index] = glyphLayer.red / 255.f;
+            uniforms.colours[index + 1] = glyphLayer.green / 255.f;
+            uniforms.colours[index + 2] = glyphLayer.blue / 255.f;
+            uniforms.colours[index + 3] = 1.f;
+        }
+    }
+    return uniforms;
+}
+
+constexpr GlyphUniforms GLYPH_UNIFORMS = makeGlyphUniforms();
+
+#endif //MINESWEEPER_GLYPH_ATLAS_H
@@ -0,0 +1,1092 @@
+#include "hint_engine.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+#include "seeding.h"
+
+namespace {
+
+const std::pair<int32_t, int32_t> NEIGHBOURS[8] = {{0,  1},
+                                                    {0,  -1},
+                                                    {1,  0},
+                                                    {-1, 0},
+                                                    {-1, -1},
+                                                    {-1, 1},
+                                                    {1,  -1},
+                                                    {1,  1}};
+
+// A component with more layouts than this, or that takes more search nodes to enumerate, makes
+// the board too open to sample.
+constexpr int64_t MAX_LAYOUTS = 1 << 18;
+constexpr int64_t MAX_SEARCH_NODES = 1 << 24;
+
+int64_t steadyNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+double logChoose(int32_t n, int32_t k) {
+    return std::lgamma(n + 1.0) - std::lgamma(k + 1.0) - std::lgamma(n - k + 1.0);
+}
+
+// Scales values so the largest is 1; only ratios within a row matter.
+void normalize(std::vector<double> &values) {
+    double largest = *std::max_element(values.begin(), values.end());
+    if (largest > 0.0) {
+        for (double &value: values) {
+            value /= largest;
+        }
+    }
+}
+
+std::vector<double> convolve(const std::vector<double> &a, const std::vector<double> &b) {
+    std::vector<double> result(a.size() + b.size() - 1, 0.0);
+    for (size_t i = 0; i < a.size(); i++) {
+        for (size_t j = 0; j < b.size(); j++) {
+            result[i + j] += a[i] * b[j];
+        }
+    }
+    normalize(result);
+    return result;
+}
+
+// Picks an index with chance proportional to its weight, or -1 if every weight is 0.
+int32_t pickWeighted(const double *weights, int32_t count, std::mt19937_64 &rng) {
+    double total = 0.0;
+    int32_t last = -1;
+    for (int32_t i = 0; i < count; i++) {
+        total += weights[i];
+        if (weights[i] > 0.0) {
+            last = i;
+        }
+    }
+    if (last < 0) {
+        return -1;
+    }
+    double target = std::uniform_real_distribution<double>(0.0, total)(rng);
+    for (int32_t i = 0; i < last; i++) {
+        target -= weights[i];
+        if (weights[i] > 0.0 and target < 0.0) {
+            return i;
+        }
+    }
+    return last;
+}
+
+struct Constraint {
+    int32_t need;
+    int32_t assigned;
+    int32_t unassigned;
+};
+
+// Depth-first search over one component's cells, in an order where each cell shares numbers with
+// the ones before it, so contradictions are found early.
+struct Enumeration {
+    int32_t size = 0;
+    int32_t words = 0;
+    std::vector<Constraint> constraints;
+    std::vector<std::vector<int32_t>> cellConstraints;
+    std::vector<uint64_t> bits;
+    int32_t mines = 0;
+    int64_t nodes = 0;
+    std::vector<uint64_t> found;
+    std::vector<int32_t> foundMines;
+
+    // Returns false once the search is over budget.
+    bool search(int32_t cell) {
+        if (++nodes > MAX_SEARCH_NODES) {
+            return false;
+        }
+        if (cell == size) {
+            if (static_cast<int64_t>(foundMines.size()) >= MAX_LAYOUTS) {
+                return false;
+            }
+            found.insert(found.end(), bits.begin(), bits.end());
+            foundMines.push_back(mines);
+            return true;
+        }
+        for (int32_t value = 0; value <= 1; value++) {
+            bool isConsistent = true;
+            for (int32_t index: cellConstraints[cell]) {
+                Constraint &constraint = constraints[index];
+                constraint.assigned += value;
+                constraint.unassigned -= 1;
+                isConsistent = isConsistent and constraint.assigned <= constraint.need and
+                               constraint.assigned + constraint.unassigned >= constraint.need;
+            }
+            bool isWithinBudget = true;
+            if (isConsistent) {
+                bits[cell >> 6] |= static_cast<uint64_t>(value) << (cell & 63);
+                mines += value;
+                isWithinBudget = search(cell + 1);
+                bits[cell >> 6] &= ~(uint64_t{1} << (cell & 63));
+                mines -= value;
+            }
+            for (int32_t index: cellConstraints[cell]) {
+                constraints[index].assigned -= value;
+                constraints[index].unassigned += 1;
+            }
+            if (not isWithinBudget) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+bool isInBounds(int32_t width, int32_t height, int32_t x, int32_t y) {
+    return 0 <= x and x < width and 0 <= y and y < height;
+}
+
+struct Edge {
+    int32_t cell;
+    int64_t visits;
+    double wins;
+};
+
+struct Node {
+    std::vector<Edge> edges;
+    int64_t visits = 0;
+};
+
+struct WorkerResult {
+    std::vector<Edge> root;
+    int64_t iterations = 0;
+    int64_t nodes = 0;
+};
+
+// What every worker searches from, read-only while they run.
+struct SearchShared {
+    const LayoutSampler &sampler;
+    // The board with no mines under its hidden cells, one under every flag and a flag on every
+    // cell that is a mine in all layouts.
+    const BoardFork &base;
+    const HintConfig &config;
+    const std::vector<int32_t> &rootCells;
+    // Revealed cells of base that border hidden, unflagged ones.
+    const std::vector<int32_t> &frontier;
+    // Flags on base, and hidden cells left without one.
+    int32_t flagCount;
+    int32_t hiddenCount;
+    int64_t deadline;
+};
+
+// One worker's tree and scratch. Playing out a layout keeps its flag and hidden cell counts, the
+// revealed cells that border hidden ones and the numbers waiting to be settled up to date as cells
+// change, so no step of a rollout scans the whole board.
+class Searcher {
+public:
+    Searcher(const SearchShared &shared, uint64_t seed)
+            : shared(shared), rng(seed), width(shared.base.getWidth()),
+              height(shared.base.getHeight()), interior(shared.sampler.getInterior()),
+              isPending(static_cast<size_t>(width) * height, 0),
+              estimate(static_cast<size_t>(width) * height, 0.f),
+              estimateStamp(static_cast<size_t>(width) * height, 0) {}
+
+    WorkerResult run();
+
+private:
+    int32_t selectEdge(const Node &node) const;
+
+    // Reveals a safe cell and queues the numbers the change may settle.
+    void reveal(BoardFork &board, int32_t cell);
+
+    void flag(BoardFork &board, int32_t cell);
+
+    // Queues the cell, if revealed, and its revealed neighbours.
+    void queueAround(const BoardFork &board, int32_t cell);
+
+    // Reveals every cell single-point deduction and the mine count prove safe and flags every
+    // cell they prove a mine, until neither finds anything. Only queued numbers are looked at.
+    // Both rules are sound in a consistent layout, so this never steps on a mine.
+    void settle(BoardFork &board);
+
+    // Fills candidates with the hidden cells the frontier borders and a local estimate of their
+    // mine chance: the worst ratio of missing mines to hidden neighbours over the numbers they
+    // border. Cells no number borders share density; there are interiorCount of them.
+    void estimateLocally(const BoardFork &board);
+
+    // A uniformly chosen hidden cell that estimateLocally did not reach, marking it reached.
+    int32_t takeInteriorCell(const BoardFork &board);
+
+    void expand(Node &node, const BoardFork &board);
+
+    // Guesses the locally least likely mine, then settles, until the layout is cleared or a
+    // guess hits a mine. Returns 1 for a win and 0 for a loss.
+    double rollOut(BoardFork &board);
+
+    struct Candidate {
+        float probability;
+        uint32_t tieBreak;
+        int32_t cell;
+
+        bool operator<(const Candidate &other) const {
+            return probability != other.probability ? probability < other.probability
+                                                    : tieBreak < other.tieBreak;
+        }
+    };
+
+    const SearchShared &shared;
+    std::mt19937_64 rng;
+    int32_t width;
+    int32_t height;
+    // Of the layout being played.
+    int32_t mineCount = 0;
+    int32_t flags = 0;
+    int32_t hiddenLeft = 0;
+    std::vector<int32_t> frontier;
+    std::vector<int32_t> pending;
+    std::vector<uint8_t> isPending;
+    std::vector<int32_t> uncovered;
+    std::vector<int32_t> interior;
+    std::vector<int32_t> mines;
+    // Estimates are valid where estimateStamp matches stamp.
+    std::vector<Candidate> candidates;
+    std::vector<float> estimate;
+    std::vector<uint32_t> estimateStamp;
+    uint32_t stamp = 0;
+    float density = 0.f;
+    int32_t interiorCount = 0;
+    std::unordered_map<uint64_t, Node> nodes;
+    std::vector<std::pair<Node *, int32_t>> path;
+};
+
+WorkerResult Searcher::run() {
+    const HintConfig &config = shared.config;
+    Node root;
+    for (int32_t cell: shared.rootCells) {
+        root.edges.push_back(Edge{cell, 0, 0.0});
+    }
+    WorkerResult result;
+    while (steadyNanos() < shared.deadline) {
+        // Flags are mines in every layout, so the layout's mines are the flags and the draw
+        BoardFork board = shared.base.fork();
+        shared.sampler.sample(rng, interior, mines);
+        for (int32_t cell: mines) {
+            board.setMine(cell % width, cell / width, true);
+        }
+        mineCount = board.getMineCount();
+        flags = shared.flagCount;
+        hiddenLeft = shared.hiddenCount;
+        frontier = shared.frontier;
+
+        Node *node = &root;
+        int32_t depth = 0;
+        double reward;
+        path.clear();
+        while (true) {
+            int32_t edge = selectEdge(*node);
+            path.emplace_back(node, edge);
+            int32_t cell = node->edges[edge].cell;
+            const Cell &target = board.getCell(cell % width, cell / width);
+            if (target.isRevealed or target.isFlagged) {
+                // Only a hash collision brings a position here with this cell already settled
+                reward = rollOut(board);
+                break;
+            }
+            if (target.isMine) {
+                reward = 0.0;
+                break;
+            }
+            reveal(board, cell);
+            settle(board);
+            if (flags == mineCount) {
+                reward = 1.0;
+                break;
+            }
+            depth += 1;
+            if (depth < config.maxDepth) {
+                auto found = nodes.find(board.getVisibleHash());
+                if (found != nodes.end()) {
+                    node = &found->second;
+                    continue;
+                }
+                if (static_cast<int32_t>(nodes.size()) < config.maxNodes) {
+                    expand(nodes[board.getVisibleHash()], board);
+                }
+            }
+            reward = rollOut(board);
+            break;
+        }
+        for (const auto [pathNode, edge]: path) {
+            pathNode->visits += 1;
+            pathNode->edges[edge].visits += 1;
+            pathNode->edges[edge].wins += reward;
+        }
+        result.iterations += 1;
+    }
+    result.root = std::move(root.edges);
+    result.nodes = static_cast<int64_t>(nodes.size()) + 1;
+    return result;
+}
+
+int32_t Searcher::selectEdge(const Node &node) const {
+    int32_t best = 0;
+    double bestScore = -1.0;
+    double logVisits = std::log(static_cast<double>(std::max<int64_t>(node.visits, 1)));
+    for (size_t i = 0; i < node.edges.size(); i++) {
+        const Edge &edge = node.edges[i];
+        if (edge.visits == 0) {
+            return static_cast<int32_t>(i);
+        }
+        double visits = static_cast<double>(edge.visits);
+        double score = edge.wins / visits +
+                       shared.config.exploration * std::sqrt(logVisits / visits);
+        if (score > bestScore) {
+            best = static_cast<int32_t>(i);
+            bestScore = score;
+        }
+    }
+    return best;
+}
+
+void Searcher::reveal(BoardFork &board, int32_t cell) {
+    uncovered.clear();
+    board.revealCell(cell % width, cell / width, uncovered);
+    hiddenLeft -= static_cast<int32_t>(uncovered.size());
+    for (int32_t index: uncovered) {
+        frontier.push_back(index);
+        queueAround(board, index);
+    }
+}
+
+void Searcher::flag(BoardFork &board, int32_t cell) {
+    board.setFlag(cell % width, cell / width, true);
+    flags += 1;
+    hiddenLeft -= 1;
+    queueAround(board, cell);
+}
+
+void Searcher::queueAround(const BoardFork &board, int32_t cell) {
+    int32_t x = cell % width;
+    int32_t y = cell / width;
+    auto queue = [this, &board](int32_t x, int32_t y) {
+        int32_t index = y * width + x;
+        if (board.getCell(x, y).isRevealed and not isPending[index]) {
+            isPending[index] = 1;
+            pending.push_back(index);
+        }
+    };
+    queue(x, y);
+    for (const auto [dx, dy]: NEIGHBOURS) {
+        if (isInBounds(width, height, x + dx, y + dy)) {
+            queue(x + dx, y + dy);
+        }
+    }
+}
+
+void Searcher::settle(BoardFork &board) {
+    while (true) {
+        while (not pending.empty()) {
+            int32_t index = pending.back();
+            pending.pop_back();
+            isPending[index] = 0;
+            int32_t x = index % width;
+            int32_t y = index / width;
+            int32_t number = board.getCell(x, y).adjacentMines;
+            if (number == 0) {
+                continue;
+            }
+            int32_t flagsAround = 0;
+            int32_t hiddenAround = 0;
+            for (const auto [dx, dy]: NEIGHBOURS) {
+                if (not isInBounds(width, height, x + dx, y + dy)) {
+                    continue;
+                }
+                const Cell &neighbour = board.getCell(x + dx, y + dy);
+                if (neighbour.isFlagged) {
+                    flagsAround += 1;
+                } else if (not neighbour.isRevealed) {
+                    hiddenAround += 1;
+                }
+            }
+            bool isSafe = flagsAround == number;
+            bool isMines = number - flagsAround == hiddenAround;
+            if (hiddenAround == 0 or (not isSafe and not isMines)) {
+                continue;
+            }
+            for (const auto [dx, dy]: NEIGHBOURS) {
+                if (not isInBounds(width, height, x + dx, y + dy)) {
+                    continue;
+                }
+                const Cell &neighbour = board.getCell(x + dx, y + dy);
+                if (neighbour.isFlagged or neighbour.isRevealed) {
+                    continue;
+                }
+                if (isMines) {
+                    flag(board, (y + dy) * width + (x + dx));
+                } else {
+                    reveal(board, (y + dy) * width + (x + dx));
+                }
+            }
+        }
+        // Once the numbers are settled, the mine count can still decide every hidden cell at once
+        int32_t minesLeft = mineCount - flags;
+        if (hiddenLeft == 0 or (minesLeft != 0 and minesLeft != hiddenLeft)) {
+            return;
+        }
+        for (int32_t index = 0; index < width * height; index++) {
+            const Cell &cell = board.getCell(index % width, index / width);
+            if (cell.isRevealed or cell.isFlagged) {
+                continue;
+            }
+            if (minesLeft == 0) {
+                reveal(board, index);
+            } else {
+                flag(board, index);
+            }
+        }
+    }
+}
+
+void Searcher::estimateLocally(const BoardFork &board) {
+    stamp += 1;
+    if (stamp == 0) {
+        std::fill(estimateStamp.begin(), estimateStamp.end(), 0);
+        stamp = 1;
+    }
+    candidates.clear();
+    // Cells that no longer border a hidden one never will again, so they leave the frontier
+    size_t kept = 0;
+    for (int32_t index: frontier) {
+        int32_t x = index % width;
+        int32_t y = index / width;
+        int32_t flagsAround = 0;
+        int32_t hiddenAround = 0;
+        for (const auto [dx, dy]: NEIGHBOURS) {
+            if (not isInBounds(width, height, x + dx, y + dy)) {
+                continue;
+            }
+            const Cell &neighbour = board.getCell(x + dx, y + dy);
+            if (neighbour.isFlagged) {
+                flagsAround += 1;
+            } else if (not neighbour.isRevealed) {
+                hiddenAround += 1;
+            }
+        }
+        if (hiddenAround == 0) {
+            continue;
+        }
+        frontier[kept++] = index;
+        float local = static_cast<float>(board.getCell(x, y).adjacentMines - flagsAround) /
+                      static_cast<float>(hiddenAround);
+        for (const auto [dx, dy]: NEIGHBOURS) {
+            if (not isInBounds(width, height, x + dx, y + dy)) {
+                continue;
+            }
+            const Cell &neighbour = board.getCell(x + dx, y + dy);
+            if (neighbour.isFlagged or neighbour.isRevealed) {
+                continue;
+            }
+            int32_t neighbourIndex = (y + dy) * width + (x + dx);
+            if (estimateStamp[neighbourIndex] != stamp) {
+                estimateStamp[neighbourIndex] = stamp;
+                estimate[neighbourIndex] = local;
+                candidates.push_back(Candidate{0.f, 0, neighbourIndex});
+            } else {
+                estimate[neighbourIndex] = std::max(estimate[neighbourIndex], local);
+            }
+        }
+    }
+    frontier.resize(kept);
+    float frontierMines = 0.f;
+    for (Candidate &candidate: candidates) {
+        candidate.probability = estimate[candidate.cell];
+        frontierMines += candidate.probability;
+    }
+    interiorCount = hiddenLeft - static_cast<int32_t>(candidates.size());
+    density = 1.f;
+    if (interiorCount > 0) {
+        float minesLeft = static_cast<float>(mineCount - flags) - frontierMines;
+        density = std::clamp(minesLeft / static_cast<float>(interiorCount), 0.f, 1.f);
+    }
+}
+
+int32_t Searcher::takeInteriorCell(const BoardFork &board) {
+    auto cellCount = static_cast<uint64_t>(width) * static_cast<uint64_t>(height);
+    auto isInterior = [this, &board](int32_t index) {
+        const Cell &cell = board.getCell(index % width, index / width);
+        return not cell.isRevealed and not cell.isFlagged and estimateStamp[index] != stamp;
+    };
+    // Rejection sampling is uniform and quick while the interior is a fair share of the board;
+    // past a few tries a scan from a random cell finishes the job
+    int32_t index = static_cast<int32_t>(rng() % cellCount);
+    for (int32_t attempt = 0; attempt < 32 and not isInterior(index); attempt++) {
+        index = static_cast<int32_t>(rng() % cellCount);
+    }
+    for (uint64_t step = 0; step < cellCount and not isInterior(index); step++) {
+        index = static_cast<int32_t>((static_cast<uint64_t>(index) + 1) % cellCount);
+    }
+    estimateStamp[index] = stamp;
+    return index;
+}
+
+void Searcher::expand(Node &node, const BoardFork &board) {
+    estimateLocally(board);
+    for (Candidate &candidate: candidates) {
+        candidate.tieBreak = static_cast<uint32_t>(rng());
+    }
+    // Interior cells are all alike, so a random few of them stand for the rest
+    auto limit = static_cast<size_t>(shared.config.maxCandidates);
+    int32_t interiorTaken = std::min(interiorCount, shared.config.maxCandidates);
+    for (int32_t i = 0; i < interiorTaken; i++) {
+        candidates.push_back(Candidate{density, static_cast<uint32_t>(rng()),
+                                       takeInteriorCell(board)});
+    }
+    auto count = std::min(candidates.size(), limit);
+    std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end());
+    node.edges.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        node.edges.push_back(Edge{candidates[i].cell, 0, 0.0});
+    }
+}
+
+double Searcher::rollOut(BoardFork &board) {
+    while (flags < mineCount) {
+        estimateLocally(board);
+        // The lowest estimate, ties broken uniformly across frontier and interior cells
+        int32_t cell = -1;
+        float lowest = 2.f;
+        int64_t ties = 0;
+        for (const Candidate &candidate: candidates) {
+            if (candidate.probability < lowest) {
+                cell = candidate.cell;
+                lowest = candidate.probability;
+                ties = 1;
+            } else if (candidate.probability == lowest and
+                       rng() % static_cast<uint64_t>(++ties) == 0) {
+                cell = candidate.cell;
+            }
+        }
+        if (interiorCount > 0 and
+            (density < lowest or (density == lowest and
+                                  static_cast<int64_t>(rng() % static_cast<uint64_t>(
+                                          ties + interiorCount)) < interiorCount))) {
+            cell = takeInteriorCell(board);
+        }
+        if (cell < 0) {
+            return 0.0;
+        }
+        if (board.getCell(cell % width, cell / width).isMine) {
+            return 0.0;
+        }
+        reveal(board, cell);
+        settle(board);
+    }
+    return 1.0;
+}
+
+bool enumerateLayouts(LayoutComponent &component, Enumeration &enumeration) {
+    enumeration.bits.assign(enumeration.words, 0);
+    if (not enumeration.search(0) or enumeration.foundMines.empty()) {
+        return false;
+    }
+    // Grouped by mine count with a counting sort
+    auto size = static_cast<int32_t>(component.cells.size());
+    component.words = enumeration.words;
+    component.countStart.assign(size + 2, 0);
+    for (int32_t mines: enumeration.foundMines) {
+        component.countStart[mines + 1] += 1;
+    }
+    for (int32_t k = 0; k <= size; k++) {
+        component.countStart[k + 1] += component.countStart[k];
+    }
+    std::vector<int64_t> next(component.countStart.begin(), component.countStart.end() - 1);
+    component.layouts.resize(enumeration.found.size());
+    component.mineTotals.assign(static_cast<size_t>(size + 1) * size, 0);
+    for (size_t layout = 0; layout < enumeration.foundMines.size(); layout++) {
+        int32_t mines = enumeration.foundMines[layout];
+        const uint64_t *bits = enumeration.found.data() + layout * component.words;
+        std::copy(bits, bits + component.words,
+                  component.layouts.begin() + next[mines]++ * component.words);
+        for (int32_t i = 0; i < size; i++) {
+            component.mineTotals[static_cast<size_t>(mines) * size + i] +=
+                    static_cast<int64_t>(bits[i >> 6] >> (i & 63) & 1);
+        }
+    }
+    return true;
+}
+
+// Half width of the 95% interval around a candidate's win rate; unvisited ones are unknown.
+double winRateMargin(const HintCandidate &candidate) {
+    if (candidate.visits == 0) {
+        return 1.0;
+    }
+    return 1.96 * std::sqrt(candidate.winRate * (1.0 - candidate.winRate) /
+                            static_cast<double>(candidate.visits));
+}
+
+Task<WorkerResult> searchWorker(const SearchShared &shared, uint64_t seed) {
+    Searcher searcher(shared, seed);
+    co_return searcher.run();
+}
+
+}
+
+bool LayoutSampler::build(const GameBoard &board) {
+    width = board.getWidth();
+    int32_t height = board.getHeight();
+    int32_t cellCount = width * height;
+    flagCount = 0;
+    hidden.clear();
+    interior.clear();
+    components.clear();
+    ways.clear();
+    totalWeights.clear();
+    probability.assign(cellCount, -1.0);
+
+    // -1 for revealed and flagged cells, -2 for hidden cells no number borders (yet), otherwise
+    // the union-find parent of a frontier cell
+    std::vector<int32_t> parent(cellCount, -1);
+    auto find = [&parent](int32_t index) {
+        while (parent[index] != index) {
+            parent[index] = parent[parent[index]];
+            index = parent[index];
+        }
+        return index;
+    };
+    for (int32_t y = 0; y < height; y++) {
+        for (int32_t x = 0; x < width; x++) {
+            const Cell &cell = board.getCell(x, y);
+            if (cell.isFlagged) {
+                flagCount += 1;
+            } else if (not cell.isRevealed) {
+                hidden.push_back(y * width + x);
+                parent[y * width + x] = -2;
+            }
+        }
+    }
+    minesLeft = board.getMineCount() - flagCount;
+    if (minesLeft < 0 or minesLeft > static_cast<int32_t>(hidden.size())) {
+        return false;
+    }
+
+    // Numbers bordering hidden cells, as (cell index, missing mines); each links its hidden
+    // neighbours into one component
+    std::vector<std::pair<int32_t, int32_t>> numbers;
+    for (int32_t y = 0; y < height; y++) {
+        for (int32_t x = 0; x < width; x++) {
+            const Cell &cell = board.getCell(x, y);
+            if (not cell.isRevealed) {
+                continue;
+            }
+            int32_t need = cell.adjacentMines;
+            int32_t first = -1;
+            int32_t hiddenAround = 0;
+            for (const auto [dx, dy]: NEIGHBOURS) {
+                if (not isInBounds(width, height, x + dx, y + dy)) {
+                    continue;
+                }
+                const Cell &neighbour = board.getCell(x + dx, y + dy);
+                int32_t index = (y + dy) * width + (x + dx);
+                if (neighbour.isFlagged) {
+                    need -= 1;
+                } else if (not neighbour.isRevealed) {
+                    hiddenAround += 1;
+                    if (parent[index] == -2) {
+                        parent[index] = index;
+                    }
+                    if (first < 0) {
+                        first = index;
+                    } else {
+                        int32_t a = find(first);
+                        int32_t b = find(index);
+                        parent[std::max(a, b)] = std::min(a, b);
+                    }
+                }
+            }
+            if (need < 0 or need > hiddenAround) {
+                return false;
+            }
+            if (hiddenAround > 0) {
+                numbers.emplace_back(y * width + x, need);
+            }
+        }
+    }
+
+    std::vector<int32_t> componentOf(cellCount, -1);
+    for (int32_t index: hidden) {
+        if (parent[index] == -2) {
+            interior.push_back(index);
+            continue;
+        }
+        int32_t root = find(index);
+        if (componentOf[root] < 0) {
+            componentOf[root] = static_cast<int32_t>(components.size());
+            components.emplace_back();
+        }
+        components[componentOf[root]].cells.push_back(index);
+    }
+    std::vector<std::vector<std::pair<int32_t, int32_t>>> componentNumbers(components.size());
+    for (const auto &number: numbers) {
+        int32_t x = number.first % width;
+        int32_t y = number.first / width;
+        for (const auto [dx, dy]: NEIGHBOURS) {
+            int32_t index = (y + dy) * width + (x + dx);
+            if (isInBounds(width, height, x + dx, y + dy) and parent[index] >= 0) {
+                componentNumbers[componentOf[find(index)]].push_back(number);
+                break;
+            }
+        }
+    }
+
+    std::vector<int32_t> localId(cellCount, -1);
+    for (size_t c = 0; c < components.size(); c++) {
+        LayoutComponent &component = components[c];
+        auto size = static_cast<int32_t>(component.cells.size());
+        Enumeration enumeration;
+        enumeration.size = size;
+        enumeration.words = (size + 63) / 64;
+        enumeration.cellConstraints.resize(size);
+
+        // Members of each number, then a breadth-first order over cells sharing numbers
+        std::vector<std::vector<int32_t>> members(componentNumbers[c].size());
+        for (int32_t i = 0; i < size; i++) {
+            localId[component.cells[i]] = i;
+        }
+        for (size_t n = 0; n < componentNumbers[c].size(); n++) {
+            int32_t x = componentNumbers[c][n].first % width;
+            int32_t y = componentNumbers[c][n].first / width;
+            for (const auto [dx, dy]: NEIGHBOURS) {
+                int32_t index = (y + dy) * width + (x + dx);
+                if (isInBounds(width, height, x + dx, y + dy) and parent[index] >= 0) {
+                    members[n].push_back(localId[index]);
+                    enumeration.cellConstraints[localId[index]].push_back(static_cast<int32_t>(n));
+                }
+            }
+        }
+        std::vector<int32_t> order;
+        std::vector<bool> isQueued(size, false);
+        order.push_back(0);
+        isQueued[0] = true;
+        for (size_t head = 0; head < order.size(); head++) {
+            for (int32_t n: enumeration.cellConstraints[order[head]]) {
+                for (int32_t member: members[n]) {
+                    if (not isQueued[member]) {
+                        isQueued[member] = true;
+                        order.push_back(member);
+                    }
+                }
+            }
+        }
+        std::vector<int32_t> orderedCells(size);
+        std::vector<int32_t> position(size);
+        for (int32_t i = 0; i < size; i++) {
+            orderedCells[i] = component.cells[order[i]];
+            position[order[i]] = i;
+        }
+        component.cells = std::move(orderedCells);
+        for (auto &cellConstraints: enumeration.cellConstraints) {
+            cellConstraints.clear();
+        }
+        for (size_t n = 0; n < members.size(); n++) {
+            for (int32_t member: members[n]) {
+                enumeration.cellConstraints[position[member]].push_back(static_cast<int32_t>(n));
+            }
+            enumeration.constraints.push_back(Constraint{
+                    componentNumbers[c][n].second, 0, static_cast<int32_t>(members[n].size())});
+        }
+        if (not enumerateLayouts(component, enumeration)) {
+            return false;
+        }
+    }
+
+    // Frontier mine totals, one component at a time
+    ways.push_back({1.0});
+    for (const LayoutComponent &component: components) {
+        const std::vector<double> &previous = ways.back();
+        std::vector<double> next(previous.size() + component.cells.size(), 0.0);
+        for (size_t t = 0; t < previous.size(); t++) {
+            for (size_t k = 0; k + 1 < component.countStart.size(); k++) {
+                auto layouts = static_cast<double>(component.countStart[k + 1] -
+                                                   component.countStart[k]);
+                next[t + k] += previous[t] * layouts;
+            }
+        }
+        normalize(next);
+        ways.push_back(std::move(next));
+    }
+    // Each frontier total leaves the rest of the mines to the interior, in as many ways as it
+    // has to choose their cells
+    const std::vector<double> &frontier = ways.back();
+    auto interiorCount = static_cast<int32_t>(interior.size());
+    std::vector<double> logWeights(frontier.size(), -std::numeric_limits<double>::infinity());
+    double largest = -std::numeric_limits<double>::infinity();
+    for (size_t t = 0; t < frontier.size(); t++) {
+        int32_t rest = minesLeft - static_cast<int32_t>(t);
+        if (frontier[t] > 0.0 and rest >= 0 and rest <= interiorCount) {
+            logWeights[t] = std::log(frontier[t]) + logChoose(interiorCount, rest);
+            largest = std::max(largest, logWeights[t]);
+        }
+    }
+    if (largest == -std::numeric_limits<double>::infinity()) {
+        return false;
+    }
+    totalWeights.resize(frontier.size());
+    for (size_t t = 0; t < frontier.size(); t++) {
+        totalWeights[t] = std::exp(logWeights[t] - largest);
+    }
+    computeProbabilities();
+    return true;
+}
+
+void LayoutSampler::computeProbabilities() {
+    // suffix[c]: weights of the components from c on holding t mines together
+    std::vector<std::vector<double>> suffix(components.size() + 1);
+    suffix[components.size()] = {1.0};
+    for (size_t c = components.size(); c-- > 0;) {
+        const LayoutComponent &component = components[c];
+        std::vector<double> counts(component.cells.size() + 1, 0.0);
+        for (size_t k = 0; k < counts.size(); k++) {
+            counts[k] = static_cast<double>(component.countStart[k + 1] - component.countStart[k]);
+        }
+        suffix[c] = convolve(counts, suffix[c + 1]);
+    }
+
+    // The interior's share of layouts for each frontier total, as in totalWeights
+    auto interiorCount = static_cast<int32_t>(interior.size());
+    std::vector<double> interiorWeights(totalWeights.size(), 0.0);
+    double expectedInterior = 0.0;
+    double total = 0.0;
+    for (size_t t = 0; t < totalWeights.size(); t++) {
+        int32_t rest = minesLeft - static_cast<int32_t>(t);
+        if (ways.back()[t] > 0.0) {
+            interiorWeights[t] = totalWeights[t] / ways.back()[t];
+        }
+        expectedInterior += totalWeights[t] * rest;
+        total += totalWeights[t];
+    }
+    for (int32_t index: interior) {
+        probability[index] = expectedInterior / total / interiorCount;
+    }
+
+    for (size_t c = 0; c < components.size(); c++) {
+        const LayoutComponent &component = components[c];
+        auto size = static_cast<int32_t>(component.cells.size());
+        // Weight of the other components holding s mines, then of this one holding k
+        std::vector<double> others = convolve(ways[c], suffix[c + 1]);
+        std::vector<double> weights(size + 1, 0.0);
+        double weightTotal = 0.0;
+        for (int32_t k = 0; k <= size; k++) {
+            int64_t layouts = component.countStart[k + 1] - component.countStart[k];
+            if (layouts == 0) {
+                continue;
+            }
+            double sum = 0.0;
+            for (size_t s = 0; s < others.size() and s + k < interiorWeights.size(); s++) {
+                sum += others[s] * interiorWeights[s + k];
+            }
+            weights[k] = sum * static_cast<double>(layouts);
+            weightTotal += weights[k];
+        }
+        for (int32_t i = 0; i < size; i++) {
+            double p = 0.0;
+            for (int32_t k = 0; k <= size; k++) {
+                int64_t layouts = component.countStart[k + 1] - component.countStart[k];
+                if (layouts > 0) {
+                    p += weights[k] * static_cast<double>(
+                            component.mineTotals[static_cast<size_t>(k) * size + i]) /
+                         static_cast<double>(layouts);
+                }
+            }
+            probability[component.cells[i]] = weightTotal > 0.0 ? p / weightTotal : 0.0;
+        }
+    }
+}
+
+void LayoutSampler::sample(std::mt19937_64 &rng, std::vector<int32_t> &interior,
+                           std::vector<int32_t> &outMines) const {
+    outMines.clear();
+    auto total = pickWeighted(totalWeights.data(), static_cast<int32_t>(totalWeights.size()), rng);
+    int32_t frontierMines = total;
+    // Each component's count given the total left to the ones before it, last component first
+    std::vector<double> weights;
+    for (size_t c = components.size(); c-- > 0;) {
+        const LayoutComponent &component = components[c];
+        const std::vector<double> &before = ways[c];
+        auto size = static_cast<int32_t>(component.cells.size());
+        weights.assign(size + 1, 0.0);
+        for (int32_t k = 0; k <= size and k <= total; k++) {
+            if (total - k < static_cast<int32_t>(before.size())) {
+                weights[k] = before[total - k] *
+                             static_cast<double>(component.countStart[k + 1] -
+                                                 component.countStart[k]);
+            }
+        }
+        int32_t k = pickWeighted(weights.data(), size + 1, rng);
+        total -= k;
+        int64_t layout = std::uniform_int_distribution<int64_t>(
+                component.countStart[k], component.countStart[k + 1] - 1)(rng);
+        const uint64_t *bits = component.layouts.data() + layout * component.words;
+        for (int32_t i = 0; i < size; i++) {
+            if (bits[i >> 6] >> (i & 63) & 1) {
+                outMines.push_back(component.cells[i]);
+            }
+        }
+    }
+    // The rest go anywhere in the interior: a partial shuffle picks them uniformly
+    auto interiorCount = static_cast<int32_t>(interior.size());
+    for (int32_t i = 0; i < minesLeft - frontierMines; i++) {
+        std::swap(interior[i], interior[std::uniform_int_distribution<int32_t>(
+                i, interiorCount - 1)(rng)]);
+        outMines.push_back(interior[i]);
+    }
+}
+
+double LayoutSampler::getMineProbability(int32_t index) const {
+    return probability[index];
+}
+
+const std::vector<int32_t> &LayoutSampler::getHidden() const {
+    return hidden;
+}
+
+const std::vector<int32_t> &LayoutSampler::getInterior() const {
+    return interior;
+}
+
+int32_t LayoutSampler::getFlagCount() const {
+    return flagCount;
+}
+
+HintEngine::HintEngine(TaskScheduler &scheduler) : scheduler(scheduler) {}
+
+bool HintEngine::findHint(const GameBoard &board, const HintConfig &config,
+                          HintResult &outResult) {
+    int64_t start = steadyNanos();
+    outResult = HintResult{};
+    outResult.move = Move{-1, -1, false};
+    int32_t width = board.getWidth();
+    if (board.state == STARTED) {
+        // The first reveal clears a safe zone around itself
+        outResult.move = Move{width / 2, board.getHeight() / 2, false};
+        outResult.isCertain = true;
+        return true;
+    }
+    if (board.state != ONGOING or not sampler.build(board)) {
+        return false;
+    }
+
+    // Safe cells need no search; neither do mines once nothing else is left
+    std::vector<HintCandidate> candidates;
+    std::mt19937_64 rng(config.seed);
+    for (int32_t index: sampler.getHidden()) {
+        double p = sampler.getMineProbability(index);
+        Move move{index % width, index / width, false};
+        if (p == 0.0) {
+            outResult.move = move;
+            outResult.isCertain = true;
+            outResult.elapsedNanos = steadyNanos() - start;
+            return true;
+        }
+        candidates.push_back(HintCandidate{move, p, 0, 0.0});
+    }
+    // Equally likely cells in random order, so the cut does not favour the top of the board
+    std::shuffle(candidates.begin(), candidates.end(), rng);
+    std::stable_sort(candidates.begin(), candidates.end(),
+                     [](const HintCandidate &a, const HintCandidate &b) {
+                         return a.mineProbability < b.mineProbability;
+                     });
+    if (candidates.front().mineProbability == 1.0) {
+        outResult.move = Move{candidates.front().move.x, candidates.front().move.y, true};
+        outResult.isCertain = true;
+        outResult.elapsedNanos = steadyNanos() - start;
+        return true;
+    }
+    while (not candidates.empty() and candidates.back().mineProbability == 1.0) {
+        candidates.pop_back();
+    }
+    candidates.resize(std::min(candidates.size(), static_cast<size_t>(config.maxCandidates)));
+    std::vector<int32_t> rootCells;
+    for (const HintCandidate &candidate: candidates) {
+        rootCells.push_back(candidate.move.y * width + candidate.move.x);
+    }
+
+    // The layouts are drawn onto a copy of the board with every hidden mine lifted and a mine
+    // under every flag, so nothing of the real layout is left to find. Cells that are mines in
+    // every layout are flagged up front, which leaves play nothing to settle at the root.
+    int32_t height = board.getHeight();
+    BoardFork base(board);
+    int32_t flagCount = sampler.getFlagCount();
+    for (int32_t y = 0; y < height; y++) {
+        for (int32_t x = 0; x < width; x++) {
+            const Cell &cell = board.getCell(x, y);
+            if (not cell.isRevealed) {
+                base.setMine(x, y, cell.isFlagged);
+            }
+        }
+    }
+    for (int32_t index: sampler.getHidden()) {
+        if (sampler.getMineProbability(index) == 1.0) {
+            base.setFlag(index % width, index / width, true);
+            flagCount += 1;
+        }
+    }
+    auto hiddenCount = static_cast<int32_t>(sampler.getHidden().size()) -
+                       (flagCount - sampler.getFlagCount());
+    std::vector<int32_t> frontier;
+    for (int32_t y = 0; y < height; y++) {
+        for (int32_t x = 0; x < width; x++) {
+            if (not base.getCell(x, y).isRevealed) {
+                continue;
+            }
+            bool isBordering = false;
+            for (const auto [dx, dy]: NEIGHBOURS) {
+                if (isInBounds(width, height, x + dx, y + dy)) {
+                    const Cell &neighbour = base.getCell(x + dx, y + dy);
+                    isBordering = isBordering or (not neighbour.isRevealed and
+                                                  not neighbour.isFlagged);
+                }
+            }
+            if (isBordering) {
+                frontier.push_back(y * width + x);
+            }
+        }
+    }
+
+    SearchShared shared{sampler, base, config, rootCells, frontier, flagCount, hiddenCount,
+                        start + config.budgetNanos};
+    std::vector<Task<WorkerResult>> tasks;
+    for (int32_t worker = 0; worker < scheduler.getThreadCount(); worker++) {
+        tasks.push_back(searchWorker(shared, deriveSeed(config.seed, worker)));
+    }
+    std::vector<WorkerResult> results = syncWait(whenAll(scheduler, std::move(tasks)));
+
+    int64_t rootVisits = 0;
+    std::vector<double> wins(candidates.size(), 0.0);
+    for (const WorkerResult &result: results) {
+        outResult.iterations += result.iterations;
+        outResult.nodes += result.nodes;
+        for (size_t i = 0; i < candidates.size(); i++) {
+            candidates[i].visits += result.root[i].visits;
+            wins[i] += result.root[i].wins;
+        }
+    }
+    for (size_t i = 0; i < candidates.size(); i++) {
+        rootVisits += candidates[i].visits;
+        candidates[i].winRate = candidates[i].visits == 0 ? 0.0 : wins[i] / candidates[i].visits;
+    }
+    // The least likely mine comes first before the sort, so it wins ties in visits
+    const Move leastLikely = candidates.front().move;
+    std::stable_sort(candidates.begin(), candidates.end(),
+                     [](const HintCandidate &a, const HintCandidate &b) {
+                         return a.visits > b.visits;
+                     });
+    const HintCandidate &best = candidates.front();
+    outResult.threads = static_cast<int32_t>(results.size());
+    if (rootVisits > 0) {
+        outResult.confidence = static_cast<double>(best.visits) / rootVisits;
+    }
+    outResult.winRateMargin = winRateMargin(best);
+    // The most visited move only where its win rate is clearly above the runner-up's; otherwise
+    // the search could not tell them apart, and the exact mine chance is the better guide
+    outResult.isSeparated = candidates.size() == 1 or
+                            best.winRate - outResult.winRateMargin >
+                            candidates[1].winRate + winRateMargin(candidates[1]);
+    outResult.move = outResult.isSeparated ? best.move : leastLikely;
+    outResult.candidates = std::move(candidates);
+    outResult.elapsedNanos = steadyNanos() - start;
+    return true;
+}
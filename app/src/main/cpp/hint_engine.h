@@ -0,0 +1,144 @@
+#ifndef MINESWEEPER_HINT_ENGINE_H
+#define MINESWEEPER_HINT_ENGINE_H
+
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "board_fork.h"
+#include "game_objects.h"
+#include "solver.h"
+#include "task_scheduler.h"
+
+// Budget of a hint asked for during play: one frame at 60 Hz.
+constexpr int64_t HINT_LIVE_BUDGET_NANOS = 16000000;
+
+// Budget of a position analysed after the game.
+constexpr int64_t HINT_ANALYSIS_BUDGET_NANOS = 2000000000;
+
+struct HintConfig {
+    int64_t budgetNanos = HINT_LIVE_BUDGET_NANOS;
+    // Guesses below the root the tree grows before rollouts take over.
+    int32_t maxDepth = 4;
+    // Moves searched per position, the least likely mines first.
+    int32_t maxCandidates = 12;
+    // Tree nodes each worker keeps. Past it, positions new to the tree are only rolled out.
+    int32_t maxNodes = 1 << 16;
+    // UCB1 exploration constant; rewards are 0 or 1.
+    double exploration = 0.5;
+    uint64_t seed = 1;
+};
+
+struct HintCandidate {
+    Move move;
+    // Chance the cell holds a mine, over every mine layout consistent with the board.
+    double mineProbability;
+    int64_t visits;
+    // Share of the visits that went on to clear the board.
+    double winRate;
+};
+
+struct HintResult {
+    // The cell to reveal.
+    Move move;
+    // The cell is safe in every consistent layout, so nothing was searched.
+    bool isCertain;
+    int64_t iterations;
+    // Tree nodes across all workers.
+    int64_t nodes;
+    int32_t threads;
+    int64_t elapsedNanos;
+    // Share of the root's visits that went to the most visited move: near 1 the search settled
+    // on it, near 1 / candidates it could not tell the moves apart.
+    double confidence;
+    // Half width of the 95% interval around the most visited move's win rate.
+    double winRateMargin;
+    // The most visited move's win rate interval lies above the runner-up's, and move is that
+    // move. Otherwise the search could not separate them and move is the least likely mine.
+    bool isSeparated;
+    // The moves searched, most visited first.
+    std::vector<HintCandidate> candidates;
+};
+
+// A frontier component: hidden cells linked by the numbers they border, with every mine layout
+// on them that satisfies those numbers, grouped by how many mines it places.
+struct LayoutComponent {
+    // Row-major cell indices.
+    std::vector<int32_t> cells;
+    // Bits per layout, one per cell, in words of 64.
+    int32_t words = 0;
+    std::vector<uint64_t> layouts;
+    // Layouts with k mines are [countStart[k], countStart[k + 1]).
+    std::vector<int64_t> countStart;
+    // mineTotals[k * cells.size() + i]: layouts with k mines that put one on cell i.
+    std::vector<int64_t> mineTotals;
+};
+
+// Draws mine layouts uniformly from all those consistent with what a board shows, the total mine
+// count included, with flags taken as mines. Each frontier component's layouts are enumerated
+// once; a draw then picks how many mines each component and the cells away from the numbers hold,
+// weighted by how many full layouts that split allows, and one layout per component.
+class LayoutSampler {
+public:
+    // Returns false if the board contradicts itself or a component has too many layouts to
+    // enumerate.
+    bool build(const GameBoard &board);
+
+    // Replaces outMines with the row-major indices of the hidden, unflagged cells that hold a mine
+    // in a random consistent layout. interior is the caller's copy of getInterior(), reordered by
+    // every draw.
+    void sample(std::mt19937_64 &rng, std::vector<int32_t> &interior,
+                std::vector<int32_t> &outMines) const;
+
+    // Chance a cell holds a mine, or -1 if it is revealed or flagged.
+    double getMineProbability(int32_t index) const;
+
+    // Hidden, unflagged cells.
+    const std::vector<int32_t> &getHidden() const;
+
+    // Hidden cells no number borders.
+    const std::vector<int32_t> &getInterior() const;
+
+    int32_t getFlagCount() const;
+
+private:
+    void computeProbabilities();
+
+    int32_t width = 0;
+    int32_t flagCount = 0;
+    // Mines among the hidden, unflagged cells.
+    int32_t minesLeft = 0;
+    std::vector<int32_t> hidden;
+    std::vector<int32_t> interior;
+    std::vector<LayoutComponent> components;
+    // ways[c][t]: weight of the first c components holding t mines together, each row scaled to
+    // a maximum of 1.
+    std::vector<std::vector<double>> ways;
+    // Weight of the frontier holding t mines, the interior's share of layouts included.
+    std::vector<double> totalWeights;
+    std::vector<double> probability;
+};
+
+// Picks the cell to reveal when no safe deduction exists, by Monte Carlo tree search over the
+// information the board shows. Every iteration draws a mine layout consistent with the board,
+// plays the tree's moves on a BoardFork of it and scores a win or a loss. Positions are nodes
+// keyed by their visible hash, so layouts that show the same thing share statistics, and after
+// every reveal the cells single-point deduction settles are played out. Past maxDepth guesses or
+// a position new to the tree, a rollout guesses the locally least likely mine to the end. Each of
+// the scheduler's workers searches a tree of its own until the budget runs out and the root
+// statistics are added up, so the hint comes back within one iteration of the budget. The most
+// visited move is the hint only if its win rate is clearly above the runner-up's, and the least
+// likely mine otherwise. A safe cell, when there is one, is returned at once.
+class HintEngine {
+public:
+    explicit HintEngine(TaskScheduler &scheduler = getEngineScheduler());
+
+    // Must not be called from one of the scheduler's workers. Returns false if the board is not
+    // in play or its layouts cannot be enumerated (see LayoutSampler::build).
+    bool findHint(const GameBoard &board, const HintConfig &config, HintResult &outResult);
+
+private:
+    TaskScheduler &scheduler;
+    LayoutSampler sampler;
+};
+
+#endif //MINESWEEPER_HINT_ENGINE_H
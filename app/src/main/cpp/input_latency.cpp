@@ -0,0 +1,159 @@
+#include "input_latency.h"
+#include <cstdio>
+
+InputLatencyTracker::InputLatencyTracker(const FrameClock &clock) : clock(clock) {}
+
+void InputLatencyTracker::onInputApplied(int64_t eventNanos, int64_t dequeueNanos) {
+    if (pendingCount == LATENCY_MAX_PENDING) {
+        dropped += 1;
+        return;
+    }
+    pending[pendingCount] = InputTimes{eventNanos, dequeueNanos, clock.nowNanos()};
+    pendingCount += 1;
+}
+
+int32_t InputLatencyTracker::beginFrame() {
+    if (pendingCount == 0) {
+        return -1;
+    }
+    int32_t id = nextFrameId;
+    nextFrameId = nextFrameId == INT32_MAX ? 0 : nextFrameId + 1;
+    FrameInFlight &frame = frames[id % LATENCY_FRAMES_IN_FLIGHT];
+    if (frame.id >= 0) {
+        // Its presentation time is long overdue
+        unpresented += frame.inputCount;
+        complete(frame, frame.swapEndNanos);
+    }
+    frame.id = id;
+    frame.startNanos = clock.nowNanos();
+    frame.swapStartNanos = frame.startNanos;
+    frame.swapEndNanos = frame.startNanos;
+    frame.inputCount = pendingCount;
+    for (int32_t i = 0; i < pendingCount; i++) {
+        frame.inputs[i] = pending[i];
+    }
+    pendingCount = 0;
+    return id;
+}
+
+void InputLatencyTracker::onSwapStarted(int32_t frame) {
+    if (FrameInFlight *inFlight = findFrame(frame)) {
+        inFlight->swapStartNanos = clock.nowNanos();
+    }
+}
+
+void InputLatencyTracker::onSwapFinished(int32_t frame, bool awaitPresent) {
+    if (FrameInFlight *inFlight = findFrame(frame)) {
+        inFlight->swapEndNanos = clock.nowNanos();
+        if (not awaitPresent) {
+            complete(*inFlight, inFlight->swapEndNanos);
+        }
+    }
+}
+
+void InputLatencyTracker::onPresented(int32_t frame, int64_t presentNanos) {
+    if (FrameInFlight *inFlight = findFrame(frame)) {
+        complete(*inFlight, presentNanos);
+    }
+}
+
+void InputLatencyTracker::onPresentUnknown(int32_t frame) {
+    if (FrameInFlight *inFlight = findFrame(frame)) {
+        unpresented += inFlight->inputCount;
+        complete(*inFlight, inFlight->swapEndNanos);
+    }
+}
+
+const LatencyHistogram &InputLatencyTracker::getHistogram(LatencyStage stage) const {
+    return histograms[static_cast<size_t>(stage)];
+}
+
+uint64_t InputLatencyTracker::getSamples() const {
+    return getHistogram(LatencyStage::TOTAL).getCount();
+}
+
+uint64_t InputLatencyTracker::getUnpresented() const {
+    return unpresented;
+}
+
+uint64_t InputLatencyTracker::getDropped() const {
+    return dropped;
+}
+
+int32_t InputLatencyTracker::format(char *buffer, size_t size) const {
+    size_t used = 0;
+    auto append = [&](int written) {
+        if (written > 0) {
+            used += static_cast<size_t>(written);
+        }
+    };
+    auto at = [&]() { return used < size ? buffer + used : nullptr; };
+    auto rest = [&]() { return used < size ? size - used : 0; };
+    append(std::snprintf(at(), rest(), "{\"samples\":%llu",
+                         static_cast<unsigned long long>(getSamples())));
+    for (int32_t stage = 0; stage < static_cast<int32_t>(LatencyStage::COUNT); stage++) {
+        const LatencyHistogram &histogram = histograms[stage];
+        append(std::snprintf(at(), rest(), ",\"%s_us\":[%llu,%llu,%llu]",
+                             latencyStageName(static_cast<LatencyStage>(stage)),
+                             static_cast<unsigned long long>(histogram.percentile(0.5) / 1000),
+                             static_cast<unsigned long long>(histogram.percentile(0.9) / 1000),
+                             static_cast<unsigned long long>(histogram.percentile(0.99) / 1000)));
+    }
+    append(std::snprintf(at(), rest(), "}"));
+    return static_cast<int32_t>(used);
+}
+
+void InputLatencyTracker::clear() {
+    for (LatencyHistogram &histogram: histograms) {
+        histogram.clear();
+    }
+    unpresented = 0;
+    dropped = 0;
+}
+
+InputLatencyTracker::FrameInFlight *InputLatencyTracker::findFrame(int32_t frame) {
+    if (frame < 0) {
+        return nullptr;
+    }
+    FrameInFlight &inFlight = frames[frame % LATENCY_FRAMES_IN_FLIGHT];
+    return inFlight.id == frame ? &inFlight : nullptr;
+}
+
+void InputLatencyTracker::complete(FrameInFlight &frame, int64_t presentNanos) {
+    for (int32_t i = 0; i < frame.inputCount; i++) {
+        const InputTimes &input = frame.inputs[i];
+        record(LatencyStage::INPUT_QUEUE, input.eventNanos, input.dequeueNanos);
+        record(LatencyStage::ENGINE, input.dequeueNanos, input.appliedNanos);
+        record(LatencyStage::FRAME_WAIT, input.appliedNanos, frame.startNanos);
+        record(LatencyStage::RENDER, frame.startNanos, frame.swapStartNanos);
+        record(LatencyStage::PRESENT, frame.swapStartNanos, presentNanos);
+        record(LatencyStage::TOTAL, input.eventNanos, presentNanos);
+    }
+    frame.id = -1;
+    frame.inputCount = 0;
+}
+
+void InputLatencyTracker::record(LatencyStage stage, int64_t from, int64_t to) {
+    // Input timestamps come from another process and may trail by a little
+    histograms[static_cast<size_t>(stage)].record(to > from ? static_cast<uint64_t>(to - from) : 0);
+}
+
+const char *latencyStageName(LatencyStage stage) {
+    switch (stage) {
+        case LatencyStage::INPUT_QUEUE:
+            return "queue";
+        case LatencyStage::ENGINE:
+            return "engine";
+        case LatencyStage::FRAME_WAIT:
+            return "wait";
+        case LatencyStage::RENDER:
+            return "render";
+        case LatencyStage::PRESENT:
+            return "present";
+        case LatencyStage::TOTAL:
+            return "total";
+        case LatencyStage::COUNT:
+            break;
+    }
+    return "unknown";
+}
@@ -0,0 +1,116 @@
+#ifndef MINESWEEPER_INPUT_LATENCY_H
+#define MINESWEEPER_INPUT_LATENCY_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include "frame_scheduler.h"
+#include "latency_histogram.h"
+
+// The stages between a touch and the photons showing its result, in order.
+enum class LatencyStage {
+    // From the touch to the render loop reading it from the input queue.
+    INPUT_QUEUE,
+    // Recognizing the gesture and applying it to the board or camera.
+    ENGINE,
+    // Waiting for the vsync of the frame that draws the change.
+    FRAME_WAIT,
+    // Drawing that frame, up to eglSwapBuffers.
+    RENDER,
+    // From eglSwapBuffers to the display showing the frame, or to eglSwapBuffers returning where
+    // the driver does not report presentation times.
+    PRESENT,
+    // Touch to photon, the sum of the stages above.
+    TOTAL,
+    COUNT
+};
+
+// Inputs applied but not yet drawn, and frames swapped but not yet known to be on screen. Inputs
+// beyond that are dropped from the measurement and counted; a frame still unpresented when
+// its slot is needed again completes at its swap.
+constexpr int32_t LATENCY_MAX_PENDING = 32;
+constexpr int32_t LATENCY_FRAMES_IN_FLIGHT = 8;
+
+// Follows each input that changed something visible, tagged with its event time, to the first
+// frame drawn after it was applied, and records every stage once that frame is on screen. All
+// times are on the clock's base, which on device is the monotonic clock of input events, vsync and
+// presentation timestamps alike.
+//
+// Not thread-safe; everything runs on the render thread.
+class InputLatencyTracker {
+public:
+    explicit InputLatencyTracker(const FrameClock &clock);
+
+    // An input that happened at eventNanos and was read from the queue at dequeueNanos has just
+    // been applied.
+    void onInputApplied(int64_t eventNanos, int64_t dequeueNanos);
+
+    // A frame starts drawing; it carries every input applied since the last one. Returns the id to
+    // pass to the calls below, or -1 if no input waits for it, which they ignore.
+    int32_t beginFrame();
+
+    // Just before eglSwapBuffers.
+    void onSwapStarted(int32_t frame);
+
+    // eglSwapBuffers returned. With awaitPresent the frame's inputs stay open until onPresented or
+    // onPresentUnknown, otherwise they complete now.
+    void onSwapFinished(int32_t frame, bool awaitPresent);
+
+    void onPresented(int32_t frame, int64_t presentNanos);
+
+    // The driver will not say when the frame was shown; its inputs complete at their swap.
+    void onPresentUnknown(int32_t frame);
+
+    const LatencyHistogram &getHistogram(LatencyStage stage) const;
+
+    // Inputs measured to the end.
+    uint64_t getSamples() const;
+
+    // Inputs whose presentation time never came, measured to their swap instead.
+    uint64_t getUnpresented() const;
+
+    // Inputs not measured because LATENCY_MAX_PENDING were already waiting.
+    uint64_t getDropped() const;
+
+    // Writes e.g. {"samples":200,"queue_us":[310,820,1900],...,"total_us":[21000,28000,33500]}
+    // with the p50, p90 and p99 of every stage, without a newline. Returns the length written,
+    // like snprintf.
+    int32_t format(char *buffer, size_t size) const;
+
+    void clear();
+
+private:
+    struct InputTimes {
+        int64_t eventNanos;
+        int64_t dequeueNanos;
+        int64_t appliedNanos;
+    };
+
+    struct FrameInFlight {
+        int32_t id = -1;
+        int64_t startNanos = 0;
+        int64_t swapStartNanos = 0;
+        int64_t swapEndNanos = 0;
+        int32_t inputCount = 0;
+        std::array<InputTimes, LATENCY_MAX_PENDING> inputs{};
+    };
+
+    FrameInFlight *findFrame(int32_t frame);
+
+    void complete(FrameInFlight &frame, int64_t presentNanos);
+
+    void record(LatencyStage stage, int64_t from, int64_t to);
+
+    const FrameClock &clock;
+    std::array<InputTimes, LATENCY_MAX_PENDING> pending{};
+    int32_t pendingCount = 0;
+    std::array<FrameInFlight, LATENCY_FRAMES_IN_FLIGHT> frames;
+    int32_t nextFrameId = 0;
+    std::array<LatencyHistogram, static_cast<size_t>(LatencyStage::COUNT)> histograms;
+    uint64_t unpresented = 0;
+    uint64_t dropped = 0;
+};
+
+const char *latencyStageName(LatencyStage stage);
+
+#endif //MINESWEEPER_INPUT_LATENCY_H
@@ -0,0 +1,100 @@
+#ifndef MINESWEEPER_LATENCY_HISTOGRAM_H
+#define MINESWEEPER_LATENCY_HISTOGRAM_H
+
+#include <array>
+#include <cstdint>
+
+// Fixed-memory log-linear histogram of nanosecond durations. Every power of two is split into
+// SUB_BUCKETS linear buckets, so the relative error of a reported value stays below
+// 1 / SUB_BUCKETS no matter how large the value is.
+class LatencyHistogram {
+public:
+    static constexpr int32_t SUB_BUCKET_BITS = 3;
+    static constexpr int32_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static constexpr int32_t MAGNITUDES = 64 - SUB_BUCKET_BITS;
+    static constexpr int32_t BUCKET_COUNT = (MAGNITUDES + 1) * SUB_BUCKETS;
+
+    void record(uint64_t nanos) {
+        buckets[bucketIndex(nanos)] += 1;
+        count += 1;
+        sum += nanos;
+        if (nanos > max) {
+            max = nanos;
+        }
+    }
+
+    void merge(const LatencyHistogram &other) {
+        for (int32_t i = 0; i < BUCKET_COUNT; i++) {
+            buckets[i] += other.buckets[i];
+        }
+        count += other.count;
+        sum += other.sum;
+        if (other.max > max) {
+            max = other.max;
+        }
+    }
+
+    void clear() {
+        buckets.fill(0);
+        count = 0;
+        sum = 0;
+        max = 0;
+    }
+
+    uint64_t getCount() const {
+        return count;
+    }
+
+    uint64_t getMax() const {
+        return max;
+    }
+
+    double getMean() const {
+        return count == 0 ? 0.0 : static_cast<double>(sum) / static_cast<double>(count);
+    }
+
+    // Returns the upper bound of the bucket holding the given quantile, clamped to the maximum
+    // recorded value. quantile is in [0, 1].
+    uint64_t percentile(double quantile) const {
+        if (count == 0) {
+            return 0;
+        }
+        auto rank = static_cast<uint64_t>(quantile * static_cast<double>(count - 1)) + 1;
+        uint64_t seen = 0;
+        for (int32_t i = 0; i < BUCKET_COUNT; i++) {
+            seen += buckets[i];
+            if (seen >= rank) {
+                uint64_t upper = bucketUpperBound(i);
+                return upper < max ? upper : max;
+            }
+        }
+        return max;
+    }
+
+    static int32_t bucketIndex(uint64_t nanos) {
+        if (nanos < SUB_BUCKETS) {
+            return static_cast<int32_t>(nanos);
+        }
+        int32_t magnitude = 63 - __builtin_clzll(nanos) - SUB_BUCKET_BITS + 1;
+        auto subBucket = static_cast<int32_t>(nanos >> (magnitude - 1)) - SUB_BUCKETS;
+        return magnitude * SUB_BUCKETS + subBucket;
+    }
+
+    static uint64_t bucketUpperBound(int32_t index) {
+        int32_t magnitude = index / SUB_BUCKETS;
+        int32_t subBucket = index % SUB_BUCKETS;
+        if (magnitude == 0) {
+            return static_cast<uint64_t>(subBucket);
+        }
+        uint64_t base = static_cast<uint64_t>(SUB_BUCKETS + subBucket) << (magnitude - 1);
+        return base + (uint64_t{1} << (magnitude - 1)) - 1;
+    }
+
+private:
+    std::array<uint64_t, BUCKET_COUNT> buckets{};
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint64_t max = 0;
+};
+
+#endif //MINESWEEPER_LATENCY_HISTOGRAM_H
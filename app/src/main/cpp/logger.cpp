@@ -0,0 +1,276 @@
+#include "logger.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+std::atomic<int32_t> runtimeLogLevel{LOG_LEVEL_INFO};
+
+namespace {
+
+// One thread's records. Only that thread writes head and fills slots; only the logging thread
+// writes tail.
+class LogRing {
+public:
+    explicit LogRing(uint32_t threadIndex) : threadIndex(threadIndex) {}
+
+    // The slot for the next record, or nullptr if the ring is full.
+    LogRecord *claim() {
+        uint64_t position = head.load(std::memory_order_relaxed);
+        if (position - tail.load(std::memory_order_acquire) >= LOG_RING_RECORDS) {
+            return nullptr;
+        }
+        return &records[position % LOG_RING_RECORDS];
+    }
+
+    // Hands the claimed slot to the logging thread.
+    void publish() {
+        head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Appends the published records to batch, leaving them in place until release().
+    void collect(std::vector<const LogRecord *> &batch) {
+        uint64_t end = head.load(std::memory_order_acquire);
+        collectedEnd = end;
+        for (uint64_t position = tail.load(std::memory_order_relaxed); position < end; position++) {
+            batch.push_back(&records[position % LOG_RING_RECORDS]);
+        }
+    }
+
+    // Frees the slots of the records collect() returned.
+    void release() {
+        tail.store(collectedEnd, std::memory_order_release);
+    }
+
+    bool isEmpty() const {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_relaxed);
+    }
+
+    const uint32_t threadIndex;
+    std::atomic<uint64_t> dropped{0};
+    // Set when the thread exits; the ring is freed once drained.
+    std::atomic<bool> isRetired{false};
+
+private:
+    std::array<LogRecord, LOG_RING_RECORDS> records;
+    // Apart, so the producer's and the consumer's counters do not share a cache line.
+    alignas(64) std::atomic<uint64_t> head{0};
+    alignas(64) std::atomic<uint64_t> tail{0};
+    uint64_t collectedEnd = 0;
+};
+
+struct LoggerState {
+    // Guards everything below except the atomics. Producers only take it the first time a thread
+    // logs.
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<std::unique_ptr<LogRing>> rings;
+    std::unique_ptr<LogSink> sink;
+    std::thread thread;
+    bool isRunning = false;
+    uint32_t nextThreadIndex = 0;
+    uint64_t retiredDropped = 0;
+    std::vector<const LogRecord *> batch;
+
+    std::atomic<bool> isDrainRequested{false};
+    std::atomic<uint64_t> written{0};
+};
+
+// Never destroyed, so threads still logging during static destruction find it intact.
+LoggerState &loggerState() {
+    static auto *state = new LoggerState();
+    return *state;
+}
+
+struct RingHandle {
+    LogRing *ring = nullptr;
+
+    ~RingHandle() {
+        if (ring != nullptr) {
+            ring->isRetired.store(true, std::memory_order_release);
+        }
+    }
+};
+
+thread_local RingHandle ringHandle;
+
+LogRing *threadRing() {
+    if (ringHandle.ring == nullptr) {
+        LoggerState &state = loggerState();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.rings.push_back(std::make_unique<LogRing>(state.nextThreadIndex++));
+        ringHandle.ring = state.rings.back().get();
+    }
+    return ringHandle.ring;
+}
+
+// Writes every published record to the sink, oldest first. Call with state.mutex held.
+void drainRings(LoggerState &state) {
+    state.batch.clear();
+    for (auto &ring: state.rings) {
+        ring->collect(state.batch);
+    }
+    // Each ring is in order already; merging them keeps records from different threads in the
+    // order they were logged.
+    std::stable_sort(state.batch.begin(), state.batch.end(),
+                     [](const LogRecord *a, const LogRecord *b) {
+                         return a->timeNanos < b->timeNanos;
+                     });
+    for (const LogRecord *record: state.batch) {
+        state.sink->write(*record);
+    }
+    if (not state.batch.empty()) {
+        state.sink->flush();
+        state.written.fetch_add(state.batch.size(), std::memory_order_relaxed);
+    }
+    for (auto &ring: state.rings) {
+        ring->release();
+    }
+    state.rings.erase(std::remove_if(state.rings.begin(), state.rings.end(),
+                                     [&state](const std::unique_ptr<LogRing> &ring) {
+                                         if (not ring->isRetired.load(std::memory_order_acquire) or
+                                             not ring->isEmpty()) {
+                                             return false;
+                                         }
+                                         state.retiredDropped += ring->dropped.load();
+                                         return true;
+                                     }),
+                      state.rings.end());
+}
+
+void runLogging(LoggerState &state) {
+    std::unique_lock<std::mutex> lock(state.mutex);
+    while (true) {
+        state.wake.wait_for(lock, std::chrono::milliseconds(LOG_DRAIN_MILLIS), [&state]() {
+            return not state.isRunning or state.isDrainRequested.load(std::memory_order_relaxed);
+        });
+        state.isDrainRequested.store(false, std::memory_order_relaxed);
+        drainRings(state);
+        if (not state.isRunning) {
+            return;
+        }
+    }
+}
+
+}
+
+FileLogSink::FileLogSink(FILE *file, bool ownsFile) : file(file), ownsFile(ownsFile) {}
+
+FileLogSink::~FileLogSink() {
+    if (ownsFile and file != nullptr) {
+        std::fclose(file);
+    }
+}
+
+void FileLogSink::write(const LogRecord &record) {
+    if (firstNanos < 0) {
+        firstNanos = record.timeNanos;
+    }
+    std::fprintf(file, "%10.6f %c t%u %.*s\n",
+                 static_cast<double>(record.timeNanos - firstNanos) / 1e9,
+                 logLevelLetter(record.level), record.threadIndex,
+                 static_cast<int>(record.length), record.text);
+}
+
+void FileLogSink::flush() {
+    std::fflush(file);
+}
+
+void startLogging(std::unique_ptr<LogSink> sink) {
+    stopLogging();
+    LoggerState &state = loggerState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.sink = std::move(sink);
+    state.isRunning = true;
+    state.thread = std::thread(runLogging, std::ref(state));
+}
+
+void stopLogging() {
+    LoggerState &state = loggerState();
+    std::thread thread;
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        if (not state.isRunning) {
+            return;
+        }
+        state.isRunning = false;
+        thread = std::move(state.thread);
+    }
+    state.wake.notify_one();
+    thread.join();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.sink.reset();
+}
+
+void requestLogDrain() {
+    LoggerState &state = loggerState();
+    // No lock: a wake that races with the logging thread going back to sleep is at worst
+    // LOG_DRAIN_MILLIS late.
+    state.isDrainRequested.store(true, std::memory_order_relaxed);
+    state.wake.notify_one();
+}
+
+void setLogLevel(LogLevel level) {
+    runtimeLogLevel.store(level, std::memory_order_relaxed);
+}
+
+LogLevel getLogLevel() {
+    return static_cast<LogLevel>(runtimeLogLevel.load(std::memory_order_relaxed));
+}
+
+void logMessage(LogLevel level, const char *format, ...) {
+    LogRing *ring = threadRing();
+    LogRecord *record = ring->claim();
+    if (record == nullptr) {
+        ring->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    record->timeNanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    record->threadIndex = ring->threadIndex;
+    record->level = level;
+    va_list arguments;
+    va_start(arguments, format);
+    int length = std::vsnprintf(record->text, LOG_TEXT_BYTES, format, arguments);
+    va_end(arguments);
+    record->length = static_cast<uint32_t>(std::min<int64_t>(std::max(length, 0),
+                                                             LOG_TEXT_BYTES - 1));
+    ring->publish();
+    if (level >= LOG_LEVEL_WARN) {
+        requestLogDrain();
+    }
+}
+
+LogStats getLogStats() {
+    LoggerState &state = loggerState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    LogStats stats;
+    stats.written = state.written.load(std::memory_order_relaxed);
+    stats.dropped = state.retiredDropped;
+    for (const auto &ring: state.rings) {
+        stats.dropped += ring->dropped.load(std::memory_order_relaxed);
+    }
+    return stats;
+}
+
+char logLevelLetter(LogLevel level) {
+    switch (level) {
+        case LOG_LEVEL_VERBOSE:
+            return 'V';
+        case LOG_LEVEL_DEBUG:
+            return 'D';
+        case LOG_LEVEL_INFO:
+            return 'I';
+        case LOG_LEVEL_WARN:
+            return 'W';
+        case LOG_LEVEL_ERROR:
+            return 'E';
+        case LOG_LEVEL_SILENT:
+            break;
+    }
+    return '?';
+}
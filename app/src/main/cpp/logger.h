@@ -0,0 +1,131 @@
+#ifndef MINESWEEPER_LOGGER_H
+#define MINESWEEPER_LOGGER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+
+enum LogLevel : int32_t {
+    LOG_LEVEL_VERBOSE = 0,
+    LOG_LEVEL_DEBUG = 1,
+    LOG_LEVEL_INFO = 2,
+    LOG_LEVEL_WARN = 3,
+    LOG_LEVEL_ERROR = 4,
+    // Only as a threshold: nothing is logged.
+    LOG_LEVEL_SILENT = 5
+};
+
+// Calls below this level are compiled out, arguments and all. Release builds keep debug calls by
+// default, so diagnostics can be switched on at run time with setLogLevel without a new build.
+#ifndef MINESWEEPER_MIN_LOG_LEVEL
+#define MINESWEEPER_MIN_LOG_LEVEL 1
+#endif
+
+// printf-style logging. A call checks its level twice: against MINESWEEPER_MIN_LOG_LEVEL, which
+// the compiler folds away, then against the run time level with one relaxed load. Only then is the
+// message formatted, straight into the calling thread's ring buffer.
+#define MINESWEEPER_LOG(level, ...) \
+    do { \
+        if ((level) >= MINESWEEPER_MIN_LOG_LEVEL and isLogLevelEnabled(level)) { \
+            logMessage((level), __VA_ARGS__); \
+        } \
+    } while (false)
+
+#define LOGV(...) MINESWEEPER_LOG(LOG_LEVEL_VERBOSE, __VA_ARGS__)
+#define LOGD(...) MINESWEEPER_LOG(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define LOGI(...) MINESWEEPER_LOG(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOGW(...) MINESWEEPER_LOG(LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOGE(...) MINESWEEPER_LOG(LOG_LEVEL_ERROR, __VA_ARGS__)
+
+// Longer messages are cut to fit; LogRecord is a fixed 256 bytes.
+constexpr size_t LOG_TEXT_BYTES = 232;
+
+struct LogRecord {
+    int64_t timeNanos;
+    // Small per-thread number, in the order threads first logged.
+    uint32_t threadIndex;
+    LogLevel level;
+    uint32_t length;
+    char text[LOG_TEXT_BYTES];
+};
+
+static_assert(sizeof(LogRecord) == 256, "LogRecord is sized to whole cache lines");
+
+// Where records end up. Called only from the logging thread, in timestamp order per drain.
+class LogSink {
+public:
+    virtual ~LogSink() = default;
+
+    virtual void write(const LogRecord &record) = 0;
+
+    // Called once a drain has been written, e.g. to flush a file.
+    virtual void flush() {}
+};
+
+// Writes one line per record to a stdio stream: seconds since the first record, level letter,
+// thread index and text.
+class FileLogSink : public LogSink {
+public:
+    // The sink closes file on destruction only if it owns it, so it can wrap stderr.
+    explicit FileLogSink(FILE *file, bool ownsFile = false);
+
+    ~FileLogSink() override;
+
+    void write(const LogRecord &record) override;
+
+    void flush() override;
+
+private:
+    FILE *file;
+    bool ownsFile;
+    int64_t firstNanos = -1;
+};
+
+struct LogStats {
+    // Records handed to the sink.
+    uint64_t written = 0;
+    // Records lost because a thread's ring was full. Logging never waits for room.
+    uint64_t dropped = 0;
+};
+
+// Each logging thread gets its own single-producer ring of LOG_RING_RECORDS records the first time
+// it logs; only that first call takes a lock. A background thread drains every ring into the sink
+// every LOG_DRAIN_MILLIS, or sooner after a warning or error.
+constexpr size_t LOG_RING_RECORDS = 128;
+constexpr int32_t LOG_DRAIN_MILLIS = 20;
+
+// Starts the logging thread with sink, replacing any earlier one. Records logged before this wait
+// in their rings, as far as they fit.
+void startLogging(std::unique_ptr<LogSink> sink);
+
+// Drains every ring into the sink, then stops the logging thread and releases the sink.
+void stopLogging();
+
+// Asks the logging thread to drain now, without waiting for it.
+void requestLogDrain();
+
+// The run time level, LOG_LEVEL_INFO until set. Read through isLogLevelEnabled.
+extern std::atomic<int32_t> runtimeLogLevel;
+
+void setLogLevel(LogLevel level);
+
+LogLevel getLogLevel();
+
+inline bool isLogLevelEnabled(LogLevel level) {
+    return level >= runtimeLogLevel.load(std::memory_order_relaxed);
+}
+
+// Use the LOG macros instead, which skip disabled levels without formatting.
+void logMessage(LogLevel level, const char *format, ...)
+#if defined(__GNUC__)
+__attribute__((format(printf, 2, 3)))
+#endif
+;
+
+LogStats getLogStats();
+
+char logLevelLetter(LogLevel level);
+
+#endif //MINESWEEPER_LOGGER_H
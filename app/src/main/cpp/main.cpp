@@ -1,7 +1,15 @@
 #include <jni.h>
+#include <android/choreographer.h>
+#include <sys/system_properties.h>
+#include <algorithm>
+#include <cstdlib>
+#include <mutex>
 
 #include "AndroidOut.h"
+#include "logger.h"
 #include "Renderer.h"
+#include "frame_scheduler.h"
+#include "native-lib.h"
 
 #include <game-activity/GameActivity.cpp>
 #include <game-text-input/gametextinput.cpp>
@@ -10,6 +18,45 @@ extern "C" {
 
 #include <game-activity/native_app_glue/android_native_app_glue.c>
 
+/*!
+ * Decides when frames are drawn. Only touched from the native app thread.
+ */
+static SteadyFrameClock frameClock;
+static FrameScheduler frameScheduler(frameClock);
+
+/*!
+ * Whether the app is between APP_CMD_RESUME and APP_CMD_PAUSE. Frames are only drawn while it is
+ * resumed and has a window.
+ */
+static bool isResumed = false;
+
+/*!
+ * Recomputes whether the scheduler may draw after the window or lifecycle changed
+ * @param pApp the app the state belongs to
+ */
+static void updateSchedulerActive(android_app *pApp) {
+    frameScheduler.setActive(isResumed && pApp->userData != nullptr);
+}
+
+/*!
+ * Choreographer callback, called on the native app thread from inside ALooper_pollOnce once per
+ * requested vsync
+ * @param frameTimeNanos the vsync time the frame will be shown for
+ * @param data the android_app
+ */
+static void onVsync(int64_t frameTimeNanos, void *data) {
+    auto *pApp = reinterpret_cast<android_app *>(data);
+    if (!frameScheduler.onVsync(frameTimeNanos) || !pApp->userData) {
+        return;
+    }
+    auto *pRenderer = reinterpret_cast<Renderer *>(pApp->userData);
+    pRenderer->render();
+    // a reveal too large for one frame continues on the next vsync
+    if (pRenderer->isAnimating()) {
+        frameScheduler.invalidate(FRAME_ANIMATION);
+    }
+}
+
 /*!
  * Handles commands sent to this Android application
  * @param pApp the app the commands are coming from
@@ -23,6 +70,8 @@ void handle_cmd(android_app *pApp, int32_t cmd) {
             // if you change the class here as a reinterpret_cast is dangerous this in the
             // android_main function and the APP_CMD_TERM_WINDOW handler case.
             pApp->userData = new Renderer(pApp);
+            frameScheduler.invalidate(FRAME_SURFACE);
+            updateSchedulerActive(pApp);
             break;
         case APP_CMD_TERM_WINDOW:
             // The window is being destroyed. Use this to clean up your userData to avoid leaking
@@ -35,6 +84,24 @@ void handle_cmd(android_app *pApp, int32_t cmd) {
                 pApp->userData = nullptr;
                 delete pRenderer;
             }
+            updateSchedulerActive(pApp);
+            break;
+        case APP_CMD_WINDOW_RESIZED:
+        case APP_CMD_WINDOW_REDRAW_NEEDED:
+        case APP_CMD_CONTENT_RECT_CHANGED:
+        case APP_CMD_CONFIG_CHANGED:
+        case APP_CMD_WINDOW_INSETS_CHANGED:
+            // Nothing else tells a blocked loop that the surface changed, so redraw on all of these
+            frameScheduler.invalidate(FRAME_SURFACE);
+            break;
+        case APP_CMD_RESUME:
+            isResumed = true;
+            frameScheduler.invalidate(FRAME_SURFACE);
+            updateSchedulerActive(pApp);
+            break;
+        case APP_CMD_PAUSE:
+            isResumed = false;
+            updateSchedulerActive(pApp);
             break;
         default:
             break;
@@ -56,12 +123,31 @@ bool motion_event_filter_func(const GameActivityMotionEvent *motionEvent) {
             sourceClass == AINPUT_SOURCE_CLASS_JOYSTICK);
 }
 
+/*!
+ * Reads the log level from the debug.minesweeper.loglevel system property, 0 for verbose through 5
+ * for silent. Without the property only info and above are logged.
+ */
+static LogLevel readLogLevelProperty() {
+    char value[PROP_VALUE_MAX] = {};
+    if (__system_property_get("debug.minesweeper.loglevel", value) <= 0) {
+        return LOG_LEVEL_INFO;
+    }
+    int level = std::atoi(value);
+    return static_cast<LogLevel>(std::clamp(level, int(LOG_LEVEL_VERBOSE), int(LOG_LEVEL_SILENT)));
+}
+
 /*!
  * This the main entry point for a native activity
  */
 void android_main(struct android_app *pApp) {
+    // Records are formatted on the calling thread and written to logcat from a logging thread, so
+    // logging never blocks a frame. Raise the level for a debugging session without a new build:
+    //   adb shell setprop debug.minesweeper.loglevel 1
+    startLogging(std::make_unique<AndroidOut>("AO"));
+    setLogLevel(readLogLevelProperty());
+
     // Can be removed, useful to ensure your code is running
-    aout << "Welcome to android_main" << std::endl;
+    LOGI("Welcome to android_main");
 
     // Register an event handler for Android events
     pApp->onAppCmd = handle_cmd;
@@ -71,17 +157,26 @@ void android_main(struct android_app *pApp) {
     // implemented in android_native_app_glue.c.
     android_app_set_motion_event_filter(pApp, motion_event_filter_func);
 
-    // This sets up a typical game/event loop. It will run until the app is destroyed.
+    // Board changes from the UI thread wake the looper below
+    {
+        std::lock_guard<std::mutex> lock(gameBoardMutex);
+        renderLooper = pApp->looper;
+    }
+    AChoreographer *pChoreographer = AChoreographer_getInstance();
+
+    // This sets up an event driven game loop. It blocks until something happens: input, an app
+    // command, a board change from the UI thread or a requested vsync. Frames are drawn from the
+    // vsync callback and only when something changed, so a static board uses no CPU.
     do {
-        // Process all pending events before running game logic.
+        // Block for the first event, then process everything else that is pending.
+        int timeout = -1;
         bool done = false;
         while (!done) {
-            // 0 is non-blocking.
-            int timeout = 0;
             int events;
             android_poll_source *pSource;
             int result = ALooper_pollOnce(timeout, nullptr, &events,
                                           reinterpret_cast<void**>(&pSource));
+            timeout = 0;
             switch (result) {
                 case ALOOPER_POLL_TIMEOUT:
                     [[clang::fallthrough]];
@@ -90,9 +185,10 @@ void android_main(struct android_app *pApp) {
                     done = true;
                     break;
                 case ALOOPER_EVENT_ERROR:
-                    aout << "ALooper_pollOnce returned an error" << std::endl;
+                    LOGE("ALooper_pollOnce returned an error");
                     break;
                 case ALOOPER_POLL_CALLBACK:
+                    // a vsync callback ran
                     break;
                 default:
                     if (pSource) {
@@ -108,11 +204,30 @@ void android_main(struct android_app *pApp) {
             auto *pRenderer = reinterpret_cast<Renderer *>(pApp->userData);
 
             // Process game input
-            pRenderer->handleInput();
+            if (pRenderer->handleInput()) {
+                frameScheduler.invalidate(FRAME_INPUT);
+            }
+            if (pRenderer->hasBoardChanged()) {
+                frameScheduler.invalidate(FRAME_BOARD);
+            }
+            // the cell atlas loader wakes the loop when the atlas is ready to upload
+            if (pRenderer->isAnimating()) {
+                frameScheduler.invalidate(FRAME_ANIMATION);
+            }
+        }
 
-            // Render a frame
-            pRenderer->render();
+        // Draw on the next vsync if anything changed
+        if (frameScheduler.wantsVsync()) {
+            AChoreographer_postFrameCallback64(pChoreographer, onVsync, pApp);
+            frameScheduler.onVsyncPosted();
         }
     } while (!pApp->destroyRequested);
+
+    {
+        std::lock_guard<std::mutex> lock(gameBoardMutex);
+        renderLooper = nullptr;
+    }
+    // Write out whatever is still queued before the process can go away
+    stopLogging();
 }
 }
\ No newline at end of file
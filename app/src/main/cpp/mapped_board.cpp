@@ -0,0 +1,458 @@
+#include "mapped_board.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <random>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "seeding.h"
+
+namespace {
+
+constexpr char MAPPED_BOARD_MAGIC[8] = {'M', 'S', 'B', 'O', 'A', 'R', 'D', '\0'};
+
+constexpr uint8_t COUNT_MASK = 0x0f;
+constexpr uint8_t MINE_BIT = 0x10;
+constexpr uint8_t REVEALED_BIT = 0x20;
+constexpr uint8_t FLAGGED_BIT = 0x40;
+
+// msync and madvise want whole pages, which may be larger than a tile, e.g. on 16 KB page devices.
+void pageRange(uint8_t *begin, uint8_t *end, uint8_t *&outBegin, size_t &outBytes) {
+    static const auto pageBytes = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+    auto first = reinterpret_cast<uintptr_t>(begin) & ~(pageBytes - 1);
+    auto last = (reinterpret_cast<uintptr_t>(end) + pageBytes - 1) & ~(pageBytes - 1);
+    outBegin = reinterpret_cast<uint8_t *>(first);
+    outBytes = last - first;
+}
+
+}
+
+MappedBoard::~MappedBoard() {
+    close();
+}
+
+bool MappedBoard::create(const std::string &path, int32_t width, int32_t height,
+                         int64_t mineCount, uint64_t seed, SafeZone safeZone) {
+    close();
+    if (width <= 0 or height <= 0 or mineCount < 0) {
+        return false;
+    }
+    int fileDescriptor = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fileDescriptor < 0) {
+        return false;
+    }
+    // The file starts sparse: all zero bytes are hidden cells without mines, and generateMines
+    // only writes the cells it has to
+    int64_t bytes = getFileBytes(width, height);
+    if (ftruncate(fileDescriptor, static_cast<off_t>(bytes)) != 0 or
+        not map(fileDescriptor, bytes)) {
+        ::close(fileDescriptor);
+        return false;
+    }
+    std::memcpy(header->magic, MAPPED_BOARD_MAGIC, sizeof(MAPPED_BOARD_MAGIC));
+    header->version = MAPPED_BOARD_VERSION;
+    header->width = width;
+    header->height = height;
+    header->safeZone = safeZone;
+    header->mineCount = std::min(mineCount, static_cast<int64_t>(width) * height);
+    header->seed = seed;
+    header->state = STARTED;
+    header->minesPlaced = 0;
+    header->flaggedMines = 0;
+    header->revealedCells = 0;
+    tileColumns = (width + MAPPED_TILE_CELLS - 1) / MAPPED_TILE_CELLS;
+    tileRows = (height + MAPPED_TILE_CELLS - 1) / MAPPED_TILE_CELLS;
+    dirtyTiles.assign((static_cast<size_t>(tileColumns) * tileRows + 63) / 64, 0);
+    return true;
+}
+
+bool MappedBoard::open(const std::string &path) {
+    close();
+    int fileDescriptor = ::open(path.c_str(), O_RDWR);
+    if (fileDescriptor < 0) {
+        return false;
+    }
+    struct stat status{};
+    Header fileHeader{};
+    if (fstat(fileDescriptor, &status) != 0 or
+        pread(fileDescriptor, &fileHeader, sizeof(fileHeader), 0) !=
+        static_cast<ssize_t>(sizeof(fileHeader)) or
+        std::memcmp(fileHeader.magic, MAPPED_BOARD_MAGIC, sizeof(MAPPED_BOARD_MAGIC)) != 0 or
+        fileHeader.version != MAPPED_BOARD_VERSION or fileHeader.width <= 0 or
+        fileHeader.height <= 0 or
+        status.st_size != getFileBytes(fileHeader.width, fileHeader.height) or
+        not map(fileDescriptor, status.st_size)) {
+        ::close(fileDescriptor);
+        return false;
+    }
+    tileColumns = (header->width + MAPPED_TILE_CELLS - 1) / MAPPED_TILE_CELLS;
+    tileRows = (header->height + MAPPED_TILE_CELLS - 1) / MAPPED_TILE_CELLS;
+    dirtyTiles.assign((static_cast<size_t>(tileColumns) * tileRows + 63) / 64, 0);
+    adviseBands(0, tileRows, MADV_RANDOM);
+    return true;
+}
+
+void MappedBoard::close() {
+    if (mapping == nullptr) {
+        return;
+    }
+    flush();
+    munmap(mapping, mappingBytes);
+    mapping = nullptr;
+    mappingBytes = 0;
+    header = nullptr;
+    tiles = nullptr;
+    tileColumns = 0;
+    tileRows = 0;
+    dirtyTiles.clear();
+}
+
+bool MappedBoard::isOpen() const {
+    return mapping != nullptr;
+}
+
+void MappedBoard::generateMines() {
+    if (header->minesPlaced) {
+        return;
+    }
+    adviseBands(0, tileRows, MADV_SEQUENTIAL);
+    // Selection sampling: each cell in file order becomes a mine with probability mines left over
+    // cells left, which gives exactly mineCount mines, every layout equally likely
+    int64_t cellsLeft = static_cast<int64_t>(header->width) * header->height;
+    int64_t minesLeft = header->mineCount;
+    std::mt19937_64 g(header->seed);
+    // A band's counts need the mines of the bands on either side, so the mines run one band ahead
+    for (int32_t tileRow = 0; tileRow <= tileRows; tileRow++) {
+        for (int32_t tileColumn = 0; tileRow < tileRows and tileColumn < tileColumns;
+             tileColumn++) {
+            int32_t firstX = tileColumn * MAPPED_TILE_CELLS;
+            int32_t firstY = tileRow * MAPPED_TILE_CELLS;
+            int32_t lastX = std::min(firstX + MAPPED_TILE_CELLS, header->width);
+            int32_t lastY = std::min(firstY + MAPPED_TILE_CELLS, header->height);
+            for (int32_t y = firstY; y < lastY and minesLeft > 0; y++) {
+                for (int32_t x = firstX; x < lastX; x++) {
+                    // A uniform double in [0, 1) scaled, rather than an integer draw below
+                    // cellsLeft, which would divide for every cell
+                    double draw = static_cast<double>(g() >> 11) * 0x1.0p-53;
+                    if (draw * static_cast<double>(cellsLeft) < static_cast<double>(minesLeft)) {
+                        *cellAt(x, y) |= MINE_BIT;
+                        minesLeft -= 1;
+                    }
+                    cellsLeft -= 1;
+                }
+            }
+        }
+        if (tileRow >= 1) {
+            countBand(tileRow - 1);
+        }
+        if (tileRow >= 2) {
+            // Dirty pages dropped from a shared mapping stay dirty in the page cache
+            adviseBands(tileRow - 2, tileRow - 1, MADV_DONTNEED);
+        }
+    }
+    adviseBands(std::max(tileRows - 2, 0), tileRows, MADV_DONTNEED);
+    std::fill(dirtyTiles.begin(), dirtyTiles.end(), ~uint64_t{0});
+    header->minesPlaced = 1;
+    adviseBands(0, tileRows, MADV_RANDOM);
+}
+
+void MappedBoard::initializeBoard(int32_t firstClickX, int32_t firstClickY) {
+    generateMines();
+    int64_t cells = static_cast<int64_t>(header->width) * header->height;
+    // A 3x3 safe zone can leave too few free cells on dense boards; fall back to only the
+    // clicked cell in that case.
+    auto zone = static_cast<SafeZone>(header->safeZone);
+    int32_t zoneRadius = zone == SAFE_AREA ? 1 : 0;
+    auto zoneCells = [&]() {
+        int64_t zoneWidth = std::min(firstClickX + zoneRadius, header->width - 1) -
+                            std::max(firstClickX - zoneRadius, 0) + 1;
+        int64_t zoneHeight = std::min(firstClickY + zoneRadius, header->height - 1) -
+                             std::max(firstClickY - zoneRadius, 0) + 1;
+        return zoneWidth * zoneHeight;
+    };
+    if (zoneRadius == 1 and cells - zoneCells() < header->mineCount) {
+        zoneRadius = 0;
+    }
+    auto isInZone = [&](int64_t x, int64_t y) {
+        return std::abs(x - firstClickX) <= zoneRadius and std::abs(y - firstClickY) <= zoneRadius;
+    };
+    int64_t zoneMines = 0;
+    for (int32_t y = firstClickY - zoneRadius; y <= firstClickY + zoneRadius; y++) {
+        for (int32_t x = firstClickX - zoneRadius; x <= firstClickX + zoneRadius; x++) {
+            zoneMines += isInBounds(x, y) and (*cellAt(x, y) & MINE_BIT) ? 1 : 0;
+        }
+    }
+    // Free cells outside the zone, where the zone's mines may go
+    int64_t freeCells = cells - zoneCells() - (header->mineCount - zoneMines);
+    // Rejection sampling over the whole board: the mines were placed uniformly, so moving those in
+    // the zone to uniform free cells outside it leaves a uniform layout of the cells outside it
+    uint64_t draws = 0;
+    for (int32_t y = firstClickY - zoneRadius; y <= firstClickY + zoneRadius; y++) {
+        for (int32_t x = firstClickX - zoneRadius; x <= firstClickX + zoneRadius; x++) {
+            if (not isInBounds(x, y) or not (*cellAt(x, y) & MINE_BIT) or freeCells <= 0) {
+                continue;
+            }
+            while (true) {
+                auto cell = static_cast<int64_t>(deriveSeed(header->seed, draws++) %
+                                                 static_cast<uint64_t>(cells));
+                int64_t toX = cell % header->width;
+                int64_t toY = cell / header->width;
+                if (isInZone(toX, toY) or (*cellAt(toX, toY) & MINE_BIT)) {
+                    continue;
+                }
+                moveMine(x, y, static_cast<int32_t>(toX), static_cast<int32_t>(toY));
+                freeCells -= 1;
+                break;
+            }
+        }
+    }
+    header->state = ONGOING;
+}
+
+int64_t MappedBoard::revealCell(int32_t x, int32_t y) {
+    const std::pair<int32_t, int32_t> DELTA2[4] = {{0,  1},
+                                                   {0,  -1},
+                                                   {1,  0},
+                                                   {-1, 0}};
+
+    uint8_t &first = *cellAt(x, y);
+    if (first & MINE_BIT) {
+        header->state = STEPPED_MINE;
+    }
+    int64_t revealed = first & REVEALED_BIT ? 0 : 1;
+    first |= REVEALED_BIT;
+    markDirty(x, y);
+    revealQueue.clear();
+    if ((first & COUNT_MASK) == 0 and not (first & MINE_BIT)) {
+        revealQueue.emplace_back(x, y);
+    }
+    for (size_t head = 0; head < revealQueue.size(); head++) {
+        const auto [currentX, currentY] = revealQueue[head];
+        for (const auto [dx, dy]: DELTA2) {
+            int32_t nextX = currentX + dx;
+            int32_t nextY = currentY + dy;
+            if (not isInBounds(nextX, nextY)) {
+                continue;
+            }
+            uint8_t &next = *cellAt(nextX, nextY);
+            if (next & (REVEALED_BIT | FLAGGED_BIT | MINE_BIT)) {
+                continue;
+            }
+            next |= REVEALED_BIT;
+            markDirty(nextX, nextY);
+            revealed += 1;
+            if ((next & COUNT_MASK) == 0) {
+                revealQueue.emplace_back(nextX, nextY);
+            }
+        }
+    }
+    header->revealedCells += revealed;
+    return revealed;
+}
+
+void MappedBoard::toggleFlag(int32_t x, int32_t y) {
+    uint8_t &cell = *cellAt(x, y);
+    cell ^= FLAGGED_BIT;
+    if (cell & MINE_BIT) {
+        header->flaggedMines += cell & FLAGGED_BIT ? 1 : -1;
+    }
+    markDirty(x, y);
+}
+
+void MappedBoard::updateGameStatus() {
+    if (header->state == STEPPED_MINE or header->state == VICTORY) {
+        return;
+    }
+    // A revealed mine ends the game first, so every mine is covered once every mine is flagged
+    if (header->minesPlaced and header->flaggedMines == header->mineCount) {
+        header->state = VICTORY;
+    }
+}
+
+Cell MappedBoard::getCell(int32_t x, int32_t y) const {
+    uint8_t cell = *cellAt(x, y);
+    return Cell{(cell & MINE_BIT) != 0, (cell & REVEALED_BIT) != 0, (cell & FLAGGED_BIT) != 0,
+                cell & COUNT_MASK};
+}
+
+int32_t MappedBoard::getWidth() const {
+    return header->width;
+}
+
+int32_t MappedBoard::getHeight() const {
+    return header->height;
+}
+
+int64_t MappedBoard::getMineCount() const {
+    return header->mineCount;
+}
+
+GameStatus MappedBoard::getState() const {
+    return static_cast<GameStatus>(header->state);
+}
+
+int64_t MappedBoard::getRevealedCount() const {
+    return header->revealedCells;
+}
+
+void MappedBoard::flush() {
+    if (mapping == nullptr) {
+        return;
+    }
+    size_t tileCount = static_cast<size_t>(tileColumns) * tileRows;
+    size_t tile = 0;
+    while (tile < tileCount) {
+        if (not (dirtyTiles[tile / 64] >> (tile % 64) & 1)) {
+            // Skip clean words whole
+            tile = dirtyTiles[tile / 64] >> (tile % 64) == 0 ? (tile / 64 + 1) * 64 : tile + 1;
+            continue;
+        }
+        size_t end = tile;
+        while (end < tileCount and (dirtyTiles[end / 64] >> (end % 64) & 1)) {
+            dirtyTiles[end / 64] &= ~(uint64_t{1} << (end % 64));
+            end += 1;
+        }
+        uint8_t *begin;
+        size_t bytes;
+        pageRange(tiles + tile * MAPPED_TILE_BYTES, tiles + end * MAPPED_TILE_BYTES, begin, bytes);
+        msync(begin, bytes, MS_SYNC);
+        tile = end;
+    }
+    uint8_t *begin;
+    size_t bytes;
+    pageRange(mapping, mapping + sizeof(Header), begin, bytes);
+    msync(begin, bytes, MS_SYNC);
+}
+
+void MappedBoard::releasePages() {
+    flush();
+    adviseBands(0, tileRows, MADV_DONTNEED);
+}
+
+int64_t MappedBoard::getFileBytes(int32_t width, int32_t height) {
+    int64_t tileColumns = (width + MAPPED_TILE_CELLS - 1) / MAPPED_TILE_CELLS;
+    int64_t tileRows = (height + MAPPED_TILE_CELLS - 1) / MAPPED_TILE_CELLS;
+    return static_cast<int64_t>(MAPPED_TILE_BYTES) * (1 + tileColumns * tileRows);
+}
+
+bool MappedBoard::map(int fileDescriptor, int64_t bytes) {
+    void *address = mmap(nullptr, static_cast<size_t>(bytes), PROT_READ | PROT_WRITE, MAP_SHARED,
+                         fileDescriptor, 0);
+    if (address == MAP_FAILED) {
+        return false;
+    }
+    // The mapping keeps the file open
+    ::close(fileDescriptor);
+    mapping = static_cast<uint8_t *>(address);
+    mappingBytes = static_cast<size_t>(bytes);
+    header = reinterpret_cast<Header *>(mapping);
+    tiles = mapping + MAPPED_TILE_BYTES;
+    return true;
+}
+
+uint8_t *MappedBoard::cellAt(int32_t x, int32_t y) const {
+    size_t tile = static_cast<size_t>(y / MAPPED_TILE_CELLS) * tileColumns + x / MAPPED_TILE_CELLS;
+    return tiles + tile * MAPPED_TILE_BYTES + (y % MAPPED_TILE_CELLS) * MAPPED_TILE_CELLS +
+           x % MAPPED_TILE_CELLS;
+}
+
+bool MappedBoard::isInBounds(int32_t x, int32_t y) const {
+    return 0 <= x and x < header->width and 0 <= y and y < header->height;
+}
+
+void MappedBoard::markDirty(int32_t x, int32_t y) {
+    size_t tile = static_cast<size_t>(y / MAPPED_TILE_CELLS) * tileColumns + x / MAPPED_TILE_CELLS;
+    dirtyTiles[tile / 64] |= uint64_t{1} << (tile % 64);
+}
+
+int32_t MappedBoard::countAdjacentMines(int32_t x, int32_t y) const {
+    int32_t count = 0;
+    for (int32_t dy = -1; dy <= 1; dy++) {
+        for (int32_t dx = -1; dx <= 1; dx++) {
+            if ((dx != 0 or dy != 0) and isInBounds(x + dx, y + dy) and
+                (*cellAt(x + dx, y + dy) & MINE_BIT)) {
+                count += 1;
+            }
+        }
+    }
+    return count;
+}
+
+void MappedBoard::countBand(int32_t tileRow) {
+    int32_t firstY = tileRow * MAPPED_TILE_CELLS;
+    int32_t lastY = std::min(firstY + MAPPED_TILE_CELLS, header->height);
+    for (int32_t tileColumn = 0; tileColumn < tileColumns; tileColumn++) {
+        int32_t firstX = tileColumn * MAPPED_TILE_CELLS;
+        int32_t lastX = std::min(firstX + MAPPED_TILE_CELLS, header->width);
+        uint8_t *tile = cellAt(firstX, firstY);
+        for (int32_t y = firstY; y < lastY; y++) {
+            for (int32_t x = firstX; x < lastX; x++) {
+                int32_t localX = x - firstX;
+                int32_t localY = y - firstY;
+                uint8_t &cell = tile[localY * MAPPED_TILE_CELLS + localX];
+                int32_t count = 0;
+                bool isInside = localX > 0 and localX < MAPPED_TILE_CELLS - 1 and localY > 0 and
+                                localY < MAPPED_TILE_CELLS - 1;
+                if (not (cell & MINE_BIT) and isInside) {
+                    // Neighbours in the same tile, read directly. Padding past the board's edge
+                    // is zero, so it counts as no mine.
+                    const uint8_t *above = &cell - MAPPED_TILE_CELLS;
+                    const uint8_t *row = &cell;
+                    const uint8_t *below = &cell + MAPPED_TILE_CELLS;
+                    count = ((above[-1] & MINE_BIT) + (above[0] & MINE_BIT) +
+                             (above[1] & MINE_BIT) + (row[-1] & MINE_BIT) + (row[1] & MINE_BIT) +
+                             (below[-1] & MINE_BIT) + (below[0] & MINE_BIT) +
+                             (below[1] & MINE_BIT)) / MINE_BIT;
+                } else if (not (cell & MINE_BIT)) {
+                    count = countAdjacentMines(x, y);
+                }
+                // Writing only what changes leaves mine-free stretches of the file sparse
+                if ((cell & COUNT_MASK) != count) {
+                    cell = static_cast<uint8_t>((cell & ~COUNT_MASK) | count);
+                }
+            }
+        }
+    }
+}
+
+void MappedBoard::moveMine(int32_t fromX, int32_t fromY, int32_t toX, int32_t toY) {
+    *cellAt(fromX, fromY) &= ~MINE_BIT;
+    // Mines carry no count
+    *cellAt(toX, toY) = static_cast<uint8_t>((*cellAt(toX, toY) & ~COUNT_MASK) | MINE_BIT);
+    // The centres are left out: a packed count below zero would borrow from the flag bits
+    for (int32_t dy = -1; dy <= 1; dy++) {
+        for (int32_t dx = -1; dx <= 1; dx++) {
+            if (dx == 0 and dy == 0) {
+                continue;
+            }
+            if (isInBounds(fromX + dx, fromY + dy) and
+                not (*cellAt(fromX + dx, fromY + dy) & MINE_BIT)) {
+                *cellAt(fromX + dx, fromY + dy) -= 1;
+                markDirty(fromX + dx, fromY + dy);
+            }
+            if (isInBounds(toX + dx, toY + dy) and not (*cellAt(toX + dx, toY + dy) & MINE_BIT)) {
+                *cellAt(toX + dx, toY + dy) += 1;
+                markDirty(toX + dx, toY + dy);
+            }
+        }
+    }
+    // The vacated cell was a mine without a count
+    uint8_t &vacated = *cellAt(fromX, fromY);
+    vacated = static_cast<uint8_t>((vacated & ~COUNT_MASK) | countAdjacentMines(fromX, fromY));
+    markDirty(fromX, fromY);
+    markDirty(toX, toY);
+}
+
+void MappedBoard::adviseBands(int32_t firstRow, int32_t lastRow, int advice) const {
+    if (firstRow >= lastRow) {
+        return;
+    }
+    size_t bandBytes = static_cast<size_t>(tileColumns) * MAPPED_TILE_BYTES;
+    uint8_t *begin;
+    size_t bytes;
+    pageRange(tiles + firstRow * bandBytes, tiles + lastRow * bandBytes, begin, bytes);
+    // The header page may share the first page on large-page devices; dropping it is harmless
+    madvise(begin, bytes, advice);
+}
@@ -0,0 +1,147 @@
+#ifndef MINESWEEPER_MAPPED_BOARD_H
+#define MINESWEEPER_MAPPED_BOARD_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include "game_objects.h"
+
+// Cells are stored in square tiles of MAPPED_TILE_CELLS x MAPPED_TILE_CELLS bytes, one page each,
+// so a flood fill or a view of the board touches few pages whatever the board's width.
+constexpr int32_t MAPPED_TILE_CELLS = 64;
+constexpr size_t MAPPED_TILE_BYTES = MAPPED_TILE_CELLS * MAPPED_TILE_CELLS;
+
+// Bump whenever the file layout changes, so older files are refused.
+constexpr uint32_t MAPPED_BOARD_VERSION = 1;
+
+/*
+ * Board file, little endian, in the host's byte order:
+ *
+ *   one MAPPED_TILE_BYTES header page: "MSBOARD\0", u32 MAPPED_BOARD_VERSION, i32 width,
+ *   i32 height, i32 safeZone, i64 mineCount, u64 seed, i32 state, i32 minesPlaced,
+ *   i64 flaggedMines, i64 revealedCells, zero padding
+ *
+ * then the tiles in row-major tile order, each holding its cells row-major as one byte: the
+ * adjacent mine count in the low 4 bits, then bits for mine, revealed and flagged. Tiles on the
+ * right and bottom edges are padded to full size.
+ */
+
+// A GameBoard whose cells live in a memory-mapped file instead of the heap, for boards too large
+// for memory. Only the pages in use stay resident; the OS page cache reads the rest back in and
+// writes dirty ones out. Play follows GameBoard's rules.
+class MappedBoard {
+public:
+    MappedBoard() = default;
+
+    MappedBoard(const MappedBoard &) = delete;
+
+    MappedBoard &operator=(const MappedBoard &) = delete;
+
+    // Flushes and unmaps.
+    ~MappedBoard();
+
+    // Creates or truncates the file at path for a board without mines and maps it. Returns false
+    // if the file could not be sized or mapped.
+    bool create(const std::string &path, int32_t width, int32_t height, int64_t mineCount,
+                uint64_t seed, SafeZone safeZone = SAFE_CELL);
+
+    // Maps a board file written earlier, in whatever state it was last flushed. Returns false if
+    // path holds no valid board of this MAPPED_BOARD_VERSION.
+    bool open(const std::string &path);
+
+    // Flushes and unmaps. Does nothing if no board is open.
+    void close();
+
+    bool isOpen() const;
+
+    // Places the mines uniformly with selection sampling and counts their neighbours in one
+    // sequential sweep over the file, band by band of tiles, releasing each band once its counts
+    // are done. Memory stays at a few bands however large the board. Does nothing if the mines
+    // are already placed.
+    void generateMines();
+
+    // As GameBoard::initializeBoard: generates the mines if needed, then moves any in the safe
+    // zone to uniformly drawn free cells outside it and patches the counts around them.
+    void initializeBoard(int32_t firstClickX, int32_t firstClickY);
+
+    // As GameBoard::revealCell. Returns the number of cells uncovered.
+    int64_t revealCell(int32_t x, int32_t y);
+
+    void toggleFlag(int32_t x, int32_t y);
+
+    // As GameBoard::updateGameStatus, from counters kept as cells change instead of a full scan.
+    void updateGameStatus();
+
+    Cell getCell(int32_t x, int32_t y) const;
+
+    int32_t getWidth() const;
+
+    int32_t getHeight() const;
+
+    int64_t getMineCount() const;
+
+    GameStatus getState() const;
+
+    int64_t getRevealedCount() const;
+
+    // Writes the tiles changed since the last flush, and the header, back to the file and waits
+    // for them. Runs of neighbouring dirty tiles are written with one call.
+    void flush();
+
+    // Flushes, then drops every page of the board from this process, so resident memory starts
+    // again from nothing. The pages stay in the page cache, so reading them back is cheap while
+    // memory allows.
+    void releasePages();
+
+    // File size of a board, header included.
+    static int64_t getFileBytes(int32_t width, int32_t height);
+
+private:
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        int32_t width;
+        int32_t height;
+        int32_t safeZone;
+        int64_t mineCount;
+        uint64_t seed;
+        int32_t state;
+        int32_t minesPlaced;
+        int64_t flaggedMines;
+        int64_t revealedCells;
+    };
+
+    static_assert(sizeof(Header) <= MAPPED_TILE_BYTES, "the header fits its page");
+
+    bool map(int fileDescriptor, int64_t bytes);
+
+    uint8_t *cellAt(int32_t x, int32_t y) const;
+
+    bool isInBounds(int32_t x, int32_t y) const;
+
+    void markDirty(int32_t x, int32_t y);
+
+    int32_t countAdjacentMines(int32_t x, int32_t y) const;
+
+    void countBand(int32_t tileRow);
+
+    void moveMine(int32_t fromX, int32_t fromY, int32_t toX, int32_t toY);
+
+    // Calls madvise over the tiles of tile rows [firstRow, lastRow).
+    void adviseBands(int32_t firstRow, int32_t lastRow, int advice) const;
+
+    uint8_t *mapping = nullptr;
+    size_t mappingBytes = 0;
+    Header *header = nullptr;
+    uint8_t *tiles = nullptr;
+    int32_t tileColumns = 0;
+    int32_t tileRows = 0;
+    // One bit per tile changed since the last flush.
+    std::vector<uint64_t> dirtyTiles;
+    // Frontier of the flood fill, kept between reveals so it does not reallocate.
+    std::vector<std::pair<int32_t, int32_t>> revealQueue;
+};
+
+#endif //MINESWEEPER_MAPPED_BOARD_H
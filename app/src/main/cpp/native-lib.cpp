@@ -2,144 +2,115 @@
 // Created by SSAFY on 2024-10-02.
 //
 
+#include <algorithm>
 #include "jni.h"
-#include <string>
-#include "game_objects.h"
+#include "native-lib.h"
+#include "trace.h"
+
+GameBoard *gameBoard = nullptr;
+std::mutex gameBoardMutex;
+ALooper *renderLooper = nullptr;
+CancellationSource gameWork;
+
+namespace {
+
+// Places the mines of a new board on an engine worker, into a board of its own so the lock is only
+// held to hand them over. The first tap then only moves mines out of its safe zone. If it comes
+// first, it places the mines itself and these are dropped. board is only touched under the lock,
+// so its size and seed come by value.
+Task<void> generateMines(GameBoard *board, int32_t width, int32_t height, int32_t mineCount,
+                         uint64_t seed, CancellationToken token) {
+    if (token.isCancelled()) {
+        co_return;
+    }
+    GameBoard generated(width, height, mineCount, seed);
+    generated.generateMines();
+    std::lock_guard<std::mutex> lock(gameBoardMutex);
+    // Cancelled under this lock before the board is deleted, so board is still alive if not
+    if (not token.isCancelled()) {
+        board->adoptMines(generated);
+    }
+}
 
-extern "C" {
+}
 
-// Pointer to the GameBoard instance
-GameBoard* gameBoard = nullptr;
+extern "C" {
 
-// Initialize the GameBoard
+// Initialize the GameBoard. Play happens natively: the renderer draws the board and turns touches
+// into reveals and flags.
 JNIEXPORT jlong JNICALL
 Java_com_lumi_minesweeper_MainActivity_initGameBoard(JNIEnv* env, jobject /* this */, jint width, jint height, jint mineCount) {
+    ScopedTrace trace(TraceOp::JNI_CALL);
+    countTrace(TraceCounter::JNI_CALLS);
+    std::lock_guard<std::mutex> lock(gameBoardMutex);
+    // whatever was running for the old board is of no use now
+    gameWork.cancel();
+    gameWork = CancellationSource();
+    delete gameBoard;
     gameBoard = new GameBoard(width, height, mineCount);
+    spawn(getEngineScheduler(), generateMines(gameBoard, width, height, mineCount,
+                                              gameBoard->getSeed(), gameWork.getToken()));
+    if (renderLooper != nullptr) {
+        ALooper_wake(renderLooper);
+    }
     return reinterpret_cast<jlong>(gameBoard);
 }
 
-// Initialize the board after first click
+// Clean up the GameBoard instance
 JNIEXPORT void JNICALL
-Java_com_lumi_minesweeper_MainActivity_initializeBoard(JNIEnv* env, jobject /* this */, jlong gameBoardPtr, jint firstClickX, jint firstClickY) {
+Java_com_lumi_minesweeper_MainActivity_cleanup(JNIEnv* env, jobject /* this */, jlong gameBoardPtr) {
+    ScopedTrace trace(TraceOp::JNI_CALL);
+    countTrace(TraceCounter::JNI_CALLS);
+    std::lock_guard<std::mutex> lock(gameBoardMutex);
+    gameWork.cancel();
     auto* board = reinterpret_cast<GameBoard*>(gameBoardPtr);
-    if (board != nullptr) {
-        board->initializeBoard(firstClickX, firstClickY);
+    if (board != nullptr and board == gameBoard) {
+        delete board;
+        gameBoard = nullptr;
+        if (renderLooper != nullptr) {
+            ALooper_wake(renderLooper);
+        }
     }
 }
 
-// Reveal a cell
+// Turn tracing on or off. While on, timed operations show up as ATrace sections and counters in
+// Perfetto or systrace captures.
 JNIEXPORT void JNICALL
-Java_com_lumi_minesweeper_MainActivity_revealCell(JNIEnv* env, jobject /* this */, jlong gameBoardPtr, jint x, jint y) {
-    auto* board = reinterpret_cast<GameBoard*>(gameBoardPtr);
-    if (board != nullptr) {
-        board->revealCell(x, y);
-        board->updateGameStatus();
+Java_com_lumi_minesweeper_MainActivity_setTracing(JNIEnv* env, jobject /* this */, jboolean enabled) {
+    if (enabled) {
+        startTracing();
+    } else {
+        stopTracing();
     }
 }
 
-// Toggle a flag on a cell
+// Fills out with every TraceCounter's total, in TraceCounter order, as far as it has room. The
+// caller keeps the array between calls, so querying allocates nothing on either side.
 JNIEXPORT void JNICALL
-Java_com_lumi_minesweeper_MainActivity_toggleFlag(JNIEnv* env, jobject /* this */, jlong gameBoardPtr, jint x, jint y) {
-    auto* board = reinterpret_cast<GameBoard*>(gameBoardPtr);
-    if (board != nullptr) {
-        board->toggleFlag(x, y);
+Java_com_lumi_minesweeper_MainActivity_readTraceCounters(JNIEnv* env, jobject /* this */, jlongArray out) {
+    jlong values[static_cast<size_t>(TraceCounter::COUNT)];
+    for (size_t i = 0; i < static_cast<size_t>(TraceCounter::COUNT); i++) {
+        values[i] = static_cast<jlong>(getTraceCount(static_cast<TraceCounter>(i)));
     }
+    jsize length = std::min(env->GetArrayLength(out), static_cast<jsize>(TraceCounter::COUNT));
+    env->SetLongArrayRegion(out, 0, length, values);
 }
 
-// Get cell data
-JNIEXPORT jobject JNICALL
-Java_com_lumi_minesweeper_MainActivity_getCell(JNIEnv* env, jobject /* this */, jlong gameBoardPtr, jint x, jint y) {
-    if (gameBoardPtr == 0) return nullptr;
-
-    auto* board = reinterpret_cast<GameBoard*>(gameBoardPtr);
-    const Cell& cell = board->getCell(x, y);
-
-    // Find the CellData class
-    jclass cellDataClass = env->FindClass("com/lumi/minesweeper/CellData");
-    if (cellDataClass == nullptr) return nullptr;
-
-    // Get the constructor
-    jmethodID constructor = env->GetMethodID(cellDataClass, "<init>", "()V");
-    if (constructor == nullptr) return nullptr;
-
-    // Create a new CellData object
-    jobject cellDataObj = env->NewObject(cellDataClass, constructor);
-    if (cellDataObj == nullptr) return nullptr;
-
-    // Set fields
-    jfieldID isMineField = env->GetFieldID(cellDataClass, "isMine", "Z");
-    jfieldID isRevealedField = env->GetFieldID(cellDataClass, "isRevealed", "Z");
-    jfieldID isFlaggedField = env->GetFieldID(cellDataClass, "isFlagged", "Z");
-    jfieldID adjacentMinesField = env->GetFieldID(cellDataClass, "adjacentMines", "I");
-
-    env->SetBooleanField(cellDataObj, isMineField, cell.isMine);
-    env->SetBooleanField(cellDataObj, isRevealedField, cell.isRevealed);
-    env->SetBooleanField(cellDataObj, isFlaggedField, cell.isFlagged);
-    env->SetIntField(cellDataObj, adjacentMinesField, static_cast<int>(cell.adjacentMines));
-
-    return cellDataObj;
-}
-
-// Get game state
-JNIEXPORT jobject JNICALL
-Java_com_lumi_minesweeper_MainActivity_getGameState(JNIEnv* env, jobject /* this */, jlong gameBoardPtr) {
-    if (gameBoardPtr != 0) {
-        auto* board = reinterpret_cast<GameBoard*>(gameBoardPtr);
-
-        // Get the GameStatus class reference
-        jclass gameStatusClass = env->FindClass("com/lumi/minesweeper/GameStatus");
-        if (gameStatusClass == nullptr) {
-            return nullptr; // Error, class not found
-        }
-
-        // Convert C++ enum to Java string name of the enum constant
-        const char* enumName = nullptr;
-        switch (board->state) {
-            case GameStatus::ERROR:
-                enumName = "ERROR";
-                break;
-            case GameStatus::STARTED:
-                enumName = "STARTED";
-                break;
-            case GameStatus::ONGOING:
-                enumName = "ONGOING";
-                break;
-            case GameStatus::STEPPED_MINE:
-                enumName = "STEPPED_MINE";
-                break;
-            case GameStatus::VICTORY:
-                enumName = "VICTORY";
-                break;
-            default:
-                return nullptr; // Unknown state, handle as error
-        }
-
-        jstring jEnumName = env->NewStringUTF(enumName);
-        if (jEnumName == nullptr) {
-            return nullptr; // Error, could not create string
-        }
-
-        // Use the valueOf method to get the enum constant
-        jmethodID valueOfMethod = env->GetStaticMethodID(gameStatusClass, "valueOf", "(Ljava/lang/String;)Lcom/lumi/minesweeper/GameStatus;");
-        if (valueOfMethod == nullptr) {
-            return nullptr; // Error, method not found
-        }
-
-        return env->CallStaticObjectMethod(gameStatusClass, valueOfMethod, jEnumName);
-    }
-
-    return nullptr; // Error state
-}
-
-
-// Clean up the GameBoard instance
+// Fills out with the span durations of one TraceOp while tracing was on: count, then p50, p90, p99
+// and max in nanoseconds, as far as it has room. Unknown operations give all zeros.
 JNIEXPORT void JNICALL
-Java_com_lumi_minesweeper_MainActivity_cleanup(JNIEnv* env, jobject /* this */, jlong gameBoardPtr) {
-    auto* board = reinterpret_cast<GameBoard*>(gameBoardPtr);
-    if (board != nullptr) {
-        delete board;
-        gameBoard = nullptr;
+Java_com_lumi_minesweeper_MainActivity_readTraceLatency(JNIEnv* env, jobject /* this */, jint op, jlongArray out) {
+    jlong values[5] = {};
+    if (op >= 0 and op < static_cast<jint>(TraceOp::COUNT)) {
+        LatencyHistogram histogram = getTraceLatency(static_cast<TraceOp>(op));
+        values[0] = static_cast<jlong>(histogram.getCount());
+        values[1] = static_cast<jlong>(histogram.percentile(0.5));
+        values[2] = static_cast<jlong>(histogram.percentile(0.9));
+        values[3] = static_cast<jlong>(histogram.percentile(0.99));
+        values[4] = static_cast<jlong>(histogram.getMax());
     }
+    jsize length = std::min(env->GetArrayLength(out), static_cast<jsize>(5));
+    env->SetLongArrayRegion(out, 0, length, values);
 }
 
-} // extern "C"
\ No newline at end of file
+} // extern "C"
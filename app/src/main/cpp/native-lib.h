@@ -0,0 +1,23 @@
+#ifndef MINESWEEPER_NATIVE_LIB_H
+#define MINESWEEPER_NATIVE_LIB_H
+
+#include <android/looper.h>
+#include <mutex>
+#include "game_objects.h"
+#include "task_scheduler.h"
+
+// The board the activity created, shared between its JNI calls on the UI thread and the renderer
+// on the native app thread. Hold gameBoardMutex while touching either.
+extern GameBoard *gameBoard;
+extern std::mutex gameBoardMutex;
+
+// The looper of the native app thread while it runs, also guarded by gameBoardMutex. The render
+// loop blocks on it when nothing needs drawing, so replacing the board from the UI thread wakes it.
+extern ALooper *renderLooper;
+
+// Background work for the current board, such as generating or analysing it on
+// getEngineScheduler(), holds a token of gameWork and stops once it is cancelled. Replacing the
+// board or leaving the activity cancels it. Also guarded by gameBoardMutex.
+extern CancellationSource gameWork;
+
+#endif //MINESWEEPER_NATIVE_LIB_H
@@ -0,0 +1,90 @@
+#include "program_cache.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace {
+
+const char MAGIC[4] = {'M', 'S', 'P', 'B'};
+
+// Driver binaries are a few tens of kilobytes; anything far larger is a damaged header.
+constexpr uint32_t MAX_BINARY_BYTES = 64u << 20;
+
+struct CacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t key;
+    uint32_t format;
+    uint32_t size;
+    uint64_t hash;
+};
+
+static_assert(sizeof(CacheHeader) == 32, "CacheHeader is written to disk as is");
+
+uint64_t fnv1a(uint64_t hash, const uint8_t *bytes, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+constexpr uint64_t FNV_OFFSET = 0xcbf29ce484222325ull;
+
+}
+
+uint64_t programCacheKey(std::initializer_list<const char *> parts) {
+    uint64_t hash = FNV_OFFSET;
+    for (const char *part: parts) {
+        // The terminator goes in too, so moving text from one part to the next changes the key.
+        const char *text = part == nullptr ? "" : part;
+        hash = fnv1a(hash, reinterpret_cast<const uint8_t *>(text), std::strlen(text) + 1);
+    }
+    return hash;
+}
+
+bool writeProgramBinary(const std::string &path, uint64_t key, const ProgramBinary &binary) {
+    if (binary.bytes.empty() or binary.bytes.size() > MAX_BINARY_BYTES) {
+        return false;
+    }
+    CacheHeader header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = PROGRAM_CACHE_VERSION;
+    header.key = key;
+    header.format = binary.format;
+    header.size = static_cast<uint32_t>(binary.bytes.size());
+    header.hash = fnv1a(FNV_OFFSET, binary.bytes.data(), binary.bytes.size());
+
+    std::string temporaryPath = path + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char *>(binary.bytes.data()),
+                   static_cast<std::streamsize>(binary.bytes.size()));
+        if (not file.flush()) {
+            std::remove(temporaryPath.c_str());
+            return false;
+        }
+    }
+    return std::rename(temporaryPath.c_str(), path.c_str()) == 0;
+}
+
+bool readProgramBinary(const std::string &path, uint64_t key, ProgramBinary &outBinary) {
+    std::ifstream file(path, std::ios::binary);
+    CacheHeader header{};
+    if (not file.read(reinterpret_cast<char *>(&header), sizeof(header))) {
+        return false;
+    }
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 or
+        header.version != PROGRAM_CACHE_VERSION or header.key != key or header.size == 0 or
+        header.size > MAX_BINARY_BYTES) {
+        return false;
+    }
+    std::vector<uint8_t> bytes(header.size);
+    if (not file.read(reinterpret_cast<char *>(bytes.data()), header.size) or
+        fnv1a(FNV_OFFSET, bytes.data(), bytes.size()) != header.hash) {
+        return false;
+    }
+    outBinary.format = header.format;
+    outBinary.bytes = std::move(bytes);
+    return true;
+}
@@ -0,0 +1,39 @@
+#ifndef MINESWEEPER_PROGRAM_CACHE_H
+#define MINESWEEPER_PROGRAM_CACHE_H
+
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+// Bump whenever the cache file layout changes.
+constexpr uint32_t PROGRAM_CACHE_VERSION = 1;
+
+// A linked GL program as returned by glGetProgramBinary, kept free of GL types so the cache can be
+// exercised off device.
+struct ProgramBinary {
+    uint32_t format = 0;
+    std::vector<uint8_t> bytes;
+};
+
+// Identifies a program binary: hash every part that decides what the driver links, i.e. the
+// driver's vendor, renderer and version strings, the shader sources and the attribute bindings. A
+// driver update changes the version string and so invalidates every cached binary.
+uint64_t programCacheKey(std::initializer_list<const char *> parts);
+
+/*
+ * Cache file, little endian, one program per file:
+ *
+ *   "MSPB", u32 PROGRAM_CACHE_VERSION, u64 key, u32 binary format, u32 byte count, u64 FNV-1a hash
+ *   of the bytes, then the bytes
+ */
+
+// Writes to a temporary file next to path and renames it over path. Returns false if the file could
+// not be written.
+bool writeProgramBinary(const std::string &path, uint64_t key, const ProgramBinary &binary);
+
+// Returns false if path holds no intact binary for key. The driver may still reject a binary it
+// wrote itself, so callers must fall back to compiling from source when glProgramBinary fails.
+bool readProgramBinary(const std::string &path, uint64_t key, ProgramBinary &outBinary);
+
+#endif //MINESWEEPER_PROGRAM_CACHE_H
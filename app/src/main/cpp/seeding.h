@@ -0,0 +1,20 @@
+#ifndef MINESWEEPER_SEEDING_H
+#define MINESWEEPER_SEEDING_H
+
+#include <cstdint>
+
+// SplitMix64 finaliser. Cheap and well mixed, so consecutive indices give unrelated seeds.
+inline uint64_t splitMix64(uint64_t value) {
+    value += 0x9e3779b97f4a7c15ULL;
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+    return value ^ (value >> 31);
+}
+
+// Seed of the index-th board of a run. Depends only on the master seed and the index, never on
+// which thread happens to generate the board, so batch results reproduce exactly.
+inline uint64_t deriveSeed(uint64_t masterSeed, uint64_t index) {
+    return splitMix64(masterSeed ^ splitMix64(index));
+}
+
+#endif //MINESWEEPER_SEEDING_H
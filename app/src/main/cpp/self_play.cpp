@@ -0,0 +1,202 @@
+#include "self_play.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <memory>
+#include <vector>
+#include "seeding.h"
+#include "worker_pool.h"
+
+namespace {
+
+// Games handed to a worker at a time; large enough to keep the shared counter cold.
+constexpr int64_t GAMES_PER_CLAIM = 64;
+
+uint64_t nanosSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+}
+
+}
+
+void SelfPlayReport::merge(const SelfPlayReport &other) {
+    games += other.games;
+    wins += other.wins;
+    losses += other.losses;
+    stalled += other.stalled;
+    moves += other.moves;
+    cellsRevealed += other.cellsRevealed;
+    threeBVTotal += other.threeBVTotal;
+    wonThreeBVTotal += other.wonThreeBVTotal;
+    moveLatency.merge(other.moveLatency);
+    cache.merge(other.cache);
+}
+
+uint64_t visibleNeighbourhood(const GameBoard &board, int32_t x, int32_t y) {
+    uint64_t packed = 0;
+    int32_t shift = 0;
+    for (int32_t dy = -1; dy <= 1; dy++) {
+        for (int32_t dx = -1; dx <= 1; dx++) {
+            int32_t nx = x + dx;
+            int32_t ny = y + dy;
+            uint64_t code = 11;
+            if (0 <= nx and nx < board.getWidth() and 0 <= ny and ny < board.getHeight()) {
+                const Cell &cell = board.getCell(nx, ny);
+                if (cell.isRevealed) {
+                    code = static_cast<uint64_t>(cell.adjacentMines);
+                } else {
+                    code = cell.isFlagged ? 10 : 9;
+                }
+            }
+            packed |= code << shift;
+            shift += 4;
+        }
+    }
+    return packed;
+}
+
+GameStatus playGame(GameBoard &board, Strategy &strategy, uint64_t seed, BoardAnalyzer &analyzer,
+                    SelfPlayReport &report, std::vector<TracedMove> *trace) {
+    board.reset(seed);
+    strategy.reset();
+    std::mt19937_64 rng(splitMix64(seed));
+    // Every move changes at least one cell, so a game can never legitimately take longer.
+    int64_t moveLimit = 2 * static_cast<int64_t>(board.getWidth()) * board.getHeight();
+
+    if (trace != nullptr) {
+        trace->clear();
+    }
+
+    int64_t moves = 0;
+    while (board.state == STARTED or board.state == ONGOING) {
+        if (moves == moveLimit) {
+            break;
+        }
+        auto start = std::chrono::steady_clock::now();
+        Move move = strategy.nextMove(board, rng);
+        if (not move.isValid()) {
+            break;
+        }
+        if (board.state == STARTED) {
+            board.initializeBoard(move.x, move.y);
+            move.flag = false;
+        }
+        uint64_t neighbourhood = 0;
+        if (trace != nullptr) {
+            neighbourhood = visibleNeighbourhood(board, move.x, move.y);
+        }
+        int32_t uncovered = 0;
+        if (move.flag) {
+            board.toggleFlag(move.x, move.y);
+        } else {
+            uncovered = board.revealCell(move.x, move.y);
+        }
+        board.updateGameStatus();
+        report.moveLatency.record(nanosSince(start));
+        if (trace != nullptr) {
+            trace->push_back(TracedMove{move.x, move.y, move.flag, uncovered, neighbourhood});
+        }
+        moves += 1;
+    }
+
+    // Play never changes mines or counts, so the finished board still has the generated layout.
+    int32_t threeBV = board.state == STARTED ? 0 : analyzer.analyze(board).threeBV;
+    report.games += 1;
+    report.moves += moves;
+    report.threeBVTotal += threeBV;
+    if (board.state == VICTORY) {
+        report.wins += 1;
+        report.wonThreeBVTotal += threeBV;
+    } else if (board.state == STEPPED_MINE) {
+        report.losses += 1;
+    } else {
+        report.stalled += 1;
+    }
+    for (int32_t y = 0; y < board.getHeight(); y++) {
+        for (int32_t x = 0; x < board.getWidth(); x++) {
+            const Cell &cell = board.getCell(x, y);
+            if (cell.isRevealed and not cell.isMine) {
+                report.cellsRevealed += 1;
+            }
+        }
+    }
+    return board.state;
+}
+
+SelfPlayReport runSelfPlay(const SelfPlayConfig &config) {
+    int32_t threadCount = resolveThreadCount(config.threads);
+    ChunkCounter counter(config.games, GAMES_PER_CLAIM);
+    std::vector<SelfPlayReport> reports(threadCount);
+    std::unique_ptr<TranspositionTable> table;
+    if (config.tableBits > 0) {
+        table = std::make_unique<TranspositionTable>(config.tableBits);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    runWorkers(threadCount, [&config, &counter, &reports, &table](int32_t index) {
+        const Difficulty &difficulty = config.difficulty;
+        GameBoard board(difficulty.width, difficulty.height, difficulty.mineCount, 0,
+                        config.safeZone);
+        auto strategy = makeStrategy(config.strategy, table.get());
+        BoardAnalyzer analyzer;
+        int64_t first;
+        int64_t last;
+        while (counter.claim(first, last)) {
+            for (int64_t game = first; game < last; game++) {
+                playGame(board, *strategy, deriveSeed(config.masterSeed, game), analyzer,
+                         reports[index]);
+            }
+        }
+        reports[index].cache = strategy->getCacheStats();
+    });
+
+    SelfPlayReport total;
+    for (const auto &report: reports) {
+        total.merge(report);
+    }
+    total.wallNanos = nanosSince(start);
+    return total;
+}
+
+void writeReport(std::ostream &out, const SelfPlayConfig &config, const SelfPlayReport &report) {
+    double games = static_cast<double>(std::max<int64_t>(report.games, 1));
+    double seconds = static_cast<double>(std::max<uint64_t>(report.wallNanos, 1)) / 1e9;
+
+    // Wilson score interval at 95% confidence, well behaved even near 0% and 100% win rates.
+    double rate = static_cast<double>(report.wins) / games;
+    double z = 1.96;
+    double denominator = 1.0 + z * z / games;
+    double centre = (rate + z * z / (2.0 * games)) / denominator;
+    double margin = z * std::sqrt(rate * (1.0 - rate) / games + z * z / (4.0 * games * games)) /
+                    denominator;
+
+    out << std::fixed << std::setprecision(2);
+    out << "difficulty: " << config.difficulty.name << " (" << config.difficulty.width << "x"
+        << config.difficulty.height << ", " << config.difficulty.mineCount << " mines)\n";
+    out << "strategy: " << strategyName(config.strategy) << "\n";
+    out << "safe zone: " << safeZoneName(config.safeZone) << "\n";
+    out << "master seed: " << config.masterSeed << "\n";
+    out << "games: " << report.games << " (won " << report.wins << ", lost " << report.losses
+        << ", stalled " << report.stalled << ")\n";
+    out << "win rate: " << 100.0 * rate << "% (95% CI " << 100.0 * (centre - margin) << "% - "
+        << 100.0 * (centre + margin) << "%)\n";
+    out << "throughput: " << report.games / seconds << " games/s, " << report.moves / seconds
+        << " moves/s, " << report.cellsRevealed / seconds << " cells/s, "
+        << report.threeBVTotal / seconds << " 3BV/s\n";
+    out << "3BV: mean " << report.threeBVTotal / games << ", mean of won games "
+        << static_cast<double>(report.wonThreeBVTotal) /
+           static_cast<double>(std::max<int64_t>(report.wins, 1)) << "\n";
+    const LatencyHistogram &latency = report.moveLatency;
+    out << "move latency ns: mean " << latency.getMean() << ", p50 " << latency.percentile(0.5)
+        << ", p90 " << latency.percentile(0.9) << ", p99 " << latency.percentile(0.99)
+        << ", p99.9 " << latency.percentile(0.999) << ", max " << latency.getMax() << "\n";
+    if (report.cache.lookups > 0) {
+        out << "solver cache: " << report.cache.lookups << " lookups, hit rate "
+            << 100.0 * report.cache.getHitRate() << "%, " << report.cache.solves
+            << " components enumerated in " << static_cast<double>(report.cache.solveNanos) / 1e6
+            << " ms, est. saved " << static_cast<double>(report.cache.getEstimatedSavedNanos()) / 1e6
+            << " ms\n";
+    }
+    out << "wall time: " << seconds << " s\n";
+}
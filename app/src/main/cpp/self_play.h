@@ -0,0 +1,69 @@
+#ifndef MINESWEEPER_SELF_PLAY_H
+#define MINESWEEPER_SELF_PLAY_H
+
+#include <cstdint>
+#include <ostream>
+#include <random>
+#include <vector>
+#include "board_metrics.h"
+#include "difficulty.h"
+#include "game_objects.h"
+#include "latency_histogram.h"
+#include "solver.h"
+
+struct SelfPlayConfig {
+    Difficulty difficulty = DIFFICULTIES[0];
+    StrategyKind strategy = StrategyKind::PROBABILITY;
+    SafeZone safeZone = SAFE_CELL;
+    int64_t games = 1000;
+    uint64_t masterSeed = 1;
+    // 0 uses every hardware thread.
+    int32_t threads = 0;
+    // Log2 of the solver transposition table slots shared by all workers; 0 disables the table.
+    int32_t tableBits = 16;
+};
+
+struct SelfPlayReport {
+    int64_t games = 0;
+    int64_t wins = 0;
+    int64_t losses = 0;
+    int64_t stalled = 0;
+    int64_t moves = 0;
+    int64_t cellsRevealed = 0;
+    int64_t threeBVTotal = 0;
+    int64_t wonThreeBVTotal = 0;
+    uint64_t wallNanos = 0;
+    LatencyHistogram moveLatency;
+    SolverCacheStats cache;
+
+    void merge(const SelfPlayReport &other);
+};
+
+// One move of a traced game, with what the player could see around the cell before making it.
+struct TracedMove {
+    int32_t x;
+    int32_t y;
+    bool flag;
+    // Cells uncovered by the move; 0 for flags.
+    int32_t uncovered;
+    // visibleNeighbourhood of the cell before the move.
+    uint64_t neighbourhood;
+};
+
+// Visible 3x3 neighbourhood of a cell packed as nine 4-bit codes, row by row from the top left
+// starting at the low bits: 0-8 a revealed number, 9 hidden, 10 flagged, 11 off the board.
+uint64_t visibleNeighbourhood(const GameBoard &board, int32_t x, int32_t y);
+
+// Resets the board to the given seed and lets the strategy play it to the end, accumulating into
+// the report. The board, strategy and analyzer are reused so a worker allocates nothing per game.
+// When trace is set it is cleared and receives every move of the game.
+GameStatus playGame(GameBoard &board, Strategy &strategy, uint64_t seed, BoardAnalyzer &analyzer,
+                    SelfPlayReport &report, std::vector<TracedMove> *trace = nullptr);
+
+// Plays config.games seeded games across worker threads. Game i always uses
+// deriveSeed(config.masterSeed, i), so the totals do not depend on the thread count.
+SelfPlayReport runSelfPlay(const SelfPlayConfig &config);
+
+void writeReport(std::ostream &out, const SelfPlayConfig &config, const SelfPlayReport &report);
+
+#endif //MINESWEEPER_SELF_PLAY_H
@@ -0,0 +1,3475 @@
+// Headless command line driver for the engine, built only for desktop hosts.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <numeric>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "atlas_cache.h"
+#include "board_fork.h"
+#include "board_instances.h"
+#include "board_metrics.h"
+#include "board_view.h"
+#include "difficulty.h"
+#include "dataset_export.h"
+#include "frame_scheduler.h"
+#include "gesture_recognizer.h"
+#include "input_latency.h"
+#include "glyph_atlas.h"
+#include "hint_engine.h"
+#include "latency_histogram.h"
+#include "logger.h"
+#include "mapped_board.h"
+#include "program_cache.h"
+#include "seeding.h"
+#include "self_play.h"
+#include "spectator_stream.h"
+#include "startup_profile.h"
+#include "stats_store.h"
+#include "task_scheduler.h"
+#include "trace.h"
+#include "worker_pool.h"
+#include "zobrist.h"
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+// Heap allocations made by each thread. The global allocation functions are replaced below so the
+// allocs command can check that steady-state play allocates nothing.
+thread_local int64_t threadAllocations = 0;
+
+void *operator new(size_t bytes) {
+    threadAllocations += 1;
+    void *memory = std::malloc(bytes == 0 ? 1 : bytes);
+    if (memory == nullptr) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void *operator new[](size_t bytes) {
+    return operator new(bytes);
+}
+
+void *operator new(size_t bytes, std::align_val_t alignment) {
+    threadAllocations += 1;
+    auto align = static_cast<size_t>(alignment);
+    // aligned_alloc wants a multiple of the alignment
+    size_t rounded = (std::max<size_t>(bytes, 1) + align - 1) / align * align;
+    void *memory = std::aligned_alloc(align, rounded);
+    if (memory == nullptr) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void *operator new[](size_t bytes, std::align_val_t alignment) {
+    return operator new(bytes, alignment);
+}
+
+void operator delete(void *memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void *memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void *memory, size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void *memory, std::align_val_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void *memory, std::align_val_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void *memory, size_t, std::align_val_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void *memory, size_t, std::align_val_t) noexcept {
+    std::free(memory);
+}
+
+namespace {
+
+class Options {
+public:
+    Options(int argc, char **argv) : argc(argc), argv(argv) {}
+
+    const char *get(const char *name, const char *fallback) const {
+        for (int i = 2; i + 1 < argc; i++) {
+            if (argv[i][0] == '-' and argv[i][1] == '-' and std::strcmp(argv[i] + 2, name) == 0) {
+                return argv[i + 1];
+            }
+        }
+        return fallback;
+    }
+
+    int64_t getInt(const char *name, int64_t fallback) const {
+        const char *value = get(name, nullptr);
+        return value == nullptr ? fallback : std::strtoll(value, nullptr, 10);
+    }
+
+    uint64_t getUnsigned(const char *name, uint64_t fallback) const {
+        const char *value = get(name, nullptr);
+        return value == nullptr ? fallback : std::strtoull(value, nullptr, 10);
+    }
+
+private:
+    int argc;
+    char **argv;
+};
+
+int usage() {
+    std::cerr << "usage: minesweeper_sim <command> [--option value]...\n"
+                 "\n"
+                 "commands:\n"
+                 "  selfplay  --difficulty beginner|intermediate|expert\n"
+                 "            --strategy deductive|probability|random\n"
+                 "            --safe-zone cell|area --games N --seed N --threads N\n"
+                 "            --table-bits N (0 disables the solver cache)\n"
+                 "  metrics   --difficulty beginner|intermediate|expert --safe-zone cell|area\n"
+                 "            --first-x N --first-y N --boards N --seed N --threads N\n"
+                 "            --min-3bv N --max-3bv N --max-matches N\n"
+                 "  export    --out PATH --difficulty beginner|intermediate|expert\n"
+                 "            --strategy deductive|probability|random --safe-zone cell|area\n"
+                 "            --games N --seed N --chunk-games N --threads N --queue-depth N\n"
+                 "  forks     --difficulty beginner|intermediate|expert --width N --height N\n"
+                 "            --mines N --seed N --branches N --threads N\n"
+                 "  instances --width N --height N --mines N --seed N --frames N\n"
+                 "            --surface-width N --surface-height N\n"
+                 "  view      --width N --height N --seed N --positions N\n"
+                 "            --surface-width N --surface-height N\n"
+                 "  frames    --refresh-hz N --idle-seconds N\n"
+                 "  gestures  [--trace PATH] [--record PATH] --repeats N\n"
+                 "  cascade   --width N --height N --mines N --seed N --budget N\n"
+                 "  atlas     --cache PATH --tile-size N --threads N\n"
+                 "  programs  --cache PATH --bytes N\n"
+                 "  glyphs    --max-scale N\n"
+                 "  log       --threads N --messages N\n"
+                 "  trace     --out PATH --difficulty beginner|intermediate|expert --games N\n"
+                 "            --threads N\n"
+                 "  latency   --refresh-hz N --inputs N --seed N\n"
+                 "  tasks     --difficulty beginner|intermediate|expert --jobs N\n"
+                 "            --games-per-job N --threads N\n"
+                 "  firstclick --boards N --samples N --seed N\n"
+                 "  mapped    --path PATH --memory-limit-mib N --width N --height N --mines N\n"
+                 "            --moves N --release-every N --seed N\n"
+                 "  allocs    --difficulty beginner|intermediate|expert --games N --frames N\n"
+                 "            --seed N\n"
+                 "  layouts   --max-size N --mine-permille N --runs N --seed N\n"
+                 "  spectate  --socket PATH --spectators N --games N --keyframe-interval N\n"
+                 "            --difficulty beginner|intermediate|expert --seed N\n"
+                 "  stats     --dir PATH --records N --compact-every N --seed N\n"
+                 "  hint      --difficulty beginner|intermediate|expert --games N --budget-ms N\n"
+                 "            --analysis-ms N --threads N --seed N\n";
+    return 2;
+}
+
+int runSelfPlayCommand(const Options &options) {
+    SelfPlayConfig config;
+    if (not parseDifficulty(options.get("difficulty", "beginner"), config.difficulty) or
+        not parseStrategy(options.get("strategy", "probability"), config.strategy) or
+        not parseSafeZone(options.get("safe-zone", "cell"), config.safeZone)) {
+        return usage();
+    }
+    config.games = options.getInt("games", config.games);
+    config.masterSeed = options.getUnsigned("seed", config.masterSeed);
+    config.threads = static_cast<int32_t>(options.getInt("threads", config.threads));
+    config.tableBits = static_cast<int32_t>(options.getInt("table-bits", config.tableBits));
+
+    SelfPlayReport report = runSelfPlay(config);
+    writeReport(std::cout, config, report);
+    return 0;
+}
+
+int runMetricsCommand(const Options &options) {
+    MetricsBatchConfig config;
+    if (not parseDifficulty(options.get("difficulty", "beginner"), config.difficulty) or
+        not parseSafeZone(options.get("safe-zone", "cell"), config.safeZone)) {
+        return usage();
+    }
+    config.firstClickX = static_cast<int32_t>(options.getInt("first-x", config.firstClickX));
+    config.firstClickY = static_cast<int32_t>(options.getInt("first-y", config.firstClickY));
+    config.boards = options.getInt("boards", config.boards);
+    config.masterSeed = options.getUnsigned("seed", config.masterSeed);
+    config.threads = static_cast<int32_t>(options.getInt("threads", config.threads));
+    config.minThreeBV = static_cast<int32_t>(options.getInt("min-3bv", config.minThreeBV));
+    config.maxThreeBV = static_cast<int32_t>(options.getInt("max-3bv", config.maxThreeBV));
+    config.maxMatches = options.getInt("max-matches", config.maxMatches);
+
+    MetricsBatchResult result = runMetricsBatch(config);
+    writeMetricsReport(std::cout, config, result);
+    return 0;
+}
+
+// Reads an exported file back chunk by chunk and compares every game with the same seed played
+// again. Returns the number of games that differ, or -1 if the file cannot be decoded or does not
+// match the config.
+int64_t verifyDataset(const ExportConfig &config, int64_t &outMoves) {
+    DatasetReader reader;
+    if (not reader.open(config.path)) {
+        return -1;
+    }
+    const DatasetInfo &info = reader.getInfo();
+    const Difficulty &difficulty = config.difficulty;
+    if (info.width != difficulty.width or info.height != difficulty.height or
+        info.mineCount != difficulty.mineCount or info.safeZone != config.safeZone or
+        info.strategy != config.strategy or info.masterSeed != config.masterSeed or
+        info.games != config.games) {
+        return -1;
+    }
+    GameBoard board(difficulty.width, difficulty.height, difficulty.mineCount, 0, config.safeZone);
+    auto strategy = makeStrategy(config.strategy);
+    BoardAnalyzer analyzer;
+    SelfPlayReport report;
+    std::vector<TracedMove> trace;
+    DatasetChunk chunk;
+    size_t cellCount = static_cast<size_t>(difficulty.width) * difficulty.height;
+    int64_t game = 0;
+    int64_t mismatches = 0;
+    outMoves = 0;
+    for (int64_t index = 0; index < static_cast<int64_t>(info.chunkOffsets.size()); index++) {
+        if (not reader.readChunk(index, chunk)) {
+            return -1;
+        }
+        for (size_t i = 0; i < chunk.seeds.size(); i++, game++) {
+            uint64_t seed = deriveSeed(config.masterSeed, static_cast<uint64_t>(game));
+            GameStatus outcome = playGame(board, *strategy, seed, analyzer, report, &trace);
+            bool isSame = chunk.seeds[i] == seed and chunk.outcomes[i] == outcome and
+                          chunk.moveOffsets[i + 1] - chunk.moveOffsets[i] == trace.size();
+            const uint8_t *mines = chunk.mines.data() + i * cellCount;
+            const uint8_t *counts = chunk.counts.data() + i * cellCount;
+            for (size_t cell = 0; isSame and cell < cellCount; cell++) {
+                const Cell &played = board.getCell(static_cast<int32_t>(cell % difficulty.width),
+                                                   static_cast<int32_t>(cell / difficulty.width));
+                isSame = mines[cell] == (played.isMine ? 1 : 0) and
+                         counts[cell] == (played.isMine ? 0 : played.adjacentMines);
+            }
+            for (size_t move = 0; isSame and move < trace.size(); move++) {
+                const TracedMove &decoded = chunk.moves[chunk.moveOffsets[i] + move];
+                isSame = decoded.x == trace[move].x and decoded.y == trace[move].y and
+                         decoded.flag == trace[move].flag and
+                         decoded.uncovered == trace[move].uncovered and
+                         decoded.neighbourhood == trace[move].neighbourhood;
+            }
+            mismatches += isSame ? 0 : 1;
+        }
+        outMoves += static_cast<int64_t>(chunk.moves.size());
+    }
+    return game == info.games and outMoves == info.moves ? mismatches : -1;
+}
+
+int runExportCommand(const Options &options) {
+    ExportConfig config;
+    const char *path = options.get("out", nullptr);
+    if (path == nullptr or
+        not parseDifficulty(options.get("difficulty", "beginner"), config.difficulty) or
+        not parseStrategy(options.get("strategy", "probability"), config.strategy) or
+        not parseSafeZone(options.get("safe-zone", "cell"), config.safeZone)) {
+        return usage();
+    }
+    config.path = path;
+    config.games = options.getInt("games", config.games);
+    config.masterSeed = options.getUnsigned("seed", config.masterSeed);
+    config.gamesPerChunk = static_cast<int32_t>(options.getInt("chunk-games", config.gamesPerChunk));
+    config.generatorThreads = static_cast<int32_t>(options.getInt("threads", config.generatorThreads));
+    config.queueDepth = static_cast<int32_t>(options.getInt("queue-depth", config.queueDepth));
+
+    ExportSummary summary;
+    if (not exportDataset(config, summary)) {
+        std::cerr << "failed to write " << config.path << "\n";
+        return 1;
+    }
+    double seconds = static_cast<double>(std::max<uint64_t>(summary.wallNanos, 1)) / 1e9;
+    std::cout << "games: " << summary.games << "\n"
+              << "moves: " << summary.moves << "\n"
+              << "chunks: " << summary.chunks << "\n"
+              << "bytes: " << summary.bytes << "\n"
+              << "throughput: " << summary.games / seconds << " games/s, "
+              << summary.bytes / seconds / 1e6 << " MB/s\n";
+
+    int64_t decodedMoves = 0;
+    int64_t mismatches = verifyDataset(config, decodedMoves);
+    if (mismatches < 0) {
+        std::cout << "decoded: UNREADABLE, or header and footer do not match the export\n";
+        return 1;
+    }
+    std::cout << "decoded: " << summary.games << " games and " << decodedMoves
+              << " moves against the same seeds played again, " << mismatches << " differ\n";
+    return mismatches == 0 ? 0 : 1;
+}
+
+// Whether a fork shows exactly what a board does: every cell, the visible hash and the status.
+bool isSameBoard(const BoardFork &fork, GameBoard &board) {
+    board.updateGameStatus();
+    if (fork.getVisibleHash() != board.getVisibleHash() or fork.getState() != board.state) {
+        return false;
+    }
+    for (int32_t y = 0; y < board.getHeight(); y++) {
+        for (int32_t x = 0; x < board.getWidth(); x++) {
+            const Cell &forked = fork.getCell(x, y);
+            const Cell &cell = board.getCell(x, y);
+            if (forked.isMine != cell.isMine or forked.isRevealed != cell.isRevealed or
+                forked.isFlagged != cell.isFlagged or forked.adjacentMines != cell.adjacentMines) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Plays the same random move on a fork and a board: a flag toggled one time in four, else a
+// reveal of an unflagged cell.
+void playOnBoth(BoardFork &fork, GameBoard &board, std::mt19937_64 &rng) {
+    auto x = static_cast<int32_t>(rng() % static_cast<uint64_t>(board.getWidth()));
+    auto y = static_cast<int32_t>(rng() % static_cast<uint64_t>(board.getHeight()));
+    const Cell &cell = board.getCell(x, y);
+    if (cell.isRevealed) {
+        return;
+    }
+    if (rng() % 4 == 0) {
+        fork.setFlag(x, y, not cell.isFlagged);
+        board.toggleFlag(x, y);
+    } else if (not cell.isFlagged) {
+        fork.revealCell(x, y);
+        board.revealCell(x, y);
+    }
+}
+
+// Plays into the middle of a seeded game, then checks that forks play exactly like GameBoard
+// copies and never see each other's writes, on one thread and on several forking the same root at
+// once. Then times forks and speculative reveals on them against full GameBoard copies.
+int runForksCommand(const Options &options) {
+    Difficulty difficulty{};
+    if (not parseDifficulty(options.get("difficulty", "expert"), difficulty)) {
+        return usage();
+    }
+    auto width = static_cast<int32_t>(options.getInt("width", difficulty.width));
+    auto height = static_cast<int32_t>(options.getInt("height", difficulty.height));
+    auto mines = static_cast<int32_t>(options.getInt(
+            "mines", width == difficulty.width and height == difficulty.height
+                     ? difficulty.mineCount : static_cast<int64_t>(width) * height / 5));
+    uint64_t seed = options.getUnsigned("seed", 1);
+    int64_t branches = options.getInt("branches", 200000);
+    auto threads = static_cast<int32_t>(options.getInt("threads", 4));
+    if (width <= 0 or height <= 0 or width > 65535 or height > 65535 or mines < 0 or
+        mines >= width * height or branches <= 0 or threads <= 0) {
+        return usage();
+    }
+
+    GameBoard board(width, height, mines, seed);
+    auto strategy = makeStrategy(StrategyKind::DEDUCTIVE);
+    std::mt19937_64 rng(seed);
+    int32_t cellCount = width * height;
+    int32_t revealedCount = 0;
+    while (board.state == STARTED or revealedCount < cellCount / 4) {
+        Move move = strategy->nextMove(board, rng);
+        if (board.state == STARTED) {
+            board.initializeBoard(move.x, move.y);
+        } else if (move.flag) {
+            board.toggleFlag(move.x, move.y);
+            continue;
+        } else if (board.getCell(move.x, move.y).isMine) {
+            // Only safe cells, so the position stays playable.
+            continue;
+        }
+        revealedCount += board.revealCell(move.x, move.y);
+    }
+    board.updateGameStatus();
+    std::vector<std::pair<int32_t, int32_t>> hidden;
+    for (int32_t y = 0; y < height; y++) {
+        for (int32_t x = 0; x < width; x++) {
+            const Cell &cell = board.getCell(x, y);
+            if (not cell.isRevealed and not cell.isFlagged) {
+                hidden.emplace_back(x, y);
+            }
+        }
+    }
+    const BoardFork root(board);
+
+    // Siblings and their children all alive at once, each played against a board copy of its own.
+    // Forks and boards are reserved up front, so nothing moves while others share its tiles.
+    const int32_t siblings = 32;
+    std::vector<BoardFork> forks;
+    std::vector<GameBoard> copies;
+    forks.reserve(2 * siblings);
+    copies.reserve(2 * siblings);
+    for (int32_t i = 0; i < siblings; i++) {
+        forks.push_back(root.fork());
+        copies.push_back(board);
+    }
+    for (int32_t round = 0; round < 6; round++) {
+        // Halfway, every sibling forks a child, and the writes after that go to both
+        for (int32_t i = 0; round == 3 and i < siblings; i++) {
+            forks.push_back(forks[i].fork());
+            copies.push_back(copies[i]);
+        }
+        for (size_t i = 0; i < forks.size(); i++) {
+            playOnBoth(forks[i], copies[i], rng);
+        }
+    }
+    int64_t mismatches = isSameBoard(root, board) ? 0 : 1;
+    for (size_t i = 0; i < forks.size(); i++) {
+        mismatches += isSameBoard(forks[i], copies[i]) ? 0 : 1;
+    }
+    std::printf("%zu forks of one root, moves against board copies: %lld differ, root %s\n",
+                forks.size(), static_cast<long long>(mismatches),
+                isSameBoard(root, board) ? "unchanged" : "CHANGED");
+    forks.clear();
+
+    // Threads forking the shared root and their own forks at once, every fork checked as it goes
+    std::atomic<int64_t> threadMismatches{0};
+    const int32_t iterations = 2000;
+    std::vector<std::thread> workers;
+    for (int32_t thread = 0; thread < threads; thread++) {
+        workers.emplace_back([&, thread]() {
+            std::mt19937_64 threadRng(deriveSeed(seed, static_cast<uint64_t>(thread)));
+            int64_t differ = 0;
+            for (int32_t i = 0; i < iterations; i++) {
+                BoardFork child = root.fork();
+                GameBoard childBoard = board;
+                playOnBoth(child, childBoard, threadRng);
+                playOnBoth(child, childBoard, threadRng);
+                BoardFork grandchild = child.fork();
+                GameBoard grandchildBoard = childBoard;
+                playOnBoth(grandchild, grandchildBoard, threadRng);
+                playOnBoth(child, childBoard, threadRng);
+                differ += isSameBoard(child, childBoard) ? 0 : 1;
+                differ += isSameBoard(grandchild, grandchildBoard) ? 0 : 1;
+            }
+            threadMismatches += differ;
+        });
+    }
+    for (auto &worker: workers) {
+        worker.join();
+    }
+    bool isRootUnchanged = isSameBoard(root, board);
+    std::printf("%d threads forking the root and their own forks, %d times each: %lld differ, "
+                "root %s\n", threads, iterations, static_cast<long long>(threadMismatches.load()),
+                isRootUnchanged ? "unchanged" : "CHANGED");
+    mismatches += threadMismatches.load() + (isRootUnchanged ? 0 : 1);
+
+    // A fork costs a tile table and a reference per tile, a copy every cell
+    // The hashes are printed, so neither loop can be dropped
+    uint64_t hashes = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int64_t i = 0; i < branches; i++) {
+        BoardFork branch = root.fork();
+        hashes += branch.getVisibleHash();
+    }
+    double forkSeconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+    start = std::chrono::steady_clock::now();
+    for (int64_t i = 0; i < branches; i++) {
+        GameBoard copy = board;
+        hashes += copy.getVisibleHash();
+    }
+    double copySeconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+
+    int64_t copiedTiles = 0;
+    start = std::chrono::steady_clock::now();
+    for (int64_t i = 0; i < branches; i++) {
+        const auto [x, y] = hidden[i % hidden.size()];
+        BoardFork branch = root.fork();
+        branch.revealCell(x, y);
+        copiedTiles += branch.getCopiedTiles();
+    }
+    double forkBranchSeconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+    start = std::chrono::steady_clock::now();
+    for (int64_t i = 0; i < branches; i++) {
+        const auto [x, y] = hidden[i % hidden.size()];
+        GameBoard copy = board;
+        copy.revealCell(x, y);
+    }
+    double copyBranchSeconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+
+    std::printf("%dx%d, %zu hidden cells: fork %.0f ns, board copy %.0f ns (hashes %llx); fork "
+                "and reveal %.0f ns (%.2f tiles copied), board copy and reveal %.0f ns\n", width,
+                height, hidden.size(), forkSeconds / branches * 1e9, copySeconds / branches * 1e9,
+                static_cast<unsigned long long>(hashes),
+                forkBranchSeconds / branches * 1e9, static_cast<double>(copiedTiles) / branches,
+                copyBranchSeconds / branches * 1e9);
+    return mismatches == 0 ? 0 : 1;
+}
+
+
+// Exercises the renderer's CPU side on a board of any size: the first full instance build,
+// per-frame updates of an unchanged board, incremental updates after single-cell changes, and
+// touch hit-testing against the board layout.
+int runInstancesCommand(const Options &options) {
+    auto width = static_cast<int32_t>(options.getInt("width", 1000));
+    auto height = static_cast<int32_t>(options.getInt("height", 1000));
+    auto mines = static_cast<int32_t>(options.getInt("mines", static_cast<int64_t>(width) * height / 6));
+    uint64_t seed = options.getUnsigned("seed", 1);
+    int64_t frames = options.getInt("frames", 10000);
+    auto surfaceWidth = static_cast<int32_t>(options.getInt("surface-width", 1080));
+    auto surfaceHeight = static_cast<int32_t>(options.getInt("surface-height", 2340));
+    if (width <= 0 or height <= 0 or width > 65535 or height > 65535 or mines >= width * height) {
+        return usage();
+    }
+
+    GameBoard board(width, height, mines, seed);
+    board.initializeBoard(width / 2, height / 2);
+    board.revealCell(width / 2, height / 2);
+
+    InstanceBuilder builder;
+    auto start = std::chrono::steady_clock::now();
+    builder.update(board);
+    double buildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    // Everything is uploaded once, as if the whole board were on screen.
+    std::vector<InstanceRange> ranges;
+    size_t instanceCount = 0;
+    for (RenderTile &tile: builder.getTiles()) {
+        InstanceBuilder::collectDirtyRanges(tile, ranges);
+        instanceCount += tile.instances.size();
+    }
+
+    LatencyHistogram idle;
+    for (int64_t frame = 0; frame < frames; frame++) {
+        start = std::chrono::steady_clock::now();
+        builder.update(board);
+        idle.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count());
+    }
+
+    // Flag toggles change one cell each; what matters is that their cost and upload size do not
+    // grow with the board.
+    std::mt19937_64 rng(seed);
+    LatencyHistogram patch;
+    int64_t patchedBytes = 0;
+    int64_t moves = std::min<int64_t>(frames, 1000);
+    for (int64_t move = 0; move < moves; move++) {
+        auto x = static_cast<int32_t>(rng() % width);
+        auto y = static_cast<int32_t>(rng() % height);
+        if (board.getCell(x, y).isRevealed) {
+            continue;
+        }
+        board.toggleFlag(x, y);
+        start = std::chrono::steady_clock::now();
+        builder.update(board);
+        patch.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count());
+        RenderTile &tile = builder.getTiles()[(y >> RENDER_TILE_SHIFT) * builder.getTileColumns() +
+                                              (x >> RENDER_TILE_SHIFT)];
+        InstanceBuilder::collectDirtyRanges(tile, ranges);
+        for (const InstanceRange &range: ranges) {
+            patchedBytes += range.count * sizeof(CellInstance);
+        }
+    }
+
+    // Every cell centre, projected with the renderer's matrix, must hit-test back to that cell.
+    BoardCamera camera;
+    camera.reset(surfaceWidth, surfaceHeight, width, height);
+    float viewProjection[16];
+    camera.buildViewProjection(viewProjection);
+    int64_t misses = 0;
+    for (const RenderTile &tile: builder.getTiles()) {
+        for (const CellInstance &instance: tile.instances) {
+            float clipX = viewProjection[0] * (instance.x + 0.5f) + viewProjection[12];
+            float clipY = viewProjection[5] * (instance.y + 0.5f) + viewProjection[13];
+            int32_t x = -1;
+            int32_t y = -1;
+            if (not camera.cellAt((clipX + 1.f) * 0.5f * surfaceWidth,
+                                  (1.f - clipY) * 0.5f * surfaceHeight, x, y) or
+                x != instance.x or y != instance.y) {
+                misses += 1;
+            }
+        }
+    }
+
+    std::cout << "instances: " << instanceCount << " in " << builder.getTiles().size()
+              << " tiles (" << instanceCount * sizeof(CellInstance) / 1024.0 << " KiB)\n"
+              << "full build: " << buildSeconds * 1e3 << " ms\n"
+              << "unchanged frame update ns: p50 " << idle.percentile(0.5) << ", p99 "
+              << idle.percentile(0.99) << ", max " << idle.getMax() << "\n"
+              << "flag toggle update ns: p50 " << patch.percentile(0.5) << ", p99 "
+              << patch.percentile(0.99) << ", mean upload "
+              << static_cast<double>(patchedBytes) / std::max<uint64_t>(patch.getCount(), 1)
+              << " bytes\n"
+              << "cell size: " << camera.getPixelsPerCell() << " px, hit-test mismatches: "
+              << misses << "\n";
+    return misses == 0 ? 0 : 1;
+}
+
+
+int runViewCommand(const Options &options) {
+    auto width = static_cast<int32_t>(options.getInt("width", 1000));
+    auto height = static_cast<int32_t>(options.getInt("height", 1000));
+    uint64_t seed = options.getUnsigned("seed", 1);
+    int64_t positions = options.getInt("positions", 200);
+    auto surfaceWidth = static_cast<int32_t>(options.getInt("surface-width", 1080));
+    auto surfaceHeight = static_cast<int32_t>(options.getInt("surface-height", 2340));
+    if (width <= 0 or height <= 0 or width > 65535 or height > 65535 or positions <= 0) {
+        return usage();
+    }
+
+    GameBoard board(width, height, width * height / 6, seed);
+    board.initializeBoard(width / 2, height / 2);
+    board.revealCell(width / 2, height / 2);
+    InstanceBuilder builder;
+    builder.update(board);
+    const auto &tiles = builder.getTiles();
+
+    // At each zoom level the view is panned to random spots. Culling must keep every tile with a
+    // visible pixel, checked by hit-testing a grid of pixels across the surface.
+    std::mt19937_64 rng(seed);
+    BoardCamera camera;
+    camera.reset(surfaceWidth, surfaceHeight, width, height);
+    int64_t totalMisses = 0;
+    float lastPixelsPerCell = -1.f;
+    while (camera.getPixelsPerCell() != lastPixelsPerCell) {
+        lastPixelsPerCell = camera.getPixelsPerCell();
+        bool isZoomedOut = lastPixelsPerCell < LOD_PIXELS_PER_CELL;
+        int32_t maxTiles = 0;
+        size_t maxInstances = 0;
+        int64_t misses = 0;
+        LatencyHistogram cull;
+        for (int64_t position = 0; position < positions; position++) {
+            camera.pan(static_cast<float>(rng() % 2001) - 1000.f,
+                       static_cast<float>(rng() % 2001) - 1000.f);
+            auto start = std::chrono::steady_clock::now();
+            float viewProjection[16];
+            camera.buildViewProjection(viewProjection);
+            TileSpan span = visibleTiles(viewRectFromMatrix(viewProjection),
+                                         builder.getTileColumns(), builder.getTileRows());
+            cull.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - start).count());
+
+            size_t instances = 0;
+            for (int32_t row = span.firstRow; row < span.endRow; row++) {
+                for (int32_t column = span.firstColumn; column < span.endColumn; column++) {
+                    instances += tiles[row * builder.getTileColumns() + column].instances.size();
+                }
+            }
+            maxTiles = std::max(maxTiles, span.getTileCount());
+            maxInstances = std::max(maxInstances, isZoomedOut ? 0 : instances);
+
+            for (int32_t pixelY = 0; pixelY < surfaceHeight; pixelY += 16) {
+                for (int32_t pixelX = 0; pixelX < surfaceWidth; pixelX += 16) {
+                    int32_t x;
+                    int32_t y;
+                    if (not camera.cellAt(pixelX + 0.5f, pixelY + 0.5f, x, y)) {
+                        continue;
+                    }
+                    int32_t column = x >> RENDER_TILE_SHIFT;
+                    int32_t row = y >> RENDER_TILE_SHIFT;
+                    if (column < span.firstColumn or column >= span.endColumn or
+                        row < span.firstRow or row >= span.endRow) {
+                        misses += 1;
+                    }
+                }
+            }
+        }
+        std::cout << lastPixelsPerCell << " px/cell: " << (isZoomedOut ? "texels" : "instances")
+                  << ", at most " << maxTiles << "/" << tiles.size() << " tiles and "
+                  << maxInstances << " instances drawn, cull ns p50 " << cull.percentile(0.5)
+                  << ", culled visible pixels " << misses << "\n";
+        totalMisses += misses;
+        camera.zoomAt(surfaceWidth * 0.5f, surfaceHeight * 0.5f, 2.f);
+    }
+    return totalMisses == 0 ? 0 : 1;
+}
+
+
+// Drives a FrameScheduler the way the app's looper and Choreographer do, on a manual clock. Events
+// are delivered at their time; a posted vsync fires at the next refresh boundary.
+class SimulatedDisplay {
+public:
+    explicit SimulatedDisplay(int64_t refreshNanos) : refreshNanos(refreshNanos), scheduler(clock) {
+        scheduler.setActive(true);
+    }
+
+    // Runs the loop until untilNanos with no new events. Returns how often the loop woke up.
+    int64_t runUntil(int64_t untilNanos) {
+        int64_t wakeups = 0;
+        while (true) {
+            if (scheduler.wantsVsync()) {
+                scheduler.onVsyncPosted();
+                isVsyncPosted = true;
+            }
+            if (not isVsyncPosted) {
+                // blocked on the looper until the next event
+                break;
+            }
+            int64_t vsync = (clock.nowNanos() / refreshNanos + 1) * refreshNanos;
+            if (vsync > untilNanos) {
+                break;
+            }
+            clock.advance(vsync - clock.nowNanos());
+            isVsyncPosted = false;
+            wakeups += 1;
+            if (scheduler.onVsync(vsync) and eventNanos >= 0) {
+                eventToFrame.record(static_cast<uint64_t>(vsync - eventNanos));
+                eventNanos = -1;
+            }
+        }
+        clock.advance(untilNanos - clock.nowNanos());
+        return wakeups;
+    }
+
+    // An event at the current time, such as a touch or a board change. Counts as a wakeup.
+    void event(uint32_t reasons) {
+        scheduler.invalidate(reasons);
+        if (eventNanos < 0) {
+            eventNanos = clock.nowNanos();
+        }
+    }
+
+    int64_t now() const {
+        return clock.nowNanos();
+    }
+
+    FrameScheduler &getScheduler() {
+        return scheduler;
+    }
+
+    // Time from the first event a frame shows to the vsync it is drawn on.
+    const LatencyHistogram &getEventToFrame() const {
+        return eventToFrame;
+    }
+
+private:
+    int64_t refreshNanos;
+    ManualFrameClock clock;
+    FrameScheduler scheduler;
+    bool isVsyncPosted = false;
+    int64_t eventNanos = -1;
+    LatencyHistogram eventToFrame;
+};
+
+int runFramesCommand(const Options &options) {
+    int64_t refreshHz = options.getInt("refresh-hz", 60);
+    int64_t idleSeconds = options.getInt("idle-seconds", 60);
+    if (refreshHz <= 0 or idleSeconds <= 0) {
+        return usage();
+    }
+    const int64_t second = 1'000'000'000;
+    int64_t refresh = second / refreshHz;
+    SimulatedDisplay display(refresh);
+    FrameScheduler &scheduler = display.getScheduler();
+    bool isOk = true;
+
+    // A finished board nobody touches: the loop must stay blocked.
+    int64_t idleWakeups = display.runUntil(idleSeconds * second);
+    std::cout << "idle " << idleSeconds << " s: " << idleWakeups << " wakeups, "
+              << scheduler.getStats().frames << " frames\n";
+    isOk = isOk and idleWakeups == 0;
+
+    // A one second drag with touch events at 240 Hz, faster than the display: one frame per
+    // vsync, never more, each within a refresh of the touch.
+    int64_t framesBefore = scheduler.getStats().frames;
+    int64_t dragWakeups = 0;
+    int64_t dragEvents = 240;
+    for (int64_t event = 0; event < dragEvents; event++) {
+        display.event(FRAME_INPUT);
+        dragWakeups += 1 + display.runUntil(display.now() + second / dragEvents);
+    }
+    dragWakeups += display.runUntil(display.now() + second);
+    int64_t dragFrames = scheduler.getStats().frames - framesBefore;
+    std::cout << "drag: " << dragEvents << " touch events, " << dragFrames << " frames, "
+              << dragWakeups << " wakeups, event to frame ns p50 "
+              << display.getEventToFrame().percentile(0.5) << ", max "
+              << display.getEventToFrame().getMax() << "\n";
+    isOk = isOk and dragFrames <= refreshHz + 1 and
+           display.getEventToFrame().getMax() <= static_cast<uint64_t>(refresh);
+
+    // A 300 ms animation draws every vsync, then the loop goes quiet again.
+    framesBefore = scheduler.getStats().frames;
+    scheduler.animateUntil(display.now() + 300'000'000);
+    int64_t animationWakeups = display.runUntil(display.now() + 10 * second);
+    int64_t animationFrames = scheduler.getStats().frames - framesBefore;
+    std::cout << "300 ms animation: " << animationFrames << " frames, " << animationWakeups
+              << " wakeups\n";
+    isOk = isOk and animationFrames <= 300'000'000 / refresh + 1 and
+           animationWakeups <= animationFrames + 1;
+
+    // Changes while paused are drawn once on resume, not while paused.
+    framesBefore = scheduler.getStats().frames;
+    scheduler.setActive(false);
+    for (int32_t change = 0; change < 10; change++) {
+        display.event(FRAME_BOARD);
+        display.runUntil(display.now() + second);
+    }
+    int64_t pausedFrames = scheduler.getStats().frames - framesBefore;
+    scheduler.setActive(true);
+    display.runUntil(display.now() + second);
+    int64_t resumedFrames = scheduler.getStats().frames - framesBefore - pausedFrames;
+    std::cout << "paused: " << pausedFrames << " frames for 10 board changes, " << resumedFrames
+              << " on resume\n";
+    isOk = isOk and pausedFrames == 0 and resumedFrames == 1;
+
+    const FrameSchedulerStats &stats = scheduler.getStats();
+    std::cout << "total: " << stats.vsyncs << " vsyncs, " << stats.frames << " frames, "
+              << stats.idleVsyncs << " idle vsyncs\n";
+    return isOk ? 0 : 1;
+}
+
+
+// A scripted touch session with the gestures it must produce, one of each kind plus the cases that
+// must not produce one: the finger left down after a pinch, and a tap too late to chord.
+class TouchScript {
+public:
+    void down(int64_t millis, float x, float y) {
+        add(millis, TouchAction::DOWN, 0, {{0, x, y}});
+    }
+
+    void up(int64_t millis, float x, float y) {
+        add(millis, TouchAction::UP, 0, {{0, x, y}});
+    }
+
+    void move(int64_t millis, float x, float y) {
+        add(millis, TouchAction::MOVE, 0, {{0, x, y}});
+    }
+
+    void add(int64_t millis, TouchAction action, int32_t actionIndex,
+             std::initializer_list<TouchPointer> pointers) {
+        TouchEvent event{};
+        event.timeNanos = millis * 1'000'000;
+        event.action = action;
+        event.actionIndex = actionIndex;
+        for (const TouchPointer &pointer: pointers) {
+            event.pointers[event.pointerCount++] = pointer;
+        }
+        events.push_back(event);
+    }
+
+    void expect(GestureKind kind, int32_t count = 1) {
+        expected.insert(expected.end(), count, kind);
+    }
+
+    std::vector<TouchEvent> events;
+    std::vector<GestureKind> expected;
+};
+
+TouchScript buildTouchScript() {
+    TouchScript script;
+    script.down(0, 100.f, 100.f);
+    script.up(80, 100.f, 100.f);
+    script.expect(GestureKind::TAP);
+
+    script.down(250, 105.f, 102.f);
+    script.up(320, 105.f, 102.f);
+    script.expect(GestureKind::DOUBLE_TAP);
+
+    script.down(1000, 100.f, 100.f);
+    script.up(1500, 101.f, 100.f);
+    script.expect(GestureKind::LONG_PRESS);
+
+    // the first two moves stay within the slop
+    script.down(2000, 300.f, 300.f);
+    for (int32_t step = 1; step <= 10; step++) {
+        script.move(2000 + step * 8, 300.f + step * 10.f, 300.f);
+    }
+    script.up(2100, 400.f, 300.f);
+    script.expect(GestureKind::PAN, 8);
+
+    script.down(3000, 500.f, 500.f);
+    script.add(3010, TouchAction::POINTER_DOWN, 1, {{0, 500.f, 500.f}, {1, 600.f, 500.f}});
+    for (int32_t step = 1; step <= 5; step++) {
+        float spread = step * 20.f;
+        script.add(3010 + step * 8, TouchAction::MOVE, 0,
+                   {{0, 500.f - spread, 500.f}, {1, 600.f + spread, 500.f}});
+    }
+    script.expect(GestureKind::PINCH, 5);
+    script.add(3100, TouchAction::POINTER_UP, 0, {{0, 400.f, 500.f}, {1, 700.f, 500.f}});
+    script.add(3110, TouchAction::MOVE, 0, {{1, 650.f, 520.f}});
+    script.add(3120, TouchAction::UP, 0, {{1, 650.f, 520.f}});
+
+    script.down(4000, 100.f, 100.f);
+    script.up(4050, 100.f, 100.f);
+    script.expect(GestureKind::TAP);
+    return script;
+}
+
+int runGesturesCommand(const Options &options) {
+    const char *tracePath = options.get("trace", nullptr);
+    const char *recordPath = options.get("record", nullptr);
+    int64_t repeats = options.getInt("repeats", 10000);
+    if (repeats <= 0) {
+        return usage();
+    }
+
+    GestureRecognizer recognizer;
+    Gesture gesture;
+    if (tracePath != nullptr) {
+        // Replays a recorded trace and prints what it recognizes.
+        std::ifstream trace(tracePath);
+        if (not trace) {
+            std::cerr << "cannot open " << tracePath << "\n";
+            return 1;
+        }
+        std::string line;
+        int64_t lineNumber = 0;
+        while (std::getline(trace, line)) {
+            lineNumber += 1;
+            TouchEvent event;
+            if (not parseTouchEvent(line.c_str(), event)) {
+                std::cerr << tracePath << ":" << lineNumber << ": malformed event\n";
+                return 1;
+            }
+            if (recognizer.onEvent(event, gesture)) {
+                std::cout << event.timeNanos << " " << gestureName(gesture.kind) << " " << gesture.x
+                          << " " << gesture.y << " " << gesture.dx << " " << gesture.dy << " "
+                          << gesture.scale << "\n";
+            }
+        }
+        return 0;
+    }
+
+    TouchScript script = buildTouchScript();
+    if (recordPath != nullptr) {
+        std::ofstream trace(recordPath, std::ios::trunc);
+        char line[256];
+        for (const TouchEvent &event: script.events) {
+            formatTouchEvent(event, line, sizeof(line));
+            trace << line << "\n";
+        }
+    }
+
+    // The script must recognize the same whether fed directly or through the trace format.
+    bool isOk = true;
+    for (bool isReplay: {false, true}) {
+        recognizer.reset();
+        std::vector<GestureKind> recognized;
+        float pinchScale = 1.f;
+        for (const TouchEvent &original: script.events) {
+            TouchEvent event = original;
+            if (isReplay) {
+                char line[256];
+                formatTouchEvent(original, line, sizeof(line));
+                if (not parseTouchEvent(line, event)) {
+                    isOk = false;
+                    continue;
+                }
+            }
+            if (recognizer.onEvent(event, gesture)) {
+                recognized.push_back(gesture.kind);
+                if (gesture.kind == GestureKind::PINCH) {
+                    pinchScale *= gesture.scale;
+                }
+            }
+        }
+        bool isMatch = recognized == script.expected;
+        std::cout << (isReplay ? "replayed" : "direct") << ": " << recognized.size() << " of "
+                  << script.expected.size() << " gestures " << (isMatch ? "as expected" : "WRONG")
+                  << ", pinch scale " << pinchScale << " (expected 3)\n";
+        isOk = isOk and isMatch and std::abs(pinchScale - 3.f) < 1e-3f;
+    }
+
+    // Time per event with the script played back to back, shifted so taps never chord across runs.
+    LatencyHistogram perEvent;
+    int64_t gestures = 0;
+    recognizer.reset();
+    for (int64_t repeat = 0; repeat < repeats; repeat++) {
+        for (TouchEvent event: script.events) {
+            event.timeNanos += repeat * 10'000'000'000;
+            auto start = std::chrono::steady_clock::now();
+            bool isGesture = recognizer.onEvent(event, gesture);
+            perEvent.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - start).count());
+            gestures += isGesture ? 1 : 0;
+        }
+    }
+    std::cout << "recognizer ns per event: p50 " << perEvent.percentile(0.5) << ", p99 "
+              << perEvent.percentile(0.99) << ", max " << perEvent.getMax() << " over "
+              << perEvent.getCount() << " events (" << gestures << " gestures)\n";
+    return isOk ? 0 : 1;
+}
+
+
+int runCascadeCommand(const Options &options) {
+    auto width = static_cast<int32_t>(options.getInt("width", 1000));
+    auto height = static_cast<int32_t>(options.getInt("height", 1000));
+    auto mines = static_cast<int32_t>(options.getInt("mines", static_cast<int64_t>(width) * height / 1000));
+    uint64_t seed = options.getUnsigned("seed", 1);
+    auto budget = static_cast<int32_t>(options.getInt("budget", 16384));
+    if (width <= 0 or height <= 0 or width > 65535 or height > 65535 or mines >= width * height or
+        budget <= 0) {
+        return usage();
+    }
+
+    // A sparse board, so the first click opens most of it in one reveal.
+    GameBoard board(width, height, mines, seed);
+    board.initializeBoard(width / 2, height / 2);
+    GameBoard sliced = board;
+    GameBoard joined = board;
+    InstanceBuilder builder;
+    builder.update(board);
+    builder.setCellBudget(budget);
+    std::vector<InstanceRange> ranges;
+    for (RenderTile &tile: builder.getTiles()) {
+        InstanceBuilder::collectDirtyRanges(tile, ranges);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    int32_t opened = board.revealCell(width / 2, height / 2);
+    double revealMillis = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+
+    // The same reveal advanced by the budget each step must end in the same board.
+    LatencyHistogram engineSteps;
+    int32_t slicedOpened = sliced.beginReveal(width / 2, height / 2);
+    while (sliced.isRevealPending()) {
+        start = std::chrono::steady_clock::now();
+        slicedOpened += sliced.advanceReveal(budget);
+        engineSteps.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count());
+    }
+    bool isSame = slicedOpened == opened and sliced.getVisibleHash() == board.getVisibleHash();
+
+    // A tap while the wave is still filling joins it rather than cutting it short, so the board
+    // must end as if the second reveal had waited for the first.
+    int32_t second = 0;
+    while (joined.getCell(second % width, second / width).isMine) {
+        second += 1;
+    }
+    GameBoard waited = joined;
+    waited.revealCell(width / 2, height / 2);
+    waited.revealCell(second % width, second / width);
+    joined.beginReveal(width / 2, height / 2);
+    joined.advanceReveal(budget);
+    joined.beginReveal(second % width, second / width);
+    while (joined.isRevealPending()) {
+        joined.advanceReveal(budget);
+    }
+    bool isJoined = joined.getVisibleHash() == waited.getVisibleHash();
+
+    // The renderer's side: the game state is final already, the instances catch up by the budget
+    // each frame, as a wave from the clicked cell.
+    LatencyHistogram frames;
+    uint64_t maxFrameBytes = 0;
+    do {
+        start = std::chrono::steady_clock::now();
+        builder.update(board);
+        uint64_t bytes = 0;
+        for (RenderTile &tile: builder.getTiles()) {
+            InstanceBuilder::collectDirtyRanges(tile, ranges);
+            for (const InstanceRange &range: ranges) {
+                bytes += range.count * sizeof(CellInstance);
+            }
+        }
+        frames.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count());
+        maxFrameBytes = std::max(maxFrameBytes, bytes);
+    } while (builder.hasPendingCells());
+
+    int64_t mismatches = 0;
+    for (const RenderTile &tile: builder.getTiles()) {
+        for (const CellInstance &instance: tile.instances) {
+            if (instance.tile != cellTile(board.getCell(instance.x, instance.y), board.state)) {
+                mismatches += 1;
+            }
+        }
+    }
+
+    std::cout << "opening: " << opened << " cells, synchronous reveal " << revealMillis << " ms\n"
+              << "sliced reveal: " << engineSteps.getCount() << " steps of " << budget
+              << " cells, step ns p50 " << engineSteps.percentile(0.5) << ", max "
+              << engineSteps.getMax() << ", " << (isSame ? "same board" : "DIFFERENT board") << "\n"
+              << "reveal started mid-wave: "
+              << (isJoined ? "joined the wave" : "DIFFERENT board from revealing in turn") << "\n"
+              << "animated frames: " << frames.getCount() << ", frame ns p50 "
+              << frames.percentile(0.5) << ", max " << frames.getMax() << ", max upload "
+              << maxFrameBytes << " bytes, instance mismatches after " << mismatches << "\n";
+    return isSame and isJoined and mismatches == 0 ? 0 : 1;
+}
+
+
+// Milliseconds from starting loader until it has the atlas, cold from drawing it or warm from the
+// cache.
+double loadAtlas(AtlasLoader &loader, const std::string &cachePath, int32_t tileSize) {
+    auto start = std::chrono::steady_clock::now();
+    loader.start(cachePath, tileSize, nullptr);
+    while (not loader.isReady()) {
+        std::this_thread::yield();
+    }
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+            .count();
+}
+
+int runAtlasCommand(const Options &options) {
+    std::string cachePath = options.get("cache", "cell_atlas.bin");
+    auto tileSize = static_cast<int32_t>(options.getInt("tile-size", 64));
+    auto threads = static_cast<int32_t>(options.getInt("threads", 0));
+    if (tileSize <= 0 or (tileSize & (tileSize - 1)) != 0 or threads < 0) {
+        return usage();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    AtlasImage serial = buildAtlasImage(tileSize, 1);
+    double serialMillis = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+    start = std::chrono::steady_clock::now();
+    AtlasImage parallel = buildAtlasImage(tileSize, threads);
+    double parallelMillis = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+
+    // A cold start draws the atlas and leaves the cache behind, a warm one reads it back.
+    std::remove(cachePath.c_str());
+    double coldMillis;
+    bool isColdCached;
+    {
+        AtlasLoader loader;
+        coldMillis = loadAtlas(loader, cachePath, tileSize);
+        isColdCached = loader.wasCached();
+    }
+    AtlasImage warm;
+    double warmMillis;
+    bool isWarmCached;
+    {
+        AtlasLoader loader;
+        warmMillis = loadAtlas(loader, cachePath, tileSize);
+        isWarmCached = loader.wasCached();
+        warm = loader.getImage();
+    }
+    bool isSame = serial.levels == parallel.levels and warm.levels == serial.levels;
+
+    // The last level keeps one texel per tile, which should be about the tile's average colour.
+    int32_t worstError = 0;
+    const std::vector<uint8_t> &base = serial.levels.front();
+    const std::vector<uint8_t> &last = serial.levels.back();
+    int32_t side = serial.getLevelSide(0);
+    for (int32_t tile = 0; tile < ATLAS_COLUMNS * ATLAS_COLUMNS; tile++) {
+        int32_t left = tile % ATLAS_COLUMNS * tileSize;
+        int32_t top = tile / ATLAS_COLUMNS * tileSize;
+        for (int32_t channel = 0; channel < 4; channel++) {
+            int64_t sum = 0;
+            for (int32_t y = top; y < top + tileSize; y++) {
+                for (int32_t x = left; x < left + tileSize; x++) {
+                    sum += base[(static_cast<size_t>(y) * side + x) * 4 + channel];
+                }
+            }
+            auto average = static_cast<int32_t>(sum / (tileSize * tileSize));
+            int32_t texel = last[static_cast<size_t>(tile) * 4 + channel];
+            worstError = std::max(worstError, std::abs(texel - average));
+        }
+    }
+
+    // A damaged cache must be redrawn rather than shown.
+    bool isDamageCaught;
+    {
+        std::fstream file(cachePath, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(-1, std::ios::end);
+        file.put('\x5a');
+    }
+    {
+        AtlasImage damaged;
+        isDamageCaught = not readAtlasCache(cachePath, tileSize, damaged);
+    }
+    std::remove(cachePath.c_str());
+
+    size_t bytes = 0;
+    for (const auto &level: serial.levels) {
+        bytes += level.size();
+    }
+    std::cout << "atlas: " << side << " px, " << serial.levels.size() << " levels, " << bytes
+              << " bytes\n"
+              << "draw: 1 thread " << serialMillis << " ms, " << resolveThreadCount(threads)
+              << " threads " << parallelMillis << " ms\n"
+              << "cold start: " << coldMillis << " ms to ready ("
+              << (isColdCached ? "cached" : "drawn") << ")\n"
+              << "warm start: " << warmMillis << " ms to ready ("
+              << (isWarmCached ? "cached" : "drawn") << ")\n"
+              << "levels " << (isSame ? "identical" : "DIFFER") << ", worst last-level error "
+              << worstError << ", damaged cache " << (isDamageCaught ? "rejected" : "ACCEPTED")
+              << "\n";
+    bool isOk = isSame and not isColdCached and isWarmCached and worstError <= 2 and
+                isDamageCaught;
+    return isOk ? 0 : 1;
+}
+
+
+int runProgramsCommand(const Options &options) {
+    std::string cachePath = options.get("cache", "program.bin");
+    auto size = static_cast<size_t>(options.getInt("bytes", 48 * 1024));
+    if (size == 0) {
+        return usage();
+    }
+
+    // Any change to the driver strings, the sources or the bindings must give another key.
+    const char *vertex = "#version 300 es\nvoid main() {}\n";
+    uint64_t key = programCacheKey({"vendor", "renderer", "OpenGL ES 3.2 V@1", vertex, "inUV"});
+    bool isKeyed = key != programCacheKey({"vendor", "renderer", "OpenGL ES 3.2 V@2", vertex,
+                                           "inUV"}) and
+                   key != programCacheKey({"vendor", "renderer", "OpenGL ES 3.2 V@1", vertex,
+                                           "inPosition"}) and
+                   key != programCacheKey({"vendorrenderer", "", "OpenGL ES 3.2 V@1", vertex,
+                                           "inUV"});
+
+    ProgramBinary binary;
+    binary.format = 0x8741;
+    binary.bytes.resize(size);
+    uint64_t state = 0x9e3779b97f4a7c15ull;
+    for (uint8_t &byte: binary.bytes) {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        byte = static_cast<uint8_t>(state >> 56);
+    }
+
+    std::remove(cachePath.c_str());
+    ProgramBinary loaded;
+    bool isMissRejected = not readProgramBinary(cachePath, key, loaded);
+    auto start = std::chrono::steady_clock::now();
+    bool isWritten = writeProgramBinary(cachePath, key, binary);
+    double writeMillis = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+    start = std::chrono::steady_clock::now();
+    bool isRead = readProgramBinary(cachePath, key, loaded);
+    double readMillis = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+    bool isSame = isRead and loaded.format == binary.format and loaded.bytes == binary.bytes;
+    bool isOtherKeyRejected = not readProgramBinary(cachePath, key + 1, loaded);
+    {
+        std::fstream file(cachePath, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(-1, std::ios::end);
+        file.put('\x5a');
+    }
+    bool isDamageRejected = not readProgramBinary(cachePath, key, loaded);
+    std::remove(cachePath.c_str());
+
+    // A profile on made up times, to show the line the app logs.
+    StartupProfile profile;
+    profile.begin(1'000'000'000);
+    const int64_t offsets[] = {4'000'000, 21'000'000, 23'500'000, 30'000'000, 27'000'000,
+                               47'000'000};
+    for (int32_t i = 0; i < static_cast<int32_t>(StartupPhase::COUNT); i++) {
+        profile.mark(static_cast<StartupPhase>(i), 1'000'000'000 + offsets[i]);
+    }
+    profile.mark(StartupPhase::SHADERS, 1'900'000'000);
+    profile.isShaderCached = true;
+    char line[512];
+    profile.format(line, sizeof(line));
+    bool isProfileRight = profile.isComplete() and
+                          std::strstr(line, "\"shaders_ms\":23.5,") != nullptr and
+                          std::strstr(line, "\"shader_cache\":true,") != nullptr;
+
+    std::cout << "key: " << (isKeyed ? "changes with every input" : "COLLIDES") << "\n"
+              << "binary: " << size << " bytes, write " << writeMillis << " ms, read "
+              << readMillis << " ms, " << (isSame ? "identical" : "DIFFERENT") << "\n"
+              << "rejected: missing " << (isMissRejected ? "yes" : "NO") << ", other key "
+              << (isOtherKeyRejected ? "yes" : "NO") << ", damaged "
+              << (isDamageRejected ? "yes" : "NO") << "\n"
+              << "profile: " << line << "\n";
+    bool isOk = isKeyed and isWritten and isSame and isMissRejected and isOtherKeyRejected and
+                isDamageRejected and isProfileRight;
+    return isOk ? 0 : 1;
+}
+
+
+// The glyph atlas bilinearly sampled at (u, v) in texels of level 0, like GL_LINEAR does.
+float sampleGlyphAtlas(float u, float v) {
+    float x = u - 0.5f;
+    float y = v - 0.5f;
+    auto x0 = static_cast<int32_t>(std::floor(x));
+    auto y0 = static_cast<int32_t>(std::floor(y));
+    float fx = x - x0;
+    float fy = y - y0;
+    auto at = [](int32_t tx, int32_t ty) {
+        tx = std::min(std::max(tx, 0), GLYPH_ATLAS_SIZE - 1);
+        ty = std::min(std::max(ty, 0), GLYPH_ATLAS_SIZE - 1);
+        return static_cast<float>(GLYPH_ATLAS[ty * GLYPH_ATLAS_SIZE + tx]);
+    };
+    float top = at(x0, y0) * (1.f - fx) + at(x0 + 1, y0) * fx;
+    float bottom = at(x0, y0 + 1) * (1.f - fx) + at(x0 + 1, y0 + 1) * fx;
+    return top * (1.f - fy) + bottom * fy;
+}
+
+int runGlyphsCommand(const Options &options) {
+    auto maxScale = static_cast<int32_t>(options.getInt("max-scale", 512));
+    if (maxScale < GLYPH_SIZE) {
+        return usage();
+    }
+
+    // The compiled in atlas must be what the distance function gives at run time.
+    int32_t worstBakeError = 0;
+    int32_t worstEdgeValue = 0;
+    for (int32_t glyph = 0; glyph < GLYPH_COUNT; glyph++) {
+        int32_t left = glyph % GLYPH_COLUMNS * GLYPH_SIZE;
+        int32_t top = glyph / GLYPH_COLUMNS * GLYPH_SIZE;
+        for (int32_t y = 0; y < GLYPH_SIZE; y++) {
+            for (int32_t x = 0; x < GLYPH_SIZE; x++) {
+                float distance = glyphDistance(glyph, (x + 0.5f) / GLYPH_SIZE,
+                                               (y + 0.5f) / GLYPH_SIZE);
+                float value = 128.f - distance * GLYPH_SIZE / GLYPH_SPREAD * 127.f;
+                value = std::min(std::max(value, 0.f), 255.f);
+                int32_t baked = GLYPH_ATLAS[(top + y) * GLYPH_ATLAS_SIZE + left + x];
+                worstBakeError = std::max(worstBakeError,
+                                          std::abs(baked - static_cast<int32_t>(value + 0.5f)));
+                if (x == 0 or y == 0 or x == GLYPH_SIZE - 1 or y == GLYPH_SIZE - 1) {
+                    worstEdgeValue = std::max(worstEdgeValue, baked);
+                }
+            }
+        }
+    }
+
+    // Rasterize every glyph at growing sizes by thresholding the sampled field, as the cell shader
+    // does, and count pixels whose side of the edge differs from the exact shape. Pixels within
+    // half a pixel of the edge are antialiased on screen and not counted.
+    std::cout << "glyph atlas: " << GLYPH_ATLAS_SIZE << " px square, "
+              << static_cast<int32_t>(GLYPH_COUNT) << " glyphs, " << sizeof(GLYPH_ATLAS) << " bytes compiled in, worst difference from "
+              << "a run time bake " << worstBakeError << ", brightest slot edge texel "
+              << worstEdgeValue << "\n";
+    bool isCrisp = true;
+    for (int32_t scale = 8; scale <= maxScale; scale *= 2) {
+        int64_t pixels = 0;
+        int64_t wrong = 0;
+        for (int32_t glyph = 0; glyph < GLYPH_COUNT; glyph++) {
+            float left = static_cast<float>(glyph % GLYPH_COLUMNS * GLYPH_SIZE);
+            float top = static_cast<float>(glyph / GLYPH_COLUMNS * GLYPH_SIZE);
+            for (int32_t py = 0; py < scale; py++) {
+                for (int32_t px = 0; px < scale; px++) {
+                    float x = (px + 0.5f) / scale;
+                    float y = (py + 0.5f) / scale;
+                    float distance = glyphDistance(glyph, x, y);
+                    if (std::abs(distance) * scale < 0.5f) {
+                        continue;
+                    }
+                    pixels += 1;
+                    float field = sampleGlyphAtlas(left + x * GLYPH_SIZE, top + y * GLYPH_SIZE);
+                    if ((field >= 128.f) != (distance < 0.f)) {
+                        wrong += 1;
+                    }
+                }
+            }
+        }
+        double wrongPercent = 100.0 * static_cast<double>(wrong) / static_cast<double>(pixels);
+        std::cout << "  " << scale << " px per cell: " << wrong << " of " << pixels
+                  << " pixels on the wrong side of an edge (" << wrongPercent << "%)\n";
+        isCrisp = isCrisp and wrongPercent < 0.5;
+    }
+    return worstBakeError <= 1 and worstEdgeValue < 128 and isCrisp ? 0 : 1;
+}
+
+
+struct LogCounts {
+    uint64_t received = 0;
+    uint64_t outOfOrder = 0;
+};
+
+// Counts what reaches the sink and checks that each thread's records arrive in the order they were
+// logged. Only the logging thread calls it; counts outlive it, as stopLogging releases the sink.
+class CountingLogSink : public LogSink {
+public:
+    explicit CountingLogSink(LogCounts &counts) : counts(counts) {}
+
+    void write(const LogRecord &record) override {
+        uint32_t sequence = 0;
+        if (std::sscanf(record.text, "message %u", &sequence) != 1) {
+            return;
+        }
+        if (record.threadIndex >= lastSequence.size()) {
+            lastSequence.resize(record.threadIndex + 1, -1);
+        }
+        if (static_cast<int64_t>(sequence) <= lastSequence[record.threadIndex]) {
+            counts.outOfOrder += 1;
+        }
+        lastSequence[record.threadIndex] = sequence;
+        counts.received += 1;
+    }
+
+private:
+    LogCounts &counts;
+    std::vector<int64_t> lastSequence;
+};
+
+struct LogRun {
+    uint64_t attempted = 0;
+    uint64_t written = 0;
+    uint64_t dropped = 0;
+    uint64_t received = 0;
+    uint64_t outOfOrder = 0;
+    LatencyHistogram callNanos;
+};
+
+// threads producers log messages records each, pausing pauseMillis after every burst records.
+LogRun runLogThreads(int32_t threads, int32_t messages, int32_t burst, int32_t pauseMillis) {
+    LogCounts counts;
+    LogStats before = getLogStats();
+    startLogging(std::make_unique<CountingLogSink>(counts));
+    std::vector<LatencyHistogram> histograms(threads);
+    std::vector<std::thread> workers;
+    for (int32_t thread = 0; thread < threads; thread++) {
+        workers.emplace_back([&histograms, thread, messages, burst, pauseMillis]() {
+            for (int32_t i = 0; i < messages; i++) {
+                auto start = std::chrono::steady_clock::now();
+                LOGI("message %d from producer %d", i, thread);
+                histograms[thread].record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - start).count());
+                if (burst > 0 and (i + 1) % burst == 0) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(pauseMillis));
+                }
+            }
+        });
+    }
+    for (auto &worker: workers) {
+        worker.join();
+    }
+    stopLogging();
+    LogStats after = getLogStats();
+
+    LogRun run;
+    run.attempted = static_cast<uint64_t>(threads) * messages;
+    run.written = after.written - before.written;
+    run.dropped = after.dropped - before.dropped;
+    run.received = counts.received;
+    run.outOfOrder = counts.outOfOrder;
+    for (const auto &histogram: histograms) {
+        run.callNanos.merge(histogram);
+    }
+    return run;
+}
+
+void printLogRun(const char *name, const LogRun &run) {
+    std::cout << name << ": " << run.attempted << " logged, " << run.received << " written, "
+              << run.dropped << " dropped, " << run.outOfOrder << " out of order\n"
+              << "  per call: p50 " << run.callNanos.percentile(0.5) << " ns, p99 "
+              << run.callNanos.percentile(0.99) << " ns, max " << run.callNanos.getMax()
+              << " ns\n";
+}
+
+int runLogCommand(const Options &options) {
+    auto threads = static_cast<int32_t>(options.getInt("threads", 4));
+    auto messages = static_cast<int32_t>(options.getInt("messages", 20000));
+    if (threads <= 0 or messages <= 0) {
+        return usage();
+    }
+    setLogLevel(LOG_LEVEL_INFO);
+
+    // A steady stream stays well inside the rings between drains, so nothing is lost. A flood
+    // fills them: the extra records are dropped and counted, and no caller waits for room.
+    LogRun steady = runLogThreads(threads, std::min(messages, 2000), 16, 5);
+    LogRun flood = runLogThreads(threads, messages, 0, 0);
+    printLogRun("steady", steady);
+    printLogRun("flood", flood);
+
+    // Calls below the run time level cost a relaxed load; calls below MINESWEEPER_MIN_LOG_LEVEL
+    // are not compiled at all.
+    constexpr int32_t filteredCalls = 1'000'000;
+    auto start = std::chrono::steady_clock::now();
+    for (int32_t i = 0; i < filteredCalls; i++) {
+        LOGD("filtered at run time %d", i);
+    }
+    double runtimeNanos = std::chrono::duration<double, std::nano>(
+            std::chrono::steady_clock::now() - start).count() / filteredCalls;
+    start = std::chrono::steady_clock::now();
+    for (int32_t i = 0; i < filteredCalls; i++) {
+        LOGV("filtered at compile time %d", i);
+    }
+    double compileNanos = std::chrono::duration<double, std::nano>(
+            std::chrono::steady_clock::now() - start).count() / filteredCalls;
+    std::cout << "filtered call: run time " << runtimeNanos << " ns, compile time "
+              << compileNanos << " ns\n";
+
+    // What the stderr sink writes, as it would for a desktop build
+    startLogging(std::make_unique<FileLogSink>(stderr));
+    setLogLevel(LOG_LEVEL_DEBUG);
+    LOGD("debug records show once the level is lowered");
+    LOGI("info from the main thread");
+    LOGW("warnings and errors wake the logging thread at once");
+    stopLogging();
+    setLogLevel(LOG_LEVEL_INFO);
+
+    bool isOk = steady.dropped == 0 and steady.received == steady.attempted and
+                flood.received == flood.written and
+                flood.written + flood.dropped == flood.attempted and
+                steady.outOfOrder == 0 and flood.outOfOrder == 0;
+    return isOk ? 0 : 1;
+}
+
+// Plays games with random clicks the way the app applies taps, with the same spans and counters.
+// Returns the cells revealed.
+uint64_t playTracedGames(const Difficulty &difficulty, uint64_t seed, int32_t games) {
+    uint64_t revealed = 0;
+    uint64_t state = seed * 0x9e3779b97f4a7c15ull + 1;
+    for (int32_t game = 0; game < games; game++) {
+        GameBoard board(difficulty.width, difficulty.height, difficulty.mineCount, seed + game);
+        while (board.state == STARTED or board.state == ONGOING) {
+            state = state * 6364136223846793005ull + 1442695040888963407ull;
+            auto x = static_cast<int32_t>((state >> 33) % difficulty.width);
+            auto y = static_cast<int32_t>((state >> 13) % difficulty.height);
+            if (board.getCell(x, y).isRevealed) {
+                continue;
+            }
+            {
+                ScopedTrace trace(TraceOp::REVEAL_CELL);
+                if (board.state == STARTED) {
+                    board.initializeBoard(x, y);
+                }
+                int32_t opened = board.revealCell(x, y);
+                countTrace(TraceCounter::CELLS_REVEALED, opened);
+                revealed += opened;
+            }
+            ScopedTrace trace(TraceOp::UPDATE_STATUS);
+            board.updateGameStatus();
+        }
+    }
+    return revealed;
+}
+
+int runTraceCommand(const Options &options) {
+    std::string outPath = options.get("out", "trace.json");
+    auto games = static_cast<int32_t>(options.getInt("games", 200));
+    auto threads = static_cast<int32_t>(options.getInt("threads", 2));
+    Difficulty difficulty{};
+    if (not parseDifficulty(options.get("difficulty", "expert"), difficulty) or games <= 0 or
+        threads <= 0) {
+        return usage();
+    }
+
+    // What a span costs while tracing is off, which is how production builds run
+    constexpr int32_t spanCalls = 10'000'000;
+    auto start = std::chrono::steady_clock::now();
+    for (int32_t i = 0; i < spanCalls; i++) {
+        ScopedTrace trace(TraceOp::RENDER);
+    }
+    double offNanos = std::chrono::duration<double, std::nano>(
+            std::chrono::steady_clock::now() - start).count() / spanCalls;
+
+    resetTraceStats();
+    startTracing();
+    start = std::chrono::steady_clock::now();
+    constexpr int32_t tracedCalls = 10'000;
+    for (int32_t i = 0; i < tracedCalls; i++) {
+        ScopedTrace trace(TraceOp::RENDER);
+    }
+    double onNanos = std::chrono::duration<double, std::nano>(
+            std::chrono::steady_clock::now() - start).count() / tracedCalls;
+
+    std::vector<uint64_t> revealed(threads);
+    std::vector<std::thread> workers;
+    for (int32_t thread = 0; thread < threads; thread++) {
+        workers.emplace_back([&revealed, &difficulty, thread, games]() {
+            revealed[thread] = playTracedGames(difficulty, 1000 * (thread + 1), games);
+        });
+    }
+    uint64_t totalRevealed = 0;
+    for (int32_t thread = 0; thread < threads; thread++) {
+        workers[thread].join();
+        totalRevealed += revealed[thread];
+    }
+    stopTracing();
+    bool isWritten = writeChromeTrace(outPath);
+
+    std::cout << "span cost: " << offNanos << " ns with tracing off, " << onNanos
+              << " ns with tracing on\n";
+    for (int32_t op = 0; op < static_cast<int32_t>(TraceOp::COUNT); op++) {
+        LatencyHistogram latency = getTraceLatency(static_cast<TraceOp>(op));
+        if (latency.getCount() == 0) {
+            continue;
+        }
+        std::cout << "  " << traceOpName(static_cast<TraceOp>(op)) << ": " << latency.getCount()
+                  << " spans, p50 " << latency.percentile(0.5) << " ns, p99 "
+                  << latency.percentile(0.99) << " ns, max " << latency.getMax() << " ns\n";
+    }
+    for (int32_t counter = 0; counter < static_cast<int32_t>(TraceCounter::COUNT); counter++) {
+        std::cout << "  " << traceCounterName(static_cast<TraceCounter>(counter)) << ": "
+                  << getTraceCount(static_cast<TraceCounter>(counter)) << "\n";
+    }
+
+    // The file must hold one JSON object per buffered event
+    size_t fileEvents = 0;
+    {
+        std::ifstream file(outPath);
+        std::string line;
+        while (std::getline(file, line)) {
+            fileEvents += line.find("\"ph\":") != std::string::npos ? 1 : 0;
+        }
+    }
+    std::cout << "trace: " << getTraceEventCount() << " events, " << getDroppedTraceEvents()
+              << " dropped, " << fileEvents << " written to " << outPath << "\n";
+    bool isOk = isWritten and fileEvents == getTraceEventCount() and
+                getTraceCount(TraceCounter::CELLS_REVEALED) == totalRevealed and
+                getTraceLatency(TraceOp::RENDER).getCount() == tracedCalls;
+    return isOk ? 0 : 1;
+}
+
+// Drives InputLatencyTracker the way the render loop does, on a simulated clock: taps at random
+// times reach the loop after a dispatch delay, are applied, and are drawn on the next vsync with
+// random render and swap costs. A frame is shown one refresh after the vsync following its swap,
+// and with withPresent that time is reported a frame later, as EGL_ANDROID_get_frame_timestamps
+// does. Prints the breakdown and returns false if any input went unmeasured or the stages do not
+// add up to the total.
+bool simulateInputLatency(int64_t refreshNanos, int32_t inputs, uint64_t seed, bool withPresent) {
+    ManualFrameClock clock;
+    FrameScheduler scheduler(clock);
+    scheduler.setActive(true);
+    InputLatencyTracker tracker(clock);
+    uint64_t state = seed * 0x9e3779b97f4a7c15ull + 1;
+    auto uniform = [&state](int64_t low, int64_t high) {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        return low + static_cast<int64_t>((state >> 11) % static_cast<uint64_t>(high - low + 1));
+    };
+
+    struct Present {
+        int32_t frame;
+        int64_t atNanos;
+    };
+    std::vector<Present> presents;
+    auto pollPresents = [&]() {
+        size_t kept = 0;
+        for (const Present &present: presents) {
+            if (present.atNanos <= clock.nowNanos()) {
+                tracker.onPresented(present.frame, present.atNanos);
+            } else {
+                presents[kept++] = present;
+            }
+        }
+        presents.resize(kept);
+    };
+
+    int32_t sent = 0;
+    int64_t inputNanos = uniform(0, 100'000'000);
+    int64_t vsyncNanos = -1;
+    while (sent < inputs or vsyncNanos >= 0) {
+        int64_t readNanos = std::max(inputNanos + uniform(300'000, 2'000'000), clock.nowNanos());
+        if (sent < inputs and (vsyncNanos < 0 or readNanos <= vsyncNanos)) {
+            clock.advance(readNanos - clock.nowNanos());
+            int64_t dequeueNanos = clock.nowNanos();
+            clock.advance(uniform(50'000, 400'000));
+            tracker.onInputApplied(inputNanos, dequeueNanos);
+            scheduler.invalidate(FRAME_INPUT);
+            sent += 1;
+            inputNanos += uniform(20'000'000, 200'000'000);
+        } else {
+            clock.advance(vsyncNanos - clock.nowNanos());
+            vsyncNanos = -1;
+            if (scheduler.onVsync(clock.nowNanos())) {
+                int32_t frame = tracker.beginFrame();
+                clock.advance(uniform(2'000'000, 6'000'000));
+                tracker.onSwapStarted(frame);
+                clock.advance(uniform(200'000, 1'000'000));
+                tracker.onSwapFinished(frame, withPresent and frame >= 0);
+                if (withPresent and frame >= 0) {
+                    int64_t latch = (clock.nowNanos() / refreshNanos + 1) * refreshNanos;
+                    presents.push_back(Present{frame, latch + refreshNanos});
+                }
+                pollPresents();
+            }
+        }
+        if (scheduler.wantsVsync()) {
+            scheduler.onVsyncPosted();
+            vsyncNanos = (clock.nowNanos() / refreshNanos + 1) * refreshNanos;
+        }
+    }
+    // The last frames' times would arrive with the next frame drawn
+    clock.advance(10 * refreshNanos);
+    pollPresents();
+
+    char line[256];
+    tracker.format(line, sizeof(line));
+    std::cout << (withPresent ? "to presentation: " : "to swap: ") << line << "\n";
+    double stageMeans = 0.0;
+    for (int32_t stage = 0; stage < static_cast<int32_t>(LatencyStage::TOTAL); stage++) {
+        stageMeans += tracker.getHistogram(static_cast<LatencyStage>(stage)).getMean();
+    }
+    double totalMean = tracker.getHistogram(LatencyStage::TOTAL).getMean();
+    return tracker.getSamples() == static_cast<uint64_t>(inputs) and tracker.getDropped() == 0 and
+           tracker.getUnpresented() == 0 and std::abs(stageMeans - totalMean) < 1.0;
+}
+
+int runLatencyCommand(const Options &options) {
+    int64_t refreshHz = options.getInt("refresh-hz", 60);
+    auto inputs = static_cast<int32_t>(options.getInt("inputs", 2000));
+    uint64_t seed = options.getUnsigned("seed", 1);
+    if (refreshHz <= 0 or inputs <= 0) {
+        return usage();
+    }
+    int64_t refreshNanos = 1'000'000'000 / refreshHz;
+    bool isOk = simulateInputLatency(refreshNanos, inputs, seed, false);
+    isOk = simulateInputLatency(refreshNanos, inputs, seed, true) and isOk;
+    return isOk ? 0 : 1;
+}
+
+// One job of the scheduler benchmark: plays games [first, last) with the probability strategy and
+// returns the wins, stopping between games once token is cancelled.
+int64_t playJobGames(const Difficulty &difficulty, int64_t first, int64_t last,
+                     const CancellationToken &token, std::atomic<int64_t> &played) {
+    GameBoard board(difficulty.width, difficulty.height, difficulty.mineCount, 0);
+    auto strategy = makeStrategy(StrategyKind::PROBABILITY);
+    BoardAnalyzer analyzer;
+    SelfPlayReport report;
+    for (int64_t game = first; game < last and not token.isCancelled(); game++) {
+        playGame(board, *strategy, deriveSeed(1, game), analyzer, report);
+        played.fetch_add(1, std::memory_order_relaxed);
+    }
+    return report.wins;
+}
+
+Task<int64_t> playJobTask(const Difficulty &difficulty, int64_t first, int64_t last,
+                          CancellationToken token, std::atomic<int64_t> &played) {
+    co_return playJobGames(difficulty, first, last, token, played);
+}
+
+// Splits [first, last) in halves down to grain, so each level forks from inside a worker.
+Task<int64_t> sumSplit(TaskScheduler &scheduler, int64_t first, int64_t last, int64_t grain) {
+    if (last - first <= grain) {
+        int64_t sum = 0;
+        for (int64_t i = first; i < last; i++) {
+            sum += static_cast<int64_t>(deriveSeed(7, i) & 0xff);
+        }
+        co_return sum;
+    }
+    int64_t middle = first + (last - first) / 2;
+    std::vector<Task<int64_t>> halves;
+    halves.push_back(sumSplit(scheduler, first, middle, grain));
+    halves.push_back(sumSplit(scheduler, middle, last, grain));
+    std::vector<int64_t> sums = co_await whenAll(scheduler, std::move(halves));
+    co_return sums[0] + sums[1];
+}
+
+int runTasksCommand(const Options &options) {
+    auto threads = static_cast<int32_t>(options.getInt("threads", 0));
+    int64_t jobs = options.getInt("jobs", 256);
+    int64_t gamesPerJob = options.getInt("games-per-job", 4);
+    Difficulty difficulty{};
+    if (not parseDifficulty(options.get("difficulty", "beginner"), difficulty) or jobs <= 0 or
+        gamesPerJob <= 0) {
+        return usage();
+    }
+    TaskScheduler scheduler(threads);
+    CancellationToken never;
+    std::atomic<int64_t> played{0};
+    auto millisSince = [](std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - start).count();
+    };
+
+    // The naive way: a thread per job
+    auto start = std::chrono::steady_clock::now();
+    std::vector<int64_t> threadWins(jobs);
+    {
+        std::vector<std::thread> jobThreads;
+        for (int64_t job = 0; job < jobs; job++) {
+            jobThreads.emplace_back([&, job]() {
+                threadWins[job] = playJobGames(difficulty, job * gamesPerJob,
+                                               (job + 1) * gamesPerJob, never, played);
+            });
+        }
+        for (auto &thread: jobThreads) {
+            thread.join();
+        }
+    }
+    double threadMillis = millisSince(start);
+
+    start = std::chrono::steady_clock::now();
+    std::vector<Task<int64_t>> tasks;
+    for (int64_t job = 0; job < jobs; job++) {
+        tasks.push_back(playJobTask(difficulty, job * gamesPerJob, (job + 1) * gamesPerJob, never,
+                                    played));
+    }
+    std::vector<int64_t> taskWins = syncWait(whenAll(scheduler, std::move(tasks)));
+    double taskMillis = millisSince(start);
+    std::cout << jobs << " jobs of " << gamesPerJob << " " << difficulty.name << " games: thread "
+              << "per job " << threadMillis << " ms, scheduler with " << scheduler.getThreadCount()
+              << " workers " << taskMillis << " ms\n";
+
+    // Forks from inside workers, down to small leaves
+    const int64_t values = 1 << 20;
+    start = std::chrono::steady_clock::now();
+    int64_t splitSum = syncWait(sumSplit(scheduler, 0, values, 4096));
+    double splitMillis = millisSince(start);
+    int64_t serialSum = 0;
+    for (int64_t i = 0; i < values; i++) {
+        serialSum += static_cast<int64_t>(deriveSeed(7, i) & 0xff);
+    }
+    TaskSchedulerStats stats = scheduler.getStats();
+    std::cout << "recursive split of " << values << " values into " << values / 4096
+              << " leaves: " << splitMillis << " ms, " << stats.resumed << " resumes so far, "
+              << stats.stolen << " stolen\n";
+
+    // A long run cancelled part way, like a new game abandoning the last one's generation
+    CancellationSource source;
+    played.store(0);
+    tasks.clear();
+    const int64_t longJobs = 64;
+    for (int64_t job = 0; job < longJobs; job++) {
+        tasks.push_back(playJobTask(difficulty, job * 1'000'000, (job + 1) * 1'000'000,
+                                    source.getToken(), played));
+    }
+    std::thread waiter([&scheduler, &tasks]() {
+        syncWait(whenAll(scheduler, std::move(tasks)));
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    start = std::chrono::steady_clock::now();
+    source.cancel();
+    waiter.join();
+    double cancelMillis = millisSince(start);
+    std::cout << "cancelled after " << played.load() << " games, all " << longJobs
+              << " jobs returned " << cancelMillis << " ms after the cancel\n";
+
+    bool isOk = threadWins == taskWins and splitSum == serialSum and played.load() > 0 and
+                played.load() < longJobs * 1'000'000;
+    return isOk ? 0 : 1;
+}
+
+// Whether the first click at (x, y) left its zone clear, kept the mine count and left every count
+// matching its neighbours.
+bool isFirstClickValid(const GameBoard &board, int32_t x, int32_t y, int32_t zoneRadius) {
+    int32_t mines = 0;
+    for (int32_t cellY = 0; cellY < board.getHeight(); cellY++) {
+        for (int32_t cellX = 0; cellX < board.getWidth(); cellX++) {
+            const Cell &cell = board.getCell(cellX, cellY);
+            if (cell.isMine) {
+                mines += 1;
+                if (std::abs(cellX - x) <= zoneRadius and std::abs(cellY - y) <= zoneRadius) {
+                    return false;
+                }
+                continue;
+            }
+            int32_t count = 0;
+            for (int32_t dy = -1; dy <= 1; dy++) {
+                for (int32_t dx = -1; dx <= 1; dx++) {
+                    int32_t nx = cellX + dx;
+                    int32_t ny = cellY + dy;
+                    if (0 <= nx and nx < board.getWidth() and 0 <= ny and ny < board.getHeight() and
+                        board.getCell(nx, ny).isMine) {
+                        count += 1;
+                    }
+                }
+            }
+            if (count != cell.adjacentMines) {
+                return false;
+            }
+        }
+    }
+    return mines == board.getMineCount();
+}
+
+int runFirstClickCommand(const Options &options) {
+    int64_t boards = options.getInt("boards", 200);
+    uint64_t seed = options.getUnsigned("seed", 1);
+    int64_t samples = options.getInt("samples", 200000);
+    if (boards <= 0 or samples <= 0) {
+        return usage();
+    }
+    const Difficulty sizes[] = {DIFFICULTIES[0], DIFFICULTIES[2], {"huge", 1000, 1000, 160000}};
+    bool isOk = true;
+
+    // The first tap with the mines generated on the spot, as before, and generated ahead
+    for (const Difficulty &size: sizes) {
+        int64_t sizeBoards = size.width * size.height > 100000 ? std::max<int64_t>(boards / 20, 1)
+                                                               : boards;
+        LatencyHistogram synchronous;
+        LatencyHistogram pregenerated;
+        GameBoard board(size.width, size.height, size.mineCount, 0, SAFE_AREA);
+        for (int64_t i = 0; i < sizeBoards; i++) {
+            uint64_t boardSeed = deriveSeed(seed, i);
+            auto x = static_cast<int32_t>(boardSeed % size.width);
+            auto y = static_cast<int32_t>(boardSeed / size.width % size.height);
+            for (int32_t pass = 0; pass < 2; pass++) {
+                board.reset(boardSeed);
+                if (pass == 1) {
+                    board.generateMines();
+                }
+                auto start = std::chrono::steady_clock::now();
+                board.initializeBoard(x, y);
+                auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - start).count();
+                (pass == 0 ? synchronous : pregenerated).record(nanos);
+                isOk = isOk and isFirstClickValid(board, x, y, 1);
+            }
+        }
+        std::printf("%-9s %4dx%-4d %6d mines: first tap p50 %9.1f us, max %9.1f us generated on "
+                    "tap; p50 %5.2f us, max %6.2f us generated ahead\n", size.name, size.width,
+                    size.height, size.mineCount, synchronous.percentile(0.5) / 1e3,
+                    synchronous.getMax() / 1e3, pregenerated.percentile(0.5) / 1e3,
+                    pregenerated.getMax() / 1e3);
+    }
+
+    // Handing generated mines to another board gives the layout of generating in place
+    GameBoard generated(30, 16, 99, seed);
+    GameBoard adopting(30, 16, 99, seed);
+    GameBoard inPlace(30, 16, 99, seed);
+    generated.generateMines();
+    inPlace.generateMines();
+    bool isAdopted = adopting.adoptMines(generated) and not adopting.adoptMines(inPlace);
+    adopting.initializeBoard(3, 4);
+    inPlace.initializeBoard(3, 4);
+    for (int32_t y = 0; y < 16; y++) {
+        for (int32_t x = 0; x < 30; x++) {
+            isAdopted = isAdopted and
+                        adopting.getCell(x, y).isMine == inPlace.getCell(x, y).isMine and
+                        adopting.getCell(x, y).adjacentMines == inPlace.getCell(x, y).adjacentMines;
+        }
+    }
+    std::printf("adopted mines match mines generated in place: %s\n", isAdopted ? "yes" : "no");
+    isOk = isOk and isAdopted;
+
+    // Every cell outside the zone must be a mine equally often, for a click in the middle and
+    // in a corner where the zone is cut short
+    const int32_t clicks[2][2] = {{2, 2}, {0, 0}};
+    for (const auto &click: clicks) {
+        std::vector<int64_t> hits(25);
+        GameBoard small(5, 5, 10, 0, SAFE_AREA);
+        for (int64_t i = 0; i < samples; i++) {
+            small.reset(deriveSeed(seed + 1, i));
+            small.generateMines();
+            small.initializeBoard(click[0], click[1]);
+            for (int32_t cell = 0; cell < 25; cell++) {
+                hits[cell] += small.getCell(cell % 5, cell / 5).isMine ? 1 : 0;
+            }
+        }
+        auto isInZone = [&click](int32_t cell) {
+            return std::abs(cell % 5 - click[0]) <= 1 and std::abs(cell / 5 - click[1]) <= 1;
+        };
+        int32_t outside = 0;
+        for (int32_t cell = 0; cell < 25; cell++) {
+            outside += isInZone(cell) ? 0 : 1;
+        }
+        double expected = 10.0 / outside;
+        double worst = 0;
+        for (int32_t cell = 0; cell < 25; cell++) {
+            double rate = static_cast<double>(hits[cell]) / static_cast<double>(samples);
+            worst = std::max(worst, std::abs(rate - (isInZone(cell) ? 0.0 : expected)));
+        }
+        // Five standard errors of a single cell's rate
+        double tolerance = 5 * std::sqrt(expected * (1 - expected) / static_cast<double>(samples));
+        std::printf("5x5 with 10 mines, first click (%d, %d): each of %d cells a mine %.4f of the "
+                    "time, worst deviation %.4f (tolerance %.4f)\n", click[0], click[1], outside,
+                    expected, worst, tolerance);
+        isOk = isOk and worst <= tolerance;
+    }
+    return isOk ? 0 : 1;
+}
+
+// A field of /proc/self/status in KiB, such as VmRSS or VmHWM, or -1 where there is none.
+int64_t readProcessStatusKib(const char *field) {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    size_t length = std::strlen(field);
+    while (std::getline(status, line)) {
+        if (line.compare(0, length, field) == 0 and line.size() > length and line[length] == ':') {
+            return std::strtoll(line.c_str() + length + 1, nullptr, 10);
+        }
+    }
+    return -1;
+}
+
+bool writeTextFile(const std::string &path, const std::string &text) {
+    std::ofstream file(path);
+    file << text;
+    file.flush();
+    return file.good();
+}
+
+// A memory cgroup the process moved itself into, and the one it came from.
+struct MemoryCgroup {
+    std::string directory;
+    std::string parent;
+    // The file the kernel keeps the group's peak usage in bytes
+    std::string peakFile;
+};
+
+// Moves the process into a new memory cgroup below its own that is limited to limitBytes, page
+// cache included, so the kernel reclaims mapped pages rather than let the process grow past the
+// limit. Tries the unified (v2) hierarchy, then the v1 memory controller. Returns false, having
+// changed nothing, where neither is mounted writable, as in most containers and without root.
+bool enterMemoryCgroup(int64_t limitBytes, MemoryCgroup &outGroup) {
+    std::ifstream self("/proc/self/cgroup");
+    std::string line;
+    std::string unifiedPath;
+    std::string memoryPath;
+    while (std::getline(self, line)) {
+        size_t first = line.find(':');
+        size_t second = line.find(':', first + 1);
+        if (first == std::string::npos or second == std::string::npos) {
+            continue;
+        }
+        std::string controllers = "," + line.substr(first + 1, second - first - 1) + ",";
+        if (controllers == ",,") {
+            unifiedPath = line.substr(second + 1);
+        } else if (controllers.find(",memory,") != std::string::npos) {
+            memoryPath = line.substr(second + 1);
+        }
+    }
+    std::string name = "/minesweeper_mapped_" + std::to_string(getpid());
+    std::string limit = std::to_string(limitBytes);
+    struct Hierarchy {
+        std::string parent;
+        const char *limitFile;
+        const char *peakFile;
+    };
+    std::vector<Hierarchy> hierarchies;
+    if (not unifiedPath.empty() and std::filesystem::exists("/sys/fs/cgroup/cgroup.controllers")) {
+        hierarchies.push_back({"/sys/fs/cgroup" + unifiedPath, "memory.max", "memory.peak"});
+    }
+    if (not memoryPath.empty()) {
+        hierarchies.push_back({"/sys/fs/cgroup/memory" + memoryPath, "memory.limit_in_bytes",
+                               "memory.max_usage_in_bytes"});
+    }
+    for (const Hierarchy &hierarchy: hierarchies) {
+        std::string directory = hierarchy.parent + name;
+        std::error_code error;
+        if (hierarchy.limitFile == std::string("memory.max")) {
+            // Children only get the controller once the parent hands it down; fails harmlessly
+            // where it already does or cannot
+            writeTextFile(hierarchy.parent + "/cgroup.subtree_control", "+memory");
+        }
+        if (not std::filesystem::create_directory(directory, error)) {
+            continue;
+        }
+        if (writeTextFile(directory + "/" + hierarchy.limitFile, limit) and
+            writeTextFile(directory + "/cgroup.procs", std::to_string(getpid()))) {
+            outGroup = MemoryCgroup{directory, hierarchy.parent,
+                                    directory + "/" + hierarchy.peakFile};
+            return true;
+        }
+        std::filesystem::remove(directory, error);
+    }
+    return false;
+}
+
+// Moves the process back to the group it came from and removes the one it made.
+void leaveMemoryCgroup(const MemoryCgroup &group) {
+    std::error_code error;
+    writeTextFile(group.parent + "/cgroup.procs", std::to_string(getpid()));
+    std::filesystem::remove(group.directory, error);
+}
+
+// The group's peak usage in KiB, or -1 where the kernel does not keep it.
+int64_t readCgroupPeakKib(const MemoryCgroup &group) {
+    std::ifstream file(group.peakFile);
+    int64_t bytes = -1;
+    if (not(file >> bytes)) {
+        return -1;
+    }
+    return bytes / 1024;
+}
+
+// Checks every cell of the board band by band, releasing pages as it goes: counts match the
+// neighbours, the mines add up and so do the revealed cells, and no revealed cell is a mine unless
+// the game was lost.
+bool isMappedBoardValid(MappedBoard &board) {
+    int64_t mines = 0;
+    int64_t revealed = 0;
+    bool isValid = true;
+    for (int32_t y = 0; y < board.getHeight(); y++) {
+        for (int32_t x = 0; x < board.getWidth(); x++) {
+            Cell cell = board.getCell(x, y);
+            mines += cell.isMine ? 1 : 0;
+            revealed += cell.isRevealed ? 1 : 0;
+            if (cell.isMine) {
+                isValid = isValid and (not cell.isRevealed or board.getState() == STEPPED_MINE);
+                continue;
+            }
+            int32_t count = 0;
+            for (int32_t dy = -1; dy <= 1; dy++) {
+                for (int32_t dx = -1; dx <= 1; dx++) {
+                    int32_t nx = x + dx;
+                    int32_t ny = y + dy;
+                    if (0 <= nx and nx < board.getWidth() and 0 <= ny and ny < board.getHeight() and
+                        board.getCell(nx, ny).isMine) {
+                        count += 1;
+                    }
+                }
+            }
+            isValid = isValid and count == cell.adjacentMines;
+        }
+        if ((y + 1) % MAPPED_TILE_CELLS == 0) {
+            board.releasePages();
+        }
+    }
+    return isValid and mines == board.getMineCount() and revealed == board.getRevealedCount();
+}
+
+// Generates, plays, reopens and checks a board in a file several times the memory limit, and fails
+// if the process's peak resident memory, mapped file pages included, ever exceeds the limit. Where
+// it can, the command runs in a memory cgroup with that limit, so the kernel enforces it.
+int runMappedCommand(const Options &options) {
+    std::string path = options.get("path", "minesweeper_board.bin");
+    int64_t memoryLimitMib = options.getInt("memory-limit-mib", 64);
+    // A square board whose file is four times the limit, rounded up to whole tiles
+    auto side = static_cast<int64_t>(std::ceil(std::sqrt(4.0 * static_cast<double>(
+            memoryLimitMib) * (1 << 20)) / MAPPED_TILE_CELLS)) * MAPPED_TILE_CELLS;
+    auto width = static_cast<int32_t>(options.getInt("width", side));
+    auto height = static_cast<int32_t>(options.getInt("height", side));
+    int64_t mines = options.getInt("mines", static_cast<int64_t>(width) * height / 8);
+    int64_t moves = options.getInt("moves", 5000);
+    int64_t releaseEvery = options.getInt("release-every", 0);
+    uint64_t seed = options.getUnsigned("seed", 1);
+    if (memoryLimitMib <= 0 or side > INT32_MAX or width <= 0 or height <= 0 or mines < 0 or
+        moves < 0 or releaseEvery < 0) {
+        return usage();
+    }
+    int64_t limitKib = memoryLimitMib * 1024;
+    // What is resident already stays charged to the old group, so the new one gets the rest
+    MemoryCgroup group;
+    int64_t residentKib = std::max<int64_t>(readProcessStatusKib("VmRSS"), 0);
+    bool isEnforced = residentKib < limitKib and
+                      enterMemoryCgroup((limitKib - residentKib) * 1024, group);
+    if (releaseEvery == 0) {
+        // Without a cgroup nothing reclaims the mapped pages but releasePages, and a read fault
+        // may map a whole large folio of the page cache, up to a few MiB on recent kernels
+        releaseEvery = isEnforced ? 1000 : 4;
+    }
+    if (isEnforced) {
+        std::printf("limit enforced by memory cgroup %s; releasing pages every %lld moves\n",
+                    group.directory.c_str(), static_cast<long long>(releaseEvery));
+    } else {
+        std::printf("no writable memory cgroup, so the limit is only measured; releasing pages "
+                    "every %lld moves keeps the process under it\n",
+                    static_cast<long long>(releaseEvery));
+    }
+    double fileMib = static_cast<double>(MappedBoard::getFileBytes(width, height)) / (1 << 20);
+    std::printf("%dx%d board with %lld mines in %s: %.1f MiB, %.1f times the %lld MiB limit\n",
+                width, height, static_cast<long long>(mines), path.c_str(), fileMib,
+                fileMib / static_cast<double>(memoryLimitMib),
+                static_cast<long long>(memoryLimitMib));
+
+    MappedBoard board;
+    if (not board.create(path, width, height, mines, seed, SAFE_AREA)) {
+        std::cerr << "could not create " << path << "\n";
+        if (isEnforced) {
+            leaveMemoryCgroup(group);
+        }
+        return 1;
+    }
+    auto start = std::chrono::steady_clock::now();
+    board.generateMines();
+    board.flush();
+    auto generateSeconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+    int64_t generatedPeakKib = readProcessStatusKib("VmHWM");
+    std::printf("generated in %.2f s, peak resident %.1f MiB\n", generateSeconds,
+                static_cast<double>(generatedPeakKib) / 1024);
+
+    // Random play: reveal hidden cells all over the board, flagging the mines it would hit, so the
+    // game goes on and every move lands on cold pages
+    LatencyHistogram moveLatency;
+    int64_t revealedByMoves = 0;
+    int64_t maxResidentKib = 0;
+    std::mt19937_64 g(seed);
+    board.initializeBoard(width / 2, height / 2);
+    board.revealCell(width / 2, height / 2);
+    for (int64_t move = 0; move < moves; move++) {
+        auto x = static_cast<int32_t>(g() % static_cast<uint64_t>(width));
+        auto y = static_cast<int32_t>(g() % static_cast<uint64_t>(height));
+        Cell cell = board.getCell(x, y);
+        if (cell.isRevealed or cell.isFlagged) {
+            continue;
+        }
+        auto moveStart = std::chrono::steady_clock::now();
+        if (cell.isMine) {
+            board.toggleFlag(x, y);
+        } else {
+            revealedByMoves += board.revealCell(x, y);
+        }
+        board.updateGameStatus();
+        moveLatency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - moveStart).count());
+        if ((move + 1) % releaseEvery == 0) {
+            maxResidentKib = std::max(maxResidentKib, readProcessStatusKib("VmRSS"));
+            board.releasePages();
+        }
+    }
+    board.flush();
+    int64_t playedPeakKib = readProcessStatusKib("VmHWM");
+    std::printf("%lld moves revealed %lld cells: p50 %.1f us, p99 %.1f us, max %.1f ms per move; "
+                "resident at most %.1f MiB between releases, peak %.1f MiB\n",
+                static_cast<long long>(moveLatency.getCount()),
+                static_cast<long long>(revealedByMoves), moveLatency.percentile(0.5) / 1e3,
+                moveLatency.percentile(0.99) / 1e3, static_cast<double>(moveLatency.getMax()) / 1e6,
+                static_cast<double>(maxResidentKib) / 1024,
+                static_cast<double>(playedPeakKib) / 1024);
+
+    // What was flushed must come back from the file alone
+    int64_t revealedBefore = board.getRevealedCount();
+    GameStatus stateBefore = board.getState();
+    board.close();
+    if (not board.open(path)) {
+        std::cerr << "could not reopen " << path << "\n";
+        if (isEnforced) {
+            leaveMemoryCgroup(group);
+        }
+        return 1;
+    }
+    bool isReopened =
+            board.getRevealedCount() == revealedBefore and board.getState() == stateBefore;
+    start = std::chrono::steady_clock::now();
+    bool isValid = isMappedBoardValid(board);
+    auto checkSeconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+    board.close();
+    // VmHWM is the peak of the whole run, so this covers generation and play as well
+    int64_t peakKib = readProcessStatusKib("VmHWM");
+    bool isWithinLimit = 0 <= peakKib and peakKib <= limitKib;
+    std::printf("reopened: %s, every cell checked in %.2f s: %s, peak resident %.1f MiB "
+                "(%.1f%% of the file): %s the %lld MiB limit\n",
+                isReopened ? "same state" : "state lost", checkSeconds,
+                isValid ? "valid" : "INVALID", static_cast<double>(peakKib) / 1024,
+                100.0 * static_cast<double>(peakKib) / 1024 / fileMib,
+                isWithinLimit ? "within" : "OVER", static_cast<long long>(memoryLimitMib));
+    if (isEnforced) {
+        // Page cache counts against the group too, so its peak is at its limit by design
+        std::printf("memory cgroup peak %.1f MiB of %.1f MiB, page cache included\n",
+                    static_cast<double>(readCgroupPeakKib(group)) / 1024,
+                    static_cast<double>(limitKib - residentKib) / 1024);
+        leaveMemoryCgroup(group);
+    }
+    return isReopened and isValid and isWithinLimit ? 0 : 1;
+}
+
+// Plays games and app-like frames, and counts this thread's heap allocations after a short warm-up
+// that sizes every buffer: from then on play must not allocate at all.
+int runAllocsCommand(const Options &options) {
+    int64_t games = options.getInt("games", 500);
+    int64_t frames = options.getInt("frames", 20000);
+    uint64_t seed = options.getUnsigned("seed", 1);
+    Difficulty difficulty{};
+    if (not parseDifficulty(options.get("difficulty", "expert"), difficulty) or games <= 0 or
+        frames <= 0) {
+        return usage();
+    }
+    const int64_t warmUpGames = 1;
+    const int64_t warmUpFrames = 100;
+    bool isOk = true;
+
+    // Bot play, with every strategy
+    TranspositionTable table(16);
+    const StrategyKind kinds[] = {StrategyKind::DEDUCTIVE, StrategyKind::PROBABILITY,
+                                  StrategyKind::RANDOM};
+    for (StrategyKind kind: kinds) {
+        GameBoard board(difficulty.width, difficulty.height, difficulty.mineCount, 0);
+        auto strategy = makeStrategy(kind, &table);
+        BoardAnalyzer analyzer;
+        SelfPlayReport report;
+        for (int64_t game = 0; game < warmUpGames; game++) {
+            playGame(board, *strategy, deriveSeed(seed, game), analyzer, report);
+        }
+        int64_t before = threadAllocations;
+        for (int64_t game = 0; game < games; game++) {
+            playGame(board, *strategy, deriveSeed(seed, warmUpGames + game), analyzer, report);
+        }
+        int64_t allocations = threadAllocations - before;
+        std::printf("%-11s %lld games, %lld moves: %lld allocations\n", strategyName(kind),
+                    static_cast<long long>(games), static_cast<long long>(report.moves),
+                    static_cast<long long>(allocations));
+        isOk = isOk and allocations == 0;
+    }
+
+    // The app's path: traced moves on a recorded board, then the instance update and upload ranges
+    // of every frame, starting a new game on the same board whenever one ends
+    startTracing();
+    GameBoard board(difficulty.width, difficulty.height, difficulty.mineCount, seed, SAFE_AREA);
+    InstanceBuilder builder;
+    builder.setCellBudget(64);
+    std::vector<InstanceRange> ranges;
+    std::mt19937_64 g(seed);
+    int64_t newGames = 0;
+    int64_t before = 0;
+    for (int64_t frame = 0; frame < warmUpFrames + frames; frame++) {
+        if (frame == warmUpFrames) {
+            before = threadAllocations;
+        }
+        if (board.state == STEPPED_MINE or board.state == VICTORY) {
+            board.reset(deriveSeed(seed, static_cast<uint64_t>(frame)));
+            newGames += 1;
+        }
+        auto x = static_cast<int32_t>(g() % static_cast<uint64_t>(difficulty.width));
+        auto y = static_cast<int32_t>(g() % static_cast<uint64_t>(difficulty.height));
+        {
+            ScopedTrace trace(TraceOp::HANDLE_INPUT);
+            if (board.state == STARTED) {
+                board.initializeBoard(x, y);
+                board.revealCell(x, y);
+            } else if (board.getCell(x, y).isRevealed) {
+                ScopedTrace chord(TraceOp::CHORD_CELL);
+                board.chordCell(x, y);
+            } else if (board.getCell(x, y).isMine or g() % 8 == 0) {
+                ScopedTrace flag(TraceOp::TOGGLE_FLAG);
+                board.toggleFlag(x, y);
+            } else if (not board.getCell(x, y).isFlagged) {
+                ScopedTrace reveal(TraceOp::REVEAL_CELL);
+                countTrace(TraceCounter::CELLS_REVEALED, board.revealCell(x, y));
+            }
+            ScopedTrace status(TraceOp::UPDATE_STATUS);
+            board.updateGameStatus();
+        }
+        ScopedTrace render(TraceOp::RENDER);
+        builder.update(board);
+        for (RenderTile &tile: builder.getTiles()) {
+            InstanceBuilder::collectDirtyRanges(tile, ranges);
+            countTrace(TraceCounter::GL_DRAWS);
+        }
+    }
+    int64_t allocations = threadAllocations - before;
+    stopTracing();
+    std::printf("frames      %lld frames, %lld new games: %lld allocations\n",
+                static_cast<long long>(frames), static_cast<long long>(newGames),
+                static_cast<long long>(allocations));
+    isOk = isOk and allocations == 0;
+
+    // An opening far larger than a frame's budget, spread as the app spreads it, with a flag
+    // toggled on and off every frame while the instances are still catching up
+    GameBoard sparse(256, 256, 16, seed, SAFE_AREA);
+    builder.setCellBudget(64);
+    builder.update(sparse);
+    sparse.initializeBoard(128, 128);
+    int32_t waveCells = sparse.beginReveal(128, 128);
+    int32_t flagIndex = 0;
+    while (not sparse.getCell(flagIndex % 256, flagIndex / 256).isMine) {
+        flagIndex += 1;
+    }
+    int64_t waveFrames = 0;
+    before = threadAllocations;
+    do {
+        waveCells += sparse.advanceReveal(256);
+        for (int32_t toggle = 0; toggle < 2; toggle++) {
+            sparse.toggleFlag(flagIndex % 256, flagIndex / 256);
+        }
+        sparse.updateGameStatus();
+        builder.update(sparse);
+        for (RenderTile &tile: builder.getTiles()) {
+            InstanceBuilder::collectDirtyRanges(tile, ranges);
+        }
+        waveFrames += 1;
+    } while (sparse.isRevealPending() or builder.hasPendingCells());
+    allocations = threadAllocations - before;
+    std::printf("mid-wave    %lld frames, %d cells opened, a flag toggled twice a frame: "
+                "%lld allocations\n", static_cast<long long>(waveFrames), waveCells,
+                static_cast<long long>(allocations));
+    isOk = isOk and allocations == 0;
+    return isOk ? 0 : 1;
+}
+
+// Hardware cache misses of the calling thread between start and stop, from perf_event_open.
+// Unavailable off Linux, or where the kernel or a sandbox does not allow it.
+class CacheMissCounter {
+public:
+    CacheMissCounter() {
+#ifdef __linux__
+        perf_event_attr attributes{};
+        attributes.type = PERF_TYPE_HARDWARE;
+        attributes.size = sizeof(attributes);
+        attributes.config = PERF_COUNT_HW_CACHE_MISSES;
+        attributes.disabled = 1;
+        attributes.exclude_kernel = 1;
+        attributes.exclude_hv = 1;
+        fileDescriptor = static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0));
+#endif
+    }
+
+    CacheMissCounter(const CacheMissCounter &) = delete;
+
+    CacheMissCounter &operator=(const CacheMissCounter &) = delete;
+
+    ~CacheMissCounter() {
+#ifdef __linux__
+        if (fileDescriptor >= 0) {
+            close(fileDescriptor);
+        }
+#endif
+    }
+
+    bool isAvailable() const {
+        return fileDescriptor >= 0;
+    }
+
+    void start() {
+#ifdef __linux__
+        if (fileDescriptor >= 0) {
+            ioctl(fileDescriptor, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fileDescriptor, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    // Misses since start, or -1 if unavailable.
+    int64_t stop() {
+#ifdef __linux__
+        if (fileDescriptor >= 0) {
+            ioctl(fileDescriptor, PERF_EVENT_IOC_DISABLE, 0);
+            int64_t misses = 0;
+            if (read(fileDescriptor, &misses, sizeof(misses)) == sizeof(misses)) {
+                return misses;
+            }
+        }
+#endif
+        return -1;
+    }
+
+private:
+    int fileDescriptor = -1;
+};
+
+struct PhaseTiming {
+    double seconds = 0;
+    int64_t cacheMisses = -1;
+    // Cells the phase worked on, for per-cell rates.
+    int64_t cells = 0;
+};
+
+template<class Work>
+PhaseTiming timePhase(CacheMissCounter &counter, Work work) {
+    PhaseTiming timing;
+    counter.start();
+    auto start = std::chrono::steady_clock::now();
+    timing.cells = work();
+    timing.seconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    timing.cacheMisses = counter.stop();
+    return timing;
+}
+
+struct LayoutRun {
+    PhaseTiming generate;
+    PhaseTiming reveal;
+    PhaseTiming snapshot;
+};
+
+// Best of runs boards for each phase: generating the mines and their counts, revealing from the
+// centre (a sparse board, so most of it opens) and reading the visible state of every cell in
+// row-major order, as saving or exporting does. outSnapshot is left with the last run's
+// visible codes.
+template<class Layout>
+LayoutRun benchmarkLayout(int32_t width, int32_t height, int32_t mines, uint64_t seed, int32_t runs,
+                          CacheMissCounter &counter, std::vector<int8_t> &outSnapshot) {
+    BasicGameBoard<Layout> board(width, height, mines, seed, SAFE_AREA);
+    outSnapshot.resize(static_cast<size_t>(width) * height);
+    LayoutRun best;
+    auto keepFaster = [](PhaseTiming &best, const PhaseTiming &timing) {
+        if (best.cells == 0 or timing.seconds < best.seconds) {
+            best = timing;
+        }
+    };
+    for (int32_t run = 0; run < runs; run++) {
+        board.reset(deriveSeed(seed, run));
+        keepFaster(best.generate, timePhase(counter, [&]() {
+            board.generateMines();
+            return static_cast<int64_t>(width) * height;
+        }));
+        board.initializeBoard(width / 2, height / 2);
+        keepFaster(best.reveal, timePhase(counter, [&]() {
+            return static_cast<int64_t>(board.revealCell(width / 2, height / 2));
+        }));
+        keepFaster(best.snapshot, timePhase(counter, [&]() {
+            size_t i = 0;
+            for (int32_t y = 0; y < height; y++) {
+                for (int32_t x = 0; x < width; x++) {
+                    outSnapshot[i++] = static_cast<int8_t>(visibleCode(board.getCell(x, y)));
+                }
+            }
+            return static_cast<int64_t>(width) * height;
+        }));
+    }
+    return best;
+}
+
+void printPhase(const PhaseTiming &timing) {
+    std::printf(" %9.1f", static_cast<double>(timing.cells) / timing.seconds / 1e6);
+    if (timing.cacheMisses < 0) {
+        std::printf(" %7s", "n/a");
+    } else {
+        std::printf(" %7.3f", static_cast<double>(timing.cacheMisses) /
+                              static_cast<double>(std::max<int64_t>(timing.cells, 1)));
+    }
+}
+
+// Benchmarks every cell layout GameBoard is instantiated for, on boards from expert size up to
+// --max-size square, and checks that all layouts end each run in the same visible board.
+int runLayoutsCommand(const Options &options) {
+    auto maxSize = static_cast<int32_t>(options.getInt("max-size", 4096));
+    int64_t minePermille = options.getInt("mine-permille", 20);
+    auto runs = static_cast<int32_t>(options.getInt("runs", 3));
+    uint64_t seed = options.getUnsigned("seed", 1);
+    if (maxSize < 32 or maxSize > 16384 or minePermille <= 0 or minePermille >= 1000 or runs <= 0) {
+        return usage();
+    }
+
+    std::vector<std::pair<int32_t, int32_t>> sizes = {{30, 16}};
+    for (int32_t size = 64; size <= maxSize; size *= 4) {
+        sizes.emplace_back(size, size);
+    }
+    if (sizes.back().first != maxSize) {
+        sizes.emplace_back(maxSize, maxSize);
+    }
+
+    CacheMissCounter counter;
+    if (not counter.isAvailable()) {
+        std::cout << "cache misses: perf counters unavailable, shown as n/a\n";
+    }
+    std::printf("%-11s %-10s %17s %17s %17s\n", "board", "layout", "generate",
+                "reveal", "snapshot");
+    std::printf("%-11s %-10s", "", "");
+    for (int32_t phase = 0; phase < 3; phase++) {
+        std::printf(" %9s %7s", "Mcells/s", "miss/c");
+    }
+    std::printf("\n");
+
+    bool isOk = true;
+    std::vector<int8_t> expected;
+    std::vector<int8_t> snapshot;
+    for (const auto [width, height]: sizes) {
+        auto mines =
+                static_cast<int32_t>(static_cast<int64_t>(width) * height * minePermille / 1000);
+        char board[32];
+        std::snprintf(board, sizeof(board), "%dx%d", width, height);
+        const char *fastest = nullptr;
+        double fastestSeconds = 0;
+        auto report = [&](const char *name, const LayoutRun &run, bool isSame) {
+            std::printf("%-11s %-10s", board, name);
+            printPhase(run.generate);
+            printPhase(run.reveal);
+            printPhase(run.snapshot);
+            std::printf("%s\n", isSame ? "" : "  DIFFERENT board");
+            isOk = isOk and isSame;
+            double seconds = run.generate.seconds + run.reveal.seconds + run.snapshot.seconds;
+            if (fastest == nullptr or seconds < fastestSeconds) {
+                fastest = name;
+                fastestSeconds = seconds;
+            }
+        };
+        // The row-major run is the reference the others are compared against
+        LayoutRun run = benchmarkLayout<RowMajorLayout>(width, height, mines, seed, runs, counter,
+                                                        expected);
+        report("row-major", run, true);
+        run = benchmarkLayout<TiledLayout<3>>(width, height, mines, seed, runs, counter, snapshot);
+        report("tiled-8", run, snapshot == expected);
+        run = benchmarkLayout<MortonLayout>(width, height, mines, seed, runs, counter, snapshot);
+        report("morton", run, snapshot == expected);
+        std::printf("%-11s fastest overall: %s\n", board, fastest);
+    }
+    return isOk ? 0 : 1;
+}
+
+// A test spectator: a connection to the broadcaster and the board rebuilt from it.
+struct SpectatorClient {
+    int socket = -1;
+    SpectatorView view;
+    std::vector<uint8_t> buffer;
+    size_t used = 0;
+    bool isFailed = false;
+};
+
+int connectSpectator(const std::string &path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, path.c_str(),
+                std::min(path.size(), sizeof(address.sun_path) - 1));
+    int socket = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (socket >= 0 and
+        connect(socket, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0) {
+        close(socket);
+        return -1;
+    }
+    return socket;
+}
+
+// Reads what arrived for a readable client and applies its whole frames.
+void receiveFrames(SpectatorClient &client) {
+    if (client.buffer.size() - client.used < 4096) {
+        client.buffer.resize(std::max<size_t>(client.buffer.size() * 2, 65536));
+    }
+    ssize_t received = recv(client.socket, client.buffer.data() + client.used,
+                            client.buffer.size() - client.used, 0);
+    if (received <= 0) {
+        client.isFailed = true;
+        return;
+    }
+    client.used += static_cast<size_t>(received);
+    size_t consumed = 0;
+    if (not client.view.applyFrames(client.buffer.data(), client.used, consumed)) {
+        client.isFailed = true;
+        return;
+    }
+    std::memmove(client.buffer.data(), client.buffer.data() + consumed, client.used - consumed);
+    client.used -= consumed;
+}
+
+int64_t steadyNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Plays bot games on one board and broadcasts every move to --spectators local clients, half of
+// them joining halfway through. Moves wait until every client has applied the one before, as at a
+// player's pace, which times the fan-out of each. Then checks every client's board against the
+// real one.
+int runSpectateCommand(const Options &options) {
+    std::string path = options.get("socket", "/tmp/minesweeper_spectate.sock");
+    auto spectators = static_cast<int32_t>(options.getInt("spectators", 1000));
+    int64_t games = options.getInt("games", 20);
+    auto keyframeInterval = static_cast<int32_t>(options.getInt("keyframe-interval", 64));
+    uint64_t seed = options.getUnsigned("seed", 1);
+    Difficulty difficulty{};
+    if (not parseDifficulty(options.get("difficulty", "expert"), difficulty) or spectators <= 0 or
+        games <= 0 or keyframeInterval <= 0) {
+        return usage();
+    }
+    // Each spectator takes a socket on both ends
+    rlimit files{};
+    getrlimit(RLIMIT_NOFILE, &files);
+    files.rlim_cur = files.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &files);
+    if (files.rlim_cur < static_cast<rlim_t>(2 * spectators + 64)) {
+        std::cerr << "spectate: needs " << 2 * spectators + 64 << " open files, limit is "
+                  << files.rlim_cur << "\n";
+        return 1;
+    }
+
+    SpectatorBroadcaster broadcaster(keyframeInterval);
+    if (not broadcaster.start(path)) {
+        std::cerr << "spectate: cannot listen on " << path << "\n";
+        return 1;
+    }
+
+    // One thread stands in for every spectator, polling all of their connections
+    std::vector<SpectatorClient> clients(spectators);
+    int32_t earlyClients = spectators - spectators / 2;
+    std::atomic<bool> isJoiningLate{false};
+    std::atomic<bool> isPlayed{false};
+    // Sequence every connected client has applied, or -1 while one has no keyframe yet
+    std::atomic<int64_t> slowestSequence{-1};
+    std::thread clientThread([&]() {
+        for (int32_t i = 0; i < earlyClients; i++) {
+            clients[i].socket = connectSpectator(path);
+        }
+        int32_t connected = earlyClients;
+        std::vector<pollfd> polls;
+        while (true) {
+            if (connected < spectators and isJoiningLate.load()) {
+                for (; connected < spectators; connected++) {
+                    clients[connected].socket = connectSpectator(path);
+                }
+            }
+            polls.clear();
+            for (int32_t i = 0; i < connected; i++) {
+                int socket = clients[i].isFailed ? -1 : clients[i].socket;
+                polls.push_back(pollfd{socket, POLLIN, 0});
+            }
+            poll(polls.data(), polls.size(), 10);
+            int64_t slowest = INT64_MAX;
+            for (int32_t i = 0; i < connected; i++) {
+                if (polls[i].revents != 0) {
+                    receiveFrames(clients[i]);
+                }
+                if (not clients[i].isFailed) {
+                    slowest = std::min<int64_t>(slowest, clients[i].view.hasKeyframe() ?
+                                                         clients[i].view.getSequence() : -1);
+                }
+            }
+            slowestSequence.store(slowest);
+            if (isPlayed.load()) {
+                return;
+            }
+        }
+    });
+    while (broadcaster.getSubscriberCount() < earlyClients) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    GameBoard board(difficulty.width, difficulty.height, difficulty.mineCount, seed);
+    board.setRecordChanges(true);
+    auto strategy = makeStrategy(StrategyKind::DEDUCTIVE);
+    std::vector<int32_t> changes;
+    LatencyHistogram publishNanos;
+    LatencyHistogram fanOutNanos;
+    int64_t moves = 0;
+    bool isStalled = false;
+    int64_t start = steadyNanos();
+    for (int64_t game = 0; game < games; game++) {
+        if (game == games / 2) {
+            isJoiningLate.store(true);
+        }
+        board.reset(deriveSeed(seed, game));
+        strategy->reset();
+        std::mt19937_64 rng(deriveSeed(seed, game));
+        while (board.state == STARTED or board.state == ONGOING) {
+            Move move = strategy->nextMove(board, rng);
+            if (not move.isValid()) {
+                break;
+            }
+            if (board.state == STARTED) {
+                board.initializeBoard(move.x, move.y);
+                move.flag = false;
+            }
+            if (move.flag) {
+                board.toggleFlag(move.x, move.y);
+            } else {
+                board.revealCell(move.x, move.y);
+            }
+            board.updateGameStatus();
+            moves += 1;
+            int64_t publishStart = steadyNanos();
+            uint32_t sequence = broadcaster.getSequence();
+            bool isComplete = board.drainChanges(changes);
+            broadcaster.publish(board, changes, isComplete);
+            publishNanos.record(steadyNanos() - publishStart);
+            // The first move of a game goes out in the reset's keyframe, which keeps the sequence
+            if (broadcaster.getSequence() == sequence) {
+                continue;
+            }
+            while (slowestSequence.load() < broadcaster.getSequence() and not isStalled) {
+                std::this_thread::yield();
+                isStalled = steadyNanos() - publishStart > 5'000'000'000;
+            }
+            fanOutNanos.record(steadyNanos() - publishStart);
+        }
+    }
+    double playSeconds = static_cast<double>(steadyNanos() - start) / 1e9;
+    isPlayed.store(true);
+    clientThread.join();
+    SpectatorStats stats = broadcaster.getStats();
+
+    int32_t failed = 0;
+    int32_t mismatched = 0;
+    for (SpectatorClient &client: clients) {
+        if (client.isFailed) {
+            failed += 1;
+        } else if (client.view.computeVisibleHash() != board.getVisibleHash() or
+                   client.view.getState() != board.state or
+                   client.view.getWidth() != board.getWidth()) {
+            mismatched += 1;
+        }
+        close(client.socket);
+    }
+    broadcaster.stop();
+
+    // A damaged stream must be refused or misread, never read out of bounds, and a partial frame
+    // must wait for the rest
+    std::vector<uint8_t> stream;
+    encodeSpectatorKeyframe(board, 0, stream);
+    std::vector<int32_t> everyCell(static_cast<size_t>(board.getWidth()) * board.getHeight());
+    std::iota(everyCell.begin(), everyCell.end(), 0);
+    encodeSpectatorDelta(board, everyCell, 1, stream);
+    SpectatorView partial;
+    size_t consumed = 0;
+    bool isPartialWaiting = partial.applyFrames(stream.data(), stream.size() - 1, consumed) and
+                            consumed > 0 and consumed < stream.size() - 1;
+    std::mt19937_64 g(seed);
+    int32_t refused = 0;
+    const int32_t damagedStreams = 100000;
+    for (int32_t trial = 0; trial < damagedStreams; trial++) {
+        std::vector<uint8_t> damaged = stream;
+        damaged[g() % damaged.size()] ^= static_cast<uint8_t>(1 + g() % 255);
+        SpectatorView view;
+        if (not view.applyFrames(damaged.data(), damaged.size(), consumed)) {
+            refused += 1;
+        }
+    }
+
+    auto average = [](uint64_t bytes, uint64_t frames) {
+        return static_cast<double>(bytes) / static_cast<double>(std::max<uint64_t>(frames, 1));
+    };
+    std::printf("%d spectators, %d of them joining halfway; %lld games, %lld moves in %.2f s\n",
+                spectators, spectators - earlyClients, static_cast<long long>(games),
+                static_cast<long long>(moves), playSeconds);
+    std::printf("encoded once: %llu deltas of %.1f bytes, %llu keyframes of %.1f bytes; "
+                "sent %llu bytes in all\n", static_cast<unsigned long long>(stats.deltas),
+                average(stats.deltaBytes, stats.deltas),
+                static_cast<unsigned long long>(stats.keyframes),
+                average(stats.keyframeBytes, stats.keyframes),
+                static_cast<unsigned long long>(stats.sentBytes));
+    std::printf("publish ns on the game thread: p50 %lld, p99 %lld, max %lld\n",
+                static_cast<long long>(publishNanos.percentile(0.5)),
+                static_cast<long long>(publishNanos.percentile(0.99)),
+                static_cast<long long>(publishNanos.getMax()));
+    std::printf("us until every spectator applied a move: p50 %.1f, p99 %.1f, max %.1f\n",
+                static_cast<double>(fanOutNanos.percentile(0.5)) / 1e3,
+                static_cast<double>(fanOutNanos.percentile(0.99)) / 1e3,
+                static_cast<double>(fanOutNanos.getMax()) / 1e3);
+    std::printf("%llu joined, %llu dropped, %d failed, %d boards differ%s\n",
+                static_cast<unsigned long long>(stats.joined),
+                static_cast<unsigned long long>(stats.dropped), failed, mismatched,
+                isStalled ? ", STALLED" : "");
+    std::printf("damaged streams: %d of %d refused; partial frame %s\n", refused,
+                damagedStreams, isPartialWaiting ? "waits" : "MISREAD");
+    return failed == 0 and mismatched == 0 and stats.dropped == 0 and not isStalled and
+           isPartialWaiting ? 0 : 1;
+}
+
+// The aggregates StatsStore should have for one difficulty, worked out from every record at once.
+struct ExpectedStats {
+    int64_t games = 0;
+    int64_t wins = 0;
+    int64_t winMillis = 0;
+    int64_t clicks = 0;
+    int64_t threeBV = 0;
+    int32_t bestStreak = 0;
+    int32_t currentStreak = 0;
+    int32_t recentWins = 0;
+    int64_t recentWinMillis = 0;
+    std::vector<GameRecord> best;
+};
+
+ExpectedStats expectStats(const std::vector<GameRecord> &records, const Difficulty &difficulty) {
+    ExpectedStats expected;
+    std::vector<GameRecord> games;
+    for (const GameRecord &record: records) {
+        if (record.width == difficulty.width and record.height == difficulty.height and
+            record.mineCount == difficulty.mineCount) {
+            games.push_back(record);
+        }
+    }
+    int32_t streak = 0;
+    for (size_t i = 0; i < games.size(); i++) {
+        const GameRecord &game = games[i];
+        bool isWin = game.outcome == VICTORY;
+        expected.games += 1;
+        expected.clicks += game.clicks;
+        expected.threeBV += game.threeBV;
+        streak = isWin ? streak + 1 : 0;
+        expected.bestStreak = std::max(expected.bestStreak, streak);
+        if (isWin) {
+            expected.wins += 1;
+            expected.winMillis += game.durationMillis;
+            expected.best.push_back(game);
+        }
+        if (isWin and i + STATS_RECENT_GAMES >= games.size()) {
+            expected.recentWins += 1;
+            expected.recentWinMillis += game.durationMillis;
+        }
+    }
+    expected.currentStreak = streak;
+    std::stable_sort(expected.best.begin(), expected.best.end(),
+                     [](const GameRecord &a, const GameRecord &b) {
+                         return a.durationMillis < b.durationMillis;
+                     });
+    expected.best.resize(std::min<size_t>(expected.best.size(), STATS_TOP_K));
+    return expected;
+}
+
+// Checks every difficulty's aggregates and best times against a pass over all the records.
+bool matchesRecords(const StatsStore &store, const std::vector<GameRecord> &records,
+                    const std::vector<Difficulty> &difficulties) {
+    std::vector<GameRecord> best;
+    for (const Difficulty &difficulty: difficulties) {
+        ExpectedStats expected = expectStats(records, difficulty);
+        DifficultyStats stats{};
+        if (not store.getStats(difficulty.width, difficulty.height, difficulty.mineCount, stats)) {
+            if (expected.games != 0) {
+                return false;
+            }
+            continue;
+        }
+        store.getBestTimes(difficulty.width, difficulty.height, difficulty.mineCount, best);
+        bool isBestEqual = best.size() == expected.best.size();
+        for (size_t i = 0; isBestEqual and i < best.size(); i++) {
+            isBestEqual = best[i].seed == expected.best[i].seed and
+                          best[i].durationMillis == expected.best[i].durationMillis;
+        }
+        if (not isBestEqual or stats.games != expected.games or stats.wins != expected.wins or
+            stats.winMillis != expected.winMillis or stats.clicks != expected.clicks or
+            stats.threeBV != expected.threeBV or stats.bestStreak != expected.bestStreak or
+            stats.currentStreak != expected.currentStreak or
+            stats.recentWins != expected.recentWins or
+            stats.recentWinMillis != expected.recentWinMillis) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void removeStatsFiles(const std::string &directory) {
+    for (const char *name: {"/games.log", "/stats.idx", "/stats.idx.tmp"}) {
+        std::remove((directory + name).c_str());
+    }
+}
+
+double millisSince(int64_t start) {
+    return static_cast<double>(steadyNanos() - start) / 1e6;
+}
+
+// Fills a statistics store with --records synthetic games and checks it against the records
+// themselves: after appending, after reopening from the index, after replaying a log tail the
+// index does not cover, after rebuilding without an index and after cutting off a torn record.
+int runStatsCommand(const Options &options) {
+    std::string directory = options.get("dir", "/tmp/minesweeper_stats");
+    int64_t recordCount = options.getInt("records", 300000);
+    auto compactEvery = static_cast<int32_t>(options.getInt("compact-every", 256));
+    uint64_t seed = options.getUnsigned("seed", 1);
+    if (recordCount <= 0 or compactEvery <= 0) {
+        return usage();
+    }
+    removeStatsFiles(directory);
+
+    // The three built-in difficulties and a handful of custom boards, the built-in ones most played
+    std::vector<Difficulty> difficulties(DIFFICULTIES, DIFFICULTIES + 3);
+    for (int32_t i = 0; i < 5; i++) {
+        difficulties.push_back(Difficulty{"custom", 20 + 10 * i, 20 + 5 * i, 60 + 25 * i});
+    }
+    std::mt19937_64 rng(seed);
+    std::vector<GameRecord> records(static_cast<size_t>(recordCount));
+    for (int64_t i = 0; i < recordCount; i++) {
+        const Difficulty &difficulty = difficulties[rng() % 4 == 0 ? rng() % difficulties.size()
+                                                                   : rng() % 3];
+        GameRecord &record = records[static_cast<size_t>(i)];
+        record = GameRecord{};
+        record.seed = rng();
+        record.finishedAtMillis = 1700000000000 + i * 60000;
+        record.width = difficulty.width;
+        record.height = difficulty.height;
+        record.mineCount = difficulty.mineCount;
+        // Coarse times, so the best lists are full of ties
+        record.durationMillis = static_cast<int32_t>(5000 + rng() % 4000 * 100);
+        record.threeBV = static_cast<int32_t>(difficulty.mineCount / 2 + rng() % 100);
+        record.clicks = record.threeBV + static_cast<int32_t>(rng() % 50);
+        record.outcome = rng() % 3 == 0 ? VICTORY : STEPPED_MINE;
+    }
+
+    bool isCorrect = true;
+    auto check = [&](const char *stage, const StatsStore &store, int64_t expectedRecords) {
+        std::vector<GameRecord> prefix(records.begin(), records.begin() + expectedRecords);
+        bool isMatch = store.getRecordCount() == expectedRecords and
+                       matchesRecords(store, prefix, difficulties);
+        if (not isMatch) {
+            std::printf("%s: the store does not match its records\n", stage);
+        }
+        isCorrect = isCorrect and isMatch;
+    };
+
+    // Everything but the last 1000 records, then those with the index kept from before them
+    int64_t tail = std::min<int64_t>(1000, recordCount / 2);
+    int64_t head = recordCount - tail;
+    LatencyHistogram appendNanos;
+    double appendMillis;
+    {
+        StatsStore store(compactEvery);
+        if (not store.open(directory)) {
+            std::cerr << "stats: cannot open a store in " << directory << "\n";
+            return 1;
+        }
+        int64_t start = steadyNanos();
+        for (int64_t i = 0; i < head; i++) {
+            int64_t appendStart = steadyNanos();
+            isCorrect = store.append(records[static_cast<size_t>(i)]) and isCorrect;
+            appendNanos.record(steadyNanos() - appendStart);
+        }
+        appendMillis = millisSince(start);
+        check("append", store, head);
+    }
+    std::filesystem::copy_file(directory + "/stats.idx", directory + "/stats.idx.old",
+                               std::filesystem::copy_options::overwrite_existing);
+
+    int64_t queries = 100000;
+    double queryNanos;
+    double reopenMillis;
+    {
+        int64_t start = steadyNanos();
+        StatsStore store(compactEvery);
+        store.open(directory);
+        reopenMillis = millisSince(start);
+        if (store.wasRebuilt() or store.getReplayedRecords() != 0) {
+            std::printf("reopen: replayed %lld records instead of reading the index\n",
+                        static_cast<long long>(store.getReplayedRecords()));
+            isCorrect = false;
+        }
+        check("reopen", store, head);
+        DifficultyStats stats{};
+        std::vector<GameRecord> best;
+        int64_t checksum = 0;
+        start = steadyNanos();
+        for (int64_t i = 0; i < queries; i++) {
+            const Difficulty &difficulty = difficulties[static_cast<size_t>(i) % 3];
+            store.getStats(difficulty.width, difficulty.height, difficulty.mineCount, stats);
+            store.getBestTimes(difficulty.width, difficulty.height, difficulty.mineCount, best);
+            checksum += stats.wins + best.front().durationMillis;
+        }
+        queryNanos = static_cast<double>(steadyNanos() - start) / static_cast<double>(queries);
+        if (checksum == 0) {
+            isCorrect = false;
+        }
+        for (int64_t i = head; i < recordCount; i++) {
+            store.append(records[static_cast<size_t>(i)]);
+        }
+    }
+
+    // As if the app died before the index caught up with the last appends
+    std::filesystem::rename(directory + "/stats.idx.old", directory + "/stats.idx");
+    double replayMillis;
+    {
+        int64_t start = steadyNanos();
+        StatsStore store(compactEvery);
+        store.open(directory);
+        replayMillis = millisSince(start);
+        if (store.wasRebuilt() or store.getReplayedRecords() != tail) {
+            std::printf("replay: replayed %lld records, expected %lld\n",
+                        static_cast<long long>(store.getReplayedRecords()),
+                        static_cast<long long>(tail));
+            isCorrect = false;
+        }
+        check("replay", store, recordCount);
+    }
+
+    std::remove((directory + "/stats.idx").c_str());
+    double rebuildMillis;
+    {
+        int64_t start = steadyNanos();
+        StatsStore store(compactEvery);
+        store.open(directory);
+        rebuildMillis = millisSince(start);
+        if (not store.wasRebuilt()) {
+            std::printf("rebuild: opened without an index but did not rebuild\n");
+            isCorrect = false;
+        }
+        check("rebuild", store, recordCount);
+    }
+
+    // Half a record at the end, as a crash in the middle of a write would leave it
+    std::string logPath = directory + "/games.log";
+    auto logSize = std::filesystem::file_size(logPath);
+    {
+        std::ofstream log(logPath, std::ios::binary | std::ios::app);
+        const char torn[sizeof(GameRecord) / 2] = {1};
+        log.write(torn, sizeof(torn));
+    }
+    {
+        StatsStore store(compactEvery);
+        store.open(directory);
+        check("torn tail", store, recordCount);
+        if (std::filesystem::file_size(logPath) != logSize) {
+            std::printf("torn tail: the log was not cut back to its last whole record\n");
+            isCorrect = false;
+        }
+    }
+
+    auto indexSize = std::filesystem::file_size(directory + "/stats.idx");
+    std::printf("%lld records over %zu difficulties: log %.1f MB, index %.1f KB\n",
+                static_cast<long long>(recordCount), difficulties.size(),
+                static_cast<double>(logSize) / 1e6, static_cast<double>(indexSize) / 1e3);
+    std::printf("append: %.0f records/s, ns p50 %lld, p99 %lld, max %lld (compacting every %d)\n",
+                static_cast<double>(head) / appendMillis * 1e3,
+                static_cast<long long>(appendNanos.percentile(0.5)),
+                static_cast<long long>(appendNanos.percentile(0.99)),
+                static_cast<long long>(appendNanos.getMax()), compactEvery);
+    std::printf("stats and best %d times: %.0f ns per query\n", STATS_TOP_K, queryNanos);
+    std::printf("open: %.2f ms from the index, %.2f ms replaying %lld records, %.2f ms rebuilding "
+                "from the whole log\n", reopenMillis, replayMillis, static_cast<long long>(tail),
+                rebuildMillis);
+    std::printf("%s\n", isCorrect ? "every stage matches the records" : "MISMATCH");
+    removeStatsFiles(directory);
+    return isCorrect ? 0 : 1;
+}
+
+// Reveals random safe cells of a small board until about half of it shows, flagging some of the
+// mines next to what is revealed, so the position has a frontier and an interior.
+void openSmallBoard(GameBoard &board, std::mt19937_64 &rng) {
+    int32_t width = board.getWidth();
+    int32_t height = board.getHeight();
+    board.initializeBoard(width / 2, height / 2);
+    int32_t revealed = board.revealCell(width / 2, height / 2);
+    for (int32_t attempt = 0; attempt < 4 * width * height and revealed < width * height / 2;
+         attempt++) {
+        auto x = static_cast<int32_t>(rng() % width);
+        auto y = static_cast<int32_t>(rng() % height);
+        const Cell &cell = board.getCell(x, y);
+        if (cell.isRevealed) {
+            continue;
+        }
+        if (not cell.isMine) {
+            revealed += board.revealCell(x, y);
+        } else if (rng() % 3 == 0) {
+            board.toggleFlag(x, y);
+        }
+    }
+    board.updateGameStatus();
+}
+
+// Mine chance of every hidden cell over every layout of the remaining mines that fits the numbers,
+// counted one layout at a time. Returns false if there are more than maxLayouts to count.
+bool countLayouts(const GameBoard &board, int64_t maxLayouts, std::vector<double> &outProbability) {
+    int32_t width = board.getWidth();
+    int32_t height = board.getHeight();
+    std::vector<int32_t> hidden;
+    std::vector<uint8_t> isMine(static_cast<size_t>(width) * height, 0);
+    int32_t minesLeft = board.getMineCount();
+    for (int32_t y = 0; y < height; y++) {
+        for (int32_t x = 0; x < width; x++) {
+            const Cell &cell = board.getCell(x, y);
+            if (cell.isFlagged) {
+                isMine[y * width + x] = 1;
+                minesLeft -= 1;
+            } else if (not cell.isRevealed) {
+                hidden.push_back(y * width + x);
+            }
+        }
+    }
+    double layouts = 1.0;
+    for (int32_t i = 0; i < minesLeft; i++) {
+        layouts = layouts * static_cast<double>(hidden.size() - i) / (i + 1);
+    }
+    if (layouts > static_cast<double>(maxLayouts)) {
+        return false;
+    }
+    auto fits = [&]() {
+        for (int32_t y = 0; y < height; y++) {
+            for (int32_t x = 0; x < width; x++) {
+                if (not board.getCell(x, y).isRevealed) {
+                    continue;
+                }
+                int32_t mines = 0;
+                for (int32_t dy = -1; dy <= 1; dy++) {
+                    for (int32_t dx = -1; dx <= 1; dx++) {
+                        int32_t nx = x + dx;
+                        int32_t ny = y + dy;
+                        if (0 <= nx and nx < width and 0 <= ny and ny < height) {
+                            mines += isMine[ny * width + nx];
+                        }
+                    }
+                }
+                if (mines != board.getCell(x, y).adjacentMines) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    };
+    std::vector<int64_t> mineTotals(isMine.size(), 0);
+    int64_t fitting = 0;
+    // Every choice of minesLeft hidden cells, as an increasing list of positions in hidden
+    std::vector<int32_t> chosen(minesLeft);
+    std::iota(chosen.begin(), chosen.end(), 0);
+    auto hiddenCount = static_cast<int32_t>(hidden.size());
+    while (true) {
+        for (int32_t i: chosen) {
+            isMine[hidden[i]] = 1;
+        }
+        if (fits()) {
+            fitting += 1;
+            for (int32_t i: chosen) {
+                mineTotals[hidden[i]] += 1;
+            }
+        }
+        for (int32_t i: chosen) {
+            isMine[hidden[i]] = 0;
+        }
+        int32_t i = minesLeft - 1;
+        while (i >= 0 and chosen[i] == hiddenCount - minesLeft + i) {
+            i -= 1;
+        }
+        if (i < 0) {
+            break;
+        }
+        chosen[i] += 1;
+        for (int32_t j = i + 1; j < minesLeft; j++) {
+            chosen[j] = chosen[j - 1] + 1;
+        }
+    }
+    outProbability.assign(isMine.size(), -1.0);
+    for (int32_t index: hidden) {
+        outProbability[index] = static_cast<double>(mineTotals[index]) /
+                                static_cast<double>(std::max<int64_t>(fitting, 1));
+    }
+    return fitting > 0;
+}
+
+// Checks LayoutSampler's mine chances against counting every layout, and the frequencies of its
+// draws against those chances, on small positions. Returns the number of positions that differ.
+int32_t checkLayoutSampler(int32_t positions, uint64_t seed) {
+    int32_t checked = 0;
+    int32_t failed = 0;
+    double worstExact = 0.0;
+    double worstDrawn = 0.0;
+    std::vector<double> exact;
+    std::vector<int32_t> mines;
+    for (int32_t position = 0; checked < positions and position < 50 * positions; position++) {
+        std::mt19937_64 rng(deriveSeed(seed, position));
+        GameBoard board(7, 7, 10, deriveSeed(seed, position));
+        openSmallBoard(board, rng);
+        LayoutSampler sampler;
+        if (board.state != ONGOING or not countLayouts(board, 500000, exact) or
+            not sampler.build(board)) {
+            continue;
+        }
+        checked += 1;
+        const int32_t draws = 20000;
+        std::vector<int32_t> drawn(exact.size(), 0);
+        std::vector<int32_t> interior = sampler.getInterior();
+        for (int32_t draw = 0; draw < draws; draw++) {
+            sampler.sample(rng, interior, mines);
+            for (int32_t cell: mines) {
+                drawn[cell] += 1;
+            }
+        }
+        double exactError = 0.0;
+        double drawnError = 0.0;
+        for (int32_t index: sampler.getHidden()) {
+            exactError = std::max(exactError,
+                                  std::abs(sampler.getMineProbability(index) - exact[index]));
+            double frequency = static_cast<double>(drawn[index]) / draws;
+            drawnError = std::max(drawnError, std::abs(frequency - exact[index]));
+        }
+        worstExact = std::max(worstExact, exactError);
+        worstDrawn = std::max(worstDrawn, drawnError);
+        // 20000 draws put a frequency within 0.018 of its chance at 5 standard errors
+        if (exactError > 1e-9 or drawnError > 0.02) {
+            failed += 1;
+        }
+    }
+    std::printf("layout sampler: %d small positions, worst mine chance error %.2g against counting "
+                "every layout, worst draw frequency error %.4f\n", checked, worstExact, worstDrawn);
+    return checked == 0 ? 1 : failed;
+}
+
+// What the hint engine did over a run of games.
+struct HintTotals {
+    int64_t hints = 0;
+    int64_t searched = 0;
+    int64_t unsampled = 0;
+    int64_t iterations = 0;
+    double confidence = 0.0;
+    // Searches whose most visited move stood clear of the runner-up.
+    int64_t separated = 0;
+    // Searches that picked something other than the least likely mine.
+    int64_t overruled = 0;
+    LatencyHistogram searchNanos;
+};
+
+// Plays a board from a first reveal in its centre, every later move from nextMove, and returns
+// whether it was won.
+template<class NextMove>
+bool playFromCentre(GameBoard &board, NextMove nextMove) {
+    board.initializeBoard(board.getWidth() / 2, board.getHeight() / 2);
+    board.revealCell(board.getWidth() / 2, board.getHeight() / 2);
+    board.updateGameStatus();
+    while (board.state == ONGOING) {
+        Move move = nextMove();
+        if (not move.isValid()) {
+            break;
+        }
+        if (move.flag) {
+            board.toggleFlag(move.x, move.y);
+        } else {
+            board.revealCell(move.x, move.y);
+        }
+        board.updateGameStatus();
+    }
+    return board.state == VICTORY;
+}
+
+// Plays --games boards twice, once taking every move from the hint engine and once from the
+// probability strategy, from the same first reveal, and fails if hinted play wins significantly
+// less. Then analyses the first guess whose search grew a tree below the root with a longer
+// budget.
+int runHintCommand(const Options &options) {
+    Difficulty difficulty{};
+    int64_t games = options.getInt("games", 300);
+    HintConfig config;
+    config.budgetNanos = options.getInt("budget-ms", 16) * 1000000;
+    int64_t analysisNanos = options.getInt("analysis-ms", HINT_ANALYSIS_BUDGET_NANOS / 1000000) *
+                            1000000;
+    config.seed = options.getUnsigned("seed", 1);
+    auto threads = static_cast<int32_t>(options.getInt("threads", 0));
+    if (not parseDifficulty(options.get("difficulty", "intermediate"), difficulty) or games <= 0 or
+        config.budgetNanos <= 0 or analysisNanos <= 0) {
+        return usage();
+    }
+    int32_t failedPositions = checkLayoutSampler(200, config.seed);
+
+    TaskScheduler scheduler(threads);
+    HintEngine engine(scheduler);
+    auto fallback = makeStrategy(StrategyKind::PROBABILITY);
+    auto baseline = makeStrategy(StrategyKind::PROBABILITY);
+    HintTotals totals;
+    HintResult result;
+    int64_t hintWins = 0;
+    int64_t baselineWins = 0;
+    // Games only one side won
+    int64_t hintOnlyWins = 0;
+    int64_t baselineOnlyWins = 0;
+    bool hasGuessPosition = false;
+    GameBoard guessPosition(difficulty.width, difficulty.height, difficulty.mineCount, 0);
+    for (int64_t game = 0; game < games; game++) {
+        uint64_t boardSeed = deriveSeed(config.seed, game);
+        std::mt19937_64 rng(boardSeed);
+        GameBoard board(difficulty.width, difficulty.height, difficulty.mineCount, boardSeed);
+        fallback->reset();
+        bool isWon = playFromCentre(board, [&]() {
+            totals.hints += 1;
+            if (not engine.findHint(board, config, result)) {
+                totals.unsampled += 1;
+                return fallback->nextMove(board, rng);
+            }
+            if (not result.isCertain) {
+                // A guess that ends the game either way leaves the tree at its root
+                if (not hasGuessPosition and result.nodes > 1) {
+                    guessPosition = board;
+                    hasGuessPosition = true;
+                }
+                double leastLikely = 1.0;
+                double chosen = 0.0;
+                for (const HintCandidate &candidate: result.candidates) {
+                    leastLikely = std::min(leastLikely, candidate.mineProbability);
+                    if (candidate.move.x == result.move.x and candidate.move.y == result.move.y) {
+                        chosen = candidate.mineProbability;
+                    }
+                }
+                totals.searched += 1;
+                totals.iterations += result.iterations;
+                totals.confidence += result.confidence;
+                totals.separated += result.isSeparated;
+                totals.overruled += chosen > leastLikely;
+                totals.searchNanos.record(result.elapsedNanos);
+            }
+            return result.move;
+        });
+
+        board.reset(boardSeed);
+        baseline->reset();
+        rng.seed(boardSeed);
+        bool isBaselineWon =
+                playFromCentre(board, [&]() { return baseline->nextMove(board, rng); });
+        hintWins += isWon;
+        baselineWins += isBaselineWon;
+        hintOnlyWins += isWon and not isBaselineWon;
+        baselineOnlyWins += isBaselineWon and not isWon;
+    }
+
+    double searched = static_cast<double>(std::max<int64_t>(totals.searched, 1));
+    std::printf("%lld %s games, %d threads, %lld ms per search\n", static_cast<long long>(games),
+                difficulty.name, scheduler.getThreadCount(),
+                static_cast<long long>(config.budgetNanos / 1000000));
+    std::printf("hints: %lld, %lld of them searched, %lld with too many layouts to sample\n",
+                static_cast<long long>(totals.hints), static_cast<long long>(totals.searched),
+                static_cast<long long>(totals.unsampled));
+    std::printf("per search: %.0f iterations, confidence %.2f, %.0f%% separated from the "
+                "runner-up, %.0f%% not the least likely mine; ms p50 %.1f, max %.1f\n",
+                static_cast<double>(totals.iterations) / searched, totals.confidence / searched,
+                100.0 * static_cast<double>(totals.separated) / searched,
+                100.0 * static_cast<double>(totals.overruled) / searched,
+                static_cast<double>(totals.searchNanos.percentile(0.5)) / 1e6,
+                static_cast<double>(totals.searchNanos.getMax()) / 1e6);
+    // Both sides play the same boards, so only the games one of them lost tell them apart. Under
+    // equal strength each of those is equally likely to go either way (McNemar's test).
+    int64_t split = hintOnlyWins + baselineOnlyWins;
+    double z = split == 0 ? 0.0 : static_cast<double>(baselineOnlyWins - hintOnlyWins) /
+                                  std::sqrt(static_cast<double>(split));
+    bool isWorse = z > 1.96;
+    std::printf("wins: %lld with hints, %lld with the probability strategy alone; %lld won only "
+                "with hints, %lld only without, z = %.2f: %s\n",
+                static_cast<long long>(hintWins), static_cast<long long>(baselineWins),
+                static_cast<long long>(hintOnlyWins), static_cast<long long>(baselineOnlyWins), z,
+                isWorse ? "hints play significantly WORSE" : "hints play no worse");
+
+    if (hasGuessPosition) {
+        HintConfig analysis = config;
+        analysis.budgetNanos = analysisNanos;
+        engine.findHint(guessPosition, analysis, result);
+        std::printf("analysis of the first guess searched below the root, %.2f s: %lld "
+                    "iterations, %lld nodes, move (%d, %d) %s, confidence %.2f, most visited "
+                    "win rate %.3f +- %.3f\n", static_cast<double>(result.elapsedNanos) / 1e9,
+                    static_cast<long long>(result.iterations),
+                    static_cast<long long>(result.nodes), result.move.x, result.move.y,
+                    result.isSeparated ? "by search" : "as the least likely mine",
+                    result.confidence, result.candidates.front().winRate, result.winRateMargin);
+        for (size_t i = 0; i < std::min<size_t>(result.candidates.size(), 5); i++) {
+            const HintCandidate &candidate = result.candidates[i];
+            std::printf("  (%2d, %2d)  mine %.3f  visits %7lld  win rate %.3f\n", candidate.move.x,
+                        candidate.move.y, candidate.mineProbability,
+                        static_cast<long long>(candidate.visits), candidate.winRate);
+        }
+    } else {
+        std::printf("no search grew a tree below the root; nothing to analyse\n");
+    }
+    return failedPositions == 0 and not isWorse ? 0 : 1;
+}
+
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        return usage();
+    }
+    const Options options(argc, argv);
+    if (std::strcmp(argv[1], "selfplay") == 0) {
+        return runSelfPlayCommand(options);
+    }
+    if (std::strcmp(argv[1], "metrics") == 0) {
+        return runMetricsCommand(options);
+    }
+    if (std::strcmp(argv[1], "export") == 0) {
+        return runExportCommand(options);
+    }
+    if (std::strcmp(argv[1], "forks") == 0) {
+        return runForksCommand(options);
+    }
+    if (std::strcmp(argv[1], "instances") == 0) {
+        return runInstancesCommand(options);
+    }
+    if (std::strcmp(argv[1], "view") == 0) {
+        return runViewCommand(options);
+    }
+    if (std::strcmp(argv[1], "frames") == 0) {
+        return runFramesCommand(options);
+    }
+    if (std::strcmp(argv[1], "gestures") == 0) {
+        return runGesturesCommand(options);
+    }
+    if (std::strcmp(argv[1], "cascade") == 0) {
+        return runCascadeCommand(options);
+    }
+    if (std::strcmp(argv[1], "atlas") == 0) {
+        return runAtlasCommand(options);
+    }
+    if (std::strcmp(argv[1], "programs") == 0) {
+        return runProgramsCommand(options);
+    }
+    if (std::strcmp(argv[1], "glyphs") == 0) {
+        return runGlyphsCommand(options);
+    }
+    if (std::strcmp(argv[1], "log") == 0) {
+        return runLogCommand(options);
+    }
+    if (std::strcmp(argv[1], "trace") == 0) {
+        return runTraceCommand(options);
+    }
+    if (std::strcmp(argv[1], "latency") == 0) {
+        return runLatencyCommand(options);
+    }
+    if (std::strcmp(argv[1], "tasks") == 0) {
+        return runTasksCommand(options);
+    }
+    if (std::strcmp(argv[1], "firstclick") == 0) {
+        return runFirstClickCommand(options);
+    }
+    if (std::strcmp(argv[1], "mapped") == 0) {
+        return runMappedCommand(options);
+    }
+    if (std::strcmp(argv[1], "allocs") == 0) {
+        return runAllocsCommand(options);
+    }
+    if (std::strcmp(argv[1], "layouts") == 0) {
+        return runLayoutsCommand(options);
+    }
+    if (std::strcmp(argv[1], "spectate") == 0) {
+        return runSpectateCommand(options);
+    }
+    if (std::strcmp(argv[1], "stats") == 0) {
+        return runStatsCommand(options);
+    }
+    if (std::strcmp(argv[1], "hint") == 0) {
+        return runHintCommand(options);
+    }
+    return usage();
+}
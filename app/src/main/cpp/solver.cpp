@@ -0,0 +1,576 @@
+#include "solver.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include "zobrist.h"
+
+namespace {
+
+const std::pair<int32_t, int32_t> NEIGHBOURS[8] = {{0,  1},
+                                                    {0,  -1},
+                                                    {1,  0},
+                                                    {-1, 0},
+                                                    {-1, -1},
+                                                    {-1, 1},
+                                                    {1,  -1},
+                                                    {1,  1}};
+
+bool isInBounds(const GameBoard &board, int32_t x, int32_t y) {
+    return 0 <= x and x < board.getWidth() and 0 <= y and y < board.getHeight();
+}
+
+bool isHidden(const Cell &cell) {
+    return not cell.isRevealed and not cell.isFlagged;
+}
+
+class BaseStrategy : public Strategy {
+public:
+    Move nextMove(const GameBoard &board, std::mt19937_64 &rng) override {
+        auto cells = static_cast<size_t>(board.getWidth()) * board.getHeight();
+        if (cells != scratchCells) {
+            reserveScratch(cells);
+            scratchCells = cells;
+        }
+        Move move{};
+        if (popPending(board, move)) {
+            return move;
+        }
+        collectHidden(board);
+        if (hidden.empty()) {
+            return Move{-1, -1, false};
+        }
+        if (useDeduction()) {
+            deduce(board);
+            if (popPending(board, move)) {
+                return move;
+            }
+        }
+        forceByMineCount(board);
+        if (popPending(board, move)) {
+            return move;
+        }
+        return guess(board, rng);
+    }
+
+    void reset() override {
+        pending.clear();
+    }
+
+protected:
+    virtual bool useDeduction() const {
+        return true;
+    }
+
+    // Sizes the scratch for the largest sweep a board of this many cells can need, once per board
+    // size, so no move ever grows it.
+    virtual void reserveScratch(size_t cells) {
+        hidden.reserve(cells);
+        // A sweep queues each hidden cell at most once per neighbouring number, once by the mine
+        // count and once by a solved component
+        pending.reserve(10 * cells);
+    }
+
+    virtual Move guess(const GameBoard &/* board */, std::mt19937_64 &rng) {
+        std::uniform_int_distribution<size_t> pick(0, hidden.size() - 1);
+        return hidden[pick(rng)];
+    }
+
+    // Moves found by a sweep stay queued until the board makes them redundant, so one sweep
+    // usually serves many calls.
+    bool popPending(const GameBoard &board, Move &outMove) {
+        while (not pending.empty()) {
+            Move move = pending.back();
+            pending.pop_back();
+            const Cell &cell = board.getCell(move.x, move.y);
+            if (isHidden(cell)) {
+                outMove = move;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void collectHidden(const GameBoard &board) {
+        hidden.clear();
+        flagCount = 0;
+        for (int32_t y = 0; y < board.getHeight(); y++) {
+            for (int32_t x = 0; x < board.getWidth(); x++) {
+                const Cell &cell = board.getCell(x, y);
+                if (cell.isFlagged) {
+                    flagCount += 1;
+                } else if (not cell.isRevealed) {
+                    hidden.push_back(Move{x, y, false});
+                }
+            }
+        }
+    }
+
+    // Single-point rules: a number whose flags already match it clears its other neighbours, and a
+    // number with exactly as many hidden neighbours as missing mines flags all of them.
+    void deduce(const GameBoard &board) {
+        for (int32_t y = 0; y < board.getHeight(); y++) {
+            for (int32_t x = 0; x < board.getWidth(); x++) {
+                const Cell &cell = board.getCell(x, y);
+                if (not cell.isRevealed) {
+                    continue;
+                }
+                int32_t flags = 0;
+                int32_t hiddenAround = 0;
+                for (const auto [dx, dy]: NEIGHBOURS) {
+                    if (not isInBounds(board, x + dx, y + dy)) {
+                        continue;
+                    }
+                    const Cell &neighbour = board.getCell(x + dx, y + dy);
+                    if (neighbour.isFlagged) {
+                        flags += 1;
+                    } else if (not neighbour.isRevealed) {
+                        hiddenAround += 1;
+                    }
+                }
+                if (hiddenAround == 0) {
+                    continue;
+                }
+                bool safe = flags == cell.adjacentMines;
+                bool mines = cell.adjacentMines - flags == hiddenAround;
+                if (not safe and not mines) {
+                    continue;
+                }
+                for (const auto [dx, dy]: NEIGHBOURS) {
+                    if (isInBounds(board, x + dx, y + dy) and
+                        isHidden(board.getCell(x + dx, y + dy))) {
+                        pending.push_back(Move{x + dx, y + dy, mines});
+                    }
+                }
+            }
+        }
+    }
+
+    void forceByMineCount(const GameBoard &board) {
+        int32_t minesLeft = board.getMineCount() - flagCount;
+        if (minesLeft == static_cast<int32_t>(hidden.size())) {
+            for (const Move &move: hidden) {
+                pending.push_back(Move{move.x, move.y, true});
+            }
+        } else if (minesLeft == 0) {
+            pending.insert(pending.end(), hidden.begin(), hidden.end());
+        }
+    }
+
+    std::vector<Move> pending;
+    std::vector<Move> hidden;
+    int32_t flagCount = 0;
+    size_t scratchCells = 0;
+};
+
+class DeductiveStrategy : public BaseStrategy {
+};
+
+// Falls back to the hidden cell with the lowest estimated mine probability. Frontier cells are split
+// into components of cells linked by shared numbers; components small enough are solved exactly by
+// enumerating every mine layout that satisfies their numbers, which also finds cells that are safe or
+// mines in every layout. Larger components take the worst local ratio of missing mines to hidden
+// neighbours over the numbers that touch them, and the rest of the board shares the leftover density.
+class ProbabilityStrategy : public BaseStrategy {
+public:
+    explicit ProbabilityStrategy(TranspositionTable *table) : table(table) {}
+
+    SolverCacheStats getCacheStats() const override {
+        return cacheStats;
+    }
+
+protected:
+    Move guess(const GameBoard &board, std::mt19937_64 &rng) override {
+        estimateLocally(board);
+        solveComponents(board);
+        Move move{};
+        if (popPending(board, move)) {
+            return move;
+        }
+
+        int32_t width = board.getWidth();
+        float frontierMines = 0.f;
+        int32_t interiorCount = 0;
+        for (const Move &hiddenMove: hidden) {
+            float p = probability[hiddenMove.y * width + hiddenMove.x];
+            if (p < 0.f) {
+                interiorCount += 1;
+            } else {
+                frontierMines += p;
+            }
+        }
+        float interior = 1.f;
+        if (interiorCount > 0) {
+            float minesLeft = static_cast<float>(board.getMineCount() - flagCount) - frontierMines;
+            interior = std::min(1.f, std::max(0.f, minesLeft / interiorCount));
+        }
+
+        Move best{-1, -1, false};
+        float bestProbability = 2.f;
+        int32_t ties = 0;
+        for (const Move &hiddenMove: hidden) {
+            float p = probability[hiddenMove.y * width + hiddenMove.x];
+            if (p < 0.f) {
+                p = interior;
+            }
+            if (p < bestProbability) {
+                best = hiddenMove;
+                bestProbability = p;
+                ties = 1;
+            } else if (p == bestProbability) {
+                ties += 1;
+                if (std::uniform_int_distribution<int32_t>(0, ties - 1)(rng) == 0) {
+                    best = hiddenMove;
+                }
+            }
+        }
+        return best;
+    }
+
+    void reserveScratch(size_t cells) override {
+        BaseStrategy::reserveScratch(cells);
+        probability.reserve(cells);
+        parent.reserve(cells);
+        localId.reserve(cells);
+        frontier.reserve(cells);
+        numbers.reserve(cells);
+        constraints.reserve(cells);
+    }
+
+private:
+    // Components up to this size are enumerated, bounded further by MAX_NODES of search.
+    static constexpr int32_t MAX_ENUMERATED_CELLS = 24;
+    static constexpr int64_t MAX_NODES = 1 << 20;
+    static constexpr uint64_t COMPONENT_SALT = 0x9c6e8f3a51d2b7e4ULL;
+
+    struct Constraint {
+        int32_t need;
+        int32_t assigned;
+        int32_t unassigned;
+    };
+
+    // Fills probability with the local estimate for frontier cells and -1 everywhere else.
+    void estimateLocally(const GameBoard &board) {
+        int32_t width = board.getWidth();
+        probability.assign(static_cast<size_t>(width) * board.getHeight(), -1.f);
+        for (int32_t y = 0; y < board.getHeight(); y++) {
+            for (int32_t x = 0; x < width; x++) {
+                const Cell &cell = board.getCell(x, y);
+                if (not cell.isRevealed) {
+                    continue;
+                }
+                int32_t flags = 0;
+                int32_t hiddenAround = 0;
+                for (const auto [dx, dy]: NEIGHBOURS) {
+                    if (not isInBounds(board, x + dx, y + dy)) {
+                        continue;
+                    }
+                    const Cell &neighbour = board.getCell(x + dx, y + dy);
+                    if (neighbour.isFlagged) {
+                        flags += 1;
+                    } else if (not neighbour.isRevealed) {
+                        hiddenAround += 1;
+                    }
+                }
+                if (hiddenAround == 0) {
+                    continue;
+                }
+                float local = static_cast<float>(cell.adjacentMines - flags) / hiddenAround;
+                for (const auto [dx, dy]: NEIGHBOURS) {
+                    if (isInBounds(board, x + dx, y + dy) and
+                        isHidden(board.getCell(x + dx, y + dy))) {
+                        float &p = probability[(y + dy) * width + (x + dx)];
+                        p = std::max(p, local);
+                    }
+                }
+            }
+        }
+    }
+
+    void solveComponents(const GameBoard &board) {
+        int32_t width = board.getWidth();
+        int32_t cellCount = width * board.getHeight();
+        parent.assign(cellCount, -1);
+        localId.resize(cellCount);
+        frontier.clear();
+        numbers.clear();
+        for (const Move &move: hidden) {
+            int32_t index = move.y * width + move.x;
+            if (probability[index] >= 0.f) {
+                parent[index] = index;
+            }
+        }
+        // Every number's hidden neighbours end up in one component.
+        for (int32_t y = 0; y < board.getHeight(); y++) {
+            for (int32_t x = 0; x < width; x++) {
+                if (not board.getCell(x, y).isRevealed) {
+                    continue;
+                }
+                int32_t first = -1;
+                for (const auto [dx, dy]: NEIGHBOURS) {
+                    if (isInBounds(board, x + dx, y + dy) and
+                        isHidden(board.getCell(x + dx, y + dy))) {
+                        int32_t index = (y + dy) * width + (x + dx);
+                        if (first < 0) {
+                            first = index;
+                        } else {
+                            unite(first, index);
+                        }
+                    }
+                }
+                if (first >= 0) {
+                    numbers.emplace_back(0, y * width + x);
+                }
+            }
+        }
+        for (auto &number: numbers) {
+            int32_t x = number.second % width;
+            int32_t y = number.second / width;
+            for (const auto [dx, dy]: NEIGHBOURS) {
+                if (isInBounds(board, x + dx, y + dy) and isHidden(board.getCell(x + dx, y + dy))) {
+                    number.first = find((y + dy) * width + (x + dx));
+                    break;
+                }
+            }
+        }
+        for (int32_t index = 0; index < cellCount; index++) {
+            if (parent[index] >= 0) {
+                frontier.emplace_back(find(index), index);
+            }
+        }
+        std::sort(frontier.begin(), frontier.end());
+        std::sort(numbers.begin(), numbers.end());
+
+        size_t cellStart = 0;
+        size_t numberStart = 0;
+        while (cellStart < frontier.size()) {
+            int32_t root = frontier[cellStart].first;
+            size_t cellEnd = cellStart;
+            while (cellEnd < frontier.size() and frontier[cellEnd].first == root) {
+                cellEnd += 1;
+            }
+            size_t numberEnd = numberStart;
+            while (numberEnd < numbers.size() and numbers[numberEnd].first == root) {
+                numberEnd += 1;
+            }
+            auto size = static_cast<int32_t>(cellEnd - cellStart);
+            if (size <= MAX_ENUMERATED_CELLS) {
+                solveComponent(board, cellStart, cellEnd, numberStart, numberEnd);
+            }
+            cellStart = cellEnd;
+            numberStart = numberEnd;
+        }
+    }
+
+    void solveComponent(const GameBoard &board, size_t cellStart, size_t cellEnd, size_t numberStart,
+                        size_t numberEnd) {
+        int32_t width = board.getWidth();
+        auto size = static_cast<int32_t>(cellEnd - cellStart);
+        constraints.clear();
+        for (int32_t i = 0; i < size; i++) {
+            localId[frontier[cellStart + i].second] = i;
+            cellConstraintCount[i] = 0;
+        }
+
+        // The component is fully described by its cells and each number's remaining mine count,
+        // so that is what the key hashes.
+        uint64_t key = COMPONENT_SALT;
+        for (size_t i = cellStart; i < cellEnd; i++) {
+            key ^= zobristKey(frontier[i].second, VISIBLE_FLAG + 1);
+        }
+        for (size_t i = numberStart; i < numberEnd; i++) {
+            int32_t x = numbers[i].second % width;
+            int32_t y = numbers[i].second / width;
+            int32_t need = board.getCell(x, y).adjacentMines;
+            int32_t members = 0;
+            auto constraint = static_cast<int32_t>(constraints.size());
+            for (const auto [dx, dy]: NEIGHBOURS) {
+                if (not isInBounds(board, x + dx, y + dy)) {
+                    continue;
+                }
+                const Cell &neighbour = board.getCell(x + dx, y + dy);
+                if (neighbour.isFlagged) {
+                    need -= 1;
+                } else if (not neighbour.isRevealed) {
+                    int32_t local = localId[(y + dy) * width + (x + dx)];
+                    cellConstraints[local][cellConstraintCount[local]++] = constraint;
+                    members += 1;
+                }
+            }
+            constraints.push_back(Constraint{need, 0, members});
+            key ^= zobristKey(numbers[i].second, need);
+        }
+
+        ComponentVerdict verdict{};
+        bool known = false;
+        if (table != nullptr) {
+            cacheStats.lookups += 1;
+            known = table->lookup(key, verdict);
+            if (known) {
+                cacheStats.hits += 1;
+            }
+        }
+        if (not known) {
+            auto start = std::chrono::steady_clock::now();
+            known = enumerate(size, verdict);
+            cacheStats.solves += 1;
+            cacheStats.solveNanos += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - start).count();
+            if (known and table != nullptr) {
+                table->store(key, verdict);
+            }
+        }
+        if (not known) {
+            return;
+        }
+
+        for (int32_t i = 0; i < size; i++) {
+            int32_t index = frontier[cellStart + i].second;
+            probability[index] = static_cast<float>(verdict.probability[i]) / 255.f;
+            bool safe = verdict.safeMask >> i & 1u;
+            bool mine = verdict.mineMask >> i & 1u;
+            if (safe or mine) {
+                pending.push_back(Move{index % width, index / width, mine});
+            }
+        }
+    }
+
+    // Counts, for every cell, the layouts in which it holds a mine. Returns false if the search
+    // runs out of budget.
+    bool enumerate(int32_t size, ComponentVerdict &outVerdict) {
+        solutions = 0;
+        nodes = 0;
+        std::fill(mineTotals.begin(), mineTotals.begin() + size, 0);
+        if (not search(0, size) or solutions == 0) {
+            return false;
+        }
+        outVerdict.safeMask = 0;
+        outVerdict.mineMask = 0;
+        outVerdict.probability.fill(0);
+        for (int32_t i = 0; i < size; i++) {
+            if (mineTotals[i] == 0) {
+                outVerdict.safeMask |= 1u << i;
+            } else if (mineTotals[i] == solutions) {
+                outVerdict.mineMask |= 1u << i;
+            }
+            outVerdict.probability[i] = static_cast<uint8_t>(
+                    (mineTotals[i] * 255 + solutions / 2) / solutions);
+        }
+        return true;
+    }
+
+    bool search(int32_t cell, int32_t size) {
+        if (++nodes > MAX_NODES) {
+            return false;
+        }
+        if (cell == size) {
+            solutions += 1;
+            for (int32_t i = 0; i < size; i++) {
+                mineTotals[i] += assignment[i];
+            }
+            return true;
+        }
+        for (int32_t value = 0; value <= 1; value++) {
+            bool consistent = true;
+            for (int32_t i = 0; i < cellConstraintCount[cell]; i++) {
+                Constraint &constraint = constraints[cellConstraints[cell][i]];
+                constraint.assigned += value;
+                constraint.unassigned -= 1;
+                if (constraint.assigned > constraint.need or
+                    constraint.assigned + constraint.unassigned < constraint.need) {
+                    consistent = false;
+                }
+            }
+            bool finished = true;
+            if (consistent) {
+                assignment[cell] = static_cast<uint8_t>(value);
+                finished = search(cell + 1, size);
+            }
+            for (int32_t i = 0; i < cellConstraintCount[cell]; i++) {
+                Constraint &constraint = constraints[cellConstraints[cell][i]];
+                constraint.assigned -= value;
+                constraint.unassigned += 1;
+            }
+            if (not finished) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    int32_t find(int32_t index) {
+        while (parent[index] != index) {
+            parent[index] = parent[parent[index]];
+            index = parent[index];
+        }
+        return index;
+    }
+
+    void unite(int32_t a, int32_t b) {
+        a = find(a);
+        b = find(b);
+        if (a != b) {
+            parent[std::max(a, b)] = std::min(a, b);
+        }
+    }
+
+    TranspositionTable *table;
+    SolverCacheStats cacheStats;
+    std::vector<float> probability;
+    std::vector<int32_t> parent;
+    std::vector<int32_t> localId;
+    // (component root, cell index) of frontier cells and of numbers bordering hidden cells.
+    std::vector<std::pair<int32_t, int32_t>> frontier;
+    std::vector<std::pair<int32_t, int32_t>> numbers;
+    std::vector<Constraint> constraints;
+    std::array<std::array<int32_t, 8>, MAX_ENUMERATED_CELLS> cellConstraints{};
+    std::array<int32_t, MAX_ENUMERATED_CELLS> cellConstraintCount{};
+    std::array<uint8_t, MAX_ENUMERATED_CELLS> assignment{};
+    std::array<uint64_t, MAX_ENUMERATED_CELLS> mineTotals{};
+    uint64_t solutions = 0;
+    int64_t nodes = 0;
+};
+
+class RandomStrategy : public BaseStrategy {
+protected:
+    bool useDeduction() const override {
+        return false;
+    }
+};
+
+}
+
+std::unique_ptr<Strategy> makeStrategy(StrategyKind kind, TranspositionTable *table) {
+    switch (kind) {
+        case StrategyKind::DEDUCTIVE:
+            return std::make_unique<DeductiveStrategy>();
+        case StrategyKind::PROBABILITY:
+            return std::make_unique<ProbabilityStrategy>(table);
+        case StrategyKind::RANDOM:
+            return std::make_unique<RandomStrategy>();
+    }
+    return nullptr;
+}
+
+const char *strategyName(StrategyKind kind) {
+    switch (kind) {
+        case StrategyKind::DEDUCTIVE:
+            return "deductive";
+        case StrategyKind::PROBABILITY:
+            return "probability";
+        case StrategyKind::RANDOM:
+            return "random";
+    }
+    return "unknown";
+}
+
+bool parseStrategy(const char *name, StrategyKind &outKind) {
+    for (StrategyKind kind: {StrategyKind::DEDUCTIVE, StrategyKind::PROBABILITY,
+                             StrategyKind::RANDOM}) {
+        if (std::strcmp(name, strategyName(kind)) == 0) {
+            outKind = kind;
+            return true;
+        }
+    }
+    return false;
+}
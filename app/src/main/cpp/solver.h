@@ -0,0 +1,53 @@
+#ifndef MINESWEEPER_SOLVER_H
+#define MINESWEEPER_SOLVER_H
+
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+#include "game_objects.h"
+#include "transposition_table.h"
+
+enum class StrategyKind {
+    DEDUCTIVE = 0,
+    PROBABILITY = 1,
+    RANDOM = 2
+};
+
+struct Move {
+    int32_t x;
+    int32_t y;
+    bool flag;
+
+    bool isValid() const {
+        return x >= 0 and y >= 0;
+    }
+};
+
+// A player that only looks at what is visible on the board: revealed numbers and flags.
+// Implementations keep their scratch memory between calls so one instance can play many games.
+class Strategy {
+public:
+    virtual ~Strategy() = default;
+
+    // Returns the next move for a STARTED or ONGOING board, or an invalid move when every hidden
+    // cell is already flagged.
+    virtual Move nextMove(const GameBoard &board, std::mt19937_64 &rng) = 0;
+
+    // Drops any moves queued from a previous game.
+    virtual void reset() = 0;
+
+    virtual SolverCacheStats getCacheStats() const {
+        return SolverCacheStats{};
+    }
+};
+
+// Strategies that search frontier components cache their verdicts in table when one is given. A
+// table may be shared by strategies on different threads.
+std::unique_ptr<Strategy> makeStrategy(StrategyKind kind, TranspositionTable *table = nullptr);
+
+const char *strategyName(StrategyKind kind);
+
+bool parseStrategy(const char *name, StrategyKind &outKind);
+
+#endif //MINESWEEPER_SOLVER_H
@@ -0,0 +1,581 @@
+#include "spectator_stream.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "zobrist.h"
+
+namespace {
+
+// Payloads stay under 4 GiB, so their length takes at most 5 varint bytes.
+constexpr size_t MAX_LENGTH_BYTES = 5;
+// Frames one sendmsg hands to the kernel.
+constexpr size_t MAX_FRAMES_PER_SEND = 64;
+
+void putVarint(std::vector<uint8_t> &out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+// Returns false if data ends inside the varint or it runs past 64 bits.
+bool readVarint(const uint8_t *&data, const uint8_t *end, uint64_t &outValue) {
+    outValue = 0;
+    for (int32_t shift = 0; shift < 64 and data < end; shift += 7) {
+        uint8_t byte = *data++;
+        outValue |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void putRun(std::vector<uint8_t> &out, uint64_t length, int32_t code) {
+    putVarint(out, length << 4 | static_cast<uint64_t>(code + 1));
+}
+
+bool readRun(const uint8_t *&data, const uint8_t *end, uint64_t &outLength, int8_t &outCode) {
+    uint64_t value = 0;
+    if (not readVarint(data, end, value)) {
+        return false;
+    }
+    outLength = value >> 4;
+    outCode = static_cast<int8_t>(static_cast<int32_t>(value & 0x0f) - 1);
+    return outLength > 0 and outCode <= VISIBLE_FLAG;
+}
+
+bool readState(const uint8_t *&data, const uint8_t *end, GameStatus &outState) {
+    if (data == end or *data > VICTORY + 1) {
+        return false;
+    }
+    outState = static_cast<GameStatus>(static_cast<int32_t>(*data++) - 1);
+    return true;
+}
+
+// Calls visit(start, length, code) for each run of consecutive cells in sorted cells that show the
+// same visible code.
+template<class Visit>
+void forEachRun(const GameBoard &board, const std::vector<int32_t> &cells, Visit visit) {
+    int32_t width = board.getWidth();
+    size_t runStart = 0;
+    int32_t runCode = 0;
+    for (size_t i = 0; i < cells.size(); i++) {
+        int32_t code = visibleCode(board.getCell(cells[i] % width, cells[i] / width));
+        if (i > runStart and (cells[i] != cells[i - 1] + 1 or code != runCode)) {
+            visit(cells[runStart], i - runStart, runCode);
+            runStart = i;
+        }
+        runCode = code;
+    }
+    if (runStart < cells.size()) {
+        visit(cells[runStart], cells.size() - runStart, runCode);
+    }
+}
+
+// Wakes the I/O thread from poll. Returns false if the pipe is full, when it is awake already.
+bool wakeUp(int pipeEnd) {
+    uint8_t byte = 0;
+    return write(pipeEnd, &byte, 1) == 1;
+}
+
+// Starts a frame at the end of out, leaving room for its length. Returns where the payload goes.
+size_t beginFrame(std::vector<uint8_t> &out, SpectatorFrameType type) {
+    out.push_back(static_cast<uint8_t>(type));
+    out.resize(out.size() + MAX_LENGTH_BYTES);
+    return out.size();
+}
+
+// Writes the length of the payload that follows payloadStart and closes the gap before it.
+void finishFrame(std::vector<uint8_t> &out, size_t payloadStart) {
+    size_t payloadBytes = out.size() - payloadStart;
+    size_t lengthStart = payloadStart - MAX_LENGTH_BYTES;
+    size_t lengthBytes = 0;
+    for (uint64_t value = payloadBytes; ; value >>= 7) {
+        auto byte = static_cast<uint8_t>(value >= 0x80 ? value | 0x80 : value);
+        out[lengthStart + lengthBytes++] = byte;
+        if (value < 0x80) {
+            break;
+        }
+    }
+    std::memmove(&out[lengthStart + lengthBytes], &out[payloadStart], payloadBytes);
+    out.resize(lengthStart + lengthBytes + payloadBytes);
+}
+
+}
+
+void encodeSpectatorKeyframe(const GameBoard &board, uint32_t sequence, std::vector<uint8_t> &out) {
+    size_t payloadStart = beginFrame(out, SPECTATOR_KEYFRAME);
+    putVarint(out, sequence);
+    putVarint(out, static_cast<uint64_t>(board.getWidth()));
+    putVarint(out, static_cast<uint64_t>(board.getHeight()));
+    putVarint(out, static_cast<uint64_t>(board.getMineCount()));
+    out.push_back(static_cast<uint8_t>(board.state + 1));
+    uint64_t length = 0;
+    int32_t code = VISIBLE_HIDDEN;
+    for (int32_t y = 0; y < board.getHeight(); y++) {
+        for (int32_t x = 0; x < board.getWidth(); x++) {
+            int32_t next = visibleCode(board.getCell(x, y));
+            if (length > 0 and next != code) {
+                putRun(out, length, code);
+                length = 0;
+            }
+            code = next;
+            length += 1;
+        }
+    }
+    if (length > 0) {
+        putRun(out, length, code);
+    }
+    finishFrame(out, payloadStart);
+}
+
+void encodeSpectatorDelta(const GameBoard &board, std::vector<int32_t> &changes,
+                          uint32_t sequence, std::vector<uint8_t> &out) {
+    std::sort(changes.begin(), changes.end());
+    changes.erase(std::unique(changes.begin(), changes.end()), changes.end());
+
+    size_t payloadStart = beginFrame(out, SPECTATOR_DELTA);
+    putVarint(out, sequence);
+    out.push_back(static_cast<uint8_t>(board.state + 1));
+    // The run count goes ahead of the runs, so they are walked twice
+    uint64_t runs = 0;
+    forEachRun(board, changes, [&runs](int32_t, size_t, int32_t) {
+        runs += 1;
+    });
+    putVarint(out, runs);
+    uint64_t previousEnd = 0;
+    forEachRun(board, changes, [&out, &previousEnd](int32_t start, size_t length, int32_t code) {
+        putVarint(out, static_cast<uint64_t>(start) - previousEnd);
+        putRun(out, length, code);
+        previousEnd = static_cast<uint64_t>(start) + length;
+    });
+    finishFrame(out, payloadStart);
+}
+
+bool SpectatorView::applyFrames(const uint8_t *data, size_t size, size_t &outConsumed) {
+    outConsumed = 0;
+    const uint8_t *end = data + size;
+    const uint8_t *cursor = data;
+    while (cursor < end) {
+        const uint8_t *payload = cursor + 1;
+        uint64_t length = 0;
+        if (not readVarint(payload, end, length)) {
+            // Either the length is still arriving or it is too long to be one
+            if (end - (cursor + 1) >= static_cast<ptrdiff_t>(MAX_LENGTH_BYTES)) {
+                return false;
+            }
+            break;
+        }
+        if (static_cast<uint64_t>(end - payload) < length) {
+            break;
+        }
+        bool isApplied = false;
+        if (*cursor == SPECTATOR_KEYFRAME) {
+            isApplied = applyKeyframe(payload, payload + length);
+        } else if (*cursor == SPECTATOR_DELTA) {
+            isApplied = applyDelta(payload, payload + length);
+        }
+        if (not isApplied) {
+            return false;
+        }
+        cursor = payload + length;
+        outConsumed = static_cast<size_t>(cursor - data);
+    }
+    return true;
+}
+
+bool SpectatorView::applyKeyframe(const uint8_t *data, const uint8_t *end) {
+    // Cells are overwritten as they are read, so a bad keyframe leaves no usable view
+    isKeyframed = false;
+    uint64_t values[4];
+    for (uint64_t &value: values) {
+        if (not readVarint(data, end, value)) {
+            return false;
+        }
+    }
+    GameStatus frameState = STARTED;
+    if (values[0] > UINT32_MAX or values[1] == 0 or values[2] == 0 or values[1] > INT32_MAX or
+        values[2] > INT32_MAX / values[1] or values[3] > values[1] * values[2] or
+        not readState(data, end, frameState)) {
+        return false;
+    }
+    uint64_t cells = values[1] * values[2];
+    codes.resize(cells);
+    uint64_t filled = 0;
+    while (data < end) {
+        uint64_t length = 0;
+        int8_t code = 0;
+        if (not readRun(data, end, length, code) or length > cells - filled) {
+            return false;
+        }
+        std::fill_n(codes.begin() + static_cast<ptrdiff_t>(filled), length, code);
+        filled += length;
+    }
+    if (filled != cells) {
+        return false;
+    }
+    sequence = static_cast<uint32_t>(values[0]);
+    width = static_cast<int32_t>(values[1]);
+    height = static_cast<int32_t>(values[2]);
+    mineCount = static_cast<int32_t>(values[3]);
+    state = frameState;
+    isKeyframed = true;
+    return true;
+}
+
+bool SpectatorView::applyDelta(const uint8_t *data, const uint8_t *end) {
+    uint64_t frameSequence = 0;
+    uint64_t runs = 0;
+    GameStatus frameState = STARTED;
+    if (not isKeyframed or not readVarint(data, end, frameSequence) or
+        frameSequence != static_cast<uint32_t>(sequence + 1) or
+        not readState(data, end, frameState) or not readVarint(data, end, runs)) {
+        return false;
+    }
+    uint64_t cells = codes.size();
+    uint64_t previousEnd = 0;
+    for (uint64_t run = 0; run < runs; run++) {
+        uint64_t gap = 0;
+        uint64_t length = 0;
+        int8_t code = 0;
+        if (not readVarint(data, end, gap) or not readRun(data, end, length, code) or
+            gap > cells - previousEnd or length > cells - previousEnd - gap) {
+            return false;
+        }
+        uint64_t start = previousEnd + gap;
+        std::fill_n(codes.begin() + static_cast<ptrdiff_t>(start), length, code);
+        previousEnd = start + length;
+    }
+    if (data != end) {
+        return false;
+    }
+    sequence = static_cast<uint32_t>(frameSequence);
+    state = frameState;
+    return true;
+}
+
+bool SpectatorView::hasKeyframe() const {
+    return isKeyframed;
+}
+
+uint32_t SpectatorView::getSequence() const {
+    return sequence;
+}
+
+int32_t SpectatorView::getWidth() const {
+    return width;
+}
+
+int32_t SpectatorView::getHeight() const {
+    return height;
+}
+
+int32_t SpectatorView::getMineCount() const {
+    return mineCount;
+}
+
+GameStatus SpectatorView::getState() const {
+    return state;
+}
+
+int32_t SpectatorView::getCode(int32_t x, int32_t y) const {
+    return codes[static_cast<size_t>(y) * width + x];
+}
+
+uint64_t SpectatorView::computeVisibleHash() const {
+    uint64_t hash = 0;
+    for (size_t i = 0; i < codes.size(); i++) {
+        hash ^= zobristKey(static_cast<int32_t>(i), codes[i]);
+    }
+    return hash;
+}
+
+SpectatorBroadcaster::SpectatorBroadcaster(int32_t keyframeInterval, size_t maxQueuedBytes)
+        : keyframeInterval(std::max(keyframeInterval, 1)), maxQueuedBytes(maxQueuedBytes) {}
+
+SpectatorBroadcaster::~SpectatorBroadcaster() {
+    stop();
+}
+
+bool SpectatorBroadcaster::start(const std::string &path) {
+    sockaddr_un address{};
+    if (isRunning() or path.empty() or path.size() >= sizeof(address.sun_path)) {
+        return false;
+    }
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, path.c_str(), path.size());
+    listenSocket = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listenSocket < 0) {
+        return false;
+    }
+    unlink(path.c_str());
+    if (bind(listenSocket, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0 or
+        listen(listenSocket, SOMAXCONN) != 0 or pipe(wakePipe) != 0) {
+        close(listenSocket);
+        listenSocket = -1;
+        unlink(path.c_str());
+        return false;
+    }
+    for (int end: wakePipe) {
+        fcntl(end, F_SETFL, fcntl(end, F_GETFL) | O_NONBLOCK);
+        fcntl(end, F_SETFD, FD_CLOEXEC);
+    }
+    this->path = path;
+    hasPublished = false;
+    deltasSinceKeyframe = 0;
+    isStopping.store(false);
+    thread = std::thread(&SpectatorBroadcaster::run, this);
+    return true;
+}
+
+void SpectatorBroadcaster::stop() {
+    if (not thread.joinable()) {
+        return;
+    }
+    isStopping.store(true);
+    wakeUp(wakePipe[1]);
+    thread.join();
+    for (Subscriber &subscriber: subscribers) {
+        close(subscriber.socket);
+    }
+    subscribers.clear();
+    subscriberCount.store(0);
+    keyframe.reset();
+    deltasAfterKeyframe.clear();
+    outbox.clear();
+    close(listenSocket);
+    close(wakePipe[0]);
+    close(wakePipe[1]);
+    listenSocket = -1;
+    wakePipe[0] = -1;
+    wakePipe[1] = -1;
+    unlink(path.c_str());
+}
+
+bool SpectatorBroadcaster::isRunning() const {
+    return thread.joinable();
+}
+
+void SpectatorBroadcaster::publish(const GameBoard &board, std::vector<int32_t> &changes,
+                                   bool isComplete) {
+    if (not isRunning()) {
+        return;
+    }
+    bool isKeyframe = not isComplete or not hasPublished or board.getWidth() != publishedWidth or
+                      board.getHeight() != publishedHeight;
+    if (not isKeyframe and changes.empty() and board.state == publishedState) {
+        return;
+    }
+    Outgoing frame{};
+    Outgoing periodicKeyframe{};
+    if (isKeyframe) {
+        encodeSpectatorKeyframe(board, sequence, scratch);
+        frame = Outgoing{takeFrame(SPECTATOR_KEYFRAME), true, true};
+        deltasSinceKeyframe = 0;
+    } else {
+        sequence += 1;
+        encodeSpectatorDelta(board, changes, sequence, scratch);
+        frame = Outgoing{takeFrame(SPECTATOR_DELTA), true, false};
+        deltasSinceKeyframe += 1;
+        // Late joiners catch up from here instead of replaying the whole game
+        if (deltasSinceKeyframe >= keyframeInterval) {
+            encodeSpectatorKeyframe(board, sequence, scratch);
+            periodicKeyframe = Outgoing{takeFrame(SPECTATOR_KEYFRAME), false, true};
+            deltasSinceKeyframe = 0;
+        }
+    }
+    hasPublished = true;
+    publishedWidth = board.getWidth();
+    publishedHeight = board.getHeight();
+    publishedState = board.state;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        outbox.push_back(std::move(frame));
+        if (periodicKeyframe.frame) {
+            outbox.push_back(std::move(periodicKeyframe));
+        }
+    }
+    wakeUp(wakePipe[1]);
+}
+
+int32_t SpectatorBroadcaster::getSubscriberCount() const {
+    return subscriberCount.load(std::memory_order_relaxed);
+}
+
+uint32_t SpectatorBroadcaster::getSequence() const {
+    return sequence;
+}
+
+SpectatorStats SpectatorBroadcaster::getStats() const {
+    SpectatorStats stats;
+    stats.deltas = deltas.load(std::memory_order_relaxed);
+    stats.deltaBytes = deltaBytes.load(std::memory_order_relaxed);
+    stats.keyframes = keyframes.load(std::memory_order_relaxed);
+    stats.keyframeBytes = keyframeBytes.load(std::memory_order_relaxed);
+    stats.sentBytes = sentBytes.load(std::memory_order_relaxed);
+    stats.joined = joined.load(std::memory_order_relaxed);
+    stats.dropped = dropped.load(std::memory_order_relaxed);
+    return stats;
+}
+
+SpectatorBroadcaster::Frame SpectatorBroadcaster::takeFrame(SpectatorFrameType type) {
+    Frame frame = std::make_shared<const std::vector<uint8_t>>(scratch);
+    scratch.clear();
+    if (type == SPECTATOR_KEYFRAME) {
+        keyframes.fetch_add(1, std::memory_order_relaxed);
+        keyframeBytes.fetch_add(frame->size(), std::memory_order_relaxed);
+    } else {
+        deltas.fetch_add(1, std::memory_order_relaxed);
+        deltaBytes.fetch_add(frame->size(), std::memory_order_relaxed);
+    }
+    return frame;
+}
+
+void SpectatorBroadcaster::run() {
+    std::vector<pollfd> polls;
+    std::vector<Outgoing> incoming;
+    while (true) {
+        polls.clear();
+        polls.push_back(pollfd{wakePipe[0], POLLIN, 0});
+        polls.push_back(pollfd{listenSocket, POLLIN, 0});
+        for (const Subscriber &subscriber: subscribers) {
+            auto events = static_cast<short>(POLLIN | (subscriber.queue.empty() ? 0 : POLLOUT));
+            polls.push_back(pollfd{subscriber.socket, events, 0});
+        }
+        if (poll(polls.data(), polls.size(), -1) < 0 and errno != EINTR) {
+            return;
+        }
+        if (polls[0].revents & POLLIN) {
+            uint8_t drain[64];
+            while (read(wakePipe[0], drain, sizeof(drain)) > 0) {}
+        }
+        if (isStopping.load()) {
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            incoming.swap(outbox);
+        }
+        for (const Outgoing &outgoing: incoming) {
+            if (outgoing.isBroadcast) {
+                for (Subscriber &subscriber: subscribers) {
+                    enqueue(subscriber, outgoing.frame);
+                }
+            }
+            if (outgoing.isKeyframe) {
+                keyframe = outgoing.frame;
+                deltasAfterKeyframe.clear();
+            } else {
+                deltasAfterKeyframe.push_back(outgoing.frame);
+            }
+        }
+        incoming.clear();
+
+        // Spectators send nothing, so a readable socket is one being closed
+        for (size_t i = 0; i + 2 < polls.size(); i++) {
+            if ((polls[i + 2].revents & (POLLIN | POLLHUP | POLLERR)) == 0) {
+                continue;
+            }
+            uint8_t discard[256];
+            ssize_t received = recv(subscribers[i].socket, discard, sizeof(discard), 0);
+            if (received == 0 or (received < 0 and errno != EAGAIN and errno != EWOULDBLOCK)) {
+                subscribers[i].isClosed = true;
+            }
+        }
+        if (polls[1].revents & POLLIN) {
+            acceptSubscribers();
+        }
+        for (Subscriber &subscriber: subscribers) {
+            if (not subscriber.isClosed and not subscriber.queue.empty()) {
+                flush(subscriber);
+            }
+        }
+        for (size_t i = 0; i < subscribers.size();) {
+            if (subscribers[i].isClosed) {
+                close(subscribers[i].socket);
+                std::swap(subscribers[i], subscribers.back());
+                subscribers.pop_back();
+            } else {
+                i++;
+            }
+        }
+        subscriberCount.store(static_cast<int32_t>(subscribers.size()),
+                              std::memory_order_relaxed);
+    }
+}
+
+void SpectatorBroadcaster::acceptSubscribers() {
+    while (true) {
+        int socket = accept4(listenSocket, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (socket < 0) {
+            return;
+        }
+        subscribers.push_back(Subscriber{socket, {}, 0, 0, false});
+        joined.fetch_add(1, std::memory_order_relaxed);
+        // Before the first publish there is nothing to catch up on; the first keyframe is
+        // broadcast to everyone
+        if (keyframe) {
+            enqueue(subscribers.back(), keyframe);
+            for (const Frame &delta: deltasAfterKeyframe) {
+                enqueue(subscribers.back(), delta);
+            }
+        }
+    }
+}
+
+void SpectatorBroadcaster::enqueue(Subscriber &subscriber, const Frame &frame) {
+    if (subscriber.isClosed) {
+        return;
+    }
+    subscriber.queue.push_back(frame);
+    subscriber.queuedBytes += frame->size();
+    // A spectator this far behind reconnects and starts again from a keyframe
+    if (subscriber.queuedBytes > maxQueuedBytes) {
+        subscriber.isClosed = true;
+        dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void SpectatorBroadcaster::flush(Subscriber &subscriber) {
+    while (not subscriber.queue.empty()) {
+        iovec buffers[MAX_FRAMES_PER_SEND];
+        size_t count = std::min(subscriber.queue.size(), MAX_FRAMES_PER_SEND);
+        for (size_t i = 0; i < count; i++) {
+            const std::vector<uint8_t> &frame = *subscriber.queue[i];
+            size_t skip = i == 0 ? subscriber.offset : 0;
+            buffers[i].iov_base = const_cast<uint8_t *>(frame.data() + skip);
+            buffers[i].iov_len = frame.size() - skip;
+        }
+        msghdr message{};
+        message.msg_iov = buffers;
+        message.msg_iovlen = count;
+        ssize_t sent = sendmsg(subscriber.socket, &message, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (sent < 0) {
+            if (errno != EAGAIN and errno != EWOULDBLOCK and errno != EINTR) {
+                subscriber.isClosed = true;
+            }
+            return;
+        }
+        sentBytes.fetch_add(static_cast<uint64_t>(sent), std::memory_order_relaxed);
+        subscriber.queuedBytes -= static_cast<size_t>(sent);
+        auto remaining = static_cast<size_t>(sent);
+        while (remaining > 0) {
+            size_t left = subscriber.queue.front()->size() - subscriber.offset;
+            if (remaining < left) {
+                subscriber.offset += remaining;
+                break;
+            }
+            remaining -= left;
+            subscriber.offset = 0;
+            subscriber.queue.pop_front();
+        }
+    }
+}
@@ -0,0 +1,211 @@
+#ifndef MINESWEEPER_SPECTATOR_STREAM_H
+#define MINESWEEPER_SPECTATOR_STREAM_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "game_objects.h"
+
+/*
+ * Live game stream for spectators: what players can see, as a keyframe followed by deltas.
+ *
+ * Integers are unsigned LEB128 varints. The stream is a sequence of frames:
+ *
+ *   frame     u8 type, varint payload length, payload
+ *   keyframe  varint sequence, varint width, varint height, varint mineCount, u8 state + 1,
+ *             then runs covering every cell in row-major order (y * width + x)
+ *   delta     varint sequence, u8 state + 1, varint runCount, then runCount pairs of
+ *             varint gap from the end of the previous run (from 0 for the first) and a run
+ *
+ * A run is one varint, length << 4 | code + 1: length consecutive cells all showing the visible
+ * code of zobrist.h (-1 hidden, 0-8 a revealed count, 9 a revealed mine, 10 a flag). An opening
+ * is a handful of runs however large it is.
+ *
+ * Deltas are numbered one after another. A keyframe carries the sequence of the last delta it
+ * includes, so the next delta a spectator applies after it is sequence + 1.
+ */
+
+enum SpectatorFrameType {
+    SPECTATOR_KEYFRAME = 1,
+    SPECTATOR_DELTA = 2
+};
+
+// Appends a keyframe of board's visible state to out.
+void encodeSpectatorKeyframe(const GameBoard &board, uint32_t sequence, std::vector<uint8_t> &out);
+
+// Appends a delta with the current visible state of the cells in changes to out. changes holds
+// row-major cell indices in any order, repeats allowed, as GameBoard::drainChanges hands them out;
+// it is sorted and deduplicated in place.
+void encodeSpectatorDelta(const GameBoard &board, std::vector<int32_t> &changes,
+                          uint32_t sequence, std::vector<uint8_t> &out);
+
+// A spectator's copy of the board, rebuilt from the stream.
+class SpectatorView {
+public:
+    // Applies every whole frame at the start of data and sets outConsumed to their bytes; a
+    // partial frame at the end is left for the next call. Returns false on a malformed frame, a
+    // delta before the first keyframe or a delta out of sequence, after which the view needs a
+    // new connection and its keyframe.
+    bool applyFrames(const uint8_t *data, size_t size, size_t &outConsumed);
+
+    bool hasKeyframe() const;
+
+    uint32_t getSequence() const;
+
+    int32_t getWidth() const;
+
+    int32_t getHeight() const;
+
+    int32_t getMineCount() const;
+
+    GameStatus getState() const;
+
+    // Visible code of a cell, as visibleCode in zobrist.h.
+    int32_t getCode(int32_t x, int32_t y) const;
+
+    // The same hash GameBoard::getVisibleHash keeps, recomputed over every cell.
+    uint64_t computeVisibleHash() const;
+
+private:
+    bool applyKeyframe(const uint8_t *data, const uint8_t *end);
+
+    bool applyDelta(const uint8_t *data, const uint8_t *end);
+
+    bool isKeyframed = false;
+    uint32_t sequence = 0;
+    int32_t width = 0;
+    int32_t height = 0;
+    int32_t mineCount = 0;
+    GameStatus state = STARTED;
+    std::vector<int8_t> codes;
+};
+
+// Frames and bytes are counted as encoded, once per frame however many subscribers there are.
+struct SpectatorStats {
+    uint64_t deltas = 0;
+    uint64_t deltaBytes = 0;
+    // Keyframes, whether broadcast or only kept for late joiners.
+    uint64_t keyframes = 0;
+    uint64_t keyframeBytes = 0;
+    // Bytes written to subscribers, all of them together.
+    uint64_t sentBytes = 0;
+    uint64_t joined = 0;
+    // Subscribers disconnected for falling maxQueuedBytes behind.
+    uint64_t dropped = 0;
+};
+
+// Fans a game's stream out to spectators connected to a local (Unix domain) socket. publish
+// encodes each update once on the caller's thread and hands the same buffer to every subscriber;
+// an I/O thread writes it out with non-blocking sends. A spectator that joins late is sent the
+// last keyframe and the deltas since, and a keyframe is kept every keyframeInterval deltas, so
+// joining costs a bounded catch-up whatever the game's length. Existing subscribers only get
+// deltas, plus a keyframe when the board is reset or replaced.
+class SpectatorBroadcaster {
+public:
+    explicit SpectatorBroadcaster(int32_t keyframeInterval = 256,
+                                  size_t maxQueuedBytes = 4 << 20);
+
+    SpectatorBroadcaster(const SpectatorBroadcaster &) = delete;
+
+    SpectatorBroadcaster &operator=(const SpectatorBroadcaster &) = delete;
+
+    // Stops if running.
+    ~SpectatorBroadcaster();
+
+    // Listens on a socket at path, replacing any file there, and starts the I/O thread. Returns
+    // false if the socket could not be set up.
+    bool start(const std::string &path);
+
+    // Disconnects every subscriber, joins the I/O thread and removes the socket file.
+    void stop();
+
+    bool isRunning() const;
+
+    // Publishes the visible cells in changes, as drained from board since the last publish.
+    // isComplete is drainChanges' result: when false, or on the first publish or a board of a new
+    // size, a keyframe goes out instead. changes is sorted in place. Does nothing if neither the
+    // cells nor the game state changed.
+    void publish(const GameBoard &board, std::vector<int32_t> &changes, bool isComplete);
+
+    int32_t getSubscriberCount() const;
+
+    // Sequence of the last delta published. Call from the publishing thread.
+    uint32_t getSequence() const;
+
+    SpectatorStats getStats() const;
+
+private:
+    using Frame = std::shared_ptr<const std::vector<uint8_t>>;
+
+    // A frame handed from publish to the I/O thread, in publish order.
+    struct Outgoing {
+        Frame frame;
+        // Sent to every current subscriber; otherwise a keyframe only for later joiners.
+        bool isBroadcast;
+        // Becomes the keyframe late joiners start from.
+        bool isKeyframe;
+    };
+
+    struct Subscriber {
+        int socket;
+        std::deque<Frame> queue;
+        // Bytes of the front frame already sent.
+        size_t offset;
+        size_t queuedBytes;
+        bool isClosed;
+    };
+
+    // Copies the frame encoded into scratch to a buffer the subscribers share, and counts it.
+    Frame takeFrame(SpectatorFrameType type);
+
+    void run();
+
+    void acceptSubscribers();
+
+    void enqueue(Subscriber &subscriber, const Frame &frame);
+
+    void flush(Subscriber &subscriber);
+
+    int32_t keyframeInterval;
+    size_t maxQueuedBytes;
+
+    // Publishing side, on the caller's thread.
+    uint32_t sequence = 0;
+    int32_t deltasSinceKeyframe = 0;
+    bool hasPublished = false;
+    int32_t publishedWidth = 0;
+    int32_t publishedHeight = 0;
+    GameStatus publishedState = STARTED;
+    std::vector<uint8_t> scratch;
+
+    std::mutex mutex;
+    std::vector<Outgoing> outbox;
+
+    // I/O thread.
+    std::string path;
+    int listenSocket = -1;
+    // Written by publish and stop to wake the I/O thread from poll.
+    int wakePipe[2] = {-1, -1};
+    std::thread thread;
+    std::atomic<bool> isStopping{false};
+    std::vector<Subscriber> subscribers;
+    Frame keyframe;
+    std::vector<Frame> deltasAfterKeyframe;
+
+    std::atomic<int32_t> subscriberCount{0};
+    std::atomic<uint64_t> deltas{0};
+    std::atomic<uint64_t> deltaBytes{0};
+    std::atomic<uint64_t> keyframes{0};
+    std::atomic<uint64_t> keyframeBytes{0};
+    std::atomic<uint64_t> sentBytes{0};
+    std::atomic<uint64_t> joined{0};
+    std::atomic<uint64_t> dropped{0};
+};
+
+#endif //MINESWEEPER_SPECTATOR_STREAM_H
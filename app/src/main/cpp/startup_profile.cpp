@@ -0,0 +1,83 @@
+#include "startup_profile.h"
+#include <cstdio>
+
+void StartupProfile::begin(int64_t nanos) {
+    startNanos = nanos;
+    for (bool &isMarked: marked) {
+        isMarked = false;
+    }
+}
+
+void StartupProfile::mark(StartupPhase phase, int64_t nanos) {
+    auto index = static_cast<size_t>(phase);
+    if (marked[index]) {
+        return;
+    }
+    marked[index] = true;
+    phaseNanos[index] = nanos;
+}
+
+bool StartupProfile::isMarked(StartupPhase phase) const {
+    return marked[static_cast<size_t>(phase)];
+}
+
+bool StartupProfile::isComplete() const {
+    for (bool isMarked: marked) {
+        if (not isMarked) {
+            return false;
+        }
+    }
+    return true;
+}
+
+double StartupProfile::getMillis(StartupPhase phase) const {
+    auto index = static_cast<size_t>(phase);
+    return marked[index] ? static_cast<double>(phaseNanos[index] - startNanos) / 1e6 : -1.0;
+}
+
+int32_t StartupProfile::format(char *buffer, size_t size) const {
+    size_t used = 0;
+    auto append = [&](int32_t written) {
+        if (written > 0) {
+            used += static_cast<size_t>(written);
+        }
+    };
+    auto rest = [&]() { return used < size ? size - used : 0; };
+    auto at = [&]() { return used < size ? buffer + used : nullptr; };
+
+    append(std::snprintf(at(), rest(), "{"));
+    for (int32_t i = 0; i < static_cast<int32_t>(StartupPhase::COUNT); i++) {
+        auto phase = static_cast<StartupPhase>(i);
+        const char *separator = i == 0 ? "" : ",";
+        if (isMarked(phase)) {
+            append(std::snprintf(at(), rest(), "%s\"%s_ms\":%.1f", separator,
+                                 startupPhaseName(phase), getMillis(phase)));
+        } else {
+            append(std::snprintf(at(), rest(), "%s\"%s_ms\":null", separator,
+                                 startupPhaseName(phase)));
+        }
+    }
+    append(std::snprintf(at(), rest(), ",\"shader_cache\":%s,\"atlas_cache\":%s}",
+                         isShaderCached ? "true" : "false", isAtlasCached ? "true" : "false"));
+    return static_cast<int32_t>(used);
+}
+
+const char *startupPhaseName(StartupPhase phase) {
+    switch (phase) {
+        case StartupPhase::EGL_INIT:
+            return "egl_init";
+        case StartupPhase::CONTEXT:
+            return "context";
+        case StartupPhase::SHADERS:
+            return "shaders";
+        case StartupPhase::ASSETS:
+            return "assets";
+        case StartupPhase::FIRST_SWAP:
+            return "first_swap";
+        case StartupPhase::FIRST_FULL_FRAME:
+            return "first_full_frame";
+        case StartupPhase::COUNT:
+            break;
+    }
+    return "unknown";
+}
@@ -0,0 +1,58 @@
+#ifndef MINESWEEPER_STARTUP_PROFILE_H
+#define MINESWEEPER_STARTUP_PROFILE_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Milestones of bringing up the renderer, in the order a cold start usually reaches them. Assets
+// load in the background, so ASSETS may land after FIRST_SWAP.
+enum class StartupPhase {
+    // The display is initialized and a config chosen.
+    EGL_INIT,
+    // The window surface and GL context exist and are current.
+    CONTEXT,
+    // Every shader program is linked, from source or from the program cache.
+    SHADERS,
+    // The cell atlas is loaded and on the GPU.
+    ASSETS,
+    // The first frame was presented, possibly before the assets arrived.
+    FIRST_SWAP,
+    // The first frame drawn with every asset was presented.
+    FIRST_FULL_FRAME,
+    COUNT
+};
+
+// Timestamps of each startup phase relative to the start, reported once as one JSON object so
+// startup logs can be collected and compared across runs and devices.
+class StartupProfile {
+public:
+    void begin(int64_t nanos);
+
+    // Only the first mark of a phase counts.
+    void mark(StartupPhase phase, int64_t nanos);
+
+    bool isMarked(StartupPhase phase) const;
+
+    bool isComplete() const;
+
+    // Milliseconds from begin to the phase, or -1 if it is not marked.
+    double getMillis(StartupPhase phase) const;
+
+    // Writes e.g. {"egl_init_ms":3.1,...,"first_full_frame_ms":41.0,"shader_cache":true,
+    // "atlas_cache":true} without a newline. Unmarked phases are null. Returns the length written,
+    // like snprintf.
+    int32_t format(char *buffer, size_t size) const;
+
+    // Whether the programs and the atlas came from their caches, reported alongside the phases.
+    bool isShaderCached = false;
+    bool isAtlasCached = false;
+
+private:
+    int64_t startNanos = 0;
+    int64_t phaseNanos[static_cast<size_t>(StartupPhase::COUNT)] = {};
+    bool marked[static_cast<size_t>(StartupPhase::COUNT)] = {};
+};
+
+const char *startupPhaseName(StartupPhase phase);
+
+#endif //MINESWEEPER_STARTUP_PROFILE_H
@@ -0,0 +1,470 @@
+#include "stats_store.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const char LOG_MAGIC[4] = {'M', 'S', 'G', 'L'};
+const char INDEX_MAGIC[4] = {'M', 'S', 'S', 'I'};
+
+struct LogHeader {
+    char magic[4];
+    uint32_t version;
+};
+
+struct IndexHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t topK;
+    uint32_t recentGames;
+    uint64_t coveredRecords;
+    uint64_t count;
+    uint64_t hash;
+};
+
+static_assert(sizeof(LogHeader) == 8, "LogHeader is written to disk as is");
+static_assert(sizeof(IndexHeader) == 40, "IndexHeader is written to disk as is");
+static_assert(sizeof(DifficultyStats) % 8 == 0, "entries are hashed in 8 byte words");
+
+constexpr int32_t KEY_BITS = 21;
+
+// Records read from the log per call when replaying it.
+constexpr int64_t REPLAY_CHUNK = 4096;
+
+uint64_t packKey(int32_t width, int32_t height, int32_t mineCount) {
+    return static_cast<uint64_t>(width) << (2 * KEY_BITS) |
+           static_cast<uint64_t>(height) << KEY_BITS | static_cast<uint64_t>(mineCount);
+}
+
+// 32-bit FNV-1a over every field before the checksum.
+uint32_t checksumOf(const GameRecord &record) {
+    const auto *bytes = reinterpret_cast<const uint8_t *>(&record);
+    uint32_t hash = 0x811c9dc5u;
+    for (size_t i = 0; i < offsetof(GameRecord, checksum); i++) {
+        hash = (hash ^ bytes[i]) * 0x01000193u;
+    }
+    return hash;
+}
+
+uint64_t hashEntries(const std::vector<DifficultyStats> &entries) {
+    const auto *bytes = reinterpret_cast<const uint8_t *>(entries.data());
+    size_t size = entries.size() * sizeof(DifficultyStats);
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, bytes + i, sizeof(word));
+        hash = (hash ^ word) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+bool isValidRecord(const GameRecord &record) {
+    auto fits = [](int32_t value) { return value > 0 and value < (1 << KEY_BITS); };
+    return fits(record.width) and fits(record.height) and fits(record.mineCount) and
+           record.durationMillis >= 0 and record.threeBV >= 0 and record.clicks >= 0 and
+           (record.outcome == VICTORY or record.outcome == STEPPED_MINE);
+}
+
+// Writes all of size bytes, retrying short writes.
+bool writeAll(int file, const void *data, size_t size) {
+    const auto *bytes = static_cast<const uint8_t *>(data);
+    while (size > 0) {
+        ssize_t written = ::write(file, bytes, size);
+        if (written < 0 and errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        bytes += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+bool readAll(int file, void *data, size_t size, off_t offset) {
+    auto *bytes = static_cast<uint8_t *>(data);
+    while (size > 0) {
+        ssize_t got = pread(file, bytes, size, offset);
+        if (got < 0 and errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            return false;
+        }
+        bytes += got;
+        size -= static_cast<size_t>(got);
+        offset += got;
+    }
+    return true;
+}
+
+off_t recordOffset(int64_t record) {
+    return static_cast<off_t>(sizeof(LogHeader) + record * sizeof(GameRecord));
+}
+
+}
+
+StatsStore::StatsStore(int32_t compactEvery)
+        : compactEvery(std::max(compactEvery, 1)), writer(std::make_shared<IndexWriter>()) {}
+
+StatsStore::~StatsStore() {
+    close();
+}
+
+bool StatsStore::open(const std::string &directory) {
+    close();
+    if (mkdir(directory.c_str(), 0700) != 0 and errno != EEXIST) {
+        return false;
+    }
+    std::string logPath = directory + "/games.log";
+    int file = ::open(logPath.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+    if (file < 0) {
+        return false;
+    }
+    struct stat status{};
+    fstat(file, &status);
+    LogHeader header{};
+    if (status.st_size < static_cast<off_t>(sizeof(header))) {
+        // New, or its creation was cut short before the header was whole
+        std::memcpy(header.magic, LOG_MAGIC, sizeof(LOG_MAGIC));
+        header.version = STATS_STORE_VERSION;
+        if (ftruncate(file, 0) != 0 or not writeAll(file, &header, sizeof(header))) {
+            ::close(file);
+            return false;
+        }
+    } else if (not readAll(file, &header, sizeof(header), 0) or
+               std::memcmp(header.magic, LOG_MAGIC, sizeof(LOG_MAGIC)) != 0 or
+               header.version != STATS_STORE_VERSION) {
+        ::close(file);
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    logFile = file;
+    std::string indexPath = directory + "/stats.idx";
+    rebuilt = not readIndex(indexPath) or not replay(compactedRecords);
+    if (rebuilt) {
+        entries.clear();
+        entryIndex.clear();
+        compactedRecords = 0;
+        replay(0);
+    }
+    replayedRecords = records - compactedRecords;
+    {
+        std::lock_guard<std::mutex> writerLock(writer->mutex);
+        writer->path = indexPath;
+        writer->writtenRecords = compactedRecords;
+    }
+    if (records != compactedRecords) {
+        compactInBackground();
+    }
+    return true;
+}
+
+void StatsStore::close() {
+    if (not isOpen()) {
+        return;
+    }
+    bool isDirty;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        isDirty = records != compactedRecords;
+    }
+    if (isDirty) {
+        compact();
+    }
+    {
+        std::unique_lock<std::mutex> writerLock(writer->mutex);
+        writer->idle.wait(writerLock, [this]() { return writer->pending == 0; });
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    ::close(logFile);
+    logFile = -1;
+    records = 0;
+    compactedRecords = 0;
+    replayedRecords = 0;
+    rebuilt = false;
+    entries.clear();
+    entryIndex.clear();
+}
+
+bool StatsStore::isOpen() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return logFile >= 0;
+}
+
+bool StatsStore::append(GameRecord record) {
+    if (not isValidRecord(record)) {
+        return false;
+    }
+    record.checksum = checksumOf(record);
+    std::lock_guard<std::mutex> lock(mutex);
+    if (logFile < 0) {
+        return false;
+    }
+    // One write per record, so a crash leaves at most one torn record, at the end
+    if (not writeAll(logFile, &record, sizeof(record))) {
+        // Whatever part of it went out would misalign every record after it
+        if (ftruncate(logFile, recordOffset(records)) != 0) {
+            ::close(logFile);
+            logFile = -1;
+        }
+        return false;
+    }
+    apply(record);
+    records += 1;
+    if (records - compactedRecords >= compactEvery) {
+        compactInBackground();
+    }
+    return true;
+}
+
+bool StatsStore::getStats(int32_t width, int32_t height, int32_t mineCount,
+                          DifficultyStats &outStats) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    const DifficultyStats *stats = findStats(width, height, mineCount);
+    if (stats == nullptr) {
+        return false;
+    }
+    outStats = *stats;
+    return true;
+}
+
+void StatsStore::getBestTimes(int32_t width, int32_t height, int32_t mineCount,
+                              std::vector<GameRecord> &outRecords) const {
+    outRecords.clear();
+    std::lock_guard<std::mutex> lock(mutex);
+    const DifficultyStats *stats = findStats(width, height, mineCount);
+    if (stats != nullptr) {
+        outRecords.assign(stats->best, stats->best + stats->bestCount);
+    }
+}
+
+int64_t StatsStore::getRecordCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return records;
+}
+
+int64_t StatsStore::getReplayedRecords() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return replayedRecords;
+}
+
+bool StatsStore::wasRebuilt() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return rebuilt;
+}
+
+bool StatsStore::compact() {
+    int64_t snapshotRecords;
+    std::vector<DifficultyStats> snapshot;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (logFile < 0) {
+            return false;
+        }
+        snapshotRecords = records;
+        snapshot = entries;
+        compactedRecords = records;
+    }
+    return writer->write(snapshotRecords, snapshot);
+}
+
+void StatsStore::compactInBackground() {
+    // The snapshot is taken here, under the lock, so appends go on while it is written
+    compactedRecords = records;
+    {
+        std::lock_guard<std::mutex> writerLock(writer->mutex);
+        writer->pending += 1;
+    }
+    spawn(getEngineScheduler(), writeIndex(writer, records, entries));
+}
+
+Task<void> StatsStore::writeIndex(std::shared_ptr<IndexWriter> writer, int64_t records,
+                                  std::vector<DifficultyStats> entries) {
+    writer->write(records, entries);
+    std::lock_guard<std::mutex> lock(writer->mutex);
+    writer->pending -= 1;
+    writer->idle.notify_all();
+    co_return;
+}
+
+bool StatsStore::IndexWriter::write(int64_t records, const std::vector<DifficultyStats> &entries) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (records <= writtenRecords) {
+        // A newer snapshot got here first
+        return true;
+    }
+    IndexHeader header{};
+    std::memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    header.version = STATS_STORE_VERSION;
+    header.topK = STATS_TOP_K;
+    header.recentGames = STATS_RECENT_GAMES;
+    header.coveredRecords = static_cast<uint64_t>(records);
+    header.count = entries.size();
+    header.hash = hashEntries(entries);
+
+    // Renamed over the old index only once it is on storage, so a crash leaves one or the other
+    std::string temporaryPath = path + ".tmp";
+    int file = ::open(temporaryPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (file < 0) {
+        return false;
+    }
+    bool isWritten = writeAll(file, &header, sizeof(header)) and
+                     writeAll(file, entries.data(), entries.size() * sizeof(DifficultyStats)) and
+                     fsync(file) == 0;
+    ::close(file);
+    if (not isWritten or std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+        std::remove(temporaryPath.c_str());
+        return false;
+    }
+    writtenRecords = records;
+    return true;
+}
+
+bool StatsStore::readIndex(const std::string &path) {
+    int file = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (file < 0) {
+        return false;
+    }
+    IndexHeader header{};
+    struct stat status{};
+    fstat(file, &status);
+    bool isValid = readAll(file, &header, sizeof(header), 0) and
+                   std::memcmp(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) == 0 and
+                   header.version == STATS_STORE_VERSION and header.topK == STATS_TOP_K and
+                   header.recentGames == STATS_RECENT_GAMES and
+                   static_cast<uint64_t>(status.st_size) ==
+                   sizeof(header) + header.count * sizeof(DifficultyStats);
+    if (isValid) {
+        entries.resize(header.count);
+        isValid = readAll(file, entries.data(), entries.size() * sizeof(DifficultyStats),
+                          sizeof(header)) and hashEntries(entries) == header.hash;
+    }
+    ::close(file);
+    entryIndex.clear();
+    for (size_t i = 0; isValid and i < entries.size(); i++) {
+        const DifficultyStats &stats = entries[i];
+        isValid = entryIndex.emplace(packKey(stats.width, stats.height, stats.mineCount), i).second;
+    }
+    if (not isValid) {
+        entries.clear();
+        entryIndex.clear();
+        return false;
+    }
+    compactedRecords = static_cast<int64_t>(header.coveredRecords);
+    return true;
+}
+
+bool StatsStore::replay(int64_t first) {
+    struct stat status{};
+    if (fstat(logFile, &status) != 0) {
+        return false;
+    }
+    int64_t available = (status.st_size - recordOffset(0)) / static_cast<off_t>(sizeof(GameRecord));
+    std::vector<GameRecord> chunk;
+    records = first;
+    while (records < available) {
+        int64_t count = std::min(REPLAY_CHUNK, available - records);
+        chunk.resize(static_cast<size_t>(count));
+        if (not readAll(logFile, chunk.data(), chunk.size() * sizeof(GameRecord),
+                        recordOffset(records))) {
+            return false;
+        }
+        for (const GameRecord &record: chunk) {
+            if (record.checksum != checksumOf(record) or not isValidRecord(record)) {
+                available = records;
+                break;
+            }
+            apply(record);
+            records += 1;
+        }
+    }
+    if (records > available) {
+        // The index is ahead of the log; the caller starts over from the first record
+        return false;
+    }
+    // Cut off a torn or damaged end, so appends go on from the last good record
+    return status.st_size == recordOffset(records) or
+           ftruncate(logFile, recordOffset(records)) == 0;
+}
+
+void StatsStore::apply(const GameRecord &record) {
+    DifficultyStats &stats = statsFor(record.width, record.height, record.mineCount);
+    bool isWin = record.outcome == VICTORY;
+    stats.games += 1;
+    stats.clicks += record.clicks;
+    stats.threeBV += record.threeBV;
+    if (isWin) {
+        stats.wins += 1;
+        stats.winMillis += record.durationMillis;
+        stats.currentStreak += 1;
+        stats.bestStreak = std::max(stats.bestStreak, stats.currentStreak);
+    } else {
+        stats.currentStreak = 0;
+    }
+
+    if (stats.recentCount == STATS_RECENT_GAMES) {
+        int32_t dropped = stats.recentMillis[stats.recentNext];
+        if (dropped >= 0) {
+            stats.recentWins -= 1;
+            stats.recentWinMillis -= dropped;
+        }
+    } else {
+        stats.recentCount += 1;
+    }
+    stats.recentMillis[stats.recentNext] = isWin ? record.durationMillis : -1;
+    if (isWin) {
+        stats.recentWins += 1;
+        stats.recentWinMillis += record.durationMillis;
+    }
+    stats.recentNext = (stats.recentNext + 1) % STATS_RECENT_GAMES;
+
+    if (not isWin) {
+        return;
+    }
+    // Insertion into the sorted top k: after every time at or under this one
+    int32_t position = 0;
+    while (position < stats.bestCount and
+           stats.best[position].durationMillis <= record.durationMillis) {
+        position += 1;
+    }
+    if (position == STATS_TOP_K) {
+        return;
+    }
+    int32_t last = std::min(stats.bestCount, STATS_TOP_K - 1);
+    for (int32_t i = last; i > position; i--) {
+        stats.best[i] = stats.best[i - 1];
+    }
+    stats.best[position] = record;
+    stats.bestCount = std::min(stats.bestCount + 1, STATS_TOP_K);
+}
+
+DifficultyStats &StatsStore::statsFor(int32_t width, int32_t height, int32_t mineCount) {
+    auto [found, isNew] = entryIndex.emplace(packKey(width, height, mineCount), entries.size());
+    if (isNew) {
+        DifficultyStats &stats = entries.emplace_back();
+        std::memset(&stats, 0, sizeof(stats));
+        stats.width = width;
+        stats.height = height;
+        stats.mineCount = mineCount;
+    }
+    return entries[found->second];
+}
+
+const DifficultyStats *StatsStore::findStats(int32_t width, int32_t height,
+                                             int32_t mineCount) const {
+    if (std::min({width, height, mineCount}) <= 0 or
+        std::max({width, height, mineCount}) >= (1 << KEY_BITS)) {
+        return nullptr;
+    }
+    auto found = entryIndex.find(packKey(width, height, mineCount));
+    return found == entryIndex.end() ? nullptr : &entries[found->second];
+}
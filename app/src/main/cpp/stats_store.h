@@ -0,0 +1,191 @@
+#ifndef MINESWEEPER_STATS_STORE_H
+#define MINESWEEPER_STATS_STORE_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+#include "game_objects.h"
+#include "task_scheduler.h"
+
+// Bump whenever the log record or index layout changes. An index of another version is rebuilt
+// from the log; a log of another version is refused.
+constexpr uint32_t STATS_STORE_VERSION = 1;
+
+// Fastest wins kept per difficulty.
+constexpr int32_t STATS_TOP_K = 10;
+
+// Games the rolling aggregates cover per difficulty.
+constexpr int32_t STATS_RECENT_GAMES = 100;
+
+// One finished game as it is appended to the log.
+struct GameRecord {
+    uint64_t seed;
+    // Wall clock time the game ended, in Unix milliseconds.
+    int64_t finishedAtMillis;
+    int32_t width;
+    int32_t height;
+    int32_t mineCount;
+    // From the first reveal to the end of the game.
+    int32_t durationMillis;
+    int32_t threeBV;
+    // Reveals, flags and chords the player made.
+    int32_t clicks;
+    // VICTORY or STEPPED_MINE.
+    int32_t outcome;
+    // FNV-1a hash of the fields above, set by StatsStore, so a torn write at the end of the log is
+    // found and cut off when the store opens.
+    uint32_t checksum;
+};
+
+static_assert(sizeof(GameRecord) == 48, "log records have a fixed size");
+
+// Everything queried about one difficulty, i.e. one board size and mine count. Kept up to date on
+// every append and stored whole in the index, so queries are a lookup and a copy.
+struct DifficultyStats {
+    int32_t width;
+    int32_t height;
+    int32_t mineCount;
+    // Entries of best in use.
+    int32_t bestCount;
+    int64_t games;
+    int64_t wins;
+    // Durations of the wins, added up.
+    int64_t winMillis;
+    int64_t clicks;
+    int64_t threeBV;
+    int32_t currentStreak;
+    int32_t bestStreak;
+    // The last recentCount games, in a ring overwritten from recentNext: a win's duration, or -1
+    // for a loss. recentWins and recentWinMillis add them up.
+    int32_t recentCount;
+    int32_t recentNext;
+    int32_t recentWins;
+    int32_t reserved;
+    int64_t recentWinMillis;
+    int32_t recentMillis[STATS_RECENT_GAMES];
+    // Wins, fastest first; among equal times the earlier one.
+    GameRecord best[STATS_TOP_K];
+
+    double getWinRate() const {
+        return games == 0 ? 0.0 : static_cast<double>(wins) / static_cast<double>(games);
+    }
+
+    double getRecentWinRate() const {
+        return recentCount == 0 ? 0.0 : static_cast<double>(recentWins) / recentCount;
+    }
+};
+
+static_assert(std::is_trivially_copyable_v<DifficultyStats>, "the index stores entries as bytes");
+
+/*
+ * A store is a directory of two files, in the host's byte order:
+ *
+ *   games.log  "MSGL", u32 STATS_STORE_VERSION, then GameRecords, appended and never rewritten
+ *   stats.idx  "MSSI", u32 STATS_STORE_VERSION, u32 STATS_TOP_K, u32 STATS_RECENT_GAMES,
+ *              u64 log records covered, u64 difficulty count, u64 FNV-1a hash of the entries,
+ *              then the DifficultyStats entries
+ *
+ * The index is a snapshot of the aggregates after the first n records of the log. Opening reads it
+ * and replays only the records after those n; a missing or damaged index is rebuilt from the whole
+ * log. Compaction writes a new snapshot, so the replayed tail stays short.
+ */
+
+// Finished games and the leaderboard built from them. Appends and queries cost O(STATS_TOP_K) and
+// never read the log. Every compactEvery appends the index is rewritten on the engine scheduler,
+// off the caller's thread. Safe to use from several threads.
+class StatsStore {
+public:
+    explicit StatsStore(int32_t compactEvery = 256);
+
+    StatsStore(const StatsStore &) = delete;
+
+    StatsStore &operator=(const StatsStore &) = delete;
+
+    // Closes the store.
+    ~StatsStore();
+
+    // Opens the store in directory, creating it if needed. Returns false if the log cannot be
+    // opened or was written by another STATS_STORE_VERSION.
+    bool open(const std::string &directory);
+
+    // Compacts if anything was appended since the last compaction and waits for compactions still
+    // running in the background, then closes the log.
+    void close();
+
+    bool isOpen() const;
+
+    // Appends a finished game to the log and folds it into the aggregates. The write reaches the
+    // OS at once, which keeps it through an app crash, but is not synced to storage. Returns
+    // false if the log could not be written or the record is not a finished game. Sides and mine
+    // counts must stay under 2^21.
+    bool append(GameRecord record);
+
+    // Returns false, leaving outStats alone, if no game of that difficulty was recorded.
+    bool getStats(int32_t width, int32_t height, int32_t mineCount,
+                  DifficultyStats &outStats) const;
+
+    // Replaces outRecords with the fastest wins of a difficulty, fastest first.
+    void getBestTimes(int32_t width, int32_t height, int32_t mineCount,
+                      std::vector<GameRecord> &outRecords) const;
+
+    int64_t getRecordCount() const;
+
+    // Log records the last open replayed on top of the index, and whether it had to rebuild the
+    // index from the whole log.
+    int64_t getReplayedRecords() const;
+
+    bool wasRebuilt() const;
+
+    // Writes the index on the calling thread and waits for it to reach storage. Returns false if
+    // it could not be written.
+    bool compact();
+
+private:
+    // Snapshots are written one at a time, and never over a newer one.
+    struct IndexWriter {
+        std::mutex mutex;
+        std::condition_variable idle;
+        std::string path;
+        int64_t writtenRecords = -1;
+        // Background writes spawned and not yet done.
+        int32_t pending = 0;
+
+        bool write(int64_t records, const std::vector<DifficultyStats> &entries);
+    };
+
+    static Task<void> writeIndex(std::shared_ptr<IndexWriter> writer, int64_t records,
+                                 std::vector<DifficultyStats> entries);
+
+    bool readIndex(const std::string &path);
+
+    // Replays log records from first on, cutting off a torn or damaged end. Returns false if the
+    // log holds fewer than first records or cannot be read.
+    bool replay(int64_t first);
+
+    void apply(const GameRecord &record);
+
+    DifficultyStats &statsFor(int32_t width, int32_t height, int32_t mineCount);
+
+    const DifficultyStats *findStats(int32_t width, int32_t height, int32_t mineCount) const;
+
+    void compactInBackground();
+
+    int32_t compactEvery;
+    mutable std::mutex mutex;
+    int logFile = -1;
+    int64_t records = 0;
+    int64_t compactedRecords = 0;
+    int64_t replayedRecords = 0;
+    bool rebuilt = false;
+    std::vector<DifficultyStats> entries;
+    // Index of each difficulty's entry, keyed by width, height and mine count packed 21 bits each.
+    std::unordered_map<uint64_t, size_t> entryIndex;
+    std::shared_ptr<IndexWriter> writer;
+};
+
+#endif //MINESWEEPER_STATS_STORE_H
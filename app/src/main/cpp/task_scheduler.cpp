@@ -0,0 +1,109 @@
+#include "task_scheduler.h"
+#include "worker_pool.h"
+
+namespace {
+
+// The scheduler and deque of the worker running on this thread, if any.
+thread_local TaskScheduler *currentScheduler = nullptr;
+thread_local int32_t currentWorker = -1;
+
+}
+
+TaskScheduler &getEngineScheduler() {
+    static auto *scheduler = new TaskScheduler(0);
+    return *scheduler;
+}
+
+TaskScheduler::TaskScheduler(int32_t threads) {
+    int32_t count = resolveThreadCount(threads);
+    for (int32_t i = 0; i < count; i++) {
+        deques.push_back(std::make_unique<WorkerDeque>());
+    }
+    for (int32_t i = 0; i < count; i++) {
+        this->threads.emplace_back(&TaskScheduler::runWorker, this, i);
+    }
+}
+
+TaskScheduler::~TaskScheduler() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        isStopping = true;
+    }
+    wake.notify_all();
+    for (auto &thread: threads) {
+        thread.join();
+    }
+}
+
+int32_t TaskScheduler::getThreadCount() const {
+    return static_cast<int32_t>(threads.size());
+}
+
+void TaskScheduler::post(std::coroutine_handle<> handle) {
+    // A worker keeps what it forks; outsiders spread their work over every deque
+    int32_t index = currentScheduler == this ? currentWorker : static_cast<int32_t>(
+            nextDeque.fetch_add(1, std::memory_order_relaxed) % deques.size());
+    {
+        WorkerDeque &deque = *deques[index];
+        std::lock_guard<std::mutex> lock(deque.mutex);
+        deque.handles.push_back(handle);
+    }
+    queued.fetch_add(1, std::memory_order_release);
+    // Taking the lock orders this with a worker that is between checking queued and sleeping
+    { std::lock_guard<std::mutex> lock(sleepMutex); }
+    wake.notify_one();
+}
+
+TaskSchedulerStats TaskScheduler::getStats() const {
+    TaskSchedulerStats stats;
+    stats.resumed = resumed.load(std::memory_order_relaxed);
+    stats.stolen = stolen.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void TaskScheduler::runWorker(int32_t index) {
+    currentScheduler = this;
+    currentWorker = index;
+    while (true) {
+        std::coroutine_handle<> handle;
+        if (popOwn(index, handle) or steal(index, handle)) {
+            queued.fetch_sub(1, std::memory_order_relaxed);
+            resumed.fetch_add(1, std::memory_order_relaxed);
+            handle.resume();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.wait(lock, [this]() {
+            return isStopping or queued.load(std::memory_order_acquire) > 0;
+        });
+        if (isStopping and queued.load(std::memory_order_acquire) == 0) {
+            return;
+        }
+    }
+}
+
+bool TaskScheduler::popOwn(int32_t index, std::coroutine_handle<> &outHandle) {
+    WorkerDeque &deque = *deques[index];
+    std::lock_guard<std::mutex> lock(deque.mutex);
+    if (deque.handles.empty()) {
+        return false;
+    }
+    outHandle = deque.handles.back();
+    deque.handles.pop_back();
+    return true;
+}
+
+bool TaskScheduler::steal(int32_t thief, std::coroutine_handle<> &outHandle) {
+    auto count = static_cast<int32_t>(deques.size());
+    for (int32_t offset = 1; offset < count; offset++) {
+        WorkerDeque &deque = *deques[(thief + offset) % count];
+        std::lock_guard<std::mutex> lock(deque.mutex);
+        if (not deque.handles.empty()) {
+            outHandle = deque.handles.front();
+            deque.handles.pop_front();
+            stolen.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
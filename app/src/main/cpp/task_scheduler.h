@@ -0,0 +1,377 @@
+#ifndef MINESWEEPER_TASK_SCHEDULER_H
+#define MINESWEEPER_TASK_SCHEDULER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Cancellation is cooperative: work holds a token and checks it between steps, returning early
+// once it is set. A default token is never cancelled.
+class CancellationToken {
+public:
+    CancellationToken() = default;
+
+    bool isCancelled() const {
+        return state != nullptr and state->load(std::memory_order_relaxed);
+    }
+
+private:
+    friend class CancellationSource;
+
+    explicit CancellationToken(std::shared_ptr<const std::atomic<bool>> state)
+            : state(std::move(state)) {}
+
+    std::shared_ptr<const std::atomic<bool>> state;
+};
+
+class CancellationSource {
+public:
+    CancellationSource() : state(std::make_shared<std::atomic<bool>>(false)) {}
+
+    CancellationToken getToken() const {
+        return CancellationToken(state);
+    }
+
+    // Cancels every token handed out so far, at once and for good.
+    void cancel() {
+        state->store(true, std::memory_order_relaxed);
+    }
+
+    bool isCancelled() const {
+        return state->load(std::memory_order_relaxed);
+    }
+
+private:
+    std::shared_ptr<std::atomic<bool>> state;
+};
+
+struct TaskSchedulerStats {
+    // Coroutines resumed by workers.
+    uint64_t resumed = 0;
+    // Of those, taken from another worker's deque.
+    uint64_t stolen = 0;
+};
+
+// A fixed set of worker threads that resume coroutines. Each worker has its own deque: it pushes
+// and pops work at the back, so a coroutine that forks runs its children hot in cache, while idle
+// workers steal from the front of the others' deques, taking the oldest and usually largest work.
+// Work posted from outside the pool is dealt round-robin over the deques.
+class TaskScheduler {
+public:
+    // threads follows resolveThreadCount: 0 or less means one worker per hardware thread.
+    explicit TaskScheduler(int32_t threads);
+
+    TaskScheduler(const TaskScheduler &) = delete;
+
+    TaskScheduler &operator=(const TaskScheduler &) = delete;
+
+    // Lets the workers run out of work, then joins them. Nothing may be posted meanwhile.
+    ~TaskScheduler();
+
+    int32_t getThreadCount() const;
+
+    // Queues handle to be resumed on a worker.
+    void post(std::coroutine_handle<> handle);
+
+    // co_await scheduler.schedule() continues the awaiting coroutine on a worker.
+    auto schedule() {
+        struct ScheduleAwaiter {
+            TaskScheduler &scheduler;
+
+            bool await_ready() const noexcept {
+                return false;
+            }
+
+            void await_suspend(std::coroutine_handle<> handle) {
+                scheduler.post(handle);
+            }
+
+            void await_resume() const noexcept {}
+        };
+        return ScheduleAwaiter{*this};
+    }
+
+    TaskSchedulerStats getStats() const;
+
+private:
+    struct alignas(64) WorkerDeque {
+        std::mutex mutex;
+        std::deque<std::coroutine_handle<>> handles;
+    };
+
+    void runWorker(int32_t index);
+
+    bool popOwn(int32_t index, std::coroutine_handle<> &outHandle);
+
+    bool steal(int32_t thief, std::coroutine_handle<> &outHandle);
+
+    std::vector<std::unique_ptr<WorkerDeque>> deques;
+    std::vector<std::thread> threads;
+    // Handles posted and not yet taken, so idle workers know whether to look or sleep.
+    std::atomic<int64_t> queued{0};
+    std::atomic<uint32_t> nextDeque{0};
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    bool isStopping = false;
+    std::atomic<uint64_t> resumed{0};
+    std::atomic<uint64_t> stolen{0};
+};
+
+// The scheduler the engine's background work shares, one worker per hardware thread, created on
+// first use and never destroyed.
+TaskScheduler &getEngineScheduler();
+
+template<class T>
+class Task;
+
+namespace task_detail {
+
+struct PromiseBase {
+    // Resumed when the task finishes: whoever co_awaited it.
+    std::coroutine_handle<> continuation = std::noop_coroutine();
+
+    std::suspend_always initial_suspend() const noexcept {
+        return {};
+    }
+
+    struct FinalAwaiter {
+        bool await_ready() const noexcept {
+            return false;
+        }
+
+        template<class Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+            return handle.promise().continuation;
+        }
+
+        void await_resume() const noexcept {}
+    };
+
+    FinalAwaiter final_suspend() const noexcept {
+        return {};
+    }
+
+    // The engine does not use exceptions.
+    void unhandled_exception() const noexcept {
+        std::terminate();
+    }
+};
+
+template<class T>
+struct Promise : PromiseBase {
+    std::optional<T> value;
+
+    Task<T> get_return_object();
+
+    void return_value(T result) {
+        value.emplace(std::move(result));
+    }
+};
+
+template<>
+struct Promise<void> : PromiseBase {
+    Task<void> get_return_object();
+
+    void return_void() const noexcept {}
+};
+
+}
+
+// A lazily started coroutine producing a T. Nothing runs until it is co_awaited, which runs it on
+// the awaiting thread until it suspends, and resumes the awaiter when it finishes. Hand tasks to
+// whenAll to run them on a scheduler's workers, or to syncWait from a thread outside the pool.
+template<class T = void>
+class Task {
+public:
+    using promise_type = task_detail::Promise<T>;
+
+    Task(Task &&other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+
+    Task &operator=(Task &&other) noexcept {
+        if (this != &other) {
+            if (handle) {
+                handle.destroy();
+            }
+            handle = std::exchange(other.handle, nullptr);
+        }
+        return *this;
+    }
+
+    Task(const Task &) = delete;
+
+    Task &operator=(const Task &) = delete;
+
+    ~Task() {
+        if (handle) {
+            handle.destroy();
+        }
+    }
+
+    bool await_ready() const noexcept {
+        return false;
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        handle.promise().continuation = awaiting;
+        return handle;
+    }
+
+    T await_resume() {
+        if constexpr (not std::is_void_v<T>) {
+            return std::move(*handle.promise().value);
+        }
+    }
+
+private:
+    friend struct task_detail::Promise<T>;
+
+    explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+namespace task_detail {
+
+template<class T>
+Task<T> Promise<T>::get_return_object() {
+    return Task<T>(std::coroutine_handle<Promise<T>>::from_promise(*this));
+}
+
+inline Task<void> Promise<void>::get_return_object() {
+    return Task<void>(std::coroutine_handle<Promise<void>>::from_promise(*this));
+}
+
+// A coroutine that starts at once and frees itself when done, for the glue below.
+struct Detached {
+    struct promise_type {
+        Detached get_return_object() const noexcept {
+            return {};
+        }
+
+        std::suspend_never initial_suspend() const noexcept {
+            return {};
+        }
+
+        std::suspend_never final_suspend() const noexcept {
+            return {};
+        }
+
+        void return_void() const noexcept {}
+
+        void unhandled_exception() const noexcept {
+            std::terminate();
+        }
+    };
+};
+
+// Counts down the children of a whenAll and the parent itself; whoever reaches zero resumes the
+// parent, so it never matters whether the children finish before the parent suspends.
+struct JoinState {
+    std::atomic<size_t> remaining;
+    std::coroutine_handle<> parent;
+
+    void arrive() {
+        if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            parent.resume();
+        }
+    }
+};
+
+template<class T>
+Detached runJoined(TaskScheduler &scheduler, Task<T> task, std::optional<T> &outResult,
+                   JoinState &state) {
+    co_await scheduler.schedule();
+    outResult.emplace(co_await task);
+    state.arrive();
+}
+
+template<class Start>
+struct JoinAwaiter {
+    JoinState &state;
+    Start start;
+
+    bool await_ready() const noexcept {
+        return false;
+    }
+
+    bool await_suspend(std::coroutine_handle<> parent) {
+        state.parent = parent;
+        start();
+        return state.remaining.fetch_sub(1, std::memory_order_acq_rel) != 1;
+    }
+
+    void await_resume() const noexcept {}
+};
+
+inline Detached runSpawned(TaskScheduler &scheduler, Task<void> task) {
+    co_await scheduler.schedule();
+    co_await task;
+}
+
+template<class T>
+struct SyncState {
+    std::mutex mutex;
+    std::condition_variable done;
+    bool isDone = false;
+    std::optional<T> result;
+};
+
+template<class T>
+Detached runSync(Task<T> task, SyncState<T> &state) {
+    std::optional<T> result;
+    result.emplace(co_await task);
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.result = std::move(result);
+    state.isDone = true;
+    state.done.notify_one();
+}
+
+}
+
+// Runs every task on the scheduler's workers at once and completes with their results in order,
+// resuming on the worker that finished last.
+template<class T>
+Task<std::vector<T>> whenAll(TaskScheduler &scheduler, std::vector<Task<T>> tasks) {
+    std::vector<std::optional<T>> results(tasks.size());
+    task_detail::JoinState state{tasks.size() + 1, nullptr};
+    auto start = [&]() {
+        for (size_t i = 0; i < tasks.size(); i++) {
+            task_detail::runJoined(scheduler, std::move(tasks[i]), results[i], state);
+        }
+    };
+    co_await task_detail::JoinAwaiter<decltype(start)>{state, start};
+    std::vector<T> values;
+    values.reserve(results.size());
+    for (auto &result: results) {
+        values.push_back(std::move(*result));
+    }
+    co_return values;
+}
+
+// Starts task on one of the scheduler's workers without waiting for it. Nothing hears when it
+// finishes, so it should hold a CancellationToken for whatever it may outlive.
+inline void spawn(TaskScheduler &scheduler, Task<void> task) {
+    task_detail::runSpawned(scheduler, std::move(task));
+}
+
+// Blocks the calling thread, which must not be one of a scheduler's workers, until task is done.
+template<class T>
+T syncWait(Task<T> task) {
+    task_detail::SyncState<T> state;
+    task_detail::runSync(std::move(task), state);
+    std::unique_lock<std::mutex> lock(state.mutex);
+    state.done.wait(lock, [&state]() { return state.isDone; });
+    return std::move(*state.result);
+}
+
+#endif //MINESWEEPER_TASK_SCHEDULER_H
@@ -0,0 +1,244 @@
+#include "trace.h"
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#if defined(__ANDROID__)
+#include <android/trace.h>
+#endif
+
+std::atomic<bool> isTraceEnabled{false};
+
+namespace {
+
+constexpr size_t OP_COUNT = static_cast<size_t>(TraceOp::COUNT);
+constexpr size_t COUNTER_COUNT = static_cast<size_t>(TraceCounter::COUNT);
+
+struct OpLatency {
+    std::mutex mutex;
+    LatencyHistogram histogram;
+};
+
+// Counters are bumped from the UI and render threads, so each gets its own cache line.
+struct alignas(64) Counter {
+    std::atomic<uint64_t> value{0};
+};
+
+OpLatency opLatencies[OP_COUNT];
+Counter counters[COUNTER_COUNT];
+
+int64_t steadyNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#if !defined(__ANDROID__)
+
+struct TraceEvent {
+    int64_t timeNanos;
+    // The span's duration, or the counter's new value.
+    int64_t value;
+    uint32_t threadIndex;
+    bool isCounter;
+    // TraceOp or TraceCounter.
+    int32_t id;
+};
+
+// Claimed slot by slot with claimed; committed catches up once each slot is written.
+std::unique_ptr<TraceEvent[]> events;
+std::atomic<size_t> claimed{0};
+std::atomic<size_t> committed{0};
+std::atomic<uint64_t> dropped{0};
+int64_t traceStartNanos = 0;
+std::mutex bufferMutex;
+
+std::atomic<uint32_t> nextThreadIndex{0};
+thread_local uint32_t threadIndex = nextThreadIndex.fetch_add(1, std::memory_order_relaxed);
+
+void emitEvent(int64_t timeNanos, int64_t value, bool isCounter, int32_t id) {
+    size_t slot = claimed.fetch_add(1, std::memory_order_relaxed);
+    if (slot < TRACE_EVENT_CAPACITY) {
+        events[slot] = TraceEvent{timeNanos, value, threadIndex, isCounter, id};
+    } else {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    committed.fetch_add(1, std::memory_order_release);
+}
+
+#endif
+
+}
+
+void startTracing() {
+#if !defined(__ANDROID__)
+    std::lock_guard<std::mutex> lock(bufferMutex);
+    if (isTracing()) {
+        return;
+    }
+    if (not events) {
+        events = std::make_unique<TraceEvent[]>(TRACE_EVENT_CAPACITY);
+    }
+    claimed.store(0, std::memory_order_relaxed);
+    committed.store(0, std::memory_order_relaxed);
+    dropped.store(0, std::memory_order_relaxed);
+    traceStartNanos = steadyNanos();
+#endif
+    isTraceEnabled.store(true, std::memory_order_release);
+}
+
+void stopTracing() {
+    isTraceEnabled.store(false, std::memory_order_relaxed);
+#if !defined(__ANDROID__)
+    // A writer that saw tracing on has claimed its slot and is about to commit it
+    while (committed.load(std::memory_order_acquire) < claimed.load(std::memory_order_relaxed)) {
+        std::this_thread::yield();
+    }
+#endif
+}
+
+size_t getTraceEventCount() {
+#if defined(__ANDROID__)
+    return 0;
+#else
+    size_t count = committed.load(std::memory_order_acquire);
+    return count < TRACE_EVENT_CAPACITY ? count : TRACE_EVENT_CAPACITY;
+#endif
+}
+
+uint64_t getDroppedTraceEvents() {
+#if defined(__ANDROID__)
+    return 0;
+#else
+    return dropped.load(std::memory_order_relaxed);
+#endif
+}
+
+bool writeChromeTrace(const std::string &path) {
+    FILE *file = std::fopen(path.c_str(), "w");
+    if (file == nullptr) {
+        return false;
+    }
+    std::fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+#if !defined(__ANDROID__)
+    std::lock_guard<std::mutex> lock(bufferMutex);
+    const char *separator = "\n";
+    size_t count = getTraceEventCount();
+    for (size_t i = 0; i < count; i++) {
+        const TraceEvent &event = events[i];
+        double micros = static_cast<double>(event.timeNanos - traceStartNanos) / 1e3;
+        if (event.isCounter) {
+            std::fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,"
+                               "\"args\":{\"value\":%lld}}",
+                         separator, traceCounterName(static_cast<TraceCounter>(event.id)), micros,
+                         static_cast<long long>(event.value));
+        } else {
+            std::fprintf(file, "%s{\"name\":\"%s\",\"cat\":\"minesweeper\",\"ph\":\"X\","
+                               "\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+                         separator, traceOpName(static_cast<TraceOp>(event.id)), micros,
+                         static_cast<double>(event.value) / 1e3, event.threadIndex);
+        }
+        separator = ",\n";
+    }
+#endif
+    std::fprintf(file, "\n]}\n");
+    bool isWritten = std::ferror(file) == 0;
+    return std::fclose(file) == 0 and isWritten;
+}
+
+int64_t beginTraceSpan(TraceOp op) {
+#if defined(__ANDROID__)
+    ATrace_beginSection(traceOpName(op));
+#else
+    (void) op;
+#endif
+    return steadyNanos();
+}
+
+void endTraceSpan(TraceOp op, int64_t startNanos) {
+    int64_t endNanos = steadyNanos();
+#if defined(__ANDROID__)
+    // Sections must pair up per thread, even if tracing stopped inside this one
+    ATrace_endSection();
+#else
+    if (isTracing()) {
+        emitEvent(startNanos, endNanos - startNanos, false, static_cast<int32_t>(op));
+    }
+#endif
+    OpLatency &latency = opLatencies[static_cast<size_t>(op)];
+    std::lock_guard<std::mutex> lock(latency.mutex);
+    latency.histogram.record(static_cast<uint64_t>(endNanos - startNanos));
+}
+
+void countTrace(TraceCounter counter, uint64_t amount) {
+    uint64_t value = counters[static_cast<size_t>(counter)].value.fetch_add(
+            amount, std::memory_order_relaxed) + amount;
+    if (not isTracing()) {
+        return;
+    }
+#if defined(__ANDROID__)
+    ATrace_setCounter(traceCounterName(counter), static_cast<int64_t>(value));
+#else
+    emitEvent(steadyNanos(), static_cast<int64_t>(value), true, static_cast<int32_t>(counter));
+#endif
+}
+
+uint64_t getTraceCount(TraceCounter counter) {
+    return counters[static_cast<size_t>(counter)].value.load(std::memory_order_relaxed);
+}
+
+LatencyHistogram getTraceLatency(TraceOp op) {
+    OpLatency &latency = opLatencies[static_cast<size_t>(op)];
+    std::lock_guard<std::mutex> lock(latency.mutex);
+    return latency.histogram;
+}
+
+void resetTraceStats() {
+    for (OpLatency &latency: opLatencies) {
+        std::lock_guard<std::mutex> lock(latency.mutex);
+        latency.histogram.clear();
+    }
+    for (Counter &counter: counters) {
+        counter.value.store(0, std::memory_order_relaxed);
+    }
+}
+
+const char *traceOpName(TraceOp op) {
+    switch (op) {
+        case TraceOp::JNI_CALL:
+            return "jni_call";
+        case TraceOp::HANDLE_INPUT:
+            return "handle_input";
+        case TraceOp::REVEAL_CELL:
+            return "reveal_cell";
+        case TraceOp::CHORD_CELL:
+            return "chord_cell";
+        case TraceOp::TOGGLE_FLAG:
+            return "toggle_flag";
+        case TraceOp::UPDATE_STATUS:
+            return "update_status";
+        case TraceOp::RENDER:
+            return "render";
+        case TraceOp::DRAW_BOARD:
+            return "draw_board";
+        case TraceOp::COUNT:
+            break;
+    }
+    return "unknown";
+}
+
+const char *traceCounterName(TraceCounter counter) {
+    switch (counter) {
+        case TraceCounter::CELLS_REVEALED:
+            return "cells_revealed";
+        case TraceCounter::JNI_CALLS:
+            return "jni_calls";
+        case TraceCounter::GL_DRAWS:
+            return "gl_draws";
+        case TraceCounter::COUNT:
+            break;
+    }
+    return "unknown";
+}
@@ -0,0 +1,108 @@
+#ifndef MINESWEEPER_TRACE_H
+#define MINESWEEPER_TRACE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "latency_histogram.h"
+
+// Operations timed by ScopedTrace, each with its own latency histogram.
+enum class TraceOp {
+    // A call from the activity into native code.
+    JNI_CALL,
+    // Draining the input queue and applying the gestures it completes.
+    HANDLE_INPUT,
+    REVEAL_CELL,
+    CHORD_CELL,
+    TOGGLE_FLAG,
+    UPDATE_STATUS,
+    // One frame from clear to swap.
+    RENDER,
+    // Updating and drawing the visible board, the per-frame part of the UI refresh.
+    DRAW_BOARD,
+    COUNT
+};
+
+// Running totals kept whether or not tracing is on.
+enum class TraceCounter {
+    CELLS_REVEALED,
+    JNI_CALLS,
+    GL_DRAWS,
+    COUNT
+};
+
+/*
+ * While tracing is on, every ScopedTrace records its duration in its operation's histogram and
+ * emits a span: an ATrace section on Android, visible in Perfetto and systrace, or an event in a
+ * fixed buffer elsewhere that writeChromeTrace saves as Chrome trace JSON. Counter changes are
+ * emitted the same way. While it is off a span costs one relaxed load and reads no clock, so spans
+ * stay in production builds.
+ */
+extern std::atomic<bool> isTraceEnabled;
+
+inline bool isTracing() {
+    return isTraceEnabled.load(std::memory_order_relaxed);
+}
+
+// Turns tracing on and clears the event buffer. Histograms and counters keep accumulating until
+// resetTraceStats.
+void startTracing();
+
+// Turns tracing off and waits for events being written to land. Spans open at that moment are
+// counted in their histograms but not emitted.
+void stopTracing();
+
+// Events the buffer holds, TRACE_EVENT_CAPACITY at most; later ones are dropped and counted.
+constexpr size_t TRACE_EVENT_CAPACITY = 1 << 16;
+
+size_t getTraceEventCount();
+
+uint64_t getDroppedTraceEvents();
+
+// Writes the buffer as a Chrome trace JSON file, for chrome://tracing or ui.perfetto.dev. Call
+// after stopTracing. Returns false if the file could not be written; Android builds have no
+// buffer and always write an empty trace.
+bool writeChromeTrace(const std::string &path);
+
+// Called by ScopedTrace; returns the start time.
+int64_t beginTraceSpan(TraceOp op);
+
+void endTraceSpan(TraceOp op, int64_t startNanos);
+
+// Times the enclosing scope as op.
+class ScopedTrace {
+public:
+    explicit ScopedTrace(TraceOp op) : op(op), startNanos(isTracing() ? beginTraceSpan(op) : -1) {}
+
+    ScopedTrace(const ScopedTrace &) = delete;
+
+    ScopedTrace &operator=(const ScopedTrace &) = delete;
+
+    ~ScopedTrace() {
+        if (startNanos >= 0) {
+            endTraceSpan(op, startNanos);
+        }
+    }
+
+private:
+    TraceOp op;
+    int64_t startNanos;
+};
+
+// Adds amount to counter, safe from any thread.
+void countTrace(TraceCounter counter, uint64_t amount = 1);
+
+uint64_t getTraceCount(TraceCounter counter);
+
+// A copy of op's histogram of span durations in nanoseconds.
+LatencyHistogram getTraceLatency(TraceOp op);
+
+// Clears every histogram and counter.
+void resetTraceStats();
+
+const char *traceOpName(TraceOp op);
+
+const char *traceCounterName(TraceCounter counter);
+
+#endif //MINESWEEPER_TRACE_H
@@ -0,0 +1,53 @@
+#include "transposition_table.h"
+#include <cstring>
+
+namespace {
+
+constexpr int32_t WORDS = TranspositionTable::PAYLOAD_WORDS;
+
+void pack(const ComponentVerdict &verdict, uint64_t (&words)[WORDS]) {
+    words[0] = static_cast<uint64_t>(verdict.safeMask) | static_cast<uint64_t>(verdict.mineMask) << 32;
+    std::memcpy(&words[1], verdict.probability.data(), verdict.probability.size());
+}
+
+void unpack(const uint64_t (&words)[WORDS], ComponentVerdict &verdict) {
+    verdict.safeMask = static_cast<uint32_t>(words[0]);
+    verdict.mineMask = static_cast<uint32_t>(words[0] >> 32);
+    std::memcpy(verdict.probability.data(), &words[1], verdict.probability.size());
+}
+
+}
+
+static_assert(sizeof(ComponentVerdict::probability) == 4 * sizeof(uint64_t),
+              "probabilities must fill the last four payload words");
+
+TranspositionTable::TranspositionTable(int32_t sizeBits)
+        : slots(new Slot[size_t{1} << sizeBits]),
+          mask((uint64_t{1} << sizeBits) - 1) {}
+
+bool TranspositionTable::lookup(uint64_t key, ComponentVerdict &outVerdict) const {
+    const Slot &slot = slots[key & mask];
+    uint64_t words[WORDS];
+    uint64_t check = slot.check.load(std::memory_order_acquire);
+    for (int32_t i = 0; i < WORDS; i++) {
+        words[i] = slot.payload[i].load(std::memory_order_relaxed);
+        check ^= words[i];
+    }
+    if (check != key) {
+        return false;
+    }
+    unpack(words, outVerdict);
+    return true;
+}
+
+void TranspositionTable::store(uint64_t key, const ComponentVerdict &verdict) {
+    Slot &slot = slots[key & mask];
+    uint64_t words[WORDS];
+    pack(verdict, words);
+    uint64_t check = key;
+    for (int32_t i = 0; i < WORDS; i++) {
+        slot.payload[i].store(words[i], std::memory_order_relaxed);
+        check ^= words[i];
+    }
+    slot.check.store(check, std::memory_order_release);
+}
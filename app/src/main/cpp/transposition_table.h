@@ -0,0 +1,68 @@
+#ifndef MINESWEEPER_TRANSPOSITION_TABLE_H
+#define MINESWEEPER_TRANSPOSITION_TABLE_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+// What enumerating every mine layout of one frontier component concluded: cells that are safe or
+// mines in every layout, and each cell's mine probability quantised to 1/255.
+struct ComponentVerdict {
+    static constexpr int32_t MAX_CELLS = 32;
+
+    uint32_t safeMask;
+    uint32_t mineMask;
+    std::array<uint8_t, MAX_CELLS> probability;
+};
+
+// Per-solver cache counters, merged across threads by whoever reports them.
+struct SolverCacheStats {
+    int64_t lookups = 0;
+    int64_t hits = 0;
+    // Components enumerated on a miss and the time that took.
+    int64_t solves = 0;
+    uint64_t solveNanos = 0;
+
+    void merge(const SolverCacheStats &other) {
+        lookups += other.lookups;
+        hits += other.hits;
+        solves += other.solves;
+        solveNanos += other.solveNanos;
+    }
+
+    double getHitRate() const {
+        return lookups == 0 ? 0.0 : static_cast<double>(hits) / static_cast<double>(lookups);
+    }
+
+    // Hits priced at the mean cost of a miss.
+    uint64_t getEstimatedSavedNanos() const {
+        return solves == 0 ? 0 : solveNanos / solves * static_cast<uint64_t>(hits);
+    }
+};
+
+// Fixed-size, always-replace cache of component verdicts keyed by Zobrist hash, shared by solver
+// threads without locks. Each slot stores its key XORed with its payload words; a reader that races
+// a writer sees a mismatching key and treats the slot as a miss.
+class TranspositionTable {
+public:
+    static constexpr int32_t PAYLOAD_WORDS = 5;
+
+    // The table holds 2^sizeBits slots of 48 bytes.
+    explicit TranspositionTable(int32_t sizeBits);
+
+    bool lookup(uint64_t key, ComponentVerdict &outVerdict) const;
+
+    void store(uint64_t key, const ComponentVerdict &verdict);
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> check{0};
+        std::array<std::atomic<uint64_t>, PAYLOAD_WORDS> payload{};
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    uint64_t mask;
+};
+
+#endif //MINESWEEPER_TRANSPOSITION_TABLE_H
@@ -0,0 +1,53 @@
+#ifndef MINESWEEPER_WORKER_POOL_H
+#define MINESWEEPER_WORKER_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// Hands out [first, last) ranges of a fixed amount of work to whichever worker asks next.
+class ChunkCounter {
+public:
+    ChunkCounter(int64_t total, int64_t chunk) : total(total), chunk(chunk) {}
+
+    bool claim(int64_t &outFirst, int64_t &outLast) {
+        int64_t first = next.fetch_add(chunk, std::memory_order_relaxed);
+        if (first >= total) {
+            return false;
+        }
+        outFirst = first;
+        outLast = std::min(first + chunk, total);
+        return true;
+    }
+
+private:
+    std::atomic<int64_t> next{0};
+    int64_t total;
+    int64_t chunk;
+};
+
+// 0 or less means one worker per hardware thread.
+inline int32_t resolveThreadCount(int32_t requested) {
+    if (requested > 0) {
+        return requested;
+    }
+    return static_cast<int32_t>(std::max(1u, std::thread::hardware_concurrency()));
+}
+
+// Runs worker(index) for index in [0, threadCount), index 0 on the calling thread, and returns once
+// all of them have finished.
+template<class Worker>
+void runWorkers(int32_t threadCount, Worker worker) {
+    std::vector<std::thread> threads;
+    for (int32_t i = 1; i < threadCount; i++) {
+        threads.emplace_back(worker, i);
+    }
+    worker(0);
+    for (auto &thread: threads) {
+        thread.join();
+    }
+}
+
+#endif //MINESWEEPER_WORKER_POOL_H
@@ -0,0 +1,31 @@
+#ifndef MINESWEEPER_ZOBRIST_H
+#define MINESWEEPER_ZOBRIST_H
+
+#include <cstdint>
+#include "game_objects.h"
+#include "seeding.h"
+
+// Visible state codes hashed per cell. Hidden cells contribute nothing, so an untouched board
+// hashes to 0 and each reveal or flag is a single XOR.
+constexpr int32_t VISIBLE_HIDDEN = -1;
+constexpr int32_t VISIBLE_MINE = 9;
+constexpr int32_t VISIBLE_FLAG = 10;
+
+inline int32_t visibleCode(const Cell &cell) {
+    if (cell.isRevealed) {
+        return cell.isMine ? VISIBLE_MINE : cell.adjacentMines;
+    }
+    return cell.isFlagged ? VISIBLE_FLAG : VISIBLE_HIDDEN;
+}
+
+// Zobrist key of a cell index in a given state. Keys are derived by hashing rather than read from a
+// table, so they cost no memory however large the board is.
+inline uint64_t zobristKey(int32_t cellIndex, int32_t code) {
+    if (code == VISIBLE_HIDDEN) {
+        return 0;
+    }
+    return splitMix64((static_cast<uint64_t>(cellIndex) << 4 | static_cast<uint64_t>(code)) ^
+                      0x2545f4914f6cdd1dULL);
+}
+
+#endif //MINESWEEPER_ZOBRIST_H
@@ -1,9 +0,0 @@
-package com.lumi.minesweeper
-
-enum class GameStatus() {
-    ERROR,
-    STARTED,
-    ONGOING,
-    STEPPED_MINE,
-    VICTORY
-}
\ No newline at end of file
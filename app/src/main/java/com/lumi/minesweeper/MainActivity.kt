@@ -1,26 +1,16 @@
 package com.lumi.minesweeper
 
+import android.content.pm.ApplicationInfo
 import android.os.Bundle
 import android.util.Log
-import android.view.View
-import android.widget.Button
-import android.widget.GridLayout
 import android.widget.Toast
-import androidx.appcompat.app.AlertDialog
-import androidx.appcompat.app.AppCompatActivity
-import androidx.lifecycle.lifecycleScope
+import androidx.annotation.Keep
 import com.google.androidgamesdk.GameActivity
-import com.lumi.minesweeper.databinding.ActivityMainBinding
-import kotlinx.coroutines.Dispatchers
-import kotlinx.coroutines.launch
-import kotlinx.coroutines.withContext
-
-private const val TAG = "MainActivity_minesweeper"
 
 class MainActivity : GameActivity() {
-    private lateinit var binding: ActivityMainBinding
-
     companion object {
+        private const val TAG = "Minesweeper"
+
         init {
             System.loadLibrary("minesweeper") // Ensure this matches your C++ library name
         }
@@ -28,182 +18,67 @@ class MainActivity : GameActivity() {
 
     // Declare native methods
     private external fun initGameBoard(width: Int, height: Int, mineCount: Int): Long
-    private external fun initializeBoard(gameBoardPtr: Long, firstClickX: Int, firstClickY: Int)
-    private external fun revealCell(gameBoardPtr: Long, x: Int, y: Int)
-    private external fun toggleFlag(gameBoardPtr: Long, x: Int, y: Int)
-    private external fun getCell(gameBoardPtr: Long, x: Int, y: Int): CellData
-    private external fun getGameState(gameBoardPtr: Long): GameStatus
     private external fun cleanup(gameBoardPtr: Long)
+    private external fun setTracing(enabled: Boolean)
+    // Fills out with the totals of cells revealed, JNI calls and GL draws
+    private external fun readTraceCounters(out: LongArray)
+    // Fills out with the count, p50, p90, p99 and max nanoseconds of one traced operation, by
+    // TraceOp ordinal
+    private external fun readTraceLatency(op: Int, out: LongArray)
 
-    private lateinit var gameBoardLayout: GridLayout
     private var gameBoardPtr = 0L
+    private var isTracing = false
+    // Reused by every trace query, so reading the stats allocates no arrays
+    private val traceCounters = LongArray(3)
+    private val traceLatency = LongArray(5)
     private val gridWidth = 10
     private val gridHeight = 10
     private val mineCount = 20
-    private lateinit var gameState: GameStatus
-    private var isFirstClickFlag = true
 
     override fun onCreate(savedInstanceState: Bundle?) {
         super.onCreate(savedInstanceState)
-        binding = ActivityMainBinding.inflate(layoutInflater)
-        setContentView(binding.root)
-
-        // Initialize the game board
-        gameBoardPtr = initGameBoard(gridWidth, gridHeight, mineCount)
-        gameState = getGameState(gameBoardPtr)
-        createBoardUI()
-    }
-
-    override fun onDestroy() {
-        super.onDestroy()
-        // Clean up native resources
-        cleanup(gameBoardPtr)
-    }
-
-    private fun createBoardUI() {
-        gameBoardLayout = binding.gameBoard
-        gameBoardLayout.columnCount = gridWidth
-        gameBoardLayout.rowCount = gridHeight
-        gameBoardLayout.removeAllViews()
-
-        for (y in 0 until gridHeight) {
-            for (x in 0 until gridWidth) {
-                val button = Button(this)
-                val params = GridLayout.LayoutParams().apply {
-                    width = 0
-                    height = 0
-                    columnSpec = GridLayout.spec(x, 1f)
-                    rowSpec = GridLayout.spec(y, 1f)
-                    setMargins(2, 2, 2, 2)
-                }
-                button.layoutParams = params
-                button.text = ""
-                button.setBackgroundColor(getColor(android.R.color.white))
-
-                // Set click listeners
-                button.setOnClickListener {
-                    onCellClicked(x, y, button)
-                    for (y2 in 0 until gridHeight) {
-                        for (x2 in 0 until gridWidth) {
-                            Log.d(TAG, "createBoardUI: $x2, $y2, ${getCell(gameBoardPtr, x2, y2)}")
-                        }
-                    }
-                }
 
-                button.setOnLongClickListener {
-                    onCellLongClicked(x, y, button)
-                    true
-                }
+        // Debuggable builds trace by default, so Perfetto captures show the native sections and
+        // counters. Release builds keep the spans compiled in but switched off.
+        isTracing = applicationInfo.flags and ApplicationInfo.FLAG_DEBUGGABLE != 0
+        setTracing(isTracing)
 
-                gameBoardLayout.addView(button)
-            }
-        }
+        // Initialize the game board. The native renderer draws it on the activity's surface and
+        // handles taps (reveal) and long presses (flag) itself.
+        gameBoardPtr = initGameBoard(gridWidth, gridHeight, mineCount)
     }
 
-    private fun onCellClicked(x: Int, y: Int, button: Button) {
-        if (isFirstClickFlag) {
-            isFirstClickFlag = false
-            lifecycleScope.launch {
-                withContext(Dispatchers.Default) {
-                    initializeBoard(gameBoardPtr, x, y)
-                }
-                button.isEnabled = false
-            }
-        }
-        lifecycleScope.launch {
-            withContext(Dispatchers.Default) {
-                revealCell(gameBoardPtr, x, y)
-            }
-            gameState = withContext(Dispatchers.Default) {
-                getGameState(gameBoardPtr)
-            }
-            for (y2 in 0 until gridHeight) {
-                for (x2 in 0 until gridWidth) {
-                    val buttonToUpdate = gameBoardLayout.getChildAt(y2 * gridWidth + x2) as Button
-                    updateCellUI(x2, y2, buttonToUpdate)
-                }
-            }
-            Log.d(TAG, "onCellClicked: $gameState")
-            when (gameState) {
-                GameStatus.STEPPED_MINE -> {
-                    Toast.makeText(this@MainActivity, "Game Over!", Toast.LENGTH_SHORT).show()
-                    revealAllMines()
-                    disableAllButtons()
-                }
-
-                GameStatus.VICTORY -> {
-                    Toast.makeText(this@MainActivity, "You Win!", Toast.LENGTH_SHORT).show()
-                    revealAllMines()
-                    disableAllButtons()
-                }
-
-                else -> {
-                    return@launch
-                }
-            }
+    override fun onPause() {
+        super.onPause()
+        if (isTracing) {
+            logTraceSummary()
         }
     }
 
-    private fun onCellLongClicked(x: Int, y: Int, button: Button) {
-        lifecycleScope.launch {
-            withContext(Dispatchers.Default) {
-                toggleFlag(gameBoardPtr, x, y)
-            }
-            updateCellUI(x, y, button)
-
-            gameState = withContext(Dispatchers.Default) {
-                getGameState(gameBoardPtr)
-            }
-
-            if (gameState == GameStatus.VICTORY) {
-                Toast.makeText(this@MainActivity, "You Win!", Toast.LENGTH_SHORT).show()
-                revealAllMines()
-                disableAllButtons()
-            }
+    private fun logTraceSummary() {
+        readTraceCounters(traceCounters)
+        Log.i(TAG, "cells revealed ${traceCounters[0]}, JNI calls ${traceCounters[1]}, " +
+                "GL draws ${traceCounters[2]}")
+        // TraceOp::REVEAL_CELL and TraceOp::RENDER
+        for ((name, op) in listOf("reveal" to 2, "render" to 6)) {
+            readTraceLatency(op, traceLatency)
+            Log.i(TAG, "$name: ${traceLatency[0]} spans, p50 ${traceLatency[1]} ns, " +
+                    "p99 ${traceLatency[3]} ns, max ${traceLatency[4]} ns")
         }
     }
 
-    private fun updateCellUI(x: Int, y: Int, button: Button) {
-        val cellData = getCell(gameBoardPtr, x, y)
-        if (cellData.isRevealed) {
-            button.isEnabled = false
-            if (cellData.isMine) {
-                button.text = "💣"
-                button.setBackgroundColor(getColor(android.R.color.holo_red_dark))
-            } else if (cellData.adjacentMines > 0) {
-                button.text = cellData.adjacentMines.toString()
-                button.setBackgroundColor(getColor(android.R.color.darker_gray))
-            } else {
-                button.text = ""
-                button.setBackgroundColor(getColor(android.R.color.darker_gray))
-            }
-        } else if (cellData.isFlagged) {
-            button.text = "🚩"
-            button.setBackgroundColor(getColor(android.R.color.holo_orange_light))
-        } else {
-            button.text = ""
-            button.setBackgroundColor(getColor(android.R.color.white))
+    // Called by the native renderer from its own thread when a move ends the game
+    @Keep
+    fun onGameFinished(isWon: Boolean) {
+        runOnUiThread {
+            val message = if (isWon) "You Win!" else "Game Over!"
+            Toast.makeText(this@MainActivity, message, Toast.LENGTH_SHORT).show()
         }
     }
 
-    private fun revealAllMines() {
-        for (y in 0 until gridHeight) {
-            for (x in 0 until gridWidth) {
-                val cellData = getCell(gameBoardPtr, x, y)
-                if (cellData.isMine) {
-                    val button = gameBoardLayout.getChildAt(y * gridWidth + x) as Button
-                    button.text = "💣"
-                    button.isEnabled = false
-                    button.setBackgroundColor(getColor(android.R.color.holo_red_dark))
-                }
-            }
-        }
-    }
-
-    private fun disableAllButtons() {
-        for (i in 0 until gridWidth * gridHeight) {
-            val button = gameBoardLayout.getChildAt(i) as Button
-            button.isEnabled = false
-        }
+    override fun onDestroy() {
+        super.onDestroy()
+        // Clean up native resources
+        cleanup(gameBoardPtr)
     }
 }